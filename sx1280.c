@@ -8,21 +8,31 @@
  * Copyright (C) 2025 Jeff Shelton
  */
 
-/*
- * TODO: Jam multiple Ethernet packets into one transmission.
- */
-
+#include <linux/bitmap.h>
+#include <linux/ctype.h>
 #include <linux/device.h>
+#include <linux/hrtimer.h>
 #include <linux/init.h>
 #include <linux/if_arp.h>
 #include <linux/ip.h>
 #include <linux/ipv6.h>
+#include <linux/kthread.h>
+#include <linux/lz4.h>
 #include <linux/module.h>
 #include <linux/netdevice.h>
 #include <linux/of.h>
+#include <linux/prandom.h>
+#include <linux/random.h>
 #include <linux/spi/spi.h>
 #include <linux/types.h>
+#include <linux/udp.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/version.h>
 #include <net/cfg80211.h>
+#include <net/ip.h>
+#include <net/ipv6.h>
+
+#include "sx1280_tdma.h"
 
 // Constants.
 #define SX1280_FREQ_XOSC_HZ 52000000
@@ -360,12 +370,16 @@ union sx1280_packet_status {
 #define SX1280_IRQ_RANGING_MASTER_RESULT_VALID   BIT(9)
 #define SX1280_IRQ_RANGING_MASTER_TIMEOUT        BIT(10)
 #define SX1280_IRQ_RANGING_SLAVE_REQUEST_VALID   BIT(11)
-#define SX1280_IRQ_CAD_DONE                      BIT(11)
+#define SX1280_IRQ_CAD_DONE                      BIT(12)
 #define SX1280_IRQ_CAD_DETECTED                  BIT(13)
 #define SX1280_IRQ_RX_TX_TIMEOUT                 BIT(14)
 #define SX1280_IRQ_PREAMBLE_DETECTED             BIT(15)
 #define SX1280_IRQ_ADVANCED_RANGING_DONE         BIT(15)
 
+/* IRQs that mark a received packet as failed */
+#define SX1280_IRQ_RX_ERRORS \
+  (SX1280_IRQ_SYNC_WORD_ERROR | SX1280_IRQ_HEADER_ERROR | SX1280_IRQ_CRC_ERROR)
+
 /* GetPacketStatus status flags */
 #define SX1280_PACKET_STATUS_STATUS_RX_NO_ACK BIT(5)
 #define SX1280_PACKET_STATUS_STATUS_PKT_SENT  BIT(0)
@@ -621,1697 +635,12789 @@ static const struct sx1280_config sx1280_default_config = {
 
 #define SX1280_BUSY_TIMEOUT_US 500000
 
-enum sx1280_state {
-  SX1280_STATE_SLEEP,
-  SX1280_STATE_STANDBY,
-  SX1280_STATE_FS,
-  SX1280_STATE_TX,
-  SX1280_STATE_RX,
-};
+/*
+ * SPI clock limits. The clock from the device tree is capped at the datasheet
+ * maximum and stepped down towards the minimum until the self test passes.
+ */
+#define SX1280_SPI_SPEED_MAX_HZ 18000000
+#define SX1280_SPI_SPEED_MIN_HZ 1000000
+#define SX1280_SPI_TEST_LEN 15
+#define SX1280_SPI_TEST_ROUNDS 4
 
-/* The private, internal structure for the SX1280 driver. */
-struct sx1280_priv {
-  /* Devices */
-  struct net_device *netdev;
-  struct spi_device *spi;
+/*
+ * Bounds on how long to spin on BUSY before sleeping. The actual spin time is
+ * calibrated during setup from how long BUSY stays high after a command.
+ */
+#define SX1280_BUSY_SPIN_MIN_US 2
+#define SX1280_BUSY_SPIN_MAX_US 50
+#define SX1280_BUSY_CALIBRATION_ROUNDS 8
 
-  /* GPIOs + IRQs */
-  struct gpio_desc *busy;
-  struct gpio_desc *dio;
-  struct gpio_desc *reset;
-  int dio_index;
-  int irq;
+/*
+ * Header sizes assumed for time on air with variable length packets, which
+ * carry the payload length before the payload.
+ */
+#define SX1280_GFSK_HEADER_BITS 8
+#define SX1280_FLRC_HEADER_BITS 16
+#define SX1280_FLRC_SYNC_WORD_BITS 32
+#define SX1280_FLRC_TAIL_BITS 6
 
-  /*
-   * The current configuration of the SX1280.
-   */
-  struct sx1280_config cfg;
+/*
+ * TX timeouts allow for the packet's time on air, plus an eighth and this much
+ * again for ramp up and scheduling.
+ */
+#define SX1280_TX_TIMEOUT_MARGIN_US 1000
 
-  /* The packet waiting to be transmitted. */
-  struct sk_buff *tx_skb;
+/*
+ * Duty cycle limits, with the percentage held in thousandths of a percent. The
+ * default of 100% leaves the limiter off.
+ */
+#define SX1280_DUTY_MILLIPERCENT_MAX 100000
+#define SX1280_DUTY_WINDOW_S_DEFAULT 3600
+#define SX1280_DUTY_WINDOW_S_MAX 86400
 
-  struct workqueue_struct *xmit_queue;
-  struct work_struct tx_work;
+/*
+ * Frequency hopping: the size of the channel table and of the hop sequence
+ * through it, and the range of dwell times for time-based hopping.
+ */
+#define SX1280_FHSS_CHANNELS_MAX 64
+#define SX1280_FHSS_SEQ_MAX 256
+#define SX1280_FHSS_DWELL_US_MIN 1000
+#define SX1280_FHSS_DWELL_US_MAX 10000000
+
+/* Binary sysfs attributes are read through a const pointer since 6.13. */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+#define SX1280_BIN_ATTR_CONST const
+#else
+#define SX1280_BIN_ATTR_CONST
+#endif
 
-  /*
-   * Mutex that locks all uninterruptible operations.
-   *
-   * This mutex should be locked before every transaction involving the chip,
-   * especially in IRQ handlers.
-   */
-  struct mutex lock;
+/*
+ * Spectrum survey: the range swept by default (the whole 2.4 GHz band in 1 MHz
+ * steps), and how many RSSI samples are taken at each step after waiting for
+ * the receiver to settle.
+ */
+#define SX1280_SURVEY_FREQ_HZ_MIN 2400000000
+#define SX1280_SURVEY_FREQ_HZ_MAX 2500000000
+#define SX1280_SURVEY_STEP_HZ_DEFAULT 1000000
+#define SX1280_SURVEY_STEP_HZ_MIN 10000
+#define SX1280_SURVEY_STEPS_MAX 1024
+#define SX1280_SURVEY_SAMPLES_DEFAULT 8
+#define SX1280_SURVEY_SAMPLES_MAX 32
+#define SX1280_SURVEY_SETTLE_US_DEFAULT 50
+#define SX1280_SURVEY_SETTLE_US_MAX 10000
 
-  /*
-   * Spinlock that protects all atomic, Tx-related operations spawned from xmit.
-   */
-  struct spinlock tx_lock;
+/*
+ * Automatic channel selection: the candidate table, how much quieter another
+ * channel has to be to move to it (in RSSI units of -0.5 dBm, so 3 dB), and
+ * how many frames an interval needs for its packet error rate to count.
+ */
+#define SX1280_ACS_CHANNELS_MAX 64
+#define SX1280_ACS_HYSTERESIS 6
+#define SX1280_ACS_PER_PERCENT_DEFAULT 20
+#define SX1280_ACS_INTERVAL_S_DEFAULT 60
+#define SX1280_ACS_INTERVAL_S_MAX 86400
+#define SX1280_ACS_MIN_FRAMES 16
 
-  /*
-   * The current operational mode state of the chip, used to determine what is
-   * currently going on within the chip and what actions are legal to take.
-   */
-  enum sx1280_state state;
+/*
+ * Adaptive data rate: the default margin to keep above what a rate needs, the
+ * extra needed before stepping up to it (in quarter dB, so 2 dB), how heavily
+ * each packet's level is weighted into the average (1 / 2^shift), how many
+ * packets it takes before acting on it, how long to go without hearing
+ * anything before falling back to the most robust rate, and how many decisions
+ * are kept for link/adr_history.
+ */
+#define SX1280_ADR_MARGIN_DB_DEFAULT 6
+#define SX1280_ADR_MARGIN_DB_MAX 30
+#define SX1280_ADR_HYSTERESIS_QDB 8
+#define SX1280_ADR_EWMA_SHIFT 3
+#define SX1280_ADR_MIN_PACKETS 4
+#define SX1280_ADR_FALLBACK_MS 5000
+#define SX1280_ADR_HISTORY_LEN 16
 
-  /*
-   * Wait queue for all operations that require the chip to be idle, such as
-   * setting mode and packet parameters. All waiters in the queue will be
-   * triggered at once and must hold a lock.
-   */
-  wait_queue_head_t idle_wait;
+/* Received packets that may wait for NAPI before more are dropped. */
+#define SX1280_RX_QUEUE_LEN 64
 
-  /*
-   * Whether the device / driver is fully initialized.
-   *
-   * Used to gate the IRQ handler so that it doesn't receive spurious interrupts
-   * during setup, causing the device / driver to enter an invalid state.
-   */
-  bool initialized;
+/*
+ * Capacity of the TX ring. The usable depth is configurable up to this size,
+ * though the airtime queue limit usually stops the queue well before that.
+ */
+#define SX1280_TX_RING_SIZE 64
+#define SX1280_TX_RING_DEPTH_DEFAULT 32
 
-#ifdef DEBUG
-  struct delayed_work status_check;
-#endif
-};
+/* Airtime queue limit, in microseconds of estimated time on air; 0 is off. */
+#define SX1280_AQL_TARGET_US_DEFAULT 50000
+#define SX1280_AQL_TARGET_US_MAX 10000000
 
-/****************
-* SPI Functions *
-****************/
+/*
+ * Link layer framing. Every frame starts with a dispatch byte: raw IP packets
+ * are recognized by their version nibble (0x4_ / 0x6_), while the driver's own
+ * headers use dispatch values with the top bit set.
+ */
+#define SX1280_DISPATCH_FRAG 0x80
+#define SX1280_DISPATCH_AGG 0x81
+#define SX1280_DISPATCH_IPHC6 0x82
+#define SX1280_DISPATCH_IPHC4 0x83
+#define SX1280_DISPATCH_LZ4 0x84
+#define SX1280_DISPATCH_ARQ 0x85
+#define SX1280_DISPATCH_ACK 0x86
+#define SX1280_DISPATCH_BEACON 0x87
+#define SX1280_DISPATCH_RATE 0x88
+
+/* Nesting limit for headers within headers, e.g. a fragment within a frame. */
+#define SX1280_LINK_MAX_DEPTH 4
+
+/* Default and largest MTU, which may exceed a single frame via fragmentation. */
+#define SX1280_LINK_MTU_DEFAULT 1280
+#define SX1280_LINK_PAYLOAD_MAX 1500
 
-/**
- * Waits for the BUSY pin to be pulled low, so a SPI transfer can begin.
- *
- * For short waits, which are expected in the vast majority of cases, this
- * function quickly busy-loops. Once the time has surpassed 50 us, it starts
- * sleeping for longer periods before ultimately timing out.
- *
- * @context - process & locked
+/*
+ * Fragment header: dispatch, source node ID, datagram tag, then the fragment's
+ * index and the fragment count minus one packed into a nibble each.
  */
-static int sx1280_wait_busy(struct sx1280_priv *priv) {
-  ktime_t start = ktime_get();
-  s64 wait = 0;
+#define SX1280_FRAG_HDR_LEN 4
+#define SX1280_FRAG_MAX 16
 
-  while (gpiod_get_value_cansleep(priv->busy)) {
-    wait = ktime_us_delta(ktime_get(), start);
+/*
+ * Limits on reassembly: how many datagrams may be reassembled at once, how much
+ * memory they may hold, and how long they may wait for missing fragments by
+ * default (long enough for a full datagram at slow LoRa settings).
+ */
+#define SX1280_REASM_SLOTS 8
+#define SX1280_REASM_MEM_MAX (32 * 1024)
+#define SX1280_REASM_TIMEOUT_MS_DEFAULT 10000
 
-    if (wait < 50) {
-      cpu_relax();
-    } else if (wait < SX1280_BUSY_TIMEOUT_US) {
-      usleep_range(20, 40);
-    } else {
-      return -ETIMEDOUT;
-    }
-  }
+/*
+ * Aggregate frame: the dispatch byte, followed by sub-frames that are each a
+ * length byte and a packet. A frame that isn't full may be held back for up to
+ * the configured delay, which is capped here.
+ */
+#define SX1280_AGG_HDR_LEN 1
+#define SX1280_AGG_SUB_HDR_LEN 1
+#define SX1280_AGG_DELAY_US_MAX 100000
 
-  return 0;
-}
+/*
+ * Compressed IP headers: the dispatch byte, a flags byte saying which fields
+ * are elided, then the fields that are carried inline.
+ */
+#define SX1280_IPHC_HDR_LEN 2
+#define SX1280_IPHC_HDR_MAX 48
+
+#define SX1280_IPHC6_TF BIT(7)
+#define SX1280_IPHC6_NH_UDP BIT(6)
+#define SX1280_IPHC6_HLIM GENMASK(5, 4)
+#define SX1280_IPHC6_HLIM_SHIFT 4
+#define SX1280_IPHC6_SAM GENMASK(3, 2)
+#define SX1280_IPHC6_SAM_SHIFT 2
+#define SX1280_IPHC6_DAM GENMASK(1, 0)
+#define SX1280_IPHC6_DAM_SHIFT 0
+
+/* IPv6 addressing modes. */
+#define SX1280_IPHC6_ADDR_INLINE 0 /* All 128 bits inline */
+#define SX1280_IPHC6_ADDR_LL64 1   /* fe80::/64, 64-bit interface ID inline */
+#define SX1280_IPHC6_ADDR_LL16 2   /* fe80::ff:fe00:XXXX, 16 bits inline */
+#define SX1280_IPHC6_ADDR_SHORT 3  /* Source ::, or destination ff02::XX */
+
+#define SX1280_IPHC4_TOS BIT(7)
+#define SX1280_IPHC4_ID BIT(6)
+#define SX1280_IPHC4_FRAG GENMASK(5, 4)
+#define SX1280_IPHC4_FRAG_SHIFT 4
+#define SX1280_IPHC4_TTL GENMASK(3, 2)
+#define SX1280_IPHC4_TTL_SHIFT 2
+#define SX1280_IPHC4_UDP BIT(1)
+
+/* IPv4 fragment field modes. */
+#define SX1280_IPHC4_FRAG_DF 0
+#define SX1280_IPHC4_FRAG_NONE 1
+#define SX1280_IPHC4_FRAG_INLINE 2
 
-/**
- * Performs an arbitrary SPI transaction with the SX1280, after first waiting
- * for BUSY = 0 (this is necessary for every transaction).
- *
- * @context - process & locked
+/*
+ * LZ4-compressed datagram: the dispatch byte followed by an LZ4 block, which
+ * decompresses to another frame. Datagrams shorter than the minimum are never
+ * worth compressing.
  */
-static int sx1280_transfer(
-  struct sx1280_priv *priv,
-  struct spi_transfer *xfers,
-  unsigned int num_xfers
-) {
-  int err;
-  if (
-    (err = sx1280_wait_busy(priv))
-    || (err = spi_sync_transfer(priv->spi, xfers, num_xfers))
-    || (err = sx1280_wait_busy(priv))
-  ) {
-    return err;
-  }
+#define SX1280_LZ4_HDR_LEN 1
+#define SX1280_LZ4_MIN_LEN 32
 
-  return 0;
-}
+/* Node ID that addresses every node, and so is never a node's own. */
+#define SX1280_NODE_BROADCAST 0xFF
 
-static int sx1280_write(
-  struct sx1280_priv *priv,
-  void *buf,
-  size_t len
-) {
-  int err;
-  if (
-    (err = sx1280_wait_busy(priv))
-    || (err = spi_write(priv->spi, buf, len))
-    || (err = sx1280_wait_busy(priv))
-  ) {
-    return err;
-  }
+/*
+ * ARQ header: dispatch, destination and source node IDs and sequence number,
+ * followed by the frame being carried. ACKs echo the source node ID and
+ * sequence number of the frame they acknowledge, padded out to the mode's
+ * minimum frame size if needed.
+ */
+#define SX1280_ARQ_HDR_LEN 4
+#define SX1280_ARQ_ACK_LEN 3
+#define SX1280_ARQ_ACK_BUF_LEN 8
 
-  return 0;
-}
+/*
+ * ARQ defaults and limits. The ACK delay is the AutoTx delay, which has to
+ * leave the driver time to fill in the ACK after RX done. Retransmissions back
+ * off by a random number of slots (a quarter of the ACK timeout each), up to
+ * 2^SX1280_ARQ_BACKOFF_EXP_MAX slots.
+ */
+#define SX1280_ARQ_RETRIES_DEFAULT 3
+#define SX1280_ARQ_RETRIES_MAX 15
+#define SX1280_ARQ_ACK_DELAY_US_DEFAULT 1000
+#define SX1280_ARQ_ACK_DELAY_US_MIN 100
+#define SX1280_ARQ_ACK_TIMEOUT_MS_DEFAULT 100
+#define SX1280_ARQ_ACK_TIMEOUT_MS_MAX 10000
+#define SX1280_ARQ_BACKOFF_EXP_MAX 5
+#define SX1280_ARQ_BUSY_RETRY_US 1000
 
-/**
- * @context process & locked
+/*
+ * Rate announcement: dispatch, source node ID, the modulation parameter to
+ * switch to, and whether that's just for the next frame exchange (a probe) or
+ * for good. ADR only keeps its changes once the next exchange goes through.
+ * It's padded out to the mode's minimum frame size if needed.
  */
-static int sx1280_get_status(struct sx1280_priv *priv, u8 *status) {
-  int err;
-  u8 tx[2] = { SX1280_CMD_GET_STATUS };
-  u8 rx[2];
+#define SX1280_RC_MSG_LEN 4
+#define SX1280_RC_MSG_BUF_LEN 8
 
-  struct spi_transfer xfer = {
-    .tx_buf = tx,
-    .rx_buf = rx,
-    .len = ARRAY_SIZE(rx),
-  };
+/*
+ * How long the frame after an announcement is held back, for the other end to
+ * change rate: its interrupt and readout, then SetStandby, SetModulationParams,
+ * SetPacketParams and SetRx, each waiting on BUSY, with room for the worker
+ * being scheduled late.
+ */
+#define SX1280_RC_TURNAROUND_US 2000
 
-  if ((err = sx1280_transfer(priv, &xfer, 1))) {
-    dev_err(&priv->spi->dev, "GetStatus failed: %d\n", err);
-    return err;
-  }
+/*
+ * Probing rate control: one ARQ frame in SX1280_RC_PROBE_INTERVAL is sent at a
+ * neighbouring rate, and each attempt is weighted into its rate's success
+ * probability by 1 / 2^shift, with SX1280_RC_PROB_ONE standing for certain.
+ * A rate other than the link's needs SX1280_RC_MIN_ATTEMPTS attempts before
+ * it can be picked, so one lucky probe doesn't move the link.
+ */
+#define SX1280_RC_PROBE_INTERVAL 10
+#define SX1280_RC_MIN_ATTEMPTS 4
+#define SX1280_RC_EWMA_SHIFT 3
+#define SX1280_RC_PROB_ONE 65536
+#define SX1280_RC_RATES_MAX 8
 
-  if (status) {
-    *status = rx[1];
-  }
+/* Number of peers whose last sequence number is kept to catch duplicates. */
+#define SX1280_ARQ_PEERS 8
 
-  return 0;
-}
+/*
+ * CSMA/CA defaults, after unslotted 802.15.4: a backoff of up to 2^BE - 1
+ * slots before each clear channel assessment, BE growing from the minimum to
+ * the maximum exponent with every busy one, and giving up after max_backoffs.
+ */
+#define SX1280_MAC_CCA_THRESHOLD_DBM_DEFAULT (-90)
+#define SX1280_MAC_SLOT_US_DEFAULT 320
+#define SX1280_MAC_SLOT_US_MAX 100000
+#define SX1280_MAC_MIN_BE_DEFAULT 3
+#define SX1280_MAC_MAX_BE_DEFAULT 5
+#define SX1280_MAC_BE_MAX 10
+#define SX1280_MAC_MAX_BACKOFFS_DEFAULT 4
+#define SX1280_MAC_MAX_BACKOFFS_MAX 16
+#define SX1280_MAC_CAD_SYMBOLS SX1280_LORA_CAD_04_SYMBOLS
+
+/* Time for the instantaneous RSSI to settle after entering RX. */
+#define SX1280_MAC_SETTLE_US 100
+
+/* How soon to try again when the channel can't be sensed yet. */
+#define SX1280_MAC_BUSY_RETRY_US 1000
 
-/**
- * @context process & locked
+/*
+ * TDMA beacon: dispatch, coordinator node ID and beacon sequence number,
+ * padded out to the mode's minimum frame size if needed.
  */
-static int sx1280_write_register(
-  struct sx1280_priv *priv,
-  u16 addr,
-  const u8 *data,
-  size_t len
-) {
-  int err;
-  u8 cmd_tx[] = {
-    SX1280_CMD_WRITE_REGISTER,
-    addr >> 8,
-    addr & 0xFF
-  };
+#define SX1280_TDMA_BEACON_LEN 3
+#define SX1280_TDMA_BEACON_BUF_LEN 8
 
-  struct spi_transfer xfers[] = {
-    {
-      .tx_buf = cmd_tx,
-      .len = ARRAY_SIZE(cmd_tx),
-      .cs_change = 0,
-},
-    {
-      .tx_buf = data,
-      .len = len,
-    }
-  };
+/*
+ * TDMA defaults and limits. Slots are numbered from the end of the beacon, and
+ * owned or listened-to slots are given as bitmasks.
+ */
+#define SX1280_TDMA_SUPERFRAME_US_DEFAULT 100000
+#define SX1280_TDMA_SUPERFRAME_US_MIN 1000
+#define SX1280_TDMA_SUPERFRAME_US_MAX 10000000
+#define SX1280_TDMA_SLOT_US_DEFAULT 10000
+#define SX1280_TDMA_SLOT_US_MIN 100
+#define SX1280_TDMA_GUARD_US_DEFAULT 1000
+
+/* Who, if anyone, is waiting on the BUSY interrupt. */
+enum sx1280_busy_waiter {
+  SX1280_BUSY_DISARMED,
+  SX1280_BUSY_ARMED_WAIT,
+  SX1280_BUSY_ARMED_ASYNC,
+};
 
-  if ((err = sx1280_transfer(priv, xfers, ARRAY_SIZE(xfers)))) {
-    dev_err(&priv->spi->dev, "WriteRegister failed: %d\n", err);
-    return err;
-  }
+/* Limits on asynchronous command sequences. */
+#define SX1280_ASYNC_MAX_CMDS 4
+#define SX1280_ASYNC_CMD_LEN 9
 
-  return 0;
-}
+/*
+ * How long a sequence may spin on BUSY from a completion callback when BUSY
+ * can't interrupt. Sequences only chain commands that release BUSY quickly.
+ */
+#define SX1280_ASYNC_BUSY_SPIN_US 100
 
-static int sx1280_read_register(
+struct sx1280_priv;
+struct sx1280_async_cmd;
+
+/*
+ * Hook run once a command in a sequence has completed, to interpret its
+ * response. Returns 0 to continue with the next command, a positive value to
+ * end the sequence early, or a negative error code to abort it.
+ *
+ * Hooks run in the SPI completion context and must not sleep.
+ */
+typedef int (*sx1280_async_hook_t)(
   struct sx1280_priv *priv,
-  u16 addr,
-  u8 *data,
-  size_t len
-) {
-  int err;
-  u8 cmd_tx[] = {
-    SX1280_CMD_READ_REGISTER,
-    addr >> 8,
-    addr & 0xFF,
-    0
-  };
+  struct sx1280_async_cmd *cmd
+);
 
-  struct spi_transfer xfers[] = {
-    {
-      .tx_buf = cmd_tx,
-      .len = ARRAY_SIZE(cmd_tx),
-      .cs_change = 0
-    },
-    {
-      .rx_buf = data,
-      .len = len
-    }
-  };
+/*
+ * A pre-built command, issued on its own or as part of an asynchronous
+ * sequence. The message is initialized once during setup, and the buffers are
+ * kept on their own cache lines so that they can be used for DMA.
+ */
+struct sx1280_async_cmd {
+  struct spi_message msg;
+  struct spi_transfer xfers[2];
+  sx1280_async_hook_t done;
 
-  if ((err = sx1280_transfer(priv, xfers, ARRAY_SIZE(xfers)))) {
-    dev_err(&priv->spi->dev, "ReadRegister failed: %d\n", err);
-    return err;
-  }
+  u8 tx[SX1280_ASYNC_CMD_LEN] ____cacheline_aligned;
+  u8 rx[SX1280_ASYNC_CMD_LEN] ____cacheline_aligned;
+};
 
-  return 0;
-}
+/*
+ * The hot-path commands, allocated separately from the driver structure.
+ *
+ * WriteBuffer and ReadBuffer carry their payload in a second transfer that is
+ * pointed at the packet for each use. The rest only ever have their header
+ * bytes rewritten, so their messages can be optimized up front.
+ */
+struct sx1280_cmds {
+  struct sx1280_async_cmd set_packet_params;
+  struct sx1280_async_cmd write_buffer;
+  struct sx1280_async_cmd read_buffer;
+  struct sx1280_async_cmd set_tx;
+  struct sx1280_async_cmd set_rx;
+  struct sx1280_async_cmd set_auto_tx;
+  struct sx1280_async_cmd set_rf_frequency;
+  struct sx1280_async_cmd get_irq_status;
+  struct sx1280_async_cmd clear_irq_status;
+};
+
+/*
+ * A sequence of commands that is issued back-to-back with spi_async, each one
+ * submitted from the completion callback of the last (or from the BUSY
+ * interrupt, if the chip is still busy), so that the issuing thread only has
+ * to wake up once the whole sequence is over.
+ */
+struct sx1280_async {
+  struct sx1280_async_cmd *cmds[SX1280_ASYNC_MAX_CMDS];
+  unsigned int len;
+  unsigned int pos;
+  int status;
+  struct completion done;
+
+  /* Result of the interrupt readout sequence. */
+  u16 irq_mask;
+};
+
+/*
+ * Payload bytes read speculatively by the RX readout. Packets up to this size
+ * are delivered without any further SPI traffic.
+ */
+#define SX1280_RX_READOUT_PREFIX_LEN 64
+
+/*
+ * Floor on the chip select gap between commands in the RX readout. The status
+ * and IRQ commands are handled without changing the radio state and release
+ * BUSY well within a microsecond, so the gap is mostly set by the calibrated
+ * BUSY time instead.
+ */
+#define SX1280_RX_READOUT_GAP_MIN_US 1
+
+/* Transfers making up the RX readout, in the order they're clocked out. */
+enum sx1280_rx_readout_xfer {
+  SX1280_RX_READOUT_IRQ_STATUS,
+  SX1280_RX_READOUT_CLEAR_IRQ,
+  SX1280_RX_READOUT_PACKET_STATUS,
+  SX1280_RX_READOUT_BUFFER_STATUS,
+  SX1280_RX_READOUT_READ_BUFFER,
+  SX1280_RX_READOUT_DATA,
+  SX1280_RX_READOUT_XFERS,
+};
+
+/*
+ * The interrupt readout used while listening, built once and issued as a
+ * single spi_message: GetIrqStatus, ClrIrqStatus, GetPacketStatus,
+ * GetRxBufferStatus and a ReadBuffer of the start of the RX buffer, with chip
+ * select released between commands for long enough that BUSY has dropped.
+ *
+ * Kept in its own allocation so that the buffers are safe to DMA.
+ */
+struct sx1280_rx_readout {
+  struct spi_message msg;
+  struct spi_transfer xfers[SX1280_RX_READOUT_XFERS];
+
+  /*
+   * Buffers, clear of the cache lines touched by the SPI core. The commands
+   * clocked out can share a line, but each buffer clocked in gets one of its
+   * own, as the controller may DMA some transfers and not others.
+   */
+  u8 irq_status_tx[4] ____cacheline_aligned;
+  u8 clear_irq[3];
+  u8 packet_status_tx[7];
+  u8 buffer_status_tx[4];
+  u8 read_buffer[3];
+
+  u8 irq_status_rx[4] ____cacheline_aligned;
+  u8 packet_status_rx[7] ____cacheline_aligned;
+  u8 buffer_status_rx[4] ____cacheline_aligned;
+  u8 data[SX1280_RX_READOUT_PREFIX_LEN] ____cacheline_aligned;
+};
+
+/* Commands whose last programmed value is shadowed. */
+enum sx1280_shadow_cmd {
+  SX1280_SHADOW_PACKET_PARAMS,
+  SX1280_SHADOW_MODULATION_PARAMS,
+  SX1280_SHADOW_RF_FREQUENCY,
+  SX1280_SHADOW_TX_PARAMS,
+  SX1280_SHADOW_DIO_IRQ_PARAMS,
+  SX1280_SHADOW_AUTO_TX,
+  SX1280_SHADOW_CAD_PARAMS,
+  SX1280_SHADOW_CMDS,
+};
+
+/*
+ * Shadowed registers: the packet engine's whitening, CRC and sync word
+ * configuration, which the chip never changes by itself.
+ */
+#define SX1280_SHADOW_REG_START SX1280_REG_WHITENING_INITIAL_VALUE
+#define SX1280_SHADOW_REGS \
+  (SX1280_REG_SYNC_ADDRESS_3_BYTE_0 - SX1280_SHADOW_REG_START + 1)
+
+/*
+ * What was last programmed into the chip, so that writes which wouldn't change
+ * anything can be skipped. Commands are kept in their encoded form.
+ */
+struct sx1280_shadow {
+  u8 cmds[SX1280_SHADOW_CMDS][SX1280_ASYNC_CMD_LEN];
+  unsigned long cmds_valid;
+  u8 regs[SX1280_SHADOW_REGS];
+  DECLARE_BITMAP(regs_valid, SX1280_SHADOW_REGS);
+
+  /* Number of commands and register writes skipped. */
+  unsigned long elided;
+};
+
+/*
+ * Per-CPU interface statistics, which can be updated from any context without
+ * contending on a lock.
+ */
+struct sx1280_pcpu_stats {
+  u64_stats_t rx_packets;
+  u64_stats_t rx_bytes;
+  u64_stats_t rx_errors;
+  u64_stats_t rx_length_errors;
+  u64_stats_t rx_dropped;
+  u64_stats_t tx_packets;
+  u64_stats_t tx_bytes;
+  u64_stats_t tx_dropped;
+  u64_stats_t rx_airtime_ns;
+  u64_stats_t tx_airtime_ns;
+  struct u64_stats_sync syncp;
+};
+
+/* Adds to a per-CPU statistic of the interface. */
+#define SX1280_STATS_ADD(priv, field, n) \
+  do { \
+    struct sx1280_pcpu_stats *__stats = get_cpu_ptr((priv)->stats); \
+    unsigned long __flags = u64_stats_update_begin_irqsave(&__stats->syncp); \
+    u64_stats_add(&__stats->field, (n)); \
+    u64_stats_update_end_irqrestore(&__stats->syncp, __flags); \
+    put_cpu_ptr((priv)->stats); \
+  } while (0)
+
+#define SX1280_STATS_INC(priv, field) SX1280_STATS_ADD(priv, field, 1)
+
+enum sx1280_state {
+  SX1280_STATE_SLEEP,
+  SX1280_STATE_STANDBY,
+  SX1280_STATE_FS,
+  SX1280_STATE_TX,
+  SX1280_STATE_RX,
+  SX1280_STATE_CAD,
+};
+
+/* A datagram being reassembled from its fragments. */
+struct sx1280_reasm {
+  struct sk_buff *frags[SX1280_FRAG_MAX];
+  unsigned long expires;
+  u16 received;
+  u8 src;
+  u8 tag;
+  u8 count;
+  bool active;
+};
+
+/*
+ * Link layer state: the datagram being sent (which may span several frames),
+ * and the datagrams being reassembled.
+ */
+struct sx1280_link {
+  /* DMA-safe buffer for frames built by the driver, e.g. fragments. */
+  u8 *frame;
+
+  /*
+   * Payload of the datagram at the tail of the TX ring: either the packet
+   * itself, or its compressed form in the encoded buffer.
+   */
+  const u8 *payload;
+  unsigned int payload_len;
+  u8 *encoded;
+
+  /* Progress through the datagram if it is being sent in fragments. */
+  unsigned int frag_offset;
+  unsigned int frag_size;
+  u8 frag_idx;
+  u8 frag_count;
+
+  /* Set once the fragments still to come have been dropped, e.g. on stop. */
+  bool frag_dropped;
+
+  /* Number of packets completed once the frame on the air is sent. */
+  unsigned int frame_skbs;
+
+  /* Header compression, and the bytes it saved in the frame on the air. */
+  bool iphc_enabled;
+  unsigned int frame_saved;
+  unsigned long iphc_saved;
+
+  /*
+   * Payload compression, with its buffers and what it has cost and saved so
+   * far. The byte counts cover every datagram offered for compression, so
+   * their ratio is the overall compression ratio.
+   */
+  bool lz4_enabled;
+  void *lz4_wrkmem;
+  u8 *lz4_out;
+  u64 lz4_bytes_in;
+  u64 lz4_bytes_out;
+  u64 lz4_compress_ns;
+  u64 lz4_decompress_ns;
+
+  /*
+   * Aggregation of small packets into a single frame. A frame that isn't full
+   * is held back until agg_timer fires, which sets agg_flush and kicks the TX
+   * work to send whatever has been gathered.
+   */
+  bool agg_enabled;
+  unsigned int agg_delay_us;
+  struct hrtimer agg_timer;
+  bool agg_flush;
+  unsigned long agg_packets;
+
+  u8 node_id;
+  u8 tag;
+
+  struct sx1280_reasm reasm[SX1280_REASM_SLOTS];
+  unsigned int reasm_mem;
+  unsigned int reasm_timeout_ms;
+};
+
+/* Where the sender is with the frame it is trying to get acknowledged. */
+enum sx1280_arq_phase {
+  SX1280_ARQ_IDLE,
+  SX1280_ARQ_WAIT_ACK,
+  SX1280_ARQ_BACKOFF,
+};
+
+/* The last sequence number seen from a peer, to catch retransmissions. */
+struct sx1280_arq_peer {
+  u8 node_id;
+  u8 seq;
+  bool valid;
+};
+
+/*
+ * Stop-and-wait ARQ state.
+ *
+ * As a sender, each frame for `dst` is wrapped in an ARQ header and held until
+ * it's acknowledged, retransmitted with backoff whenever the ACK doesn't arrive
+ * in time. Broadcast frames go without, as no one acknowledges them. As a
+ * receiver, ARQ frames addressed to this node are always acknowledged: in LoRa
+ * with an explicit header by the chip itself with AutoTx, a fixed delay after
+ * RX done, and otherwise by the driver as soon as the frame has been read out.
+ */
+struct sx1280_arq {
+  bool enabled;
+  u8 dst;
+  unsigned int retries_max;
+  unsigned int ack_delay_us;
+  unsigned int ack_timeout_ms;
+
+  /* The frame on the air or awaiting an ACK, if it carries an ARQ header. */
+  bool frame;
+  u8 hdr[SX1280_ARQ_HDR_LEN];
+  const u8 *data;
+  unsigned int len;
+  u8 seq;
+
+  enum sx1280_arq_phase phase;
+  unsigned int retries;
+  struct hrtimer timer;
+  struct kthread_work work;
+
+  /*
+   * DMA-safe ACK buffer, whether AutoTx is armed to send it, and whether an ACK
+   * is on the air.
+   */
+  u8 *ack;
+  bool auto_ack;
+  bool acking;
+
+  struct sx1280_arq_peer peers[SX1280_ARQ_PEERS];
+  unsigned int peer_next;
+
+  /* Statistics. */
+  unsigned long acked;
+  unsigned long retransmissions;
+  unsigned long failures;
+  unsigned long duplicates;
+};
+
+/* Where the MAC is with getting the channel for the frame waiting on it. */
+enum sx1280_mac_phase {
+  SX1280_MAC_IDLE,
+  SX1280_MAC_BACKOFF,
+  SX1280_MAC_CCA,
+};
+
+/*
+ * CSMA/CA state.
+ *
+ * With CSMA enabled, a frame is only sent once a clear channel assessment
+ * (CCA) finds the channel free, after a random backoff. In LoRa the CCA is
+ * channel activity detection, if enabled; otherwise it compares the
+ * instantaneous RSSI against a threshold. The chip keeps listening while
+ * backing off, so frames from other nodes are still received.
+ */
+struct sx1280_mac {
+  bool enabled;
+  bool cad;
+  int cca_threshold_dbm;
+  unsigned int slot_us;
+  unsigned int min_be;
+  unsigned int max_be;
+  unsigned int max_backoffs;
+
+  /* The frame waiting for the channel, as it's to be passed to tx_start. */
+  const u8 *hdr;
+  unsigned int hdr_len;
+  const u8 *data;
+  unsigned int len;
+
+  enum sx1280_mac_phase phase;
+  unsigned int backoffs;
+  unsigned int be;
+  struct hrtimer timer;
+  struct kthread_work work;
+
+  /* When the channel was first found busy for this frame, or 0. */
+  u64 busy_since_ns;
+
+  /* Statistics. */
+  unsigned long deferrals;
+  unsigned long failures;
+  u64 busy_ns;
+};
+
+/*
+ * TDMA state.
+ *
+ * Time is divided into superframes, each started by a beacon from the
+ * coordinator and split into equal slots. A node only starts transmitting at
+ * the start of a slot it owns, one frame per slot, and keeps the chip in
+ * standby through slots it neither owns nor listens in. Nodes take the end of
+ * the beacon as the start of the superframe: the coordinator from its TX done
+ * interrupt, everyone else from their RX done interrupt.
+ */
+struct sx1280_tdma {
+  bool enabled;
+  bool coordinator;
+  unsigned int superframe_us;
+  unsigned int slot_us;
+  unsigned int guard_us;
+  u32 tx_slots;
+  u32 rx_slots;
+
+  /* Where the superframe stands, and whether an owned slot is open. */
+  struct sx1280_tdma_sync sync;
+  bool slot_open;
+
+  /* DMA-safe beacon buffer, and whether the beacon is on the air. */
+  u8 *beacon;
+  u8 seq;
+  bool beaconing;
+
+  struct hrtimer timer;
+  struct kthread_work work;
+
+  /* Statistics. */
+  unsigned long beacons;
+  unsigned long beacons_missed;
+};
+
+/*
+ * Airtime queue limit (AQL): rather than a number of packets, the ring is
+ * limited by how long its packets will take to send, so that queueing delay
+ * stays bounded whatever the modulation. Each packet is charged an estimate
+ * from a linear model of the current settings as it's queued, and gives back
+ * the same amount once it leaves the ring.
+ */
+struct sx1280_aql {
+  unsigned int target_us;
+
+  /* Model: a fixed cost per frame, plus a cost per byte in picoseconds. */
+  unsigned int frame_max;
+  u64 frame_ns;
+  u64 byte_ps;
+
+  u64 queued_ns;
+  u64 slot_ns[SX1280_TX_RING_SIZE];
+
+  /* Statistics. */
+  unsigned long stops;
+};
+
+/*
+ * Header of the spectrum survey's result, followed by `samples` raw RSSI
+ * readings (-2 × dBm) for each of `steps` frequencies from `start_hz` on.
+ */
+struct sx1280_survey_hdr {
+  __le32 start_hz;
+  __le32 step_hz;
+  __le16 steps;
+  __le16 samples;
+} __packed;
+
+/*
+ * A rate the adaptive data rate controller can pick: the modulation parameter
+ * it's programmed with (spreading factor or FLRC bitrate), that parameter as
+ * shown through sysfs, and the lowest level it demodulates at in quarter dB.
+ * That's the SNR for LoRa, and the RSSI for FLRC as it reports no SNR.
+ */
+struct sx1280_adr_rate {
+  u8 param;
+  u32 value;
+  s16 level_qdb;
+};
+
+/* A change of rate, kept for link/adr_history. */
+struct sx1280_adr_change {
+  u64 ns;
+  u32 from;
+  u32 to;
+  s32 level_qdb;
+};
+
+/*
+ * Adaptive data rate (ADR): the level of every packet received is averaged,
+ * and the fastest rate that still leaves the margin is picked. Both ends have
+ * to be on the same rate, so a change is announced in a rate frame ahead of an
+ * ARQ frame sent at the new rate, and only kept once that frame exchange has
+ * gone through: by the sender once the ACK is in, and by the receiver once the
+ * ACK is out. The chip is reprogrammed between packets, as it's next armed.
+ * Rates are ordered from the most robust up, and only the spreading factor
+ * (LoRa) or bitrate (FLRC) is changed.
+ */
+struct sx1280_adr {
+  bool enabled;
+  unsigned int margin_db;
+
+  /*
+   * The mode averaged over, the rate in use, the rate the level calls for, and
+   * the average (<< shift).
+   */
+  enum sx1280_mode mode;
+  u8 target;
+  u8 pick;
+  s32 level;
+  unsigned int packets;
+  struct hrtimer timer;
+  struct kthread_work work;
+
+  /*
+   * The rate announced, and whether a frame is being sent or received at it
+   * (on behalf of the other end).
+   */
+  u8 trial;
+  bool trying;
+  bool following;
+
+  /* Ring of the last changes, indexed by the free-running change count. */
+  struct sx1280_adr_change history[SX1280_ADR_HISTORY_LEN];
+  unsigned long changes;
+};
+
+/* Delivery statistics of one rate, for rate control. */
+struct sx1280_rc_stats {
+  unsigned long attempts;
+  unsigned long successes;
+  u32 prob;
+};
+
+/*
+ * Probing rate control (RC) for GFSK and FLRC, which report no SNR to adapt
+ * to: after Minstrel, the rate is learned from ARQ delivery instead. Every so
+ * often a frame is sent at a neighbouring rate, and the rate with the best
+ * expected throughput (success probability × bitrate) is used. Both ends have
+ * to be on the same rate, so every change, probes included, is announced in a
+ * frame of its own at the current rate. Rates are ordered from the most robust
+ * up, and only the bitrate is changed.
+ */
+struct sx1280_rc {
+  bool enabled;
+
+  /* The mode the statistics are for, and those of each rate in it. */
+  enum sx1280_mode mode;
+  struct sx1280_rc_stats stats[SX1280_RC_RATES_MAX];
+  unsigned int best;
+  unsigned int frames;
+  bool probe_up;
+
+  /* The link's rate, and the one the chip is to be on for now. */
+  u8 base;
+  u8 rate;
+
+  /*
+   * The announcement being sent, and whether a probe is being sent or followed
+   * (on behalf of the other end).
+   */
+  u8 msg[SX1280_RC_MSG_BUF_LEN];
+  bool announcing;
+  bool probing;
+  bool following;
+  struct hrtimer timer;
+  struct kthread_work work;
+
+  /* Whether the frame after the announcement is being held back. */
+  bool turnaround;
+  struct hrtimer turnaround_timer;
+  struct kthread_work turnaround_work;
+
+  /* Statistics. */
+  unsigned long probes;
+  unsigned long changes;
+};
+
+/* Spectrum survey settings, and the result of the last sweep. */
+struct sx1280_survey {
+  u32 start_hz;
+  u32 stop_hz;
+  u32 step_hz;
+  unsigned int samples;
+  unsigned int settle_us;
+
+  u8 *result;
+  size_t result_len;
+};
+
+/*
+ * Automatic channel selection (ACS): as the interface comes up, the noise
+ * floor of each candidate channel is sampled and the quietest is used. Every
+ * interval after that, the packet error rate (CRC errors and retransmissions
+ * against frames that made it) is checked, and the selection run again if it
+ * has climbed past the threshold. The check runs on the system workqueue
+ * rather than the driver's worker, as it waits for the chip to be idle, which
+ * takes the worker servicing the chip. It can't be used along with frequency
+ * hopping, which doesn't use the fixed channel.
+ */
+struct sx1280_acs {
+  bool enabled;
+  u32 channels[SX1280_ACS_CHANNELS_MAX];
+  unsigned int n_channels;
+  unsigned int interval_s;
+  unsigned int per_percent;
+
+  /* Frame counts at the start of the interval. */
+  u64 good;
+  u64 bad;
+  struct hrtimer timer;
+  struct work_struct work;
+
+  /* Statistics. */
+  unsigned long switches;
+};
+
+/*
+ * Frequency hopping (FHSS). Channels are kept as the PLL words SetRfFrequency
+ * takes, worked out as they're configured, and visited in the order of the
+ * hop sequence: a shuffle of the table drawn from the seed, so that nodes with
+ * the same seed agree on it, or one given explicitly. The chip is retuned as
+ * part of arming TX or RX.
+ *
+ * Nodes need a shared reference to hop in step, which is TDMA's beacon.
+ * Beacons are sent and listened for on the first channel of the sequence, and
+ * each one anchors the sequence for its superframe, which starts from the
+ * beacon's sequence number. With no dwell time, each frame exchange (a frame,
+ * and its ACK if it's an ARQ frame) moves on to the next channel from there, so
+ * nodes that fell out of step over a lost frame are back in step by the next
+ * beacon. Otherwise, the channel changes every dwell time, counted from the
+ * end of the beacon.
+ */
+struct sx1280_fhss {
+  bool enabled;
+  u32 channels[SX1280_FHSS_CHANNELS_MAX];
+  unsigned int n_channels;
+  u8 seq[SX1280_FHSS_SEQ_MAX];
+  unsigned int seq_len;
+  bool seq_explicit;
+  u32 seed;
+  unsigned int dwell_us;
+
+  /*
+   * Where in the sequence the chip is, the beacon's sequence number and end it
+   * was anchored to, and whether it's on the beacon channel instead.
+   */
+  unsigned int pos;
+  u8 base;
+  u64 start_ns;
+  bool rendezvous;
+  struct hrtimer timer;
+  struct kthread_work work;
+
+  /* Statistics. */
+  unsigned long hops;
+};
+
+/*
+ * Duty cycle limiter: a token bucket of airtime, refilled at the allowed
+ * fraction of real time and holding at most that fraction of the window.
+ * Frames are only started if the bucket holds their time on air, and every
+ * transmission, ACKs and beacons included, is paid for once it's done. While
+ * the bucket is short, the packet queue is stopped until a timer finds it
+ * refilled.
+ */
+struct sx1280_duty {
+  unsigned int millipercent;
+  unsigned int window_s;
+
+  s64 tokens_ns;
+  u64 refill_ns;
+
+  bool throttled;
+  u64 throttled_since_ns;
+  struct hrtimer timer;
+  struct kthread_work work;
+
+  /* Statistics. */
+  unsigned long throttles;
+  u64 throttled_ns;
+};
+
+/* The private, internal structure for the SX1280 driver. */
+struct sx1280_priv {
+  /* Devices */
+  struct net_device *netdev;
+  struct spi_device *spi;
+
+  /* GPIOs + IRQs */
+  struct gpio_desc *busy;
+  struct gpio_desc *dio;
+  struct gpio_desc *reset;
+  int dio_index;
+  int irq;
+
+  /* When the last DIO interrupt fired, for timing against RX and TX done. */
+  u64 irq_ns;
+
+  /*
+   * Optional interrupt on the falling edge of BUSY, which lets BUSY waits sleep
+   * instead of polling. Negative if the BUSY GPIO can't interrupt.
+   *
+   * The interrupt is only enabled while a waiter is armed, and whichever of
+   * the handler or the waiter clears busy_armed is the one to disable it.
+   */
+  int busy_irq;
+  atomic_t busy_armed;
+  struct completion busy_done;
+
+  /* How long to spin on BUSY before sleeping, calibrated during setup. */
+  unsigned int busy_spin_us;
+
+  /*
+   * Hot-path command sequences, issued with spi_async. This is only possible
+   * if BUSY can be read without sleeping; otherwise sequences are run one
+   * command at a time with spi_sync.
+   */
+  struct sx1280_async async;
+  bool async_capable;
+  struct sx1280_cmds *cmds;
+
+  /* Single-message interrupt readout used while in RX. */
+  struct sx1280_rx_readout *rx_readout;
+
+  /*
+   * The current configuration of the SX1280.
+   */
+  struct sx1280_config cfg;
+
+  /* Shadow of the chip's configuration, protected by lock. */
+  struct sx1280_shadow shadow;
+
+  /*
+   * Ring of packets waiting to be transmitted, protected by tx_lock.
+   *
+   * Packets are added at the head by xmit and removed from the tail once the
+   * chip has finished with them, so while the chip is in TX the packet at the
+   * tail is the one on the air. The indices are free-running and wrapped on
+   * access, and the ring holds at most tx_ring_depth packets at a time.
+   */
+  struct sk_buff *tx_ring[SX1280_TX_RING_SIZE];
+  unsigned int tx_head;
+  unsigned int tx_tail;
+  unsigned int tx_ring_depth;
+
+  /* Airtime queue limit of the TX ring, also protected by tx_lock. */
+  struct sx1280_aql aql;
+
+  /* Time on air of the transmission in progress, for airtime accounting. */
+  u64 tx_airtime_ns;
+
+  /* Datagram size whose cost is reported through link/airtime_us. */
+  unsigned int airtime_query_len;
+
+  /*
+   * Link layer, ARQ, MAC, TDMA, duty cycle, frequency hopping and data rate
+   * state, protected by lock.
+   */
+  struct sx1280_link link;
+  struct sx1280_arq arq;
+  struct sx1280_mac mac;
+  struct sx1280_tdma tdma;
+  struct sx1280_duty duty;
+  struct sx1280_fhss fhss;
+  struct sx1280_adr adr;
+  struct sx1280_rc rc;
+
+  /*
+   * The mode and rate parameter the chip was last programmed with, which ADR
+   * and rate control move away from the configured one.
+   */
+  enum sx1280_mode rate_mode;
+  u8 rate;
+
+  /* Spectrum survey and automatic channel selection, protected by lock. */
+  struct sx1280_survey survey;
+  struct sx1280_acs acs;
+
+  /*
+   * Worker that services the chip: starting transmissions and handling DIO
+   * interrupts. It is a dedicated thread so that it can be made real-time and
+   * pinned to a CPU, and runs SCHED_FIFO by default.
+   */
+  struct kthread_worker *worker;
+  struct kthread_work tx_work;
+  struct kthread_work irq_work;
+  bool realtime;
+
+  /* Received packets waiting to be delivered by NAPI. */
+  struct napi_struct napi;
+  struct sk_buff_head rx_queue;
+
+  /* Interface statistics, reported through ndo_get_stats64. */
+  struct sx1280_pcpu_stats __percpu *stats;
+
+  /*
+   * Mutex that locks all uninterruptible operations.
+   *
+   * This mutex should be locked before every transaction involving the chip,
+   * especially in IRQ handlers.
+   */
+  struct mutex lock;
+
+  /*
+   * Spinlock that protects all atomic, Tx-related operations spawned from xmit.
+   */
+  struct spinlock tx_lock;
+
+  /*
+   * The current operational mode state of the chip, used to determine what is
+   * currently going on within the chip and what actions are legal to take.
+   */
+  enum sx1280_state state;
+
+  /*
+   * Wait queue for all operations that require the chip to be idle, such as
+   * setting mode and packet parameters. All waiters in the queue will be
+   * triggered at once and must hold a lock.
+   */
+  wait_queue_head_t idle_wait;
+
+  /*
+   * Whether the device / driver is fully initialized.
+   *
+   * Used to gate the IRQ handler so that it doesn't receive spurious interrupts
+   * during setup, causing the device / driver to enter an invalid state.
+   */
+  bool initialized;
+
+#ifdef DEBUG
+  struct delayed_work status_check;
+#endif
+};
+
+/****************
+* SPI Functions *
+****************/
+
+/**
+ * Ends the current asynchronous sequence and wakes up the thread running it.
+ * @context any
+ */
+static void sx1280_async_finish(struct sx1280_priv *priv, int status) {
+  priv->async.status = status;
+  complete(&priv->async.done);
+}
+
+/**
+ * Submits the current command of the running sequence once BUSY is low.
+ *
+ * If the chip is still busy, the submission is handed off to the BUSY
+ * interrupt when there is one. Otherwise, BUSY is polled for a bounded time.
+ *
+ * @context any
+ */
+static void sx1280_async_submit(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_async *async = &priv->async;
+
+  if (gpiod_get_value(priv->busy)) {
+    if (priv->busy_irq >= 0) {
+      atomic_set(&priv->busy_armed, SX1280_BUSY_ARMED_ASYNC);
+      enable_irq(priv->busy_irq);
+
+      /*
+       * If BUSY fell before the interrupt was armed, whoever disarms it first
+       * is responsible for submitting the command.
+       */
+      if (
+        gpiod_get_value(priv->busy)
+        || atomic_xchg(&priv->busy_armed, SX1280_BUSY_DISARMED)
+          != SX1280_BUSY_ARMED_ASYNC
+      ) {
+        return;
+      }
+
+      disable_irq_nosync(priv->busy_irq);
+    } else {
+      ktime_t start = ktime_get();
+
+      while (gpiod_get_value(priv->busy)) {
+        if (ktime_us_delta(ktime_get(), start) > SX1280_ASYNC_BUSY_SPIN_US) {
+          sx1280_async_finish(priv, -ETIMEDOUT);
+          return;
+        }
+
+        cpu_relax();
+      }
+    }
+  }
+
+  if ((err = spi_async(priv->spi, &async->cmds[async->pos]->msg))) {
+    sx1280_async_finish(priv, err);
+  }
+}
+
+/**
+ * SPI completion callback for each command in an asynchronous sequence.
+ * @context any
+ */
+static void sx1280_async_complete(void *context) {
+  struct sx1280_priv *priv = (struct sx1280_priv *) context;
+  struct sx1280_async *async = &priv->async;
+  struct sx1280_async_cmd *cmd = async->cmds[async->pos];
+
+  int ret = cmd->msg.status;
+  if (!ret && cmd->done) {
+    ret = cmd->done(priv, cmd);
+  }
+
+  if (ret) {
+    sx1280_async_finish(priv, ret < 0 ? ret : 0);
+  } else if (++async->pos == async->len) {
+    sx1280_async_finish(priv, 0);
+  } else {
+    sx1280_async_submit(priv);
+  }
+}
+
+/**
+ * Hard interrupt handler for the falling edge of BUSY.
+ * @context atomic
+ */
+static irqreturn_t sx1280_busy_irq(int irq, void *dev_id) {
+  struct sx1280_priv *priv = (struct sx1280_priv *) dev_id;
+
+  switch (atomic_xchg(&priv->busy_armed, SX1280_BUSY_DISARMED)) {
+  case SX1280_BUSY_ARMED_WAIT:
+    disable_irq_nosync(irq);
+    complete(&priv->busy_done);
+    break;
+  case SX1280_BUSY_ARMED_ASYNC:
+    disable_irq_nosync(irq);
+    sx1280_async_submit(priv);
+    break;
+  }
+
+  return IRQ_HANDLED;
+}
+
+/**
+ * Sleeps until the BUSY interrupt fires or the timeout elapses.
+ *
+ * The caller must re-check BUSY afterwards, since an edge latched while the
+ * interrupt was disabled may be replayed as soon as it is enabled.
+ *
+ * @context - process & locked
+ */
+static void sx1280_wait_busy_irq(struct sx1280_priv *priv, s64 timeout_us) {
+  reinit_completion(&priv->busy_done);
+  atomic_set(&priv->busy_armed, SX1280_BUSY_ARMED_WAIT);
+  enable_irq(priv->busy_irq);
+
+  /* BUSY may have already fallen before the interrupt was armed. */
+  if (gpiod_get_value_cansleep(priv->busy)) {
+    wait_for_completion_timeout(&priv->busy_done, usecs_to_jiffies(timeout_us));
+  }
+
+  if (atomic_xchg(&priv->busy_armed, SX1280_BUSY_DISARMED)) {
+    disable_irq_nosync(priv->busy_irq);
+  }
+}
+
+/**
+ * Waits for the BUSY pin to be pulled low, so a SPI transfer can begin.
+ *
+ * For short waits, which are expected in the vast majority of cases, this
+ * function quickly busy-loops for the calibrated spin time. After that, it
+ * sleeps until the falling edge of BUSY if BUSY can interrupt, or polls at a
+ * coarser interval otherwise, before ultimately timing out.
+ *
+ * @context - process & locked
+ */
+static int sx1280_wait_busy(struct sx1280_priv *priv) {
+  ktime_t start = ktime_get();
+  s64 wait = 0;
+
+  while (gpiod_get_value_cansleep(priv->busy)) {
+    wait = ktime_us_delta(ktime_get(), start);
+
+    if (wait < priv->busy_spin_us) {
+      cpu_relax();
+    } else if (wait >= SX1280_BUSY_TIMEOUT_US) {
+      return -ETIMEDOUT;
+    } else if (priv->busy_irq >= 0) {
+      sx1280_wait_busy_irq(priv, SX1280_BUSY_TIMEOUT_US - wait);
+    } else {
+      usleep_range(20, 40);
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Performs an arbitrary SPI transaction with the SX1280, after first waiting
+ * for BUSY = 0 (this is necessary for every transaction).
+ *
+ * @context - process & locked
+ */
+static int sx1280_transfer(
+  struct sx1280_priv *priv,
+  struct spi_transfer *xfers,
+  unsigned int num_xfers
+) {
+  int err;
+  if (
+    (err = sx1280_wait_busy(priv))
+    || (err = spi_sync_transfer(priv->spi, xfers, num_xfers))
+    || (err = sx1280_wait_busy(priv))
+  ) {
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_write(
+  struct sx1280_priv *priv,
+  void *buf,
+  size_t len
+) {
+  int err;
+  if (
+    (err = sx1280_wait_busy(priv))
+    || (err = spi_write(priv->spi, buf, len))
+    || (err = sx1280_wait_busy(priv))
+  ) {
+    return err;
+  }
+
+  return 0;
+}
+
+/**
+ * Forgets everything that was shadowed, e.g. after the chip has been reset.
+ * @context process & locked
+ */
+static void sx1280_shadow_invalidate(struct sx1280_priv *priv) {
+  priv->shadow.cmds_valid = 0;
+  bitmap_zero(priv->shadow.regs_valid, SX1280_SHADOW_REGS);
+}
+
+/**
+ * Checks whether a shadowed command would leave the chip as it already is, in
+ * which case it is counted as elided.
+ *
+ * @context process & locked
+ */
+static bool sx1280_shadow_cmd_match(
+  struct sx1280_priv *priv,
+  enum sx1280_shadow_cmd slot,
+  const u8 *tx,
+  size_t len
+) {
+  struct sx1280_shadow *shadow = &priv->shadow;
+
+  if (
+    !test_bit(slot, &shadow->cmds_valid)
+    || memcmp(shadow->cmds[slot], tx, len)
+  ) {
+    return false;
+  }
+
+  shadow->elided++;
+  return true;
+}
+
+/**
+ * Records a shadowed command once it has been sent. If it failed, the chip's
+ * state is unknown and the next one can't be elided.
+ *
+ * @context process & locked
+ */
+static void sx1280_shadow_cmd_update(
+  struct sx1280_priv *priv,
+  enum sx1280_shadow_cmd slot,
+  const u8 *tx,
+  size_t len,
+  bool ok
+) {
+  struct sx1280_shadow *shadow = &priv->shadow;
+
+  if (!ok) {
+    clear_bit(slot, &shadow->cmds_valid);
+    return;
+  }
+
+  memcpy(shadow->cmds[slot], tx, len);
+  set_bit(slot, &shadow->cmds_valid);
+}
+
+/**
+ * Writes a command, unless the shadow shows it wouldn't change anything.
+ * @context process & locked
+ */
+static int sx1280_write_shadowed(
+  struct sx1280_priv *priv,
+  enum sx1280_shadow_cmd slot,
+  u8 *tx,
+  size_t len
+) {
+  int err;
+
+  if (sx1280_shadow_cmd_match(priv, slot, tx, len)) {
+    return 0;
+  }
+
+  err = sx1280_write(priv, tx, len);
+  sx1280_shadow_cmd_update(priv, slot, tx, len, !err);
+
+  return err;
+}
+
+/**
+ * Checks whether writing registers would leave them as they already are. Only
+ * writes entirely within the shadowed window can be elided.
+ *
+ * @context process & locked
+ */
+static bool sx1280_shadow_regs_match(
+  struct sx1280_priv *priv,
+  u16 addr,
+  const u8 *data,
+  size_t len
+) {
+  struct sx1280_shadow *shadow = &priv->shadow;
+
+  if (
+    addr < SX1280_SHADOW_REG_START
+    || addr + len > SX1280_SHADOW_REG_START + SX1280_SHADOW_REGS
+  ) {
+    return false;
+  }
+
+  unsigned int start = addr - SX1280_SHADOW_REG_START;
+  if (
+    find_next_zero_bit(shadow->regs_valid, start + len, start) < start + len
+    || memcmp(&shadow->regs[start], data, len)
+  ) {
+    return false;
+  }
+
+  shadow->elided++;
+  return true;
+}
+
+/**
+ * Records the part of a register write that falls within the shadowed window.
+ * @context process & locked
+ */
+static void sx1280_shadow_regs_update(
+  struct sx1280_priv *priv,
+  u16 addr,
+  const u8 *data,
+  size_t len,
+  bool ok
+) {
+  struct sx1280_shadow *shadow = &priv->shadow;
+
+  for (size_t i = 0; i < len; i++) {
+    if (
+      addr + i < SX1280_SHADOW_REG_START
+      || addr + i >= SX1280_SHADOW_REG_START + SX1280_SHADOW_REGS
+    ) {
+      continue;
+    }
+
+    unsigned int reg = addr + i - SX1280_SHADOW_REG_START;
+    if (ok) {
+      shadow->regs[reg] = data[i];
+      set_bit(reg, shadow->regs_valid);
+    } else {
+      clear_bit(reg, shadow->regs_valid);
+    }
+  }
+}
+
+/**
+ * @context process & locked
+ */
+static int sx1280_get_status(struct sx1280_priv *priv, u8 *status) {
+  int err;
+  u8 tx[2] = { SX1280_CMD_GET_STATUS };
+  u8 rx[2];
+
+  struct spi_transfer xfer = {
+    .tx_buf = tx,
+    .rx_buf = rx,
+    .len = ARRAY_SIZE(rx),
+  };
+
+  if ((err = sx1280_transfer(priv, &xfer, 1))) {
+    dev_err(&priv->spi->dev, "GetStatus failed: %d\n", err);
+    return err;
+  }
+
+  if (status) {
+    *status = rx[1];
+  }
+
+  return 0;
+}
+
+/**
+ * @context process & locked
+ */
+static int sx1280_write_register(
+  struct sx1280_priv *priv,
+  u16 addr,
+  const u8 *data,
+  size_t len
+) {
+  int err;
+  u8 cmd_tx[] = {
+    SX1280_CMD_WRITE_REGISTER,
+    addr >> 8,
+    addr & 0xFF
+  };
+
+  struct spi_transfer xfers[] = {
+    {
+      .tx_buf = cmd_tx,
+      .len = ARRAY_SIZE(cmd_tx),
+      .cs_change = 0,
+},
+    {
+      .tx_buf = data,
+      .len = len,
+    }
+  };
+
+  if (sx1280_shadow_regs_match(priv, addr, data, len)) {
+    return 0;
+  }
+
+  err = sx1280_transfer(priv, xfers, ARRAY_SIZE(xfers));
+  sx1280_shadow_regs_update(priv, addr, data, len, !err);
+
+  if (err) {
+    dev_err(&priv->spi->dev, "WriteRegister failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_read_register(
+  struct sx1280_priv *priv,
+  u16 addr,
+  u8 *data,
+  size_t len
+) {
+  int err;
+  u8 cmd_tx[] = {
+    SX1280_CMD_READ_REGISTER,
+    addr >> 8,
+    addr & 0xFF,
+    0
+  };
+
+  struct spi_transfer xfers[] = {
+    {
+      .tx_buf = cmd_tx,
+      .len = ARRAY_SIZE(cmd_tx),
+      .cs_change = 0
+    },
+    {
+      .rx_buf = data,
+      .len = len
+    }
+  };
+
+  if ((err = sx1280_transfer(priv, xfers, ARRAY_SIZE(xfers)))) {
+    dev_err(&priv->spi->dev, "ReadRegister failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
 
 static int sx1280_write_buffer(
   struct sx1280_priv *priv,
-  u8 offset,
-  const u8 *data,
-  size_t len
+  u8 offset,
+  const u8 *data,
+  size_t len
+) {
+  int err;
+  u8 cmd_tx[] = {
+    SX1280_CMD_WRITE_BUFFER,
+    offset
+  };
+
+  struct spi_transfer xfers[] = {
+    {
+      .tx_buf = cmd_tx,
+      .len = ARRAY_SIZE(cmd_tx),
+      .cs_change = 0
+    },
+    {
+      .tx_buf = data,
+      .len = len
+    }
+  };
+
+  if ((err = sx1280_transfer(priv, xfers, ARRAY_SIZE(xfers)))) {
+    dev_err(&priv->spi->dev, "WriteBuffer failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_read_buffer(
+  struct sx1280_priv *priv,
+  u8 offset,
+  u8 *data,
+  size_t len
+) {
+  int err;
+  u8 cmd_tx[3] = { SX1280_CMD_READ_BUFFER, offset };
+
+  struct spi_transfer xfers[] = {
+    {
+      .tx_buf = cmd_tx,
+      .len = ARRAY_SIZE(cmd_tx),
+      .cs_change = 0
+    },
+    {
+      .rx_buf = data,
+      .len = len
+    }
+  };
+
+  if ((err = sx1280_transfer(priv, xfers, ARRAY_SIZE(xfers)))) {
+    dev_err(&priv->spi->dev, "ReadBuffer failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_sleep(
+  struct sx1280_priv *priv,
+  bool save_buffer,
+  bool save_ram
+) {
+  int err;
+  u8 sleep_config = (save_buffer << 1) | save_ram;
+  u8 tx[] = { SX1280_CMD_SET_SLEEP, sleep_config };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetSleep failed: %d\n", err);
+    return err;
+  }
+
+  /* Without retention, the configuration is lost while asleep. */
+  if (!save_ram) {
+    sx1280_shadow_invalidate(priv);
+  }
+
+  return 0;
+}
+
+static int sx1280_set_standby(struct sx1280_priv *priv, u8 mode) {
+  int err;
+  u8 tx[] = { SX1280_CMD_SET_STANDBY, mode };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetStandby failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_fs(struct sx1280_priv *priv) {
+  int err;
+  u8 tx[] = { SX1280_CMD_SET_FS };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetFs failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_tx(
+  struct sx1280_priv *priv,
+  u8 period_base,
+  u16 period_base_count
+) {
+  int err;
+  u8 tx[] = {
+    SX1280_CMD_SET_TX,
+    period_base,
+    period_base_count >> 8,
+    period_base_count & 0xFF
+  };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetTx failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_rx(
+  struct sx1280_priv *priv,
+  u8 period_base,
+  u16 period_base_count
+) {
+  int err;
+  u8 tx[] = {
+    SX1280_CMD_SET_RX,
+    period_base,
+    period_base_count >> 8,
+    period_base_count & 0xFF
+  };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetRx failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_rx_duty_cycle(
+  struct sx1280_priv *priv,
+  u8 period_base,
+  u16 rx_period_base_count,
+  u16 sleep_period_base_count
+) {
+  int err;
+  u8 tx[] = {
+    SX1280_CMD_SET_RX_DUTY_CYCLE,
+    period_base,
+    rx_period_base_count >> 8,
+    rx_period_base_count & 0xFF,
+    sleep_period_base_count >> 8,
+    sleep_period_base_count & 0xFF
+  };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_dbg(&priv->spi->dev, "SetRxDutyCycle failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_long_preamble(struct sx1280_priv *priv, bool enable) {
+  int err;
+  u8 tx[] = { SX1280_CMD_SET_LONG_PREAMBLE, enable };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetLongPreamble failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_cad(struct sx1280_priv *priv) {
+  int err;
+  u8 tx[] = { SX1280_CMD_SET_CAD };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetCad failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_tx_continuous_wave(struct sx1280_priv *priv) {
+  int err;
+  u8 tx[] = { SX1280_CMD_SET_TX_CONTINUOUS_WAVE };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetTxContinuousWave failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_tx_continuous_preamble(struct sx1280_priv *priv) {
+  int err;
+  u8 tx[] = { SX1280_CMD_SET_TX_CONTINUOUS_PREAMBLE };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetTxContinuousPreamble failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_auto_tx(struct sx1280_priv *priv, u16 time) {
+  int err;
+  u8 tx[] = {
+    SX1280_CMD_SET_AUTO_TX,
+    time >> 8,
+    time & 0xFF
+  };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetAutoTx failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_auto_fs(struct sx1280_priv *priv, bool enable) {
+  int err;
+  u8 tx[] = { SX1280_CMD_SET_AUTO_FS, enable };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetAutoFs failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_packet_type(
+  struct sx1280_priv *priv,
+  enum sx1280_mode packet_type
+) {
+  int err;
+  u8 tx[] = { SX1280_CMD_SET_PACKET_TYPE, (u8) packet_type };
+
+  /* Packet and modulation parameters are interpreted per packet type. */
+  clear_bit(SX1280_SHADOW_PACKET_PARAMS, &priv->shadow.cmds_valid);
+  clear_bit(SX1280_SHADOW_MODULATION_PARAMS, &priv->shadow.cmds_valid);
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetPacketType failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_get_packet_type(
+  struct sx1280_priv *priv,
+  enum sx1280_mode *packet_type
+) {
+  int err;
+  u8 tx[3] = { SX1280_CMD_GET_PACKET_TYPE };
+  u8 rx[3];
+
+  struct spi_transfer xfer = {
+    .tx_buf = tx,
+    .rx_buf = rx,
+    .len = ARRAY_SIZE(rx)
+  };
+
+  if ((err = sx1280_transfer(priv, &xfer, 1))) {
+    dev_err(&priv->spi->dev, "GetPacketType failed: %d\n", err);
+    return err;
+  } else if (rx[2] > 0x04) {
+    dev_err(&priv->spi->dev, "GetPacketType returned invalid value: %d\n", rx[2]);
+    return -EINVAL;
+  }
+
+  if (packet_type) {
+    *packet_type = (enum sx1280_mode) rx[2];
+  }
+
+  return 0;
+}
+
+static int sx1280_set_rf_frequency(
+  struct sx1280_priv *priv,
+  u32 freq
+) {
+  int err;
+  u8 tx[] = {
+    SX1280_CMD_SET_RF_FREQUENCY,
+    freq >> 16,
+    (freq >> 8) & 0xFF,
+    freq & 0xFF
+  };
+
+  if ((err = sx1280_write_shadowed(
+    priv,
+    SX1280_SHADOW_RF_FREQUENCY,
+    tx,
+    ARRAY_SIZE(tx)
+  ))) {
+    dev_err(&priv->spi->dev, "SetRfFrequency failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_tx_params(
+  struct sx1280_priv *priv,
+  u8 power,
+  enum sx1280_ramp_time ramp_time
+) {
+  int err;
+  u8 tx[] = { SX1280_CMD_SET_TX_PARAMS, power, (u8) ramp_time };
+
+  if ((err = sx1280_write_shadowed(
+    priv,
+    SX1280_SHADOW_TX_PARAMS,
+    tx,
+    ARRAY_SIZE(tx)
+  ))) {
+    dev_err(&priv->spi->dev, "SetTxParams failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_cad_params(
+  struct sx1280_priv *priv,
+  enum sx1280_cad_symbol_num cad_symbol_num
+) {
+  int err;
+  u8 tx[] = { SX1280_CMD_SET_CAD_PARAMS, (u8) cad_symbol_num };
+
+  if ((err = sx1280_write_shadowed(
+    priv,
+    SX1280_SHADOW_CAD_PARAMS,
+    tx,
+    sizeof(tx)
+  ))) {
+    dev_err(&priv->spi->dev, "SetCadParams failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_buffer_base_address(
+  struct sx1280_priv *priv,
+  u8 tx_base_addr,
+  u8 rx_base_addr
+) {
+  int err;
+  u8 tx[] = {
+    SX1280_CMD_SET_BUFFER_BASE_ADDRESS,
+    tx_base_addr,
+    rx_base_addr
+  };
+
+  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
+    dev_err(&priv->spi->dev, "SetBufferBaseAddress failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_modulation_params(
+  struct sx1280_priv *priv,
+  struct sx1280_modulation_params params
+) {
+  int err;
+  u8 tx[4] = { SX1280_CMD_SET_MODULATION_PARAMS };
+
+  switch (params.mode) {
+  case SX1280_MODE_FLRC:
+    tx[1] = (u8) params.flrc.bitrate_bandwidth;
+    tx[2] = (u8) params.flrc.coding_rate;
+    tx[3] = (u8) params.flrc.bandwidth_time;
+    break;
+  case SX1280_MODE_GFSK:
+    tx[1] = (u8) params.gfsk.bitrate_bandwidth;
+    tx[2] = (u8) params.gfsk.modulation_index;
+    tx[3] = (u8) params.gfsk.bandwidth_time;
+    break;
+  case SX1280_MODE_LORA:
+  case SX1280_MODE_RANGING:
+    tx[1] = (u8) params.lora.spreading_factor;
+    tx[2] = (u8) params.lora.bandwidth;
+    tx[3] = (u8) params.lora.coding_rate;
+    break;
+  default:
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_write_shadowed(
+    priv,
+    SX1280_SHADOW_MODULATION_PARAMS,
+    tx,
+    ARRAY_SIZE(tx)
+  ))) {
+    dev_err(&priv->spi->dev, "SetModulationParams failed: %d\n", err);
+    return err;
+  }
+
+  /* The rate comes first in every mode. */
+  priv->rate_mode = params.mode;
+  priv->rate = tx[1];
+
+  return 0;
+}
+
+/**
+ * Encodes a SetPacketParams command into its 8-byte wire format.
+ */
+static int sx1280_encode_packet_params(
+  const struct sx1280_packet_params *params,
+  u8 tx[8]
+) {
+  memset(tx, 0, 8);
+  tx[0] = SX1280_CMD_SET_PACKET_PARAMS;
+
+  switch (params->mode) {
+  case SX1280_MODE_FLRC:
+    tx[1] = (u8) params->flrc.agc_preamble_length;
+    tx[2] = (u8) params->flrc.sync_word_length;
+    tx[3] = (u8) params->flrc.sync_word_match;
+    tx[4] = (u8) params->flrc.packet_type;
+    tx[5] = (u8) params->flrc.payload_length;
+    tx[6] = (u8) params->flrc.crc_length;
+    tx[7] = (u8) params->flrc.whitening;
+    break;
+  case SX1280_MODE_GFSK:
+    tx[1] = (u8) params->gfsk.preamble_length;
+    tx[2] = (u8) params->gfsk.sync_word_length;
+    tx[3] = (u8) params->gfsk.sync_word_match;
+    tx[4] = (u8) params->gfsk.packet_type;
+    tx[5] = (u8) params->gfsk.payload_length;
+    tx[6] = (u8) params->gfsk.crc_length;
+    tx[7] = (u8) params->gfsk.whitening;
+    break;
+  case SX1280_MODE_LORA:
+  case SX1280_MODE_RANGING:
+    tx[1] = (u8) params->lora.preamble_length;
+    tx[2] = (u8) params->lora.header_type;
+    tx[3] = (u8) params->lora.payload_length;
+    tx[4] = (u8) params->lora.crc;
+    tx[5] = (u8) params->lora.iq;
+    break;
+  default:
+    return -EINVAL;
+  }
+
+  return 0;
+}
+
+static int sx1280_set_packet_params(
+  struct sx1280_priv *priv,
+  struct sx1280_packet_params params
+) {
+  int err;
+  u8 tx[8];
+
+  if ((err = sx1280_encode_packet_params(&params, tx))) {
+    return err;
+  }
+
+  if ((err = sx1280_write_shadowed(
+    priv,
+    SX1280_SHADOW_PACKET_PARAMS,
+    tx,
+    sizeof(tx)
+  ))) {
+    dev_err(&priv->spi->dev, "SetPacketParams: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+static int sx1280_get_rx_buffer_status(
+  struct sx1280_priv *priv,
+  u8 *rx_payload_len,
+  u8 *rx_start_buffer_ptr
+) {
+  int err;
+  u8 tx[4] = { SX1280_CMD_GET_RX_BUFFER_STATUS };
+  u8 rx[4];
+
+  struct spi_transfer xfer = {
+    .tx_buf = tx,
+    .rx_buf = rx,
+    .len = ARRAY_SIZE(rx)
+  };
+
+  if ((err = sx1280_transfer(priv, &xfer, 1))) {
+    dev_err(&priv->spi->dev, "GetRxBufferStatus failed: %d\n", err);
+    return err;
+  }
+
+  if (rx_payload_len) {
+    *rx_payload_len = rx[2];
+  }
+
+  if (rx_start_buffer_ptr) {
+    *rx_start_buffer_ptr = rx[3];
+  }
+
+  return 0;
+}
+
+static int sx1280_get_packet_status(
+  struct sx1280_priv *priv,
+  union sx1280_packet_status *packet_status
+) {
+  int err;
+  u8 tx[7] = { SX1280_CMD_GET_PACKET_STATUS };
+  u8 rx[7];
+
+  struct spi_transfer xfer = {
+    .tx_buf = tx,
+    .rx_buf = rx,
+    .len = ARRAY_SIZE(rx)
+  };
+
+  if ((err = sx1280_transfer(priv, &xfer, 1))) {
+    dev_err(&priv->spi->dev, "GetPacketStatus failed: %d\n", err);
+    return err;
+  }
+
+  memcpy(&packet_status->raw, &rx[2], 5);
+  return 0;
+}
+
+static int sx1280_get_rssi_inst(struct sx1280_priv *priv, u8 *rssi_inst) {
+  int err;
+  u8 tx[3] = { SX1280_CMD_GET_RSSI_INST };
+  u8 rx[3];
+
+  struct spi_transfer xfer = {
+    .tx_buf = tx,
+    .rx_buf = rx,
+    .len = ARRAY_SIZE(rx)
+  };
+
+  if ((err = sx1280_transfer(priv, &xfer, 1))) {
+    dev_err(&priv->spi->dev, "GetRssiInst failed: %d\n", err);
+    return err;
+  }
+
+  if (rssi_inst) {
+    *rssi_inst = rx[2];
+  }
+
+  return 0;
+}
+
+/** Configures the DIO pins to act as interrupts according to their masks. */
+static int sx1280_set_dio_irq_params(
+  struct sx1280_priv *priv,
+  u16 irq_mask,
+  u16 dio_mask[3]
+) {
+  int err;
+  u8 tx[] = {
+    SX1280_CMD_SET_DIO_IRQ_PARAMS,
+    irq_mask >> 8,
+    irq_mask & 0xFF,
+    dio_mask[0] >> 8,
+    dio_mask[0] & 0xFF,
+    dio_mask[1] >> 8,
+    dio_mask[1] & 0xFF,
+    dio_mask[2] >> 8,
+    dio_mask[2] & 0xFF
+  };
+
+  if ((err = sx1280_write_shadowed(
+    priv,
+    SX1280_SHADOW_DIO_IRQ_PARAMS,
+    tx,
+    sizeof(tx)
+  ))) {
+    dev_err(&priv->spi->dev, "SetDioIrqParams failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+/** Gets the current state of the IRQ register. */
+static int sx1280_get_irq_status(struct sx1280_priv *priv, u16 *irq_status) {
+  int err;
+  u8 tx[4] = { SX1280_CMD_GET_IRQ_STATUS };
+  u8 rx[4];
+
+  struct spi_transfer xfer = {
+    .tx_buf = tx,
+    .rx_buf = rx,
+    .len = ARRAY_SIZE(rx),
+  };
+
+  if ((err = sx1280_transfer(priv, &xfer, 1))) {
+    dev_err(&priv->spi->dev, "GetIrqStatus failed: %d\n", err);
+    return err;
+  }
+
+  if (irq_status) {
+    /* The IRQ status is returned in big-endian format. */
+    *irq_status = ((u16) rx[2] << 8) | rx[3];
+  }
+
+  return 0;
+}
+
+/** Clears flags in the IRQ register according to the mask. */
+static int sx1280_clear_irq_status(struct sx1280_priv *priv, u16 irq_mask) {
+  int err;
+  u8 tx[] = {
+    SX1280_CMD_CLR_IRQ_STATUS,
+    irq_mask >> 8,
+    irq_mask & 0xFF
+  };
+
+  if ((err = sx1280_write(priv, tx, sizeof(tx)))) {
+    dev_err(&priv->spi->dev, "ClearIrqStatus failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+/************************
+* Asynchronous commands *
+************************/
+
+/**
+ * Starts building a new asynchronous sequence.
+ * @context process & locked
+ */
+static void sx1280_async_reset(struct sx1280_priv *priv) {
+  priv->async.len = 0;
+}
+
+/**
+ * Appends one of the pre-built commands to the sequence being built. Its
+ * header and payload must already be filled in, and its response (if any) is
+ * left in `cmd->rx` for the hook.
+ *
+ * @context process & locked
+ */
+static void sx1280_async_add(
+  struct sx1280_priv *priv,
+  struct sx1280_async_cmd *cmd
+) {
+  struct sx1280_async *async = &priv->async;
+
+  if (WARN_ON(async->len >= SX1280_ASYNC_MAX_CMDS)) {
+    return;
+  }
+
+  async->cmds[async->len++] = cmd;
+}
+
+/**
+ * Runs the sequence one command at a time, for when BUSY can only be read from
+ * a context that can sleep.
+ *
+ * @context process & locked
+ */
+static int sx1280_async_run_sync(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_async *async = &priv->async;
+
+  for (async->pos = 0; async->pos < async->len; async->pos++) {
+    struct sx1280_async_cmd *cmd = async->cmds[async->pos];
+
+    if (
+      (err = sx1280_wait_busy(priv))
+      || (err = spi_sync(priv->spi, &cmd->msg))
+    ) {
+      return err;
+    }
+
+    if (cmd->done && (err = cmd->done(priv, cmd))) {
+      return err < 0 ? err : 0;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Runs the sequence that has been built, chaining each command from the
+ * completion of the last, and waits once for the whole sequence to finish.
+ *
+ * @context process & locked
+ */
+static int sx1280_async_run(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_async *async = &priv->async;
+
+  if (!async->len) {
+    return 0;
+  } else if (!priv->async_capable) {
+    return sx1280_async_run_sync(priv);
+  }
+
+  /* The completion is (re)attached here, since spi_sync() replaces it. */
+  for (unsigned int i = 0; i < async->len; i++) {
+    async->cmds[i]->msg.complete = sx1280_async_complete;
+    async->cmds[i]->msg.context = priv;
+  }
+
+  async->pos = 0;
+  async->status = 0;
+  reinit_completion(&async->done);
+
+  /* Only the first command can have a sleeping wait for BUSY. */
+  if ((err = sx1280_wait_busy(priv))) {
+    return err;
+  }
+
+  if ((err = spi_async(priv->spi, &async->cmds[0]->msg))) {
+    return err;
+  }
+
+  if (!wait_for_completion_timeout(
+    &async->done,
+    usecs_to_jiffies(SX1280_BUSY_TIMEOUT_US)
+  )) {
+    /*
+     * Transfers always complete, so only a wait for BUSY can stall the
+     * sequence. If the BUSY interrupt can still be disarmed, nothing else is
+     * in flight and the sequence can be abandoned.
+     */
+    if (
+      atomic_cmpxchg(
+        &priv->busy_armed,
+        SX1280_BUSY_ARMED_ASYNC,
+        SX1280_BUSY_DISARMED
+      ) == SX1280_BUSY_ARMED_ASYNC
+    ) {
+      disable_irq_nosync(priv->busy_irq);
+      dev_err(&priv->spi->dev, "async sequence timed out on BUSY\n");
+      return -ETIMEDOUT;
+    }
+
+    wait_for_completion(&async->done);
+  }
+
+  return async->status;
+}
+
+/*******************
+* Driver functions *
+*******************/
+
+/**
+ * Estimates the time on air of a packet of `len` bytes, with the model last
+ * taken from the settings.
+ * @context tx_lock
+ */
+static u64 sx1280_aql_estimate_ns(struct sx1280_aql *aql, unsigned int len) {
+  unsigned int frames = 1;
+
+  if (len > aql->frame_max && aql->frame_max > SX1280_FRAG_HDR_LEN) {
+    frames = DIV_ROUND_UP(len, aql->frame_max - SX1280_FRAG_HDR_LEN);
+  }
+
+  return frames * aql->frame_ns + div_u64(len * aql->byte_ps, 1000);
+}
+
+/**
+ * Gets whether the TX ring should take no more packets from the stack, because
+ * it holds as many packets or as much airtime as it may.
+ * @context tx_lock
+ */
+static bool sx1280_tx_ring_full(struct sx1280_priv *priv) {
+  struct sx1280_aql *aql = &priv->aql;
+
+  return priv->tx_head - priv->tx_tail >= priv->tx_ring_depth
+    || (aql->target_us && aql->queued_ns >= (u64) aql->target_us * NSEC_PER_USEC);
+}
+
+/**
+ * Returns the `n`th packet from the tail of the TX ring, or NULL if the ring
+ * doesn't hold that many packets.
+ * @context process
+ */
+static struct sk_buff *sx1280_tx_peek(struct sx1280_priv *priv, unsigned int n) {
+  struct sk_buff *skb = NULL;
+
+  spin_lock_bh(&priv->tx_lock);
+
+  if (priv->tx_head - priv->tx_tail > n) {
+    skb = priv->tx_ring[(priv->tx_tail + n) % SX1280_TX_RING_SIZE];
+  }
+
+  spin_unlock_bh(&priv->tx_lock);
+  return skb;
+}
+
+/**
+ * Removes the packet at the tail of the TX ring, accounts for it as either sent
+ * or dropped, and wakes the packet queue if there is room in the ring again.
+ * @context process
+ */
+static void sx1280_tx_complete(struct sx1280_priv *priv, bool sent) {
+  struct net_device *netdev = priv->netdev;
+
+  spin_lock_bh(&priv->tx_lock);
+
+  if (priv->tx_head == priv->tx_tail) {
+    spin_unlock_bh(&priv->tx_lock);
+    netdev_warn(netdev, "tx completion without a queued packet\n");
+    return;
+  }
+
+  unsigned int slot = priv->tx_tail % SX1280_TX_RING_SIZE;
+  struct sk_buff *skb = priv->tx_ring[slot];
+  priv->tx_ring[slot] = NULL;
+  priv->tx_tail++;
+  priv->aql.queued_ns -= priv->aql.slot_ns[slot];
+
+  if (sent) {
+    SX1280_STATS_INC(priv, tx_packets);
+    SX1280_STATS_ADD(priv, tx_bytes, skb->len);
+  } else {
+    SX1280_STATS_INC(priv, tx_dropped);
+  }
+
+  /* Let BQL know the packet has left the queue, sent or not. */
+  netdev_completed_queue(netdev, 1, skb->len);
+
+  /* The duty cycle limiter wakes the queue itself once it's over. */
+  if (
+    netif_queue_stopped(netdev)
+    && !sx1280_tx_ring_full(priv)
+    && !READ_ONCE(priv->duty.throttled)
+  ) {
+    netif_wake_queue(netdev);
+  }
+
+  spin_unlock_bh(&priv->tx_lock);
+  dev_kfree_skb(skb);
+}
+
+/**************
+* Time on air *
+**************/
+
+/**
+ * Gets the time on air of a LoRa packet with `len` bytes of payload, following
+ * the datasheet's formula. Long interleaving is counted as its standard coding
+ * rate counterpart.
+ */
+static u64 sx1280_lora_time_on_air_ns(
+  const struct sx1280_lora_modulation_params *modulation,
+  const struct sx1280_lora_packet_params *packet,
+  unsigned int len
+) {
+  unsigned int sf = modulation->spreading_factor >> 4;
+  unsigned int bw_hz;
+  unsigned int cr;
+
+  switch (modulation->bandwidth) {
+  case SX1280_LORA_BW_1600: bw_hz = 1625000; break;
+  case SX1280_LORA_BW_800: bw_hz = 812500; break;
+  case SX1280_LORA_BW_400: bw_hz = 406250; break;
+  case SX1280_LORA_BW_200: bw_hz = 203125; break;
+  default: return 0;
+  }
+
+  switch (modulation->coding_rate) {
+  case SX1280_LORA_CR_4_5: case SX1280_LORA_CR_LI_4_5: cr = 1; break;
+  case SX1280_LORA_CR_4_6: case SX1280_LORA_CR_LI_4_6: cr = 2; break;
+  case SX1280_LORA_CR_4_7: cr = 3; break;
+  default: cr = 4; break;
+  }
+
+  /* The preamble length is encoded as mantissa * 2^exponent. */
+  u64 preamble = (u64) (packet->preamble_length & 0x0F)
+    << (packet->preamble_length >> 4);
+
+  int bits = 8 * (int) len - 4 * (int) sf;
+  if (packet->crc == SX1280_LORA_CRC_ENABLE) {
+    bits += 16;
+  }
+
+  if (packet->header_type == SX1280_EXPLICIT_HEADER) {
+    bits += 20;
+  }
+
+  if (sf >= 7) {
+    bits += 8;
+  }
+
+  /* SF11 and SF12 always use low data rate optimization. */
+  unsigned int bits_per_block = 4 * (sf >= 11 ? sf - 2 : sf);
+  unsigned int payload = 8
+    + DIV_ROUND_UP(max(bits, 0), bits_per_block) * (cr + 4);
+
+  /* Counted in quarter symbols, as the preamble ends with a fraction of one. */
+  u64 quarters = 4 * (preamble + payload) + (sf < 7 ? 25 : 17);
+
+  return div_u64((quarters << sf) * NSEC_PER_SEC, bw_hz * 4);
+}
+
+/**
+ * Gets the time on air of a GFSK packet with `len` bytes of payload.
+ */
+static u64 sx1280_gfsk_time_on_air_ns(
+  const struct sx1280_gfsk_modulation_params *modulation,
+  const struct sx1280_gfsk_packet_params *packet,
+  unsigned int len
+) {
+  unsigned int bitrate;
+
+  switch (modulation->bitrate_bandwidth) {
+  case SX1280_FSK_BR_2_000_BW_2_4: bitrate = 2000000; break;
+  case SX1280_FSK_BR_1_600_BW_2_4: bitrate = 1600000; break;
+  case SX1280_FSK_BR_1_000_BW_2_4:
+  case SX1280_FSK_BR_1_000_BW_1_2: bitrate = 1000000; break;
+  case SX1280_FSK_BR_0_800_BW_2_4:
+  case SX1280_FSK_BR_0_800_BW_1_2: bitrate = 800000; break;
+  case SX1280_FSK_BR_0_500_BW_1_2:
+  case SX1280_FSK_BR_0_500_BW_0_6: bitrate = 500000; break;
+  case SX1280_FSK_BR_0_400_BW_1_2:
+  case SX1280_FSK_BR_0_400_BW_0_6: bitrate = 400000; break;
+  case SX1280_FSK_BR_0_250_BW_0_6:
+  case SX1280_FSK_BR_0_250_BW_0_3: bitrate = 250000; break;
+  case SX1280_FSK_BR_0_125_BW_0_3: bitrate = 125000; break;
+  default: return 0;
+  }
+
+  u64 bits = 4 + 4 * (packet->preamble_length >> 4)
+    + 8 * (1 + packet->sync_word_length / 2)
+    + 8 * (len + (packet->crc_length >> 4));
+
+  if (packet->packet_type == SX1280_RADIO_PACKET_VARIABLE_LENGTH) {
+    bits += SX1280_GFSK_HEADER_BITS;
+  }
+
+  return div_u64(bits * NSEC_PER_SEC + bitrate - 1, bitrate);
+}
+
+/**
+ * Gets the time on air of an FLRC packet with `len` bytes of payload. The
+ * header, payload and CRC are coded, along with the encoder's tail bits.
+ */
+static u64 sx1280_flrc_time_on_air_ns(
+  const struct sx1280_flrc_modulation_params *modulation,
+  const struct sx1280_flrc_packet_params *packet,
+  unsigned int len
+) {
+  unsigned int bitrate;
+
+  switch (modulation->bitrate_bandwidth) {
+  case SX1280_FLRC_BR_1_300_BW_1_2: bitrate = 1300000; break;
+  case SX1280_FLRC_BR_1_000_BW_1_2: bitrate = 1040000; break;
+  case SX1280_FLRC_BR_0_650_BW_0_6: bitrate = 650000; break;
+  case SX1280_FLRC_BR_0_520_BW_0_6: bitrate = 520000; break;
+  case SX1280_FLRC_BR_0_325_BW_0_3: bitrate = 325000; break;
+  case SX1280_FLRC_BR_0_260_BW_0_3: bitrate = 260000; break;
+  default: return 0;
+  }
+
+  unsigned int crc_bytes = packet->crc_length >> 4;
+  if (crc_bytes) {
+    crc_bytes++;
+  }
+
+  u64 coded = 8 * (len + crc_bytes);
+  if (packet->packet_type == SX1280_RADIO_PACKET_VARIABLE_LENGTH) {
+    coded += SX1280_FLRC_HEADER_BITS;
+  }
+
+  switch (modulation->coding_rate) {
+  case SX1280_FLRC_CR_1_2:
+    coded = 2 * (coded + SX1280_FLRC_TAIL_BITS);
+    break;
+  case SX1280_FLRC_CR_3_4:
+    coded = DIV_ROUND_UP(4 * (coded + SX1280_FLRC_TAIL_BITS), 3);
+    break;
+  default:
+    break;
+  }
+
+  u64 bits = 4 + 4 * (packet->agc_preamble_length >> 4) + coded;
+  if (packet->sync_word_length == SX1280_FLRC_SYNC_WORD_LEN_P32S) {
+    bits += SX1280_FLRC_SYNC_WORD_BITS;
+  }
+
+  return div_u64(bits * NSEC_PER_SEC + bitrate - 1, bitrate);
+}
+
+/**
+ * Gets the rate parameter the chip is configured with: the spreading factor in
+ * LoRa mode, and the bitrate and bandwidth otherwise.
+ * @context process & locked
+ */
+static u8 sx1280_rate_configured(struct sx1280_priv *priv) {
+  switch (priv->cfg.mode) {
+  case SX1280_MODE_LORA:
+    return priv->cfg.lora.modulation.spreading_factor;
+  case SX1280_MODE_FLRC:
+    return priv->cfg.flrc.modulation.bitrate_bandwidth;
+  case SX1280_MODE_GFSK:
+    return priv->cfg.gfsk.modulation.bitrate_bandwidth;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * Gets the rate parameter the chip is on, which ADR or rate control may have
+ * moved away from the configured one.
+ * @context process & locked
+ */
+static u8 sx1280_rate_current(struct sx1280_priv *priv) {
+  if (priv->rate_mode != priv->cfg.mode) {
+    return sx1280_rate_configured(priv);
+  }
+
+  return priv->rate;
+}
+
+/**
+ * Gets the configured modulation parameters of the current mode, with another
+ * rate parameter in place of the configured one.
+ * @context process & locked
+ */
+static struct sx1280_modulation_params sx1280_rate_modulation(
+  struct sx1280_priv *priv,
+  u8 param
+) {
+  struct sx1280_modulation_params mod_params = { .mode = priv->cfg.mode };
+
+  switch (mod_params.mode) {
+  case SX1280_MODE_LORA:
+    mod_params.lora = priv->cfg.lora.modulation;
+    mod_params.lora.spreading_factor = param;
+    break;
+  case SX1280_MODE_FLRC:
+    mod_params.flrc = priv->cfg.flrc.modulation;
+    mod_params.flrc.bitrate_bandwidth = param;
+    break;
+  case SX1280_MODE_GFSK:
+    mod_params.gfsk = priv->cfg.gfsk.modulation;
+    mod_params.gfsk.bitrate_bandwidth = param;
+    break;
+  default:
+    break;
+  }
+
+  return mod_params;
+}
+
+/**
+ * Gets the time on air of a packet with `len` bytes of payload, as configured
+ * for the current mode, or 0 if packets can't be sent in the current mode.
+ */
+static u64 sx1280_time_on_air_ns(struct sx1280_priv *priv, unsigned int len) {
+  struct sx1280_config *cfg = &priv->cfg;
+  struct sx1280_modulation_params mod_params =
+    sx1280_rate_modulation(priv, sx1280_rate_current(priv));
+
+  switch (cfg->mode) {
+  case SX1280_MODE_FLRC:
+    return sx1280_flrc_time_on_air_ns(
+      &mod_params.flrc,
+      &cfg->flrc.packet,
+      len
+    );
+  case SX1280_MODE_GFSK:
+    return sx1280_gfsk_time_on_air_ns(
+      &mod_params.gfsk,
+      &cfg->gfsk.packet,
+      len
+    );
+  case SX1280_MODE_LORA:
+    return sx1280_lora_time_on_air_ns(
+      &mod_params.lora,
+      &cfg->lora.packet,
+      len
+    );
+  default:
+    return 0;
+  }
+}
+
+/**
+ * Picks the finest period base whose count can express a TX timeout for a
+ * packet with the given time on air.
+ */
+static void sx1280_tx_timeout(
+  u64 airtime_ns,
+  enum sx1280_period_base *period_base,
+  u16 *period_base_count
+) {
+  static const u32 base_ns[] = {
+    [SX1280_PERIOD_BASE_15_625_US] = 15625,
+    [SX1280_PERIOD_BASE_62_500_US] = 62500,
+    [SX1280_PERIOD_BASE_1_MS] = 1000000,
+    [SX1280_PERIOD_BASE_4_MS] = 4000000,
+  };
+
+  u64 timeout_ns = airtime_ns + airtime_ns / 8
+    + (u64) SX1280_TX_TIMEOUT_MARGIN_US * NSEC_PER_USEC;
+
+  for (unsigned int i = 0; i < ARRAY_SIZE(base_ns); i++) {
+    u64 count = div_u64(timeout_ns + base_ns[i] - 1, base_ns[i]);
+
+    if (count <= U16_MAX || i == ARRAY_SIZE(base_ns) - 1) {
+      *period_base = i;
+      *period_base_count = min(count, (u64) U16_MAX);
+      return;
+    }
+  }
+}
+
+/**
+ * Sums a 64-bit per-CPU statistic of the interface, given its offset within
+ * struct sx1280_pcpu_stats.
+ * @context any
+ */
+static u64 sx1280_stats_read(struct sx1280_priv *priv, size_t offset) {
+  u64 total = 0;
+  int cpu;
+
+  for_each_possible_cpu(cpu) {
+    const struct sx1280_pcpu_stats *pcpu = per_cpu_ptr(priv->stats, cpu);
+    const u64_stats_t *stat = (const void *) pcpu + offset;
+    unsigned int start;
+    u64 value;
+
+    do {
+      start = u64_stats_fetch_begin(&pcpu->syncp);
+      value = u64_stats_read(stat);
+    } while (u64_stats_fetch_retry(&pcpu->syncp, start));
+
+    total += value;
+  }
+
+  return total;
+}
+
+/********************
+* Frequency hopping *
+********************/
+
+/**
+ * Draws the hop sequence from the seed: every channel once, in an order that
+ * only depends on the seed and the number of channels.
+ * @context process & locked
+ */
+static void sx1280_fhss_shuffle(struct sx1280_fhss *fhss) {
+  struct rnd_state state;
+
+  prandom_seed_state(&state, fhss->seed);
+
+  for (unsigned int i = 0; i < fhss->n_channels; i++) {
+    fhss->seq[i] = i;
+  }
+
+  for (unsigned int i = fhss->n_channels; i > 1; i--) {
+    unsigned int j = prandom_u32_state(&state) % i;
+    swap(fhss->seq[i - 1], fhss->seq[j]);
+  }
+
+  fhss->seq_len = fhss->n_channels;
+  fhss->seq_explicit = false;
+}
+
+/**
+ * Gets the PLL word of the channel the chip should be on, which is the fixed
+ * frequency unless hopping.
+ * @context process & locked
+ */
+static u32 sx1280_fhss_freq(struct sx1280_priv *priv) {
+  struct sx1280_fhss *fhss = &priv->fhss;
+
+  if (!fhss->enabled || !fhss->seq_len) {
+    return priv->cfg.freq;
+  }
+
+  return fhss->channels[fhss->seq[fhss->rendezvous ? 0 : fhss->pos]];
+}
+
+/**
+ * Adds a retune to the current channel to the asynchronous sequence being
+ * built, unless the chip is on it already. Being precomputed, this is a single
+ * 4-byte command.
+ * @returns Whether the retune was added, to be passed to sx1280_fhss_retuned.
+ * @context process & locked
+ */
+static bool sx1280_fhss_retune(struct sx1280_priv *priv) {
+  struct sx1280_async_cmd *cmd = &priv->cmds->set_rf_frequency;
+  u32 freq = sx1280_fhss_freq(priv);
+  u8 tx[4] = {
+    SX1280_CMD_SET_RF_FREQUENCY,
+    freq >> 16,
+    (freq >> 8) & 0xFF,
+    freq & 0xFF
+  };
+
+  if (sx1280_shadow_cmd_match(priv, SX1280_SHADOW_RF_FREQUENCY, tx, sizeof(tx))) {
+    return false;
+  }
+
+  memcpy(cmd->tx, tx, sizeof(tx));
+  sx1280_async_add(priv, cmd);
+  return true;
+}
+
+/**
+ * Records the retune added by sx1280_fhss_retune once the sequence has run.
+ * @context process & locked
+ */
+static void sx1280_fhss_retuned(struct sx1280_priv *priv, bool retuned, int err) {
+  if (retuned) {
+    sx1280_shadow_cmd_update(
+      priv,
+      SX1280_SHADOW_RF_FREQUENCY,
+      priv->cmds->set_rf_frequency.tx,
+      4,
+      !err
+    );
+  }
+}
+
+/**
+ * Moves on to the next channel once a frame exchange is over, when hopping per
+ * packet. The chip is retuned as it's next armed.
+ * @context process & locked
+ */
+static void sx1280_fhss_next(struct sx1280_priv *priv) {
+  struct sx1280_fhss *fhss = &priv->fhss;
+
+  if (fhss->enabled && !fhss->dwell_us && fhss->seq_len) {
+    fhss->pos = (fhss->pos + 1) % fhss->seq_len;
+    fhss->hops++;
+  }
+}
+
+/**
+ * Anchors the hop sequence to a TDMA beacon that was sent or received: the
+ * superframe it starts hops on from the beacon's sequence number, with dwell
+ * periods counted from the end of the beacon. The chip is retuned as it's
+ * next armed.
+ * @context process & locked
+ */
+static void sx1280_fhss_anchor(
+  struct sx1280_priv *priv,
+  u8 seq,
+  u64 beacon_ns
+) {
+  struct sx1280_fhss *fhss = &priv->fhss;
+
+  if (!fhss->enabled || !fhss->seq_len) {
+    return;
+  }
+
+  hrtimer_try_to_cancel(&fhss->timer);
+  fhss->base = seq;
+  fhss->start_ns = beacon_ns;
+  if (fhss->pos != seq % fhss->seq_len) {
+    fhss->pos = seq % fhss->seq_len;
+    fhss->hops++;
+  }
+
+  if (fhss->dwell_us) {
+    kthread_queue_work(priv->worker, &fhss->work);
+  }
+}
+
+/*********************
+* Adaptive data rate *
+*********************/
+
+/*
+ * LoRa demodulates down to an SNR of -2.5 dB at SF5, and another 2.5 dB lower
+ * for each step of the spreading factor.
+ */
+static const struct sx1280_adr_rate sx1280_adr_lora_rates[] = {
+  { SX1280_LORA_SF_12, 12, -80 },
+  { SX1280_LORA_SF_11, 11, -70 },
+  { SX1280_LORA_SF_10, 10, -60 },
+  { SX1280_LORA_SF_9,  9,  -50 },
+  { SX1280_LORA_SF_8,  8,  -40 },
+  { SX1280_LORA_SF_7,  7,  -30 },
+  { SX1280_LORA_SF_6,  6,  -20 },
+  { SX1280_LORA_SF_5,  5,  -10 },
+};
+
+/* FLRC sensitivity, in dBm, from the datasheet. */
+static const struct sx1280_adr_rate sx1280_adr_flrc_rates[] = {
+  { SX1280_FLRC_BR_0_260_BW_0_3, 260000,  -104 * 4 },
+  { SX1280_FLRC_BR_0_325_BW_0_3, 325000,  -103 * 4 },
+  { SX1280_FLRC_BR_0_520_BW_0_6, 520000,  -101 * 4 },
+  { SX1280_FLRC_BR_0_650_BW_0_6, 650000,  -100 * 4 },
+  { SX1280_FLRC_BR_1_000_BW_1_2, 1000000, -98 * 4 },
+  { SX1280_FLRC_BR_1_300_BW_1_2, 1300000, -97 * 4 },
+};
+
+/**
+ * Gets the rates to pick from in a mode.
+ * @returns The rates, most robust first, or NULL if the rate isn't adapted in
+ *          that mode.
+ */
+static const struct sx1280_adr_rate *sx1280_adr_rates(
+  enum sx1280_mode mode,
+  unsigned int *n
+) {
+  switch (mode) {
+  case SX1280_MODE_LORA:
+    *n = ARRAY_SIZE(sx1280_adr_lora_rates);
+    return sx1280_adr_lora_rates;
+  case SX1280_MODE_FLRC:
+    *n = ARRAY_SIZE(sx1280_adr_flrc_rates);
+    return sx1280_adr_flrc_rates;
+  default:
+    *n = 0;
+    return NULL;
+  }
+}
+
+/**
+ * Reprograms the chip with another rate parameter, if it has changed. The
+ * configuration is left as it is, so that the configured rate can be gone
+ * back to.
+ * @context process & locked
+ */
+static int sx1280_rate_set(struct sx1280_priv *priv, u8 param) {
+  int err;
+
+  /* Ranging has no rate of its own to change. */
+  if (
+    priv->cfg.mode == SX1280_MODE_RANGING
+    || param == sx1280_rate_current(priv)
+  ) {
+    return 0;
+  }
+
+  /* The chip may still be listening, so it's stopped first. */
+  if (
+    (err = sx1280_set_standby(priv, SX1280_STDBY_XOSC))
+    || (err = sx1280_set_modulation_params(
+      priv,
+      sx1280_rate_modulation(priv, param)
+    ))
+  ) {
+    return err;
+  }
+
+  priv->state = SX1280_STATE_STANDBY;
+  return 0;
+}
+
+/**
+ * Finds a rate parameter among the rates, falling back on the most robust.
+ */
+static unsigned int sx1280_adr_index(
+  const struct sx1280_adr_rate *rates,
+  unsigned int n,
+  u8 param
+) {
+  for (unsigned int i = 0; i < n; i++) {
+    if (rates[i].param == param) {
+      return i;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Starts averaging afresh in the current mode, from the configured rate.
+ * @context process & locked
+ */
+static void sx1280_adr_reset(struct sx1280_priv *priv) {
+  struct sx1280_adr *adr = &priv->adr;
+
+  adr->mode = priv->cfg.mode;
+  adr->target = sx1280_rate_configured(priv);
+  adr->pick = adr->target;
+  adr->level = 0;
+  adr->packets = 0;
+  adr->trying = false;
+  adr->following = false;
+}
+
+/**
+ * Arms the timer for going back to the rate in use if an announced frame never
+ * came, or for falling back on the most robust rate if nothing is heard.
+ * @context process
+ */
+static void sx1280_adr_arm(struct sx1280_priv *priv, unsigned int ms) {
+  if (priv->initialized && netif_running(priv->netdev)) {
+    hrtimer_start(&priv->adr.timer, ms_to_ktime(ms), HRTIMER_MODE_REL);
+  }
+}
+
+/**
+ * Moves from one rate to another, keeping a record of it. The chip is
+ * reprogrammed as it's next armed.
+ * @context process & locked
+ */
+static void sx1280_adr_change(
+  struct sx1280_priv *priv,
+  const struct sx1280_adr_rate *rates,
+  unsigned int from,
+  unsigned int to
+) {
+  struct sx1280_adr *adr = &priv->adr;
+
+  if (from == to) {
+    return;
+  }
+
+  struct sx1280_adr_change *change =
+    &adr->history[adr->changes % SX1280_ADR_HISTORY_LEN];
+
+  change->ns = ktime_get_ns();
+  change->from = rates[from].value;
+  change->to = rates[to].value;
+  change->level_qdb = adr->level >> SX1280_ADR_EWMA_SHIFT;
+
+  netdev_dbg(
+    priv->netdev,
+    "adr: %u -> %u at %d qdB\n",
+    change->from,
+    change->to,
+    change->level_qdb
+  );
+
+  adr->target = rates[to].param;
+  adr->pick = adr->target;
+  WRITE_ONCE(adr->changes, adr->changes + 1);
+}
+
+/**
+ * Averages in the level of a received packet, and picks the fastest rate that
+ * leaves the margin, for the next ARQ frame to announce. The rate steps down
+ * as soon as the margin is gone, but only steps up with
+ * SX1280_ADR_HYSTERESIS_QDB to spare.
+ * @context process & locked
+ */
+static void sx1280_adr_rx(
+  struct sx1280_priv *priv,
+  const union sx1280_packet_status *status
+) {
+  struct sx1280_adr *adr = &priv->adr;
+  unsigned int n;
+  const struct sx1280_adr_rate *rates = sx1280_adr_rates(priv->cfg.mode, &n);
+
+  if (!adr->enabled || !rates) {
+    return;
+  }
+
+  if (adr->mode != priv->cfg.mode) {
+    sx1280_adr_reset(priv);
+  }
+
+  /* The SNR is in quarter dB, and the RSSI in -0.5 dBm. */
+  s32 sample = priv->cfg.mode == SX1280_MODE_LORA
+    ? (s8) status->lora.snr
+    : -2 * status->gfsk_flrc.rssi_sync;
+
+  if (adr->packets++) {
+    adr->level += sample - (adr->level >> SX1280_ADR_EWMA_SHIFT);
+  } else {
+    adr->level = sample << SX1280_ADR_EWMA_SHIFT;
+  }
+
+  if (!adr->following) {
+    sx1280_adr_arm(priv, SX1280_ADR_FALLBACK_MS);
+  }
+
+  if (adr->packets < SX1280_ADR_MIN_PACKETS) {
+    return;
+  }
+
+  s32 level = adr->level >> SX1280_ADR_EWMA_SHIFT;
+  s32 margin = adr->margin_db * 4;
+  unsigned int from = sx1280_adr_index(rates, n, adr->target);
+  unsigned int to = from;
+
+  while (to > 0 && level < rates[to].level_qdb + margin) {
+    to--;
+  }
+
+  while (
+    to + 1 < n
+    && level >= rates[to + 1].level_qdb + margin + SX1280_ADR_HYSTERESIS_QDB
+  ) {
+    to++;
+  }
+
+  adr->pick = rates[to].param;
+}
+
+/**
+ * Gets the rates to pick from if ADR is on and has been averaging in the
+ * current mode.
+ * @context process & locked
+ */
+static const struct sx1280_adr_rate *sx1280_adr_sync(
+  struct sx1280_priv *priv,
+  unsigned int *n
+) {
+  const struct sx1280_adr_rate *rates = sx1280_adr_rates(priv->cfg.mode, n);
+
+  if (!priv->adr.enabled || !rates || priv->adr.mode != priv->cfg.mode) {
+    return NULL;
+  }
+
+  return rates;
+}
+
+/**
+ * Works out whether the ARQ frame about to be sent has to be preceded by the
+ * announcement of the rate picked. The announcement is built in `rc->msg` if
+ * so, and sent like those of rate control.
+ * @context process & locked
+ */
+static bool sx1280_adr_announce(struct sx1280_priv *priv) {
+  struct sx1280_adr *adr = &priv->adr;
+  struct sx1280_rc *rc = &priv->rc;
+  unsigned int n;
+
+  if (
+    !sx1280_adr_sync(priv, &n)
+    || adr->following
+    || adr->pick == adr->target
+  ) {
+    return false;
+  }
+
+  memset(rc->msg, 0, sizeof(rc->msg));
+  rc->msg[0] = SX1280_DISPATCH_RATE;
+  rc->msg[1] = priv->link.node_id;
+  rc->msg[2] = adr->pick;
+  rc->msg[3] = 0;
+  rc->announcing = true;
+
+  return true;
+}
+
+/**
+ * Keeps the rate the ARQ frame was sent at once it's acknowledged, or goes
+ * back to the rate in use if it isn't.
+ * @returns Whether the chip is to change rate.
+ * @context process & locked
+ */
+static bool sx1280_adr_feedback(struct sx1280_priv *priv, bool acked) {
+  struct sx1280_adr *adr = &priv->adr;
+  unsigned int n;
+  const struct sx1280_adr_rate *rates = sx1280_adr_sync(priv, &n);
+
+  if (!rates || !adr->trying) {
+    return false;
+  }
+
+  adr->trying = false;
+
+  if (acked) {
+    sx1280_adr_change(
+      priv,
+      rates,
+      sx1280_adr_index(rates, n, adr->target),
+      sx1280_adr_index(rates, n, adr->trial)
+    );
+  }
+
+  return !acked;
+}
+
+/**
+ * Follows the other end onto the rate it announced, for the frame it sends
+ * next, from when the chip is next armed. The rate is only kept once that
+ * frame has been acknowledged.
+ * @context process & locked
+ */
+static void sx1280_adr_follow(struct sx1280_priv *priv, u8 param) {
+  struct sx1280_adr *adr = &priv->adr;
+  unsigned int n;
+  const struct sx1280_adr_rate *rates = sx1280_adr_sync(priv, &n);
+
+  if (!rates || rates[sx1280_adr_index(rates, n, param)].param != param) {
+    return;
+  }
+
+  adr->trial = param;
+  adr->following = true;
+  sx1280_adr_arm(priv, priv->arq.ack_timeout_ms);
+}
+
+/**
+ * Keeps the rate that was followed once the ACK of the frame received at it
+ * is out, or goes back to the rate in use if it couldn't be sent.
+ * @context process & locked
+ */
+static void sx1280_adr_followed(struct sx1280_priv *priv, bool sent) {
+  struct sx1280_adr *adr = &priv->adr;
+  unsigned int n;
+  const struct sx1280_adr_rate *rates = sx1280_adr_sync(priv, &n);
+
+  if (!rates || !adr->following) {
+    return;
+  }
+
+  adr->following = false;
+  sx1280_adr_arm(priv, SX1280_ADR_FALLBACK_MS);
+
+  if (sent) {
+    sx1280_adr_change(
+      priv,
+      rates,
+      sx1280_adr_index(rates, n, adr->target),
+      sx1280_adr_index(rates, n, adr->trial)
+    );
+  }
+}
+
+/***************
+* Rate control *
+***************/
+
+/* GFSK sensitivity, in dBm, from the datasheet. */
+static const struct sx1280_adr_rate sx1280_rc_gfsk_rates[] = {
+  { SX1280_FSK_BR_0_125_BW_0_3, 125000,  -99 * 4 },
+  { SX1280_FSK_BR_0_250_BW_0_3, 250000,  -97 * 4 },
+  { SX1280_FSK_BR_0_400_BW_0_6, 400000,  -95 * 4 },
+  { SX1280_FSK_BR_0_500_BW_0_6, 500000,  -94 * 4 },
+  { SX1280_FSK_BR_0_800_BW_1_2, 800000,  -92 * 4 },
+  { SX1280_FSK_BR_1_000_BW_1_2, 1000000, -91 * 4 },
+  { SX1280_FSK_BR_1_600_BW_2_4, 1600000, -89 * 4 },
+  { SX1280_FSK_BR_2_000_BW_2_4, 2000000, -88 * 4 },
+};
+
+/**
+ * Gets the rates rate control picks from in a mode.
+ * @returns The rates, most robust first, or NULL if there's no rate control in
+ *          that mode.
+ */
+static const struct sx1280_adr_rate *sx1280_rc_rates(
+  enum sx1280_mode mode,
+  unsigned int *n
+) {
+  switch (mode) {
+  case SX1280_MODE_GFSK:
+    *n = ARRAY_SIZE(sx1280_rc_gfsk_rates);
+    return sx1280_rc_gfsk_rates;
+  case SX1280_MODE_FLRC:
+    *n = ARRAY_SIZE(sx1280_adr_flrc_rates);
+    return sx1280_adr_flrc_rates;
+  default:
+    *n = 0;
+    return NULL;
+  }
+}
+
+/**
+ * Starts learning afresh in the current mode, from the configured rate.
+ * @context process & locked
+ */
+static void sx1280_rc_reset(struct sx1280_priv *priv) {
+  struct sx1280_rc *rc = &priv->rc;
+  unsigned int n;
+  const struct sx1280_adr_rate *rates = sx1280_rc_rates(priv->cfg.mode, &n);
+
+  rc->mode = priv->cfg.mode;
+  memset(rc->stats, 0, sizeof(rc->stats));
+  rc->base = sx1280_rate_configured(priv);
+  rc->rate = rc->base;
+  rc->best = rates ? sx1280_adr_index(rates, n, rc->base) : 0;
+  rc->frames = 0;
+  rc->announcing = false;
+  rc->probing = false;
+  rc->following = false;
+}
+
+/**
+ * Gets the rates to pick from if rate control is on in the current mode,
+ * starting afresh if the mode has changed.
+ * @context process & locked
+ */
+static const struct sx1280_adr_rate *sx1280_rc_sync(
+  struct sx1280_priv *priv,
+  unsigned int *n
+) {
+  const struct sx1280_adr_rate *rates = sx1280_rc_rates(priv->cfg.mode, n);
+
+  if (!priv->rc.enabled || !rates) {
+    return NULL;
+  }
+
+  if (priv->rc.mode != priv->cfg.mode) {
+    sx1280_rc_reset(priv);
+  }
+
+  return rates;
+}
+
+/**
+ * Arms the timer for going back to the link's rate after following a probe,
+ * or for falling back on the most robust rate if nothing is heard.
+ * @context process
+ */
+static void sx1280_rc_arm(struct sx1280_priv *priv, unsigned int ms) {
+  if (priv->initialized && netif_running(priv->netdev)) {
+    hrtimer_start(&priv->rc.timer, ms_to_ktime(ms), HRTIMER_MODE_REL);
+  }
+}
+
+/**
+ * Accounts for an attempt at sending an ARQ frame at the rate the chip is on,
+ * and works out the best rate again. A probe is over with its first attempt,
+ * and any retransmissions are sent at the link's rate.
+ * @returns Whether the chip is to change rate.
+ * @context process & locked
+ */
+static bool sx1280_rc_feedback(struct sx1280_priv *priv, bool acked) {
+  struct sx1280_rc *rc = &priv->rc;
+  unsigned int n;
+  const struct sx1280_adr_rate *rates = sx1280_rc_sync(priv, &n);
+
+  if (!rates) {
+    return false;
+  }
+
+  struct sx1280_rc_stats *stats = &rc->stats[sx1280_adr_index(rates, n, rc->rate)];
+  u32 sample = acked ? SX1280_RC_PROB_ONE : 0;
+
+  if (stats->attempts++) {
+    stats->prob += (sample >> SX1280_RC_EWMA_SHIFT)
+      - (stats->prob >> SX1280_RC_EWMA_SHIFT);
+  } else {
+    stats->prob = sample;
+  }
+
+  if (acked) {
+    stats->successes++;
+  }
+
+  unsigned int base = sx1280_adr_index(rates, n, rc->base);
+  u64 best_tp = (u64) rc->stats[base].prob * rates[base].value;
+
+  rc->best = base;
+  for (unsigned int i = 0; i < n; i++) {
+    u64 tp = (u64) rc->stats[i].prob * rates[i].value;
+
+    if (rc->stats[i].attempts >= SX1280_RC_MIN_ATTEMPTS && tp > best_tp) {
+      rc->best = i;
+      best_tp = tp;
+    }
+  }
+
+  if (!rc->probing) {
+    return false;
+  }
+
+  rc->probing = false;
+  rc->rate = rc->base;
+  return true;
+}
+
+/**
+ * Works out whether the ARQ frame about to be sent has to be preceded by an
+ * announcement: of a move to a better rate, or of a probe of a neighbouring
+ * one with the frame. The announcement is built in `rc->msg` if so.
+ * @context process & locked
+ */
+static bool sx1280_rc_announce(struct sx1280_priv *priv) {
+  struct sx1280_rc *rc = &priv->rc;
+  unsigned int n;
+  const struct sx1280_adr_rate *rates = sx1280_rc_sync(priv, &n);
+  unsigned int next;
+  bool probe = false;
+
+  if (!rates || rc->following) {
+    return false;
+  }
+
+  unsigned int base = sx1280_adr_index(rates, n, rc->base);
+
+  if (rc->best != base) {
+    next = rc->best;
+  } else if (++rc->frames % SX1280_RC_PROBE_INTERVAL) {
+    return false;
+  } else {
+    /* Probe either side in turn, as far as there are rates to go to. */
+    rc->probe_up = !rc->probe_up;
+    if ((rc->probe_up && base + 1 < n) || !base) {
+      next = base + 1;
+    } else {
+      next = base - 1;
+    }
+
+    if (next >= n) {
+      return false;
+    }
+
+    probe = true;
+  }
+
+  memset(rc->msg, 0, sizeof(rc->msg));
+  rc->msg[0] = SX1280_DISPATCH_RATE;
+  rc->msg[1] = priv->link.node_id;
+  rc->msg[2] = rates[next].param;
+  rc->msg[3] = probe;
+  rc->announcing = true;
+
+  return true;
+}
+
+/**
+ * Forgets a probe that's underway, e.g. once its frame has been dropped.
+ * @context process & locked
+ */
+static void sx1280_rc_abort(struct sx1280_priv *priv) {
+  struct sx1280_rc *rc = &priv->rc;
+
+  rc->announcing = false;
+  priv->adr.trying = false;
+
+  if (rc->probing) {
+    rc->probing = false;
+    rc->rate = rc->base;
+  }
+}
+
+/**
+ * Reprograms the chip with the rate picked by ADR or rate control, or with the
+ * configured one if neither is, if it has changed. This is called as the chip
+ * is armed for the next packet, so a packet on the air is never cut short.
+ * @context process & locked
+ */
+static int sx1280_rate_apply(struct sx1280_priv *priv) {
+  struct sx1280_adr *adr = &priv->adr;
+
+  if (adr->enabled && adr->mode == priv->cfg.mode) {
+    bool trial = adr->trying || adr->following;
+    return sx1280_rate_set(priv, trial ? adr->trial : adr->target);
+  }
+
+  if (priv->rc.enabled && priv->rc.mode == priv->cfg.mode) {
+    return sx1280_rate_set(priv, priv->rc.rate);
+  }
+
+  return sx1280_rate_set(priv, sx1280_rate_configured(priv));
+}
+
+/**
+ * Puts the chip back on the configured rate as ADR or rate control is turned
+ * off. Like the modulation attributes, this doesn't interrupt listening.
+ * @context process & idle
+ */
+static int sx1280_rate_restore(struct sx1280_priv *priv) {
+  u8 param = sx1280_rate_configured(priv);
+
+  if (
+    priv->cfg.mode == SX1280_MODE_RANGING
+    || param == sx1280_rate_current(priv)
+  ) {
+    return 0;
+  }
+
+  return sx1280_set_modulation_params(priv, sx1280_rate_modulation(priv, param));
+}
+
+/*************
+* Duty cycle *
+*************/
+
+/**
+ * Gets how much airtime the duty cycle bucket holds when full.
+ */
+static u64 sx1280_duty_capacity_ns(struct sx1280_duty *duty) {
+  return div_u64(
+    (u64) duty->window_s * NSEC_PER_SEC * duty->millipercent,
+    SX1280_DUTY_MILLIPERCENT_MAX
+  );
+}
+
+/**
+ * Adds the airtime earned since the bucket was last refilled.
+ * @context process & locked
+ */
+static void sx1280_duty_refill(struct sx1280_duty *duty, u64 now) {
+  u64 capacity = sx1280_duty_capacity_ns(duty);
+
+  /* Anything longer than it takes to pay off the debt fills the bucket. */
+  u64 fill_ns = div_u64(
+    (u64) (capacity - duty->tokens_ns) * SX1280_DUTY_MILLIPERCENT_MAX,
+    duty->millipercent
+  );
+
+  u64 elapsed = min(now - duty->refill_ns, fill_ns);
+  u64 earned = div_u64(elapsed * duty->millipercent, SX1280_DUTY_MILLIPERCENT_MAX);
+
+  duty->tokens_ns = min_t(s64, duty->tokens_ns + earned, capacity);
+  duty->refill_ns = now;
+}
+
+/**
+ * Fills the bucket, e.g. after the limit has been changed.
+ * @context process & locked
+ */
+static void sx1280_duty_reset(struct sx1280_duty *duty) {
+  duty->tokens_ns = sx1280_duty_capacity_ns(duty);
+  duty->refill_ns = ktime_get_ns();
+}
+
+/**
+ * Ends throttling, letting the stack queue packets again.
+ * @context process & locked
+ */
+static void sx1280_duty_unthrottle(struct sx1280_priv *priv) {
+  struct sx1280_duty *duty = &priv->duty;
+
+  if (!duty->throttled) {
+    return;
+  }
+
+  duty->throttled_ns += ktime_get_ns() - duty->throttled_since_ns;
+  WRITE_ONCE(duty->throttled, false);
+
+  spin_lock_bh(&priv->tx_lock);
+
+  if (netif_running(priv->netdev) && !sx1280_tx_ring_full(priv)) {
+    netif_wake_queue(priv->netdev);
+  }
+
+  spin_unlock_bh(&priv->tx_lock);
+}
+
+/**
+ * Checks whether a frame of `len` bytes may be started within the duty cycle.
+ * If not, the packet queue is stopped until the bucket holds enough for it.
+ * A frame too long to ever fit is let through once the bucket is full.
+ * @context process & locked
+ */
+static bool sx1280_duty_admit(struct sx1280_priv *priv, unsigned int len) {
+  struct sx1280_duty *duty = &priv->duty;
+
+  if (duty->millipercent >= SX1280_DUTY_MILLIPERCENT_MAX) {
+    return true;
+  }
+
+  u64 now = ktime_get_ns();
+  sx1280_duty_refill(duty, now);
+
+  if (priv->arq.enabled) {
+    len += SX1280_ARQ_HDR_LEN;
+  }
+
+  s64 need = min(sx1280_time_on_air_ns(priv, len), sx1280_duty_capacity_ns(duty));
+  if (duty->tokens_ns >= need) {
+    sx1280_duty_unthrottle(priv);
+    return true;
+  }
+
+  if (!duty->throttled) {
+    duty->throttles++;
+    duty->throttled_since_ns = now;
+    WRITE_ONCE(duty->throttled, true);
+    netif_stop_queue(priv->netdev);
+  }
+
+  /* Come back once enough has been earned. */
+  u64 wait_ns = div_u64(
+    (u64) (need - duty->tokens_ns) * SX1280_DUTY_MILLIPERCENT_MAX,
+    duty->millipercent
+  );
+
+  if (priv->initialized) {
+    hrtimer_start(&duty->timer, ns_to_ktime(wait_ns + 1), HRTIMER_MODE_REL);
+  }
+
+  return false;
+}
+
+/**
+ * Accounts for a finished transmission's airtime, in the interface statistics
+ * and against the duty cycle.
+ * @context process & locked
+ */
+static void sx1280_tx_airtime(struct sx1280_priv *priv, u64 airtime_ns) {
+  struct sx1280_duty *duty = &priv->duty;
+
+  SX1280_STATS_ADD(priv, tx_airtime_ns, airtime_ns);
+
+  if (duty->millipercent >= SX1280_DUTY_MILLIPERCENT_MAX) {
+    return;
+  }
+
+  /*
+   * Transmissions that can't wait, like ACKs, may overdraw the bucket. All of
+   * it is paid back before the next frame is admitted.
+   */
+  sx1280_duty_refill(duty, ktime_get_ns());
+  duty->tokens_ns -= airtime_ns;
+}
+
+/**
+ * Lifts throttling once the bucket should hold enough for the next frame,
+ * which is checked again as it's sent.
+ * @context process
+ */
+static void sx1280_duty_work(struct kthread_work *work) {
+  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, duty.work);
+
+  mutex_lock(&priv->lock);
+  sx1280_duty_unthrottle(priv);
+
+  /*
+   * A retransmission that was held back goes first, unless it's still backing
+   * off, or TDMA sends it in the next owned slot.
+   */
+  bool retransmit = priv->arq.phase == SX1280_ARQ_BACKOFF
+    && !hrtimer_active(&priv->arq.timer)
+    && !priv->tdma.enabled;
+
+  mutex_unlock(&priv->lock);
+
+  kthread_queue_work(
+    priv->worker,
+    retransmit ? &priv->arq.work : &priv->tx_work
+  );
+}
+
+/**
+ * Hands the end of throttling off to the worker.
+ * @context hardirq
+ */
+static enum hrtimer_restart sx1280_duty_timer(struct hrtimer *timer) {
+  struct sx1280_priv *priv = container_of(timer, struct sx1280_priv, duty.timer);
+
+  kthread_queue_work(priv->worker, &priv->duty.work);
+  return HRTIMER_NORESTART;
+}
+
+/*************
+* Link layer *
+*************/
+
+/**
+ * Gets the largest radio frame the current mode can carry, less room for the
+ * ARQ header if enabled, or 0 if packets can't be sent in the current mode.
+ */
+static unsigned int sx1280_frame_max(struct sx1280_priv *priv) {
+  unsigned int frame_max;
+
+  switch (priv->cfg.mode) {
+  case SX1280_MODE_FLRC: frame_max = SX1280_FLRC_PAYLOAD_LENGTH_MAX; break;
+  case SX1280_MODE_GFSK: frame_max = SX1280_GFSK_PAYLOAD_LENGTH_MAX; break;
+  case SX1280_MODE_LORA: frame_max = SX1280_LORA_PAYLOAD_LENGTH_MAX; break;
+  default: return 0;
+  }
+
+  return priv->arq.enabled ? frame_max - SX1280_ARQ_HDR_LEN : frame_max;
+}
+
+/**
+ * Gets the length a short control frame has to be padded out to for the
+ * current mode.
+ */
+static unsigned int sx1280_frame_pad(struct sx1280_priv *priv, unsigned int len) {
+  if (priv->cfg.mode == SX1280_MODE_FLRC) {
+    return max(len, (unsigned int) SX1280_FLRC_PAYLOAD_LENGTH_MIN);
+  }
+
+  return len;
+}
+
+/**
+ * Gets the airtime it would take to send a datagram of `len` bytes as things
+ * stand, counting fragmentation, ARQ headers and ACKs, but not compression.
+ * @returns The airtime, or 0 if such a datagram can't be sent.
+ * @context process & locked
+ */
+static u64 sx1280_link_airtime_ns(struct sx1280_priv *priv, unsigned int len) {
+  unsigned int frame_max = sx1280_frame_max(priv);
+  unsigned int hdr_len = priv->arq.enabled ? SX1280_ARQ_HDR_LEN : 0;
+  u64 ack_ns = 0;
+
+  if (!frame_max) {
+    return 0;
+  }
+
+  if (priv->arq.enabled) {
+    ack_ns = sx1280_time_on_air_ns(
+      priv,
+      sx1280_frame_pad(priv, SX1280_ARQ_ACK_LEN)
+    );
+  }
+
+  if (len <= frame_max) {
+    return sx1280_time_on_air_ns(priv, hdr_len + len) + ack_ns;
+  }
+
+  /* Split evenly, the same way sx1280_link_tx_build does. */
+  unsigned int count = DIV_ROUND_UP(len, frame_max - SX1280_FRAG_HDR_LEN);
+  if (count > SX1280_FRAG_MAX) {
+    return 0;
+  }
+
+  unsigned int size = DIV_ROUND_UP(len, count);
+  unsigned int last = len - size * (count - 1);
+  hdr_len += SX1280_FRAG_HDR_LEN;
+
+  return (count - 1) * (sx1280_time_on_air_ns(priv, hdr_len + size) + ack_ns)
+    + sx1280_time_on_air_ns(priv, hdr_len + last) + ack_ns;
+}
+
+/**
+ * Refits the airtime queue limit's model to the current settings, as the cost
+ * of a frame and the cost of each byte in it. Packets already in the ring keep
+ * the estimate they were queued with.
+ * @context process & locked
+ */
+static void sx1280_aql_update(struct sx1280_priv *priv) {
+  unsigned int frame_max = sx1280_frame_max(priv);
+  u64 frame_ns = 0;
+  u64 byte_ps = 0;
+
+  if (frame_max > 1) {
+    frame_ns = sx1280_link_airtime_ns(priv, 1);
+
+    u64 full_ns = sx1280_link_airtime_ns(priv, frame_max);
+    if (full_ns > frame_ns) {
+      byte_ps = div_u64((full_ns - frame_ns) * 1000, frame_max - 1);
+    }
+  }
+
+  spin_lock_bh(&priv->tx_lock);
+  priv->aql.frame_max = frame_max;
+  priv->aql.frame_ns = frame_ns;
+  priv->aql.byte_ps = byte_ps;
+  spin_unlock_bh(&priv->tx_lock);
+}
+
+/**
+ * Gets whether ACKs can be sent by the chip with AutoTx. This needs the ACK's
+ * length to be programmed while receiving, which only LoRa with an explicit
+ * header allows; other modes take the programmed length as the largest packet
+ * to receive.
+ */
+static bool sx1280_arq_hw_ack(struct sx1280_priv *priv) {
+  return priv->cfg.mode == SX1280_MODE_LORA
+    && priv->cfg.lora.packet.header_type == SX1280_EXPLICIT_HEADER;
+}
+
+/**
+ * Forgets the ARQ frame being sent, once it's acknowledged or given up on.
+ * @context process & locked
+ */
+static void sx1280_arq_reset(struct sx1280_priv *priv) {
+  struct sx1280_arq *arq = &priv->arq;
+
+  hrtimer_try_to_cancel(&arq->timer);
+  arq->phase = SX1280_ARQ_IDLE;
+  arq->retries = 0;
+  arq->frame = false;
+  sx1280_rc_abort(priv);
+}
+
+/**
+ * Gives up on getting the channel for the frame waiting on it, if any.
+ * @context process & locked
+ */
+static void sx1280_mac_reset(struct sx1280_priv *priv) {
+  struct sx1280_mac *mac = &priv->mac;
+
+  hrtimer_try_to_cancel(&mac->timer);
+
+  if (mac->busy_since_ns) {
+    mac->busy_ns += ktime_get_ns() - mac->busy_since_ns;
+    mac->busy_since_ns = 0;
+  }
+
+  mac->phase = SX1280_MAC_IDLE;
+}
+
+/**
+ * Forgets the datagram being sent, e.g. once it has been dropped.
+ * @context process & locked
+ */
+static void sx1280_link_tx_reset(struct sx1280_priv *priv) {
+  struct sx1280_link *link = &priv->link;
+
+  sx1280_arq_reset(priv);
+  sx1280_mac_reset(priv);
+
+  link->payload = NULL;
+  link->payload_len = 0;
+  link->frag_offset = 0;
+  link->frag_idx = 0;
+  link->frag_count = 0;
+  link->frag_dropped = false;
+  link->frame_skbs = 0;
+  link->frame_saved = 0;
+}
+
+/**
+ * Compresses an IPv6 link-local or multicast address where possible.
+ * @returns The addressing mode, with any inline bytes written to `*p`.
+ */
+static u8 sx1280_iphc6_compress_addr(
+  const struct in6_addr *addr,
+  bool dst,
+  u8 **p
+) {
+  static const u8 link_local[8] = { 0xFE, 0x80 };
+  static const u8 short_iid[6] = { 0x00, 0x00, 0x00, 0xFF, 0xFE, 0x00 };
+  static const u8 mcast_all[15] = { 0xFF, 0x02 };
+  const u8 *a = addr->s6_addr;
+
+  if (!memcmp(a, link_local, sizeof(link_local))) {
+    if (!memcmp(&a[8], short_iid, sizeof(short_iid))) {
+      memcpy(*p, &a[14], 2);
+      *p += 2;
+      return SX1280_IPHC6_ADDR_LL16;
+    }
+
+    memcpy(*p, &a[8], 8);
+    *p += 8;
+    return SX1280_IPHC6_ADDR_LL64;
+  }
+
+  if (dst && !memcmp(a, mcast_all, sizeof(mcast_all))) {
+    *(*p)++ = a[15];
+    return SX1280_IPHC6_ADDR_SHORT;
+  }
+
+  if (!dst && ipv6_addr_any(addr)) {
+    return SX1280_IPHC6_ADDR_SHORT;
+  }
+
+  memcpy(*p, a, 16);
+  *p += 16;
+  return SX1280_IPHC6_ADDR_INLINE;
+}
+
+/**
+ * Expands an IPv6 address compressed by sx1280_iphc6_compress_addr.
+ * @returns The number of inline bytes consumed, or -EINVAL if there weren't
+ *          enough of them.
+ */
+static int sx1280_iphc6_expand_addr(
+  u8 mode,
+  bool dst,
+  const u8 *p,
+  unsigned int avail,
+  struct in6_addr *addr
+) {
+  u8 *a = addr->s6_addr;
+  memset(a, 0, sizeof(addr->s6_addr));
+
+  switch (mode) {
+  case SX1280_IPHC6_ADDR_INLINE:
+    if (avail < 16) {
+      return -EINVAL;
+    }
+
+    memcpy(a, p, 16);
+    return 16;
+  case SX1280_IPHC6_ADDR_LL64:
+    if (avail < 8) {
+      return -EINVAL;
+    }
+
+    a[0] = 0xFE;
+    a[1] = 0x80;
+    memcpy(&a[8], p, 8);
+    return 8;
+  case SX1280_IPHC6_ADDR_LL16:
+    if (avail < 2) {
+      return -EINVAL;
+    }
+
+    a[0] = 0xFE;
+    a[1] = 0x80;
+    a[11] = 0xFF;
+    a[12] = 0xFE;
+    memcpy(&a[14], p, 2);
+    return 2;
+  default:
+    if (!dst) {
+      return 0;
+    }
+
+    if (avail < 1) {
+      return -EINVAL;
+    }
+
+    a[0] = 0xFF;
+    a[1] = 0x02;
+    a[15] = p[0];
+    return 1;
+  }
+}
+
+/**
+ * Encodes a hop limit or TTL as one of the common values, or 0 if it has to be
+ * sent inline.
+ */
+static u8 sx1280_iphc_compress_hlim(u8 hlim) {
+  switch (hlim) {
+  case 1: return 1;
+  case 64: return 2;
+  case 255: return 3;
+  default: return 0;
+  }
+}
+
+static const u8 sx1280_iphc_hlim[] = { 0, 1, 64, 255 };
+
+/**
+ * Compresses the IPv6 header (and UDP header, if any) of a packet.
+ *
+ * Payload length is always elided, as it follows from the frame length. Other
+ * fields are elided when they take common values: no traffic class or flow
+ * label, common hop limits, link-local addresses (particularly those with
+ * short interface IDs), the unspecified source and link-local multicast
+ * destinations. UDP ports and checksum are carried as-is, with the length
+ * elided.
+ *
+ * @returns The length of the compressed header, or 0 if the packet can't be
+ *          compressed.
+ */
+static unsigned int sx1280_iphc6_compress(
+  const struct sk_buff *skb,
+  u8 *hdr,
+  unsigned int *consumed
+) {
+  const struct ipv6hdr *ip6h = (const struct ipv6hdr *) skb->data;
+
+  if (
+    skb->len < sizeof(*ip6h)
+    || ntohs(ip6h->payload_len) != skb->len - sizeof(*ip6h)
+  ) {
+    return 0;
+  }
+
+  const u8 *raw = skb->data;
+  const struct udphdr *udph = (const struct udphdr *) &raw[sizeof(*ip6h)];
+  bool udp = ip6h->nexthdr == IPPROTO_UDP
+    && skb->len >= sizeof(*ip6h) + sizeof(*udph)
+    && ntohs(udph->len) == skb->len - sizeof(*ip6h);
+
+  u8 flags = 0;
+  u8 *p = &hdr[SX1280_IPHC_HDR_LEN];
+
+  /* Traffic class and flow label, i.e. everything after the version. */
+  if ((raw[0] & 0x0F) || raw[1] || raw[2] || raw[3]) {
+    flags |= SX1280_IPHC6_TF;
+    *p++ = raw[0] & 0x0F;
+    memcpy(p, &raw[1], 3);
+    p += 3;
+  }
+
+  if (udp) {
+    flags |= SX1280_IPHC6_NH_UDP;
+  } else {
+    *p++ = ip6h->nexthdr;
+  }
+
+  u8 hlim = sx1280_iphc_compress_hlim(ip6h->hop_limit);
+  flags |= hlim << SX1280_IPHC6_HLIM_SHIFT;
+  if (!hlim) {
+    *p++ = ip6h->hop_limit;
+  }
+
+  flags |= sx1280_iphc6_compress_addr(&ip6h->saddr, false, &p)
+    << SX1280_IPHC6_SAM_SHIFT;
+  flags |= sx1280_iphc6_compress_addr(&ip6h->daddr, true, &p)
+    << SX1280_IPHC6_DAM_SHIFT;
+
+  *consumed = sizeof(*ip6h);
+
+  if (udp) {
+    memcpy(p, &udph->source, 4);
+    memcpy(p + 4, &udph->check, 2);
+    p += 6;
+    *consumed += sizeof(*udph);
+  }
+
+  hdr[0] = SX1280_DISPATCH_IPHC6;
+  hdr[1] = flags;
+  return p - hdr;
+}
+
+/**
+ * Compresses the IPv4 header (and UDP header, if any) of a packet.
+ *
+ * Total length and header checksum are always elided, as they can be rebuilt
+ * from the frame. Addresses are carried inline, since there's no shared
+ * context to compress them against, while a zero TOS and ID, the common
+ * fragment flags and common TTLs are elided. Packets with options aren't
+ * compressed.
+ *
+ * @returns The length of the compressed header, or 0 if the packet can't be
+ *          compressed.
+ */
+static unsigned int sx1280_iphc4_compress(
+  const struct sk_buff *skb,
+  u8 *hdr,
+  unsigned int *consumed
+) {
+  const struct iphdr *iph = (const struct iphdr *) skb->data;
+
+  if (
+    skb->len < sizeof(*iph)
+    || iph->ihl != 5
+    || ntohs(iph->tot_len) != skb->len
+  ) {
+    return 0;
+  }
+
+  const struct udphdr *udph = (const struct udphdr *) &skb->data[sizeof(*iph)];
+  u16 frag_off = ntohs(iph->frag_off);
+  bool udp = iph->protocol == IPPROTO_UDP
+    && !(frag_off & (IP_MF | IP_OFFSET))
+    && skb->len >= sizeof(*iph) + sizeof(*udph)
+    && ntohs(udph->len) == skb->len - sizeof(*iph);
+
+  u8 flags = 0;
+  u8 *p = &hdr[SX1280_IPHC_HDR_LEN];
+
+  if (iph->tos) {
+    flags |= SX1280_IPHC4_TOS;
+    *p++ = iph->tos;
+  }
+
+  if (iph->id) {
+    flags |= SX1280_IPHC4_ID;
+    memcpy(p, &iph->id, 2);
+    p += 2;
+  }
+
+  if (frag_off == IP_DF) {
+    flags |= SX1280_IPHC4_FRAG_DF << SX1280_IPHC4_FRAG_SHIFT;
+  } else if (!frag_off) {
+    flags |= SX1280_IPHC4_FRAG_NONE << SX1280_IPHC4_FRAG_SHIFT;
+  } else {
+    flags |= SX1280_IPHC4_FRAG_INLINE << SX1280_IPHC4_FRAG_SHIFT;
+    memcpy(p, &iph->frag_off, 2);
+    p += 2;
+  }
+
+  u8 ttl = sx1280_iphc_compress_hlim(iph->ttl);
+  flags |= ttl << SX1280_IPHC4_TTL_SHIFT;
+  if (!ttl) {
+    *p++ = iph->ttl;
+  }
+
+  if (udp) {
+    flags |= SX1280_IPHC4_UDP;
+  } else {
+    *p++ = iph->protocol;
+  }
+
+  memcpy(p, &iph->saddr, 4);
+  memcpy(p + 4, &iph->daddr, 4);
+  p += 8;
+
+  *consumed = sizeof(*iph);
+
+  if (udp) {
+    memcpy(p, &udph->source, 4);
+    memcpy(p + 4, &udph->check, 2);
+    p += 6;
+    *consumed += sizeof(*udph);
+  }
+
+  hdr[0] = SX1280_DISPATCH_IPHC4;
+  hdr[1] = flags;
+  return p - hdr;
+}
+
+/**
+ * Compresses the headers of a packet about to be sent, if enabled and if it
+ * saves anything.
+ *
+ * @context process & locked
+ * @returns The length of the compressed header written to `hdr` (which must
+ *          hold SX1280_IPHC_HDR_MAX bytes) with `consumed` set to the length of
+ *          the headers it replaces, or 0 if the packet is to be sent as-is.
+ */
+static unsigned int sx1280_link_compress(
+  struct sx1280_priv *priv,
+  const struct sk_buff *skb,
+  u8 *hdr,
+  unsigned int *consumed
+) {
+  unsigned int len = 0;
+
+  if (!priv->link.iphc_enabled || !skb->len) {
+    return 0;
+  }
+
+  switch (skb->data[0] >> 4) {
+  case 4: len = sx1280_iphc4_compress(skb, hdr, consumed); break;
+  case 6: len = sx1280_iphc6_compress(skb, hdr, consumed); break;
+  }
+
+  return len && len < *consumed ? len : 0;
+}
+
+/**
+ * Compresses the datagram being loaded for sending with LZ4, keeping the result
+ * only if it is smaller.
+ * @context process & locked
+ */
+static void sx1280_link_lz4_compress(struct sx1280_priv *priv) {
+  struct sx1280_link *link = &priv->link;
+  unsigned int len = link->payload_len;
+
+  if (len < SX1280_LZ4_MIN_LEN) {
+    return;
+  }
+
+  /* Leaving no room for a result that isn't smaller saves wasted effort. */
+  u64 start = ktime_get_ns();
+  int out_len = LZ4_compress_default(
+    (const char *) link->payload,
+    (char *) &link->lz4_out[SX1280_LZ4_HDR_LEN],
+    len,
+    len - SX1280_LZ4_HDR_LEN - 1,
+    link->lz4_wrkmem
+  );
+
+  link->lz4_compress_ns += ktime_get_ns() - start;
+  link->lz4_bytes_in += len;
+
+  if (out_len <= 0) {
+    link->lz4_bytes_out += len;
+    return;
+  }
+
+  link->lz4_out[0] = SX1280_DISPATCH_LZ4;
+  link->payload = link->lz4_out;
+  link->payload_len = SX1280_LZ4_HDR_LEN + out_len;
+  link->lz4_bytes_out += link->payload_len;
+}
+
+/**
+ * Packs as many packets from the tail of the TX ring into one frame as will fit.
+ *
+ * If the frame could hold more and nothing else is waiting, it is held back
+ * until either more packets arrive or the aggregation delay expires, so that
+ * the latency added is bounded.
+ *
+ * @context process & locked
+ * @returns The number of packets packed (with `data` and `len` set), 0 if the
+ *          packet at the tail should be sent by itself, or -EAGAIN if the
+ *          frame is being held back.
+ */
+static int sx1280_link_tx_aggregate(
+  struct sx1280_priv *priv,
+  unsigned int frame_max,
+  const u8 **data,
+  unsigned int *len
+) {
+  struct sx1280_link *link = &priv->link;
+  struct sk_buff *skb;
+  unsigned int sub_max = frame_max - SX1280_AGG_HDR_LEN - SX1280_AGG_SUB_HDR_LEN;
+  unsigned int offset = SX1280_AGG_HDR_LEN;
+  unsigned int saved = 0;
+  unsigned int n = 0;
+  u8 *frame = link->frame;
+  u8 hdr[SX1280_IPHC_HDR_MAX];
+
+  if (!link->agg_enabled) {
+    return 0;
+  }
+
+  /* Encode packets straight into the frame for as long as they fit. */
+  for (; (skb = sx1280_tx_peek(priv, n)); n++) {
+    unsigned int consumed = 0;
+    unsigned int hdr_len = sx1280_link_compress(priv, skb, hdr, &consumed);
+    unsigned int sub_len = hdr_len + skb->len - consumed;
+
+    if (
+      !sub_len
+      || sub_len > sub_max
+      || offset + SX1280_AGG_SUB_HDR_LEN + sub_len > frame_max
+    ) {
+      break;
+    }
+
+    u8 *sub = &frame[offset + SX1280_AGG_SUB_HDR_LEN];
+    frame[offset] = sub_len;
+    memcpy(sub, hdr, hdr_len);
+    memcpy(&sub[hdr_len], &skb->data[consumed], skb->len - consumed);
+
+    offset += SX1280_AGG_SUB_HDR_LEN + sub_len;
+    saved += consumed - hdr_len;
+  }
+
+  /*
+   * Hold the frame back if it has room to spare, unless the delay has already
+   * expired or the ring is full, in which case nothing more can arrive. Frames
+   * aren't held back during removal, as the timer could outlive the worker.
+   */
+  spin_lock_bh(&priv->tx_lock);
+  bool ring_full = sx1280_tx_ring_full(priv);
+  spin_unlock_bh(&priv->tx_lock);
+
+  if (
+    !skb
+    && !ring_full
+    && priv->initialized
+    && link->agg_delay_us
+    && !READ_ONCE(link->agg_flush)
+  ) {
+    if (!hrtimer_active(&link->agg_timer)) {
+      hrtimer_start(
+        &link->agg_timer,
+        us_to_ktime(link->agg_delay_us),
+        HRTIMER_MODE_REL
+      );
+    }
+
+    return -EAGAIN;
+  }
+
+  /* Whatever was held back is going out now. */
+  hrtimer_try_to_cancel(&link->agg_timer);
+  WRITE_ONCE(link->agg_flush, false);
+
+  if (n < 2) {
+    return 0;
+  }
+
+  frame[0] = SX1280_DISPATCH_AGG;
+  *data = frame;
+  *len = offset;
+  link->frame_saved = saved;
+
+  return n;
+}
+
+/**
+ * Flushes a held-back aggregate frame once the aggregation delay has expired.
+ * @context hardirq
+ */
+static enum hrtimer_restart sx1280_agg_timer(struct hrtimer *timer) {
+  struct sx1280_priv *priv = container_of(
+    timer,
+    struct sx1280_priv,
+    link.agg_timer
+  );
+
+  WRITE_ONCE(priv->link.agg_flush, true);
+  kthread_queue_work(priv->worker, &priv->tx_work);
+
+  return HRTIMER_NORESTART;
+}
+
+/**
+ * Builds the next radio frame from the TX ring: several small packets packed
+ * together, the whole of the next datagram, or its next fragment if it's larger
+ * than the mode can carry.
+ *
+ * Fragments carry a 4-byte header (dispatch, source node, datagram tag, and
+ * index / count), and are cut as large as the mode allows so that the number
+ * of frames on the air is kept to a minimum.
+ *
+ * @context process & locked
+ * @returns 0 with `data` and `len` set, -ENODATA if the ring is empty, -EAGAIN
+ *          if the frame is being held back for aggregation, or an error if the
+ *          datagram at the tail can't be sent.
+ */
+static int sx1280_link_tx_build(
+  struct sx1280_priv *priv,
+  const u8 **data,
+  unsigned int *len
+) {
+  struct sx1280_link *link = &priv->link;
+  unsigned int frame_max = sx1280_frame_max(priv);
+
+  if (!frame_max) {
+    return -EINVAL;
+  }
+
+  if (!link->payload_len) {
+    struct sk_buff *skb = sx1280_tx_peek(priv, 0);
+    if (!skb) {
+      return -ENODATA;
+    }
+
+    int n = sx1280_link_tx_aggregate(priv, frame_max, data, len);
+    if (n) {
+      /* Hold the frame back, or send the packets in one go. */
+      if (n > 0) {
+        link->frag_count = 0;
+        link->frame_skbs = n;
+      }
+
+      return n < 0 ? n : 0;
+    }
+
+    if (skb->len > SX1280_LINK_PAYLOAD_MAX) {
+      return -EMSGSIZE;
+    }
+
+    unsigned int consumed;
+    unsigned int hdr_len = sx1280_link_compress(
+      priv,
+      skb,
+      link->encoded,
+      &consumed
+    );
+
+    if (hdr_len) {
+      memcpy(
+        &link->encoded[hdr_len],
+        &skb->data[consumed],
+        skb->len - consumed
+      );
+
+      link->payload = link->encoded;
+      link->payload_len = hdr_len + skb->len - consumed;
+      link->frame_saved = consumed - hdr_len;
+    } else {
+      link->payload = skb->data;
+      link->payload_len = skb->len;
+      link->frame_saved = 0;
+    }
+
+    if (link->lz4_enabled) {
+      sx1280_link_lz4_compress(priv);
+    }
+
+    link->frag_offset = 0;
+
+    /*
+     * Start fragmenting if the datagram doesn't fit into a single frame. The
+     * datagram is split evenly, rather than leaving a runt at the end that
+     * might fall below the mode's minimum frame size.
+     */
+    if (link->payload_len > frame_max) {
+      link->frag_count = DIV_ROUND_UP(
+        link->payload_len,
+        frame_max - SX1280_FRAG_HDR_LEN
+      );
+      link->frag_size = DIV_ROUND_UP(link->payload_len, link->frag_count);
+      link->frag_idx = 0;
+      link->tag++;
+
+      if (link->frag_count > SX1280_FRAG_MAX) {
+        return -EMSGSIZE;
+      }
+    } else {
+      link->frag_count = 0;
+    }
+  }
+
+  if (!link->frag_count) {
+    *data = link->payload;
+    *len = link->payload_len;
+    link->frame_skbs = 1;
+    return 0;
+  }
+
+  /* The mode may have changed since the datagram was split. */
+  if (link->frag_size + SX1280_FRAG_HDR_LEN > frame_max) {
+    return -EMSGSIZE;
+  }
+
+  unsigned int chunk = min(
+    link->frag_size,
+    link->payload_len - link->frag_offset
+  );
+
+  u8 *frame = link->frame;
+  frame[0] = SX1280_DISPATCH_FRAG;
+  frame[1] = link->node_id;
+  frame[2] = link->tag;
+  frame[3] = (link->frag_idx << 4) | (link->frag_count - 1);
+  memcpy(&frame[SX1280_FRAG_HDR_LEN], &link->payload[link->frag_offset], chunk);
+
+  *data = frame;
+  *len = SX1280_FRAG_HDR_LEN + chunk;
+
+  /* Only the last fragment completes the packet. */
+  link->frame_skbs = link->frag_idx == link->frag_count - 1 ? 1 : 0;
+
+  return 0;
+}
+
+/**
+ * Accounts for the frame that was on the air, completing the packets it
+ * carried or moving on to the next fragment. A frame that failed takes its
+ * whole datagram down with it.
+ *
+ * @context process & locked
+ */
+static void sx1280_link_tx_done(struct sx1280_priv *priv, bool sent) {
+  struct sx1280_link *link = &priv->link;
+
+  sx1280_arq_reset(priv);
+  sx1280_mac_reset(priv);
+
+  /* A datagram that was cut short is dropped with its last fragment out. */
+  if (link->frag_dropped) {
+    sent = false;
+  } else if (sent && link->frag_count && !link->frame_skbs) {
+    link->frag_offset += link->frag_size;
+    link->frag_idx++;
+    return;
+  }
+
+  if (sent && link->frame_skbs > 1) {
+    link->agg_packets += link->frame_skbs;
+  }
+
+  if (sent && link->frame_skbs) {
+    link->iphc_saved += link->frame_saved;
+  }
+
+  unsigned int skbs = max(link->frame_skbs, 1U);
+  for (unsigned int i = 0; i < skbs; i++) {
+    sx1280_tx_complete(priv, sent);
+  }
+
+  sx1280_link_tx_reset(priv);
+}
+
+/**
+ * Queues a received IP packet for delivery by NAPI.
+ * @context process & locked
+ */
+static void sx1280_rx_deliver(struct sx1280_priv *priv, struct sk_buff *skb) {
+  struct net_device *netdev = priv->netdev;
+  u8 version = (skb->data[0] >> 4) & 0x0F;
+
+  skb->dev = netdev;
+  skb->protocol = version == 6 ? htons(ETH_P_IPV6) : htons(ETH_P_IP);
+  skb->ip_summed = CHECKSUM_NONE;
+
+  /* Packets can't be delivered while down, and shouldn't pile up forever. */
+  if (
+    !netif_running(netdev)
+    || skb_queue_len(&priv->rx_queue) >= SX1280_RX_QUEUE_LEN
+  ) {
+    SX1280_STATS_INC(priv, rx_dropped);
+    dev_kfree_skb(skb);
+    return;
+  }
+
+  /* Update netdev stats. */
+  SX1280_STATS_INC(priv, rx_packets);
+  SX1280_STATS_ADD(priv, rx_bytes, skb->len);
+
+  /*
+   * Hand the packet to NAPI, which delivers it from softirq context without
+   * the lock held. Bottom halves are disabled around the schedule so that
+   * the softirq runs as soon as they're re-enabled, rather than whenever the
+   * next interrupt happens to arrive.
+   */
+  skb_mark_napi_id(skb, &priv->napi);
+  skb_queue_tail(&priv->rx_queue, skb);
+
+  local_bh_disable();
+  napi_schedule(&priv->napi);
+  local_bh_enable();
+}
+
+/**
+ * Frees a reassembly slot and everything held in it.
+ * @context process & locked
+ */
+static void sx1280_reasm_free(
+  struct sx1280_priv *priv,
+  struct sx1280_reasm *reasm
+) {
+  for (int i = 0; i < SX1280_FRAG_MAX; i++) {
+    if (reasm->frags[i]) {
+      priv->link.reasm_mem -= reasm->frags[i]->truesize;
+      dev_kfree_skb(reasm->frags[i]);
+      reasm->frags[i] = NULL;
+    }
+  }
+
+  reasm->received = 0;
+  reasm->active = false;
+}
+
+/**
+ * Drops every datagram being reassembled.
+ * @context process & locked
+ */
+static void sx1280_reasm_flush(struct sx1280_priv *priv) {
+  for (int i = 0; i < SX1280_REASM_SLOTS; i++) {
+    sx1280_reasm_free(priv, &priv->link.reasm[i]);
+  }
+}
+
+/**
+ * Frees the slot that has been waiting the longest, to make room for another.
+ * @context process & locked
+ * @returns Whether there was a slot to free.
+ */
+static bool sx1280_reasm_evict(
+  struct sx1280_priv *priv,
+  struct sx1280_reasm *keep
+) {
+  struct sx1280_reasm *oldest = NULL;
+
+  for (int i = 0; i < SX1280_REASM_SLOTS; i++) {
+    struct sx1280_reasm *reasm = &priv->link.reasm[i];
+
+    if (
+      reasm->active
+      && reasm != keep
+      && (!oldest || time_before(reasm->expires, oldest->expires))
+    ) {
+      oldest = reasm;
+    }
+  }
+
+  if (!oldest) {
+    return false;
+  }
+
+  SX1280_STATS_INC(priv, rx_dropped);
+  sx1280_reasm_free(priv, oldest);
+  return true;
+}
+
+static void sx1280_link_rx(
+  struct sx1280_priv *priv,
+  struct sk_buff *skb,
+  unsigned int depth
+);
+static void sx1280_arq_rx_ack(struct sx1280_priv *priv, struct sk_buff *skb);
+static void sx1280_tdma_rx_beacon(struct sx1280_priv *priv, struct sk_buff *skb);
+static void sx1280_rc_rx_announce(struct sx1280_priv *priv, struct sk_buff *skb);
+
+/**
+ * Files away a received fragment, and passes the datagram on once all of its
+ * fragments have arrived.
+ *
+ * Datagrams are told apart by source node and tag. Partial datagrams are
+ * dropped once they time out, or when the slots or memory run out, starting
+ * with the one that has been waiting the longest.
+ *
+ * @context process & locked
+ */
+static void sx1280_link_rx_frag(
+  struct sx1280_priv *priv,
+  struct sk_buff *skb,
+  unsigned int depth
+) {
+  struct sx1280_link *link = &priv->link;
+
+  if (skb->len <= SX1280_FRAG_HDR_LEN) {
+    goto drop;
+  }
+
+  u8 src = skb->data[1];
+  u8 tag = skb->data[2];
+  u8 idx = skb->data[3] >> 4;
+  u8 count = (skb->data[3] & 0x0F) + 1;
+
+  if (idx >= count) {
+    goto drop;
+  }
+
+  /* Drop whatever has timed out, and look for the datagram's slot. */
+  struct sx1280_reasm *reasm = NULL;
+  struct sx1280_reasm *free = NULL;
+
+  for (int i = 0; i < SX1280_REASM_SLOTS; i++) {
+    struct sx1280_reasm *slot = &link->reasm[i];
+
+    if (slot->active && time_after(jiffies, slot->expires)) {
+      netdev_dbg(priv->netdev, "reassembly timed out: src=%u, tag=%u\n",
+        slot->src, slot->tag);
+      SX1280_STATS_INC(priv, rx_dropped);
+      sx1280_reasm_free(priv, slot);
+    }
+
+    if (!slot->active) {
+      free = free ? free : slot;
+    } else if (slot->src == src && slot->tag == tag) {
+      reasm = slot;
+    }
+  }
+
+  /* A different count means the tag has wrapped onto a new datagram. */
+  if (reasm && reasm->count != count) {
+    SX1280_STATS_INC(priv, rx_dropped);
+    sx1280_reasm_free(priv, reasm);
+    free = reasm;
+    reasm = NULL;
+  }
+
+  if (!reasm) {
+    if (!free) {
+      sx1280_reasm_evict(priv, NULL);
+      for (int i = 0; i < SX1280_REASM_SLOTS && !free; i++) {
+        free = link->reasm[i].active ? NULL : &link->reasm[i];
+      }
+    }
+
+    reasm = free;
+    reasm->active = true;
+    reasm->src = src;
+    reasm->tag = tag;
+    reasm->count = count;
+    reasm->expires = jiffies + msecs_to_jiffies(link->reasm_timeout_ms);
+  }
+
+  if (reasm->received & BIT(idx)) {
+    goto drop;
+  }
+
+  /* Keep within the memory budget, at the expense of older datagrams. */
+  while (link->reasm_mem + skb->truesize > SX1280_REASM_MEM_MAX) {
+    if (!sx1280_reasm_evict(priv, reasm)) {
+      sx1280_reasm_free(priv, reasm);
+      goto drop;
+    }
+  }
+
+  skb_pull(skb, SX1280_FRAG_HDR_LEN);
+  reasm->frags[idx] = skb;
+  reasm->received |= BIT(idx);
+  link->reasm_mem += skb->truesize;
+
+  if (reasm->received != GENMASK(count - 1, 0)) {
+    return;
+  }
+
+  /* Stitch the fragments back together. */
+  unsigned int total = 0;
+  for (int i = 0; i < count; i++) {
+    total += reasm->frags[i]->len;
+  }
+
+  struct sk_buff *whole = total <= SX1280_LINK_PAYLOAD_MAX
+    ? dev_alloc_skb(total)
+    : NULL;
+
+  if (whole) {
+    for (int i = 0; i < count; i++) {
+      skb_put_data(whole, reasm->frags[i]->data, reasm->frags[i]->len);
+    }
+  } else {
+    SX1280_STATS_INC(priv, rx_dropped);
+  }
+
+  sx1280_reasm_free(priv, reasm);
+
+  if (whole) {
+    sx1280_link_rx(priv, whole, depth + 1);
+  }
+
+  return;
+
+drop:
+  SX1280_STATS_INC(priv, rx_errors);
+  dev_kfree_skb(skb);
+}
+
+/**
+ * Expands a frame compressed by sx1280_iphc6_compress back into an IPv6
+ * packet.
+ * @context process & locked
+ */
+static void sx1280_link_rx_iphc6(struct sx1280_priv *priv, struct sk_buff *skb) {
+  const u8 *p = &skb->data[SX1280_IPHC_HDR_LEN];
+  const u8 *end = skb->data + skb->len;
+  struct ipv6hdr ip6h = { .version = 6 };
+  struct udphdr udph = { 0 };
+  int n;
+
+  if (skb->len < SX1280_IPHC_HDR_LEN) {
+    goto drop;
+  }
+
+  u8 flags = skb->data[1];
+  bool udp = flags & SX1280_IPHC6_NH_UDP;
+  u8 hlim = (flags & SX1280_IPHC6_HLIM) >> SX1280_IPHC6_HLIM_SHIFT;
+
+  if (flags & SX1280_IPHC6_TF) {
+    if (end - p < 4) {
+      goto drop;
+    }
+
+    ip6h.priority = p[0] & 0x0F;
+    memcpy(ip6h.flow_lbl, &p[1], 3);
+    p += 4;
+  }
+
+  if (!udp) {
+    if (end - p < 1) {
+      goto drop;
+    }
+
+    ip6h.nexthdr = *p++;
+  } else {
+    ip6h.nexthdr = IPPROTO_UDP;
+  }
+
+  if (!hlim) {
+    if (end - p < 1) {
+      goto drop;
+    }
+
+    ip6h.hop_limit = *p++;
+  } else {
+    ip6h.hop_limit = sx1280_iphc_hlim[hlim];
+  }
+
+  n = sx1280_iphc6_expand_addr(
+    (flags & SX1280_IPHC6_SAM) >> SX1280_IPHC6_SAM_SHIFT,
+    false,
+    p,
+    end - p,
+    &ip6h.saddr
+  );
+
+  if (n < 0) {
+    goto drop;
+  }
+
+  p += n;
+  n = sx1280_iphc6_expand_addr(
+    (flags & SX1280_IPHC6_DAM) >> SX1280_IPHC6_DAM_SHIFT,
+    true,
+    p,
+    end - p,
+    &ip6h.daddr
+  );
+
+  if (n < 0) {
+    goto drop;
+  }
+
+  p += n;
+
+  if (udp) {
+    if (end - p < 6) {
+      goto drop;
+    }
+
+    memcpy(&udph.source, p, 4);
+    memcpy(&udph.check, p + 4, 2);
+    p += 6;
+  }
+
+  unsigned int data_len = end - p;
+  unsigned int payload_len = data_len + (udp ? sizeof(udph) : 0);
+
+  if (sizeof(ip6h) + payload_len > SX1280_LINK_PAYLOAD_MAX) {
+    goto drop;
+  }
+
+  struct sk_buff *ip = dev_alloc_skb(sizeof(ip6h) + payload_len);
+  if (!ip) {
+    SX1280_STATS_INC(priv, rx_dropped);
+    dev_kfree_skb(skb);
+    return;
+  }
+
+  ip6h.payload_len = htons(payload_len);
+  skb_put_data(ip, &ip6h, sizeof(ip6h));
+
+  if (udp) {
+    udph.len = htons(payload_len);
+    skb_put_data(ip, &udph, sizeof(udph));
+  }
+
+  skb_put_data(ip, p, data_len);
+  dev_kfree_skb(skb);
+  sx1280_rx_deliver(priv, ip);
+  return;
+
+drop:
+  netdev_dbg(priv->netdev, "rx: malformed compressed IPv6 header\n");
+  SX1280_STATS_INC(priv, rx_errors);
+  dev_kfree_skb(skb);
+}
+
+/**
+ * Expands a frame compressed by sx1280_iphc4_compress back into an IPv4
+ * packet.
+ * @context process & locked
+ */
+static void sx1280_link_rx_iphc4(struct sx1280_priv *priv, struct sk_buff *skb) {
+  const u8 *p = &skb->data[SX1280_IPHC_HDR_LEN];
+  const u8 *end = skb->data + skb->len;
+  struct iphdr iph = { .version = 4, .ihl = 5 };
+  struct udphdr udph = { 0 };
+
+  if (skb->len < SX1280_IPHC_HDR_LEN) {
+    goto drop;
+  }
+
+  u8 flags = skb->data[1];
+  bool udp = flags & SX1280_IPHC4_UDP;
+  u8 frag = (flags & SX1280_IPHC4_FRAG) >> SX1280_IPHC4_FRAG_SHIFT;
+  u8 ttl = (flags & SX1280_IPHC4_TTL) >> SX1280_IPHC4_TTL_SHIFT;
+
+  /* Work out how much is inline up front, rather than checking each field. */
+  unsigned int inline_len = 8
+    + (flags & SX1280_IPHC4_TOS ? 1 : 0)
+    + (flags & SX1280_IPHC4_ID ? 2 : 0)
+    + (frag == SX1280_IPHC4_FRAG_INLINE ? 2 : 0)
+    + (ttl ? 0 : 1)
+    + (udp ? 6 : 1);
+
+  if (frag > SX1280_IPHC4_FRAG_INLINE || end - p < inline_len) {
+    goto drop;
+  }
+
+  if (flags & SX1280_IPHC4_TOS) {
+    iph.tos = *p++;
+  }
+
+  if (flags & SX1280_IPHC4_ID) {
+    memcpy(&iph.id, p, 2);
+    p += 2;
+  }
+
+  switch (frag) {
+  case SX1280_IPHC4_FRAG_DF: iph.frag_off = htons(IP_DF); break;
+  case SX1280_IPHC4_FRAG_NONE: iph.frag_off = 0; break;
+  default:
+    memcpy(&iph.frag_off, p, 2);
+    p += 2;
+    break;
+  }
+
+  iph.ttl = ttl ? sx1280_iphc_hlim[ttl] : *p++;
+  iph.protocol = udp ? IPPROTO_UDP : *p++;
+
+  memcpy(&iph.saddr, p, 4);
+  memcpy(&iph.daddr, p + 4, 4);
+  p += 8;
+
+  if (udp) {
+    memcpy(&udph.source, p, 4);
+    memcpy(&udph.check, p + 4, 2);
+    p += 6;
+  }
+
+  unsigned int data_len = end - p;
+  unsigned int tot_len = sizeof(iph) + (udp ? sizeof(udph) : 0) + data_len;
+
+  if (tot_len > SX1280_LINK_PAYLOAD_MAX) {
+    goto drop;
+  }
+
+  struct sk_buff *ip = dev_alloc_skb(tot_len);
+  if (!ip) {
+    SX1280_STATS_INC(priv, rx_dropped);
+    dev_kfree_skb(skb);
+    return;
+  }
+
+  iph.tot_len = htons(tot_len);
+  iph.check = ip_fast_csum(&iph, iph.ihl);
+  skb_put_data(ip, &iph, sizeof(iph));
+
+  if (udp) {
+    udph.len = htons(tot_len - sizeof(iph));
+    skb_put_data(ip, &udph, sizeof(udph));
+  }
+
+  skb_put_data(ip, p, data_len);
+  dev_kfree_skb(skb);
+  sx1280_rx_deliver(priv, ip);
+  return;
+
+drop:
+  netdev_dbg(priv->netdev, "rx: malformed compressed IPv4 header\n");
+  SX1280_STATS_INC(priv, rx_errors);
+  dev_kfree_skb(skb);
+}
+
+/**
+ * Decompresses a received LZ4 frame, and passes on the frame within.
+ * @context process & locked
+ */
+static void sx1280_link_rx_lz4(
+  struct sx1280_priv *priv,
+  struct sk_buff *skb,
+  unsigned int depth
+) {
+  struct sx1280_link *link = &priv->link;
+  struct sk_buff *out = dev_alloc_skb(SX1280_LINK_PAYLOAD_MAX);
+
+  if (!out) {
+    SX1280_STATS_INC(priv, rx_dropped);
+    dev_kfree_skb(skb);
+    return;
+  }
+
+  u64 start = ktime_get_ns();
+  int len = LZ4_decompress_safe(
+    (const char *) &skb->data[SX1280_LZ4_HDR_LEN],
+    (char *) out->data,
+    skb->len - SX1280_LZ4_HDR_LEN,
+    SX1280_LINK_PAYLOAD_MAX
+  );
+
+  link->lz4_decompress_ns += ktime_get_ns() - start;
+  dev_kfree_skb(skb);
+
+  if (len <= 0) {
+    netdev_dbg(priv->netdev, "rx: corrupt LZ4 frame\n");
+    SX1280_STATS_INC(priv, rx_errors);
+    dev_kfree_skb(out);
+    return;
+  }
+
+  skb_put(out, len);
+  sx1280_link_rx(priv, out, depth + 1);
+}
+
+/**
+ * Splits a received aggregate frame back into its packets.
+ * @context process & locked
+ */
+static void sx1280_link_rx_agg(
+  struct sx1280_priv *priv,
+  struct sk_buff *skb,
+  unsigned int depth
+) {
+  unsigned int offset = SX1280_AGG_HDR_LEN;
+
+  while (offset < skb->len) {
+    unsigned int sub_len = skb->data[offset];
+    offset += SX1280_AGG_SUB_HDR_LEN;
+
+    if (!sub_len || offset + sub_len > skb->len) {
+      netdev_dbg(priv->netdev, "rx: truncated aggregate frame\n");
+      SX1280_STATS_INC(priv, rx_length_errors);
+      break;
+    }
+
+    struct sk_buff *sub = dev_alloc_skb(sub_len);
+    if (!sub) {
+      SX1280_STATS_INC(priv, rx_dropped);
+    } else {
+      skb_put_data(sub, &skb->data[offset], sub_len);
+      sx1280_link_rx(priv, sub, depth + 1);
+    }
+
+    offset += sub_len;
+  }
+
+  dev_kfree_skb(skb);
+}
+
+/**
+ * Unwraps a received ARQ frame, dropping it if it's addressed to another node,
+ * or if it's a retransmission of one that was already received (and whose ACK
+ * must have been lost).
+ * @context process & locked
+ */
+static void sx1280_link_rx_arq(
+  struct sx1280_priv *priv,
+  struct sk_buff *skb,
+  unsigned int depth
+) {
+  struct sx1280_arq *arq = &priv->arq;
+  struct sx1280_arq_peer *peer = NULL;
+
+  if (skb->len <= SX1280_ARQ_HDR_LEN) {
+    SX1280_STATS_INC(priv, rx_length_errors);
+    dev_kfree_skb(skb);
+    return;
+  }
+
+  u8 dst = skb->data[1];
+  u8 node_id = skb->data[2];
+  u8 seq = skb->data[3];
+
+  if (dst != priv->link.node_id) {
+    /* Broadcast frames aren't acknowledged, so they're never sent twice. */
+    if (dst == SX1280_NODE_BROADCAST) {
+      skb_pull(skb, SX1280_ARQ_HDR_LEN);
+      sx1280_link_rx(priv, skb, depth + 1);
+      return;
+    }
+
+    netdev_dbg(priv->netdev, "rx: arq frame for node %u\n", dst);
+    dev_kfree_skb(skb);
+    return;
+  }
+
+  for (int i = 0; i < SX1280_ARQ_PEERS && !peer; i++) {
+    if (arq->peers[i].valid && arq->peers[i].node_id == node_id) {
+      peer = &arq->peers[i];
+    }
+  }
+
+  if (!peer) {
+    peer = &arq->peers[arq->peer_next++ % SX1280_ARQ_PEERS];
+    peer->node_id = node_id;
+    peer->valid = true;
+  } else if (peer->seq == seq) {
+    arq->duplicates++;
+    dev_kfree_skb(skb);
+    return;
+  }
+
+  peer->seq = seq;
+  skb_pull(skb, SX1280_ARQ_HDR_LEN);
+  sx1280_link_rx(priv, skb, depth + 1);
+}
+
+/**
+ * Takes a received frame (or a payload unwrapped from one) apart according to
+ * its dispatch byte. Raw IP packets are recognized by their version nibble.
+ *
+ * @context process & locked
+ */
+static void sx1280_link_rx(
+  struct sx1280_priv *priv,
+  struct sk_buff *skb,
+  unsigned int depth
+) {
+  if (!skb->len || depth > SX1280_LINK_MAX_DEPTH) {
+    goto drop;
+  }
+
+  u8 dispatch = skb->data[0];
+
+  switch (dispatch >> 4) {
+  case 4:
+  case 6:
+    sx1280_rx_deliver(priv, skb);
+    return;
+  }
+
+  switch (dispatch) {
+  case SX1280_DISPATCH_FRAG:
+    sx1280_link_rx_frag(priv, skb, depth);
+    return;
+  case SX1280_DISPATCH_AGG:
+    sx1280_link_rx_agg(priv, skb, depth);
+    return;
+  case SX1280_DISPATCH_IPHC6:
+    sx1280_link_rx_iphc6(priv, skb);
+    return;
+  case SX1280_DISPATCH_IPHC4:
+    sx1280_link_rx_iphc4(priv, skb);
+    return;
+  case SX1280_DISPATCH_LZ4:
+    sx1280_link_rx_lz4(priv, skb, depth);
+    return;
+  case SX1280_DISPATCH_ARQ:
+    sx1280_link_rx_arq(priv, skb, depth);
+    return;
+  case SX1280_DISPATCH_ACK:
+    /* ACKs are only ever sent by themselves. */
+    if (!depth) {
+      sx1280_arq_rx_ack(priv, skb);
+      return;
+    }
+
+    break;
+  case SX1280_DISPATCH_BEACON:
+    if (!depth) {
+      sx1280_tdma_rx_beacon(priv, skb);
+      return;
+    }
+
+    break;
+  case SX1280_DISPATCH_RATE:
+    if (!depth) {
+      sx1280_rc_rx_announce(priv, skb);
+      return;
+    }
+
+    break;
+  }
+
+drop:
+  netdev_dbg(priv->netdev, "rx: unknown frame (%u bytes)\n", skb->len);
+  SX1280_STATS_INC(priv, rx_errors);
+  dev_kfree_skb(skb);
+}
+
+/**
+ * Drops every packet in the TX ring. If `keep_active` is set, the packets on the
+ * air (if any) are left for the TX done interrupt to complete.
+ * @context process & locked
+ */
+static void sx1280_tx_purge(struct sx1280_priv *priv, bool keep_active) {
+  unsigned int pkts = 0;
+  unsigned int bytes = 0;
+
+  spin_lock_bh(&priv->tx_lock);
+
+  unsigned int keep = priv->tx_tail;
+  if (
+    keep_active
+    && priv->state == SX1280_STATE_TX
+    && priv->tx_head != priv->tx_tail
+  ) {
+    /* The frame on the air may carry several packets. */
+    keep += min(max(priv->link.frame_skbs, 1U), priv->tx_head - priv->tx_tail);
+  }
+
+  while (priv->tx_head != keep) {
+    priv->tx_head--;
+
+    unsigned int slot = priv->tx_head % SX1280_TX_RING_SIZE;
+    pkts++;
+    bytes += priv->tx_ring[slot]->len;
+    priv->aql.queued_ns -= priv->aql.slot_ns[slot];
+
+    dev_kfree_skb(priv->tx_ring[slot]);
+    priv->tx_ring[slot] = NULL;
+    SX1280_STATS_INC(priv, tx_dropped);
+  }
+
+  netdev_completed_queue(priv->netdev, pkts, bytes);
+  spin_unlock_bh(&priv->tx_lock);
+
+  /* A datagram part way through being sent is gone along with its packet. */
+  if (keep == priv->tx_tail) {
+    sx1280_link_tx_reset(priv);
+    return;
+  }
+
+  /*
+   * The frame on the air is the last try: no ACK is waited for after it, nor
+   * is the channel sensed for it again.
+   */
+  sx1280_arq_reset(priv);
+  sx1280_mac_reset(priv);
+
+  /* Nor are the fragments after it sent. */
+  if (priv->link.frag_count && !priv->link.frame_skbs) {
+    priv->link.frag_dropped = true;
+  }
+}
+
+static int sx1280_acs_open(struct sx1280_priv *priv);
+static void sx1280_tdma_restart(struct sx1280_priv *priv);
+
+static int sx1280_open(struct net_device *netdev) {
+  int err;
+
+  netdev_dbg(
+    netdev,
+    "ndo_open called by process: %s (pid %d)\n",
+    current->comm,
+    current->pid
+  );
+
+  if (current->parent) {
+    netdev_dbg(
+      netdev,
+      "  parent process: %s (pid %d)\n",
+      current->parent->comm,
+      current->parent->pid
+    );
+  }
+
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  /* Settle on a channel before the carrier comes up. */
+  if ((err = sx1280_acs_open(priv))) {
+    return err;
+  }
+
+  napi_enable(&priv->napi);
+  netif_carrier_on(netdev);
+  netif_start_queue(netdev);
+
+  /* Pick dwell-time hopping back up, as its timer is stopped while down. */
+  kthread_queue_work(priv->worker, &priv->fhss.work);
+
+  /* TDMA starts over from the next beacon, as it stops while down. */
+  mutex_lock(&priv->lock);
+  if (priv->tdma.enabled) {
+    sx1280_tdma_restart(priv);
+  }
+  mutex_unlock(&priv->lock);
+
+  if (READ_ONCE(priv->adr.enabled)) {
+    sx1280_adr_arm(priv, SX1280_ADR_FALLBACK_MS);
+  }
+
+  if (READ_ONCE(priv->rc.enabled)) {
+    sx1280_rc_arm(priv, SX1280_ADR_FALLBACK_MS);
+  }
+
+  return 0;
+}
+
+static int sx1280_stop(struct net_device *netdev) {
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  netdev_dbg(
+    netdev,
+    "ndo_stop called by process: %s (pid %d)\n",
+    current->comm,
+    current->pid
+  );
+
+  if (current->parent) {
+    netdev_dbg(
+      netdev,
+      "  parent process: %s (pid %d)\n",
+      current->parent->comm,
+      current->parent->pid
+    );
+  }
+
+  netif_stop_queue(netdev);
+  netif_carrier_off(netdev);
+  napi_disable(&priv->napi);
+  hrtimer_cancel(&priv->link.agg_timer);
+  hrtimer_cancel(&priv->duty.timer);
+  hrtimer_cancel(&priv->fhss.timer);
+  hrtimer_cancel(&priv->acs.timer);
+  cancel_work_sync(&priv->acs.work);
+  hrtimer_cancel(&priv->adr.timer);
+  hrtimer_cancel(&priv->rc.timer);
+
+  /*
+   * Don't leave stale packets in the ring to be sent on the next open, or
+   * received packets to be delivered then.
+   */
+  mutex_lock(&priv->lock);
+  sx1280_duty_unthrottle(priv);
+  sx1280_tx_purge(priv, true);
+  sx1280_reasm_flush(priv);
+  skb_queue_purge(&priv->rx_queue);
+
+  /*
+   * ARQ, CSMA and TDMA only arm their timers with the lock held and the
+   * interface running, so once here they can't be armed again.
+   */
+  hrtimer_cancel(&priv->arq.timer);
+  hrtimer_cancel(&priv->mac.timer);
+  hrtimer_cancel(&priv->tdma.timer);
+  mutex_unlock(&priv->lock);
+
+  return 0;
+}
+
+/**
+ * Called to transmit a single packet buffer.
+ * @context atomic | process
+ */
+static netdev_tx_t sx1280_xmit(struct sk_buff *skb, struct net_device *netdev) {
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  u16 protocol = ntohs(skb->protocol);
+
+  /* Log information about the packet for debugging. */
+  netdev_dbg(netdev, "xmit: proto=0x%04x, len=%d\n", protocol, skb->len);
+
+  switch (protocol) {
+  case ETH_P_IP:;
+    struct iphdr *iph = (struct iphdr *) skb->data;
+    netdev_dbg(
+      netdev,
+      "  ipv4: src=%pI4, dst=%pI4\n",
+      &iph->saddr,
+      &iph->daddr
+    );
+
+    break;
+  case ETH_P_IPV6:;
+    struct ipv6hdr *ip6h = (struct ipv6hdr *) skb->data;
+    netdev_dbg(
+      netdev,
+      "  ipv6: src=%pI6c, dst=%pI6c\n",
+      &ip6h->saddr,
+      &ip6h->daddr
+    );
+
+    break;
+  }
+
+  /*
+   * Queue the packet on the TX ring, applying backpressure to the kernel
+   * networking stack once the ring is full, either of packets or of airtime
+   * under the airtime queue limit. Packets that arrive in the
+   * intervening time will be queued by the networking stack.
+   *
+   * Once a packet has been sent and there is room in the ring again,
+   * `netif_wake_queue` is called to tell the kernel that it is permitted to
+   * call `sx1280_xmit` once again.
+   */
+  spin_lock(&priv->tx_lock);
+
+  /*
+   * Check if the ring is already full.
+   *
+   * Generally, the kernel will not call `ndo_start_xmit` if the packet queue is
+   * stopped. However, if there are packets in flight before the queue was
+   * stopped, they will still arrive here. In that case, apply backpressure to
+   * the networking stack.
+   */
+  if (priv->tx_head - priv->tx_tail >= priv->tx_ring_depth) {
+    netif_stop_queue(netdev);
+    spin_unlock(&priv->tx_lock);
+
+    netdev_err(netdev, "packet transmission requested after queue frozen\n");
+    return NETDEV_TX_BUSY;
+  }
+
+  unsigned int slot = priv->tx_head % SX1280_TX_RING_SIZE;
+  priv->tx_ring[slot] = skb;
+  priv->tx_head++;
+
+  /* Account for the bytes now queued, letting BQL throttle the qdisc. */
+  netdev_sent_queue(netdev, skb->len);
+
+  /* And for the airtime, so that the queue is stopped by how long it takes. */
+  struct sx1280_aql *aql = &priv->aql;
+  aql->slot_ns[slot] = sx1280_aql_estimate_ns(aql, skb->len);
+  aql->queued_ns += aql->slot_ns[slot];
+
+  if (sx1280_tx_ring_full(priv)) {
+    if (priv->tx_head - priv->tx_tail < priv->tx_ring_depth) {
+      aql->stops++;
+    }
+
+    netif_stop_queue(netdev);
+  }
+
+  spin_unlock(&priv->tx_lock);
+
+  /*
+   * Kick the work so that transmission can be started in a non-atomic context.
+   * If the chip is already transmitting, the work does nothing and the packet
+   * is picked up by the TX done interrupt instead.
+   */
+  kthread_queue_work(priv->worker, &priv->tx_work);
+  return NETDEV_TX_OK;
+}
+
+/**
+ * Uploads a frame onto the chip and starts transmitting it. The frame is made
+ * up of an optional header of up to SX1280_ARQ_HDR_LEN bytes, then the data.
+ * @context process & locked
+ */
+static int sx1280_tx_start(
+  struct sx1280_priv *priv,
+  const u8 *hdr,
+  unsigned int hdr_len,
+  const u8 *data,
+  unsigned int data_len
+) {
+  int err;
+  struct net_device *netdev = priv->netdev;
+  unsigned int len = hdr_len + data_len;
+
+  struct sx1280_packet_params params = { .mode = priv->cfg.mode };
+  switch (params.mode) {
+  case SX1280_MODE_FLRC:
+    /* TODO: Pad FLRC packets less than 6 bytes. */
+    if (
+      len < SX1280_FLRC_PAYLOAD_LENGTH_MIN
+      || len > SX1280_FLRC_PAYLOAD_LENGTH_MAX
+    ) {
+      netdev_warn(netdev, "invalid FLRC frame size: %u bytes\n", len);
+      return -EMSGSIZE;
+    }
+
+    priv->cfg.flrc.packet.payload_length = len;
+    params.flrc = priv->cfg.flrc.packet;
+    break;
+  case SX1280_MODE_GFSK:
+    if (len > SX1280_GFSK_PAYLOAD_LENGTH_MAX) {
+      netdev_warn(netdev, "invalid GFSK frame size: %u bytes\n", len);
+      return -EMSGSIZE;
+    }
+
+    priv->cfg.gfsk.packet.payload_length = len;
+    params.gfsk = priv->cfg.gfsk.packet;
+    break;
+  case SX1280_MODE_LORA:
+    if (
+      len < SX1280_LORA_PAYLOAD_LENGTH_MIN
+      || len > SX1280_LORA_PAYLOAD_LENGTH_MAX
+    ) {
+      netdev_warn(netdev, "invalid LoRa frame size: %u bytes\n", len);
+      return -EMSGSIZE;
+    }
+
+    priv->cfg.lora.packet.payload_length = len;
+    params.lora = priv->cfg.lora.packet;
+    break;
+  default:
+    /* Packets can't be sent in ranging mode. */
+    netdev_warn(netdev, "packet transmission requested in ranging mode\n");
+    return -EINVAL;
+  }
+
+  /* Between packets is when the rate can be changed. */
+  if ((err = sx1280_rate_apply(priv))) {
+    return err;
+  }
+
+  netdev_dbg(netdev, "tx: %*ph %*ph\n", hdr_len, hdr, data_len, data);
+
+  struct sx1280_cmds *cmds = priv->cmds;
+  u8 packet_params[8];
+
+  if ((err = sx1280_encode_packet_params(&params, packet_params))) {
+    return err;
+  }
+
+  if (hdr_len) {
+    memcpy(&cmds->write_buffer.tx[2], hdr, hdr_len);
+  }
+
+  cmds->write_buffer.xfers[0].len = 2 + hdr_len;
+  cmds->write_buffer.xfers[1].tx_buf = data;
+  cmds->write_buffer.xfers[1].len = data_len;
+
+  /*
+   * Time out just after the packet should have finished, falling back on the
+   * configured timeout if its time on air isn't known.
+   */
+  enum sx1280_period_base period_base = priv->cfg.period_base;
+  u16 period_base_count = priv->cfg.period_base_count;
+  u64 airtime_ns = sx1280_time_on_air_ns(priv, len);
+
+  if (airtime_ns) {
+    sx1280_tx_timeout(airtime_ns, &period_base, &period_base_count);
+  }
+
+  cmds->set_tx.tx[1] = period_base;
+  cmds->set_tx.tx[2] = period_base_count >> 8;
+  cmds->set_tx.tx[3] = period_base_count & 0xFF;
+
+  /*
+   * Retune (if hopping), write packet parameters (if they changed) and packet
+   * data, then transmit, in one go.
+   */
+  bool update_params = !sx1280_shadow_cmd_match(
+    priv,
+    SX1280_SHADOW_PACKET_PARAMS,
+    packet_params,
+    sizeof(packet_params)
+  );
+
+  sx1280_async_reset(priv);
+  bool retuned = sx1280_fhss_retune(priv);
+
+  if (update_params) {
+    memcpy(cmds->set_packet_params.tx, packet_params, sizeof(packet_params));
+    sx1280_async_add(priv, &cmds->set_packet_params);
+  }
+
+  sx1280_async_add(priv, &cmds->write_buffer);
+  sx1280_async_add(priv, &cmds->set_tx);
+
+  err = sx1280_async_run(priv);
+  sx1280_fhss_retuned(priv, retuned, err);
+
+  if (update_params) {
+    sx1280_shadow_cmd_update(
+      priv,
+      SX1280_SHADOW_PACKET_PARAMS,
+      packet_params,
+      sizeof(packet_params),
+      !err
+    );
+  }
+
+  if (err) {
+    netdev_err(netdev, "failed to start tx: %d\n", err);
+    return err;
+  }
+
+  priv->tx_airtime_ns = airtime_ns;
+  return 0;
+}
+
+#ifdef DEBUG
+static void sx1280_check_status(struct work_struct *work) {
+  struct sx1280_priv *priv = container_of(
+    work,
+    struct sx1280_priv,
+    status_check.work
+  );
+
+  struct spi_device *spi = priv->spi;
+
+  u8 status;
+  enum sx1280_mode packet_type;
+  u8 rx_len;
+  u8 rx_start;
+  union sx1280_packet_status packet_status;
+  u8 rssi_inst;
+  u16 irq_status;
+
+  ktime_t start = ktime_get();
+
+  mutex_lock(&priv->lock);
+
+  /* Get all statuses throughout the chip. */
+  sx1280_get_status(priv, &status);
+  sx1280_get_packet_type(priv, &packet_type);
+  sx1280_get_rx_buffer_status(priv, &rx_len, &rx_start);
+  sx1280_get_packet_status(priv, &packet_status);
+  sx1280_get_rssi_inst(priv, &rssi_inst);
+  sx1280_get_irq_status(priv, &irq_status);
+
+  u8 payload_len;
+  u8 preamble_settings;
+  sx1280_read_register(priv, SX1280_REG_PAYLOAD_LENGTH, &payload_len, 1);
+  sx1280_read_register(priv, SX1280_REG_PACKET_PREAMBLE_SETTINGS, &preamble_settings, 1);
+
+  dev_dbg(&spi->dev, "status check:\n");
+  dev_dbg(&spi->dev, "  status=0x%02x\n", status);
+  dev_dbg(&spi->dev, "  mode=%u\n", packet_type);
+  dev_dbg(&spi->dev, "  rx_start=0x%02x, rx_len=%u\n", rx_start, rx_len);
+  dev_dbg(&spi->dev, "  pkt_status=%*ph\n", 5, packet_status.raw);
+  dev_dbg(&spi->dev, "  rssi_inst=%u\n", rssi_inst);
+  dev_dbg(&spi->dev, "  irq=0x%04x\n", irq_status);
+  dev_dbg(&spi->dev, "  payload_len=%u\n", payload_len);
+  dev_dbg(&spi->dev, "  preamble_settings=0x%02x\n", preamble_settings);
+
+  ktime_t end = ktime_get();
+  s64 time = ktime_to_us(ktime_sub(end, start));
+  dev_dbg(&spi->dev, "  time=%lld us\n", time);
+
+  mutex_unlock(&priv->lock);
+  schedule_delayed_work(&priv->status_check, 5 * HZ);
+}
+
+#endif
+
+/**
+ * Sets the chip into continuous RX mode to listen for packets.
+ * @context process & locked
+ */
+static int sx1280_listen(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_arq *arq = &priv->arq;
+
+  if ((err = sx1280_rate_apply(priv))) {
+    dev_err(&priv->spi->dev, "failed to change data rate: %d\n", err);
+    return err;
+  }
+
+  /*
+   * Have the chip acknowledge ARQ frames by itself, unless this node is waiting
+   * for an ACK of its own, which mustn't be acknowledged in turn.
+   */
+  bool auto_ack = arq->enabled
+    && arq->phase == SX1280_ARQ_IDLE
+    && sx1280_arq_hw_ack(priv);
+
+  struct sx1280_packet_params packet_params = { .mode = priv->cfg.mode };
+  switch (packet_params.mode) {
+  case SX1280_MODE_FLRC:
+    priv->cfg.flrc.packet.payload_length = SX1280_FLRC_PAYLOAD_LENGTH_MAX;
+    packet_params.flrc = priv->cfg.flrc.packet;
+    break;
+  case SX1280_MODE_GFSK:
+    priv->cfg.gfsk.packet.payload_length = SX1280_GFSK_PAYLOAD_LENGTH_MAX;
+    packet_params.gfsk = priv->cfg.gfsk.packet;
+    break;
+  case SX1280_MODE_LORA:
+    priv->cfg.lora.packet.payload_length = SX1280_LORA_PAYLOAD_LENGTH_MAX;
+
+    /*
+     * With an explicit header, the length is read from each packet's header
+     * and the programmed one is ignored. Keeping whatever length the last TX
+     * left means the parameters don't need to be written again.
+     */
+    if (
+      priv->cfg.lora.packet.header_type == SX1280_EXPLICIT_HEADER
+      && test_bit(SX1280_SHADOW_PACKET_PARAMS, &priv->shadow.cmds_valid)
+    ) {
+      priv->cfg.lora.packet.payload_length =
+        priv->shadow.cmds[SX1280_SHADOW_PACKET_PARAMS][3];
+    }
+
+    /* AutoTx sends the programmed length, which has to be that of an ACK. */
+    if (auto_ack) {
+      priv->cfg.lora.packet.payload_length = SX1280_ARQ_ACK_LEN;
+    }
+
+    packet_params.lora = priv->cfg.lora.packet;
+    break;
+  case SX1280_MODE_RANGING:
+    /* TODO */
+    break;
+  }
+
+  struct sx1280_cmds *cmds = priv->cmds;
+  cmds->set_rx.tx[1] = priv->cfg.period_base;
+
+  u16 auto_tx_us = auto_ack ? arq->ack_delay_us : 0;
+  u8 auto_tx[3] = { SX1280_CMD_SET_AUTO_TX, auto_tx_us >> 8, auto_tx_us & 0xFF };
+
+  u8 params_tx[8];
+  if (!(err = sx1280_encode_packet_params(&packet_params, params_tx))) {
+    bool update_params = !sx1280_shadow_cmd_match(
+      priv,
+      SX1280_SHADOW_PACKET_PARAMS,
+      params_tx,
+      sizeof(params_tx)
+    );
+
+    bool update_auto_tx = !sx1280_shadow_cmd_match(
+      priv,
+      SX1280_SHADOW_AUTO_TX,
+      auto_tx,
+      sizeof(auto_tx)
+    );
+
+    sx1280_async_reset(priv);
+    bool retuned = sx1280_fhss_retune(priv);
+
+    if (update_params) {
+      memcpy(cmds->set_packet_params.tx, params_tx, sizeof(params_tx));
+      sx1280_async_add(priv, &cmds->set_packet_params);
+    }
+
+    if (update_auto_tx) {
+      memcpy(cmds->set_auto_tx.tx, auto_tx, sizeof(auto_tx));
+      sx1280_async_add(priv, &cmds->set_auto_tx);
+    }
+
+    sx1280_async_add(priv, &cmds->set_rx);
+    err = sx1280_async_run(priv);
+    sx1280_fhss_retuned(priv, retuned, err);
+
+    if (update_params) {
+      sx1280_shadow_cmd_update(
+        priv,
+        SX1280_SHADOW_PACKET_PARAMS,
+        params_tx,
+        sizeof(params_tx),
+        !err
+      );
+    }
+
+    if (update_auto_tx) {
+      sx1280_shadow_cmd_update(
+        priv,
+        SX1280_SHADOW_AUTO_TX,
+        auto_tx,
+        sizeof(auto_tx),
+        !err
+      );
+    }
+  }
+
+  arq->auto_ack = auto_ack && !err;
+
+  if (err) {
+    dev_err(&priv->spi->dev, "failed to transition to listen\n");
+  }
+
+  /* Wake up all waiters that are waiting for idle (anything but Tx). */
+  priv->state = SX1280_STATE_RX;
+  wake_up_all(&priv->idle_wait);
+
+  return err;
+}
+
+static void sx1280_tx_next(struct sx1280_priv *priv);
+static void sx1280_mac_backoff(struct sx1280_priv *priv);
+
+/**
+ * Drops the frame the MAC couldn't send and moves on to the next one.
+ * @context process & locked
+ */
+static void sx1280_mac_drop(struct sx1280_priv *priv) {
+  sx1280_link_tx_done(priv, false);
+  sx1280_tx_next(priv);
+
+  if (priv->state != SX1280_STATE_TX) {
+    sx1280_listen(priv);
+  }
+}
+
+/**
+ * Acts on a clear channel assessment: sends the frame if the channel is clear,
+ * and otherwise backs off again, or gives up once out of backoffs.
+ * @context process & locked
+ */
+static void sx1280_mac_cca_done(struct sx1280_priv *priv, bool busy) {
+  int err;
+  struct sx1280_mac *mac = &priv->mac;
+  u64 now = ktime_get_ns();
+
+  if (!busy) {
+    if (mac->busy_since_ns) {
+      mac->busy_ns += now - mac->busy_since_ns;
+      mac->busy_since_ns = 0;
+    }
+
+    mac->phase = SX1280_MAC_IDLE;
+
+    err = sx1280_tx_start(priv, mac->hdr, mac->hdr_len, mac->data, mac->len);
+    if (err) {
+      netdev_warn(priv->netdev, "dropped invalid tx packet: %d\n", err);
+      sx1280_mac_drop(priv);
+      return;
+    }
+
+    priv->state = SX1280_STATE_TX;
+    return;
+  }
+
+  if (!mac->busy_since_ns) {
+    mac->busy_since_ns = now;
+  }
+
+  mac->deferrals++;
+
+  if (++mac->backoffs > mac->max_backoffs) {
+    netdev_dbg(priv->netdev, "csma: channel access failure\n");
+    mac->failures++;
+    sx1280_mac_drop(priv);
+    return;
+  }
+
+  mac->be = min(mac->be + 1, mac->max_be);
+  sx1280_mac_backoff(priv);
+}
+
+/**
+ * Assesses whether the channel is clear, either with channel activity
+ * detection, which finishes with an interrupt, or straight away from the
+ * instantaneous RSSI.
+ * @context process & locked
+ */
+static void sx1280_mac_cca(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_mac *mac = &priv->mac;
+
+  if (priv->cfg.mode == SX1280_MODE_LORA && mac->cad) {
+    if (
+      (err = sx1280_set_standby(priv, SX1280_STDBY_RC))
+      || (err = sx1280_set_cad_params(priv, SX1280_MAC_CAD_SYMBOLS))
+      || (err = sx1280_set_cad(priv))
+    ) {
+      netdev_warn(priv->netdev, "failed to start cad: %d\n", err);
+      sx1280_mac_drop(priv);
+      return;
+    }
+
+    mac->phase = SX1280_MAC_CCA;
+    priv->state = SX1280_STATE_CAD;
+    return;
+  }
+
+  u8 rssi_inst;
+  if ((err = sx1280_get_rssi_inst(priv, &rssi_inst))) {
+    sx1280_mac_drop(priv);
+    return;
+  }
+
+  /* The RSSI is reported as -dBm in half dB steps. */
+  sx1280_mac_cca_done(priv, -(int) rssi_inst / 2 >= mac->cca_threshold_dbm);
+}
+
+/**
+ * Waits a random number of backoff slots, listening in the meantime, before
+ * assessing the channel.
+ * @context process & locked
+ */
+static void sx1280_mac_backoff(struct sx1280_priv *priv) {
+  struct sx1280_mac *mac = &priv->mac;
+  u64 delay_us = (u64) (get_random_u32() % (1U << mac->be)) * mac->slot_us;
+
+  /* The channel can only be sensed while listening. */
+  if (priv->state != SX1280_STATE_RX) {
+    sx1280_listen(priv);
+    delay_us = max_t(u64, delay_us, SX1280_MAC_SETTLE_US);
+  }
+
+  mac->phase = SX1280_MAC_BACKOFF;
+
+  if (!delay_us) {
+    sx1280_mac_cca(priv);
+  } else if (priv->initialized && netif_running(priv->netdev)) {
+    hrtimer_start(&mac->timer, us_to_ktime(delay_us), HRTIMER_MODE_REL);
+  }
+}
+
+/**
+ * Sends a frame, going through CSMA/CA first if it's enabled. Either way, the
+ * frame is the chip's to finish with once this succeeds.
+ * @context process & locked
+ */
+static int sx1280_mac_tx(
+  struct sx1280_priv *priv,
+  const u8 *hdr,
+  unsigned int hdr_len,
+  const u8 *data,
+  unsigned int len
+) {
+  int err;
+  struct sx1280_mac *mac = &priv->mac;
+
+  /* TDMA slots are collision-free, so there's no need to sense the channel. */
+  if (!mac->enabled || priv->tdma.enabled) {
+    if (!(err = sx1280_tx_start(priv, hdr, hdr_len, data, len))) {
+      priv->state = SX1280_STATE_TX;
+    }
+
+    return err;
+  }
+
+  mac->hdr = hdr;
+  mac->hdr_len = hdr_len;
+  mac->data = data;
+  mac->len = len;
+  mac->backoffs = 0;
+  mac->be = min(mac->min_be, mac->max_be);
+
+  sx1280_mac_backoff(priv);
+  return 0;
+}
+
+/**
+ * Starts transmitting a frame built from the TX ring, wrapping it in an ARQ
+ * header with a new sequence number if ARQ is enabled.
+ * @context process & locked
+ */
+static int sx1280_tx_frame(
+  struct sx1280_priv *priv,
+  const u8 *data,
+  unsigned int len
+) {
+  struct sx1280_arq *arq = &priv->arq;
+
+  arq->frame = arq->enabled && arq->dst != SX1280_NODE_BROADCAST;
+  if (!arq->frame) {
+    return sx1280_mac_tx(priv, NULL, 0, data, len);
+  }
+
+  arq->hdr[0] = SX1280_DISPATCH_ARQ;
+  arq->hdr[1] = arq->dst;
+  arq->hdr[2] = priv->link.node_id;
+  arq->hdr[3] = ++arq->seq;
+  arq->data = data;
+  arq->len = len;
+
+  /* A change of rate goes out first, and the frame straight after it. */
+  if (sx1280_adr_announce(priv) || sx1280_rc_announce(priv)) {
+    return sx1280_mac_tx(
+      priv,
+      NULL,
+      0,
+      priv->rc.msg,
+      sx1280_frame_pad(priv, SX1280_RC_MSG_LEN)
+    );
+  }
+
+  return sx1280_mac_tx(priv, arq->hdr, SX1280_ARQ_HDR_LEN, data, len);
+}
+
+/**
+ * Transmits the next frame from the TX ring, dropping any packets that can't be
+ * sent. Once the ring has drained, the chip is returned to continuous RX.
+ * @context process & locked
+ */
+static void sx1280_tx_next(struct sx1280_priv *priv) {
+  int err;
+  const u8 *data;
+  unsigned int len;
+
+  /* A chip that has just finished transmitting must be put back into RX. */
+  bool relisten = priv->state == SX1280_STATE_TX;
+
+  /*
+   * A frame waiting for the channel goes first, and the MAC sees to it. With
+   * TDMA, frames are only started as an owned slot opens.
+   */
+  if (
+    priv->mac.phase != SX1280_MAC_IDLE
+    || (priv->tdma.enabled && !priv->tdma.slot_open)
+  ) {
+    if (relisten) {
+      sx1280_listen(priv);
+    }
+
+    return;
+  }
+
+  while ((err = sx1280_link_tx_build(priv, &data, &len)) != -ENODATA) {
+    /* The aggregation timer kicks the work again once the delay is up. */
+    if (err == -EAGAIN) {
+      break;
+    }
+
+    /* As does the duty cycle timer, once there's airtime for the frame. */
+    if (!err && !sx1280_duty_admit(priv, len)) {
+      break;
+    }
+
+    if (!err && !(err = sx1280_tx_frame(priv, data, len))) {
+      return;
+    }
+
+    netdev_warn(priv->netdev, "dropped invalid tx packet: %d\n", err);
+    sx1280_link_tx_done(priv, false);
+    relisten = true;
+  }
+
+  if (relisten) {
+    sx1280_listen(priv);
+  }
+}
+
+static void sx1280_tx_work(struct kthread_work *work) {
+  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, tx_work);
+
+  mutex_lock(&priv->lock);
+
+  /*
+   * If the chip is already transmitting, the TX done interrupt will continue
+   * with the next packet in the ring on its own, as will the ARQ once the frame
+   * awaiting an ACK has been dealt with.
+   */
+  if (
+    priv->state != SX1280_STATE_TX
+    && priv->arq.phase == SX1280_ARQ_IDLE
+  ) {
+    sx1280_tx_next(priv);
+  }
+
+  /* Settings may have changed since, so estimate new packets afresh. */
+  sx1280_aql_update(priv);
+  mutex_unlock(&priv->lock);
+}
+
+/**
+ * Finishes with the ARQ frame, successfully or not, and moves on to whatever
+ * is next in the TX ring.
+ * @context process & locked
+ */
+static void sx1280_arq_finish(struct sx1280_priv *priv, bool acked) {
+  /* Given up on or not, the exchange is over as far as this end knows. */
+  sx1280_fhss_next(priv);
+  sx1280_link_tx_done(priv, acked);
+  sx1280_tx_next(priv);
+
+  /* Listening again re-arms AutoTx, which was off while waiting for the ACK. */
+  if (priv->state != SX1280_STATE_TX) {
+    sx1280_listen(priv);
+  }
+}
+
+/**
+ * Listens for the ACK of the ARQ frame that was just sent.
+ * @context process & locked
+ */
+static void sx1280_arq_wait(struct sx1280_priv *priv) {
+  struct sx1280_arq *arq = &priv->arq;
+
+  arq->phase = SX1280_ARQ_WAIT_ACK;
+  sx1280_listen(priv);
+
+  if (priv->initialized && netif_running(priv->netdev)) {
+    hrtimer_start(
+      &arq->timer,
+      ms_to_ktime(arq->ack_timeout_ms),
+      HRTIMER_MODE_REL
+    );
+  }
+}
+
+/**
+ * Handles a received ACK, completing the ARQ frame it acknowledges.
+ * @context process & locked
+ */
+static void sx1280_arq_rx_ack(struct sx1280_priv *priv, struct sk_buff *skb) {
+  struct sx1280_arq *arq = &priv->arq;
+
+  /* A late ACK, received during backoff, is as good as any. */
+  bool match = skb->len >= SX1280_ARQ_ACK_LEN
+    && arq->phase != SX1280_ARQ_IDLE
+    && skb->data[1] == arq->hdr[2]
+    && skb->data[2] == arq->hdr[3];
+
+  dev_kfree_skb(skb);
+
+  if (!match) {
+    return;
+  }
+
+  arq->acked++;
+  sx1280_adr_feedback(priv, true);
+  sx1280_rc_feedback(priv, true);
+  sx1280_arq_finish(priv, true);
+}
+
+/**
+ * Acknowledges a received frame if it's an ARQ frame addressed to this node.
+ *
+ * With AutoTx armed the chip sends whatever is at the start of the buffer once
+ * the ACK delay is up, so the ACK is written there in time, or the chip is
+ * stopped if there's nothing to acknowledge. Otherwise the ACK is sent by the
+ * driver straight away.
+ *
+ * @context process & locked
+ */
+static void sx1280_arq_respond(
+  struct sx1280_priv *priv,
+  const u8 *data,
+  unsigned int len
+) {
+  int err;
+  struct sx1280_arq *arq = &priv->arq;
+
+  bool ack = len > SX1280_ARQ_HDR_LEN
+    && data[0] == SX1280_DISPATCH_ARQ
+    && data[1] == priv->link.node_id;
+
+  if (!ack) {
+    if (arq->auto_ack) {
+      arq->auto_ack = false;
+
+      /*
+       * The start of the buffer is where the frame was just received, so if
+       * AutoTx goes off before the chip is stopped, it's an ACK addressed to no
+       * one that goes out rather than the frame's first bytes.
+       */
+      arq->ack[0] = SX1280_DISPATCH_ACK;
+      arq->ack[1] = SX1280_NODE_BROADCAST;
+      arq->ack[2] = 0;
+      sx1280_write_buffer(priv, 0x00, arq->ack, SX1280_ARQ_ACK_LEN);
+
+      sx1280_set_standby(priv, SX1280_STDBY_RC);
+      sx1280_listen(priv);
+    }
+
+    return;
+  }
+
+  arq->ack[0] = SX1280_DISPATCH_ACK;
+  arq->ack[1] = data[2];
+  arq->ack[2] = data[3];
+
+  if (arq->auto_ack) {
+    arq->auto_ack = false;
+    priv->tx_airtime_ns = sx1280_time_on_air_ns(priv, SX1280_ARQ_ACK_LEN);
+    err = sx1280_write_buffer(priv, 0x00, arq->ack, SX1280_ARQ_ACK_LEN);
+  } else {
+    unsigned int ack_len = sx1280_frame_pad(priv, SX1280_ARQ_ACK_LEN);
+    err = sx1280_tx_start(priv, NULL, 0, arq->ack, ack_len);
+  }
+
+  if (err) {
+    netdev_warn(priv->netdev, "failed to send ack: %d\n", err);
+    sx1280_listen(priv);
+    return;
+  }
+
+  /* Either way, the ACK is now on its way out. */
+  arq->acking = true;
+  priv->state = SX1280_STATE_TX;
+}
+
+/**
+ * Returns to where things were once an ACK has been sent.
+ * @context process & locked
+ */
+static void sx1280_arq_ack_sent(struct sx1280_priv *priv) {
+  priv->arq.acking = false;
+
+  if (priv->arq.phase != SX1280_ARQ_IDLE) {
+    sx1280_listen(priv);
+  } else {
+    sx1280_tx_next(priv);
+  }
+}
+
+/**
+ * Sends the ARQ frame awaiting an ACK again.
+ * @context process & locked
+ */
+static void sx1280_arq_retransmit(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_arq *arq = &priv->arq;
+
+  /* Backing off goes on until the duty cycle has the airtime for it. */
+  if (!sx1280_duty_admit(priv, arq->len)) {
+    return;
+  }
+
+  /* Already waiting for the ACK, so as not to arm AutoTx while backing off. */
+  arq->phase = SX1280_ARQ_WAIT_ACK;
+
+  err = sx1280_mac_tx(priv, arq->hdr, SX1280_ARQ_HDR_LEN, arq->data, arq->len);
+  if (err) {
+    arq->failures++;
+    sx1280_arq_finish(priv, false);
+    return;
+  }
+
+  arq->retransmissions++;
+}
+
+/**
+ * Handles the ACK timeout and backoff timer: gives up on or schedules another
+ * attempt at a frame whose ACK hasn't arrived, or retransmits it once the
+ * backoff is up.
+ * @context process
+ */
+static void sx1280_arq_work(struct kthread_work *work) {
+  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, arq.work);
+  struct sx1280_arq *arq = &priv->arq;
+
+  mutex_lock(&priv->lock);
+
+  if (
+    !priv->initialized
+    || !netif_running(priv->netdev)
+    || arq->phase == SX1280_ARQ_IDLE
+  ) {
+    goto unlock;
+  }
+
+  /* Don't step on an ACK that's on the air. */
+  if (priv->state == SX1280_STATE_TX) {
+    hrtimer_start(
+      &arq->timer,
+      us_to_ktime(SX1280_ARQ_BUSY_RETRY_US),
+      HRTIMER_MODE_REL
+    );
+
+    goto unlock;
+  }
+
+  if (arq->phase == SX1280_ARQ_WAIT_ACK) {
+    /* Listen at the link's rate again if the frame was a probe or a trial. */
+    if (
+      (sx1280_adr_feedback(priv, false) || sx1280_rc_feedback(priv, false))
+      && priv->state == SX1280_STATE_RX
+    ) {
+      sx1280_listen(priv);
+    }
+
+    if (arq->retries >= arq->retries_max) {
+      netdev_dbg(priv->netdev, "arq: no ack for seq %u\n", arq->hdr[3]);
+      arq->failures++;
+      sx1280_arq_finish(priv, false);
+      goto unlock;
+    }
+
+    /* Back off for a random number of slots, doubling the range each time. */
+    u32 slots = 1U << min(arq->retries, (unsigned int) SX1280_ARQ_BACKOFF_EXP_MAX);
+    u64 backoff_us = (u64) (get_random_u32() % slots)
+      * arq->ack_timeout_ms * USEC_PER_MSEC / 4;
+
+    arq->retries++;
+    arq->phase = SX1280_ARQ_BACKOFF;
+
+    /* With TDMA, the retransmission waits for the next owned slot instead. */
+    if (!priv->tdma.enabled) {
+      hrtimer_start(&arq->timer, us_to_ktime(backoff_us), HRTIMER_MODE_REL);
+    }
+
+    goto unlock;
+  }
+
+  sx1280_arq_retransmit(priv);
+
+unlock:
+  mutex_unlock(&priv->lock);
+}
+
+/**
+ * Hands the ACK timeout and backoff off to the worker.
+ * @context hardirq
+ */
+static enum hrtimer_restart sx1280_arq_timer(struct hrtimer *timer) {
+  struct sx1280_priv *priv = container_of(timer, struct sx1280_priv, arq.timer);
+
+  kthread_queue_work(priv->worker, &priv->arq.work);
+  return HRTIMER_NORESTART;
+}
+
+/**
+ * Runs the clear channel assessment once the backoff is up.
+ * @context process
+ */
+static void sx1280_mac_work(struct kthread_work *work) {
+  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, mac.work);
+  struct sx1280_mac *mac = &priv->mac;
+
+  mutex_lock(&priv->lock);
+
+  if (
+    !priv->initialized
+    || !netif_running(priv->netdev)
+    || mac->phase != SX1280_MAC_BACKOFF
+  ) {
+    goto unlock;
+  }
+
+  /* An ACK may be on the air, after which the chip listens again. */
+  if (priv->state != SX1280_STATE_RX) {
+    hrtimer_start(
+      &mac->timer,
+      us_to_ktime(SX1280_MAC_BUSY_RETRY_US),
+      HRTIMER_MODE_REL
+    );
+
+    goto unlock;
+  }
+
+  sx1280_mac_cca(priv);
+
+unlock:
+  mutex_unlock(&priv->lock);
+}
+
+/**
+ * Hands the end of the backoff off to the worker.
+ * @context hardirq
+ */
+static enum hrtimer_restart sx1280_mac_timer(struct hrtimer *timer) {
+  struct sx1280_priv *priv = container_of(timer, struct sx1280_priv, mac.timer);
+
+  kthread_queue_work(priv->worker, &priv->mac.work);
+  return HRTIMER_NORESTART;
+}
+
+/**
+ * Handles the end of channel activity detection, which leaves the chip in
+ * standby.
+ * @context process & locked
+ */
+static void sx1280_irq_cad(struct sx1280_priv *priv, u16 mask) {
+  priv->state = SX1280_STATE_STANDBY;
+
+  /* The frame may have been dropped in the meantime. */
+  if (priv->mac.phase != SX1280_MAC_CCA) {
+    sx1280_listen(priv);
+    return;
+  }
+
+  /* Anything unexpected counts as a busy channel, so CCA is tried again. */
+  if (!(mask & SX1280_IRQ_CAD_DONE)) {
+    netdev_warn(priv->netdev, "  unhandled cad irq\n");
+  }
+
+  sx1280_mac_cca_done(
+    priv,
+    !(mask & SX1280_IRQ_CAD_DONE) || (mask & SX1280_IRQ_CAD_DETECTED)
+  );
+}
+
+/**
+ * Arms the TDMA timer for the given CLOCK_MONOTONIC time.
+ * @context process & locked
+ */
+static void sx1280_tdma_arm(struct sx1280_priv *priv, u64 when_ns) {
+  if (priv->initialized && netif_running(priv->netdev)) {
+    hrtimer_start(&priv->tdma.timer, ns_to_ktime(when_ns), HRTIMER_MODE_ABS);
+  }
+}
+
+/**
+ * Has the chip listen, or stand by if it needn't, between transmissions.
+ * @context process & locked
+ */
+static void sx1280_tdma_idle(struct sx1280_priv *priv, bool listen) {
+  /* Once done, transmissions put the chip back into RX by themselves. */
+  if (priv->state == SX1280_STATE_TX) {
+    return;
+  }
+
+  if (listen) {
+    if (priv->state != SX1280_STATE_RX) {
+      sx1280_listen(priv);
+    }
+
+    return;
+  }
+
+  /* A node waiting for an ACK keeps listening for it. */
+  if (priv->state != SX1280_STATE_RX || priv->arq.phase != SX1280_ARQ_IDLE) {
+    return;
+  }
+
+  if (!sx1280_set_standby(priv, SX1280_STDBY_RC)) {
+    priv->arq.auto_ack = false;
+    priv->state = SX1280_STATE_STANDBY;
+    wake_up_all(&priv->idle_wait);
+  }
+}
+
+/**
+ * Sends the coordinator's beacon, which starts the next superframe once it's
+ * done.
+ * @context process & locked
+ */
+static void sx1280_tdma_beacon(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_tdma *tdma = &priv->tdma;
+
+  /* An ACK or a frame that overran its slot has to finish first. */
+  if (priv->state == SX1280_STATE_TX) {
+    sx1280_tdma_arm(
+      priv,
+      ktime_get_ns() + (u64) SX1280_MAC_BUSY_RETRY_US * NSEC_PER_USEC
+    );
+
+    return;
+  }
+
+  tdma->beacon[0] = SX1280_DISPATCH_BEACON;
+  tdma->beacon[1] = priv->link.node_id;
+  tdma->beacon[2] = ++tdma->seq;
+
+  unsigned int len = sx1280_frame_pad(priv, SX1280_TDMA_BEACON_LEN);
+  if ((err = sx1280_tx_start(priv, NULL, 0, tdma->beacon, len))) {
+    netdev_warn(priv->netdev, "failed to send beacon: %d\n", err);
+    sx1280_tdma_arm(
+      priv,
+      ktime_get_ns() + (u64) tdma->superframe_us * NSEC_PER_USEC
+    );
+
+    return;
+  }
+
+  tdma->beaconing = true;
+  priv->state = SX1280_STATE_TX;
+}
+
+/**
+ * Opens an owned slot, sending one frame: an ARQ frame awaiting
+ * retransmission, or otherwise the next one from the TX ring.
+ * @context process & locked
+ */
+static void sx1280_tdma_tx(struct sx1280_priv *priv) {
+  struct sx1280_tdma *tdma = &priv->tdma;
+
+  if (priv->state == SX1280_STATE_TX) {
+    return;
+  }
+
+  tdma->slot_open = true;
+
+  if (priv->arq.phase == SX1280_ARQ_BACKOFF) {
+    sx1280_arq_retransmit(priv);
+  } else if (priv->arq.phase == SX1280_ARQ_IDLE) {
+    sx1280_tx_next(priv);
+  }
+
+  tdma->slot_open = false;
+}
+
+/**
+ * Gets the shape of the superframe from the TDMA configuration and the current
+ * modulation.
+ * @context process & locked
+ */
+static struct sx1280_tdma_sched sx1280_tdma_sched(struct sx1280_priv *priv) {
+  struct sx1280_tdma *tdma = &priv->tdma;
+  struct sx1280_tdma_sched sched;
+
+  sx1280_tdma_sched_init(
+    &sched,
+    tdma->coordinator,
+    (u64) tdma->superframe_us * NSEC_PER_USEC,
+    (u64) tdma->slot_us * NSEC_PER_USEC,
+    (u64) tdma->guard_us * NSEC_PER_USEC,
+    sx1280_time_on_air_ns(priv, sx1280_frame_pad(priv, SX1280_TDMA_BEACON_LEN)),
+    tdma->tx_slots,
+    tdma->rx_slots
+  );
+
+  return sched;
+}
+
+/**
+ * Acts on where the superframe is now: sends or waits for the beacon, opens an
+ * owned slot, or has the chip listen or stand by, then arms the timer for the
+ * next slot boundary.
+ * @context process & locked
+ */
+static void sx1280_tdma_event(struct sx1280_priv *priv) {
+  struct sx1280_tdma *tdma = &priv->tdma;
+  struct sx1280_tdma_sched sched = sx1280_tdma_sched(priv);
+  struct sx1280_tdma_step step =
+    sx1280_tdma_step(&tdma->sync, &sched, ktime_get_ns());
+
+  if (step.missed) {
+    tdma->beacons_missed++;
+  }
+
+  if (step.lost) {
+    netdev_dbg(priv->netdev, "tdma: lost beacon\n");
+  }
+
+  /* Outside of slots, the beacon is sent or listened for on its channel. */
+  bool rendezvous = !step.slot_ns && step.action != SX1280_TDMA_STANDBY;
+  if (priv->fhss.rendezvous != rendezvous) {
+    priv->fhss.rendezvous = rendezvous;
+
+    if (priv->fhss.enabled && priv->state == SX1280_STATE_RX) {
+      sx1280_listen(priv);
+    }
+  }
+
+  switch (step.action) {
+  case SX1280_TDMA_BEACON:
+    sx1280_tdma_beacon(priv);
+    return;
+  case SX1280_TDMA_WAIT:
+    break;
+  case SX1280_TDMA_LISTEN:
+    sx1280_tdma_idle(priv, true);
+    break;
+  case SX1280_TDMA_STANDBY:
+    sx1280_tdma_idle(priv, false);
+    break;
+  case SX1280_TDMA_TX:
+    sx1280_tdma_tx(priv);
+    sx1280_tdma_idle(priv, true);
+    break;
+  }
+
+  if (step.next_ns) {
+    sx1280_tdma_arm(priv, step.next_ns);
+  }
+}
+
+/**
+ * Starts the superframe a received beacon marks the start of.
+ * @context process & locked
+ */
+static void sx1280_tdma_rx_beacon(struct sx1280_priv *priv, struct sk_buff *skb) {
+  struct sx1280_tdma *tdma = &priv->tdma;
+  u64 rx_ns = READ_ONCE(priv->irq_ns);
+  bool valid = skb->len >= SX1280_TDMA_BEACON_LEN;
+  u8 seq = valid ? skb->data[2] : 0;
+
+  dev_kfree_skb(skb);
+
+  if (
+    !valid
+    || !tdma->enabled
+    || tdma->coordinator
+    || !netif_running(priv->netdev)
+  ) {
+    return;
+  }
+
+  struct sx1280_tdma_sched sched = sx1280_tdma_sched(priv);
+  sx1280_tdma_sync_beacon(&tdma->sync, &sched, rx_ns);
+  sx1280_fhss_anchor(priv, seq, rx_ns);
+  tdma->beacons++;
+
+  hrtimer_try_to_cancel(&tdma->timer);
+  sx1280_tdma_event(priv);
+}
+
+/**
+ * Starts the superframe once the coordinator's beacon is done.
+ * @context process & locked
+ */
+static void sx1280_tdma_beacon_sent(struct sx1280_priv *priv, bool sent) {
+  struct sx1280_tdma *tdma = &priv->tdma;
+
+  tdma->beaconing = false;
+
+  if (!tdma->enabled) {
+    sx1280_tx_next(priv);
+    return;
+  }
+
+  priv->state = SX1280_STATE_STANDBY;
+
+  /* The interface went down meanwhile, so the superframe isn't started. */
+  if (!netif_running(priv->netdev)) {
+    sx1280_listen(priv);
+    return;
+  }
+
+  if (!sent) {
+    sx1280_listen(priv);
+    sx1280_tdma_arm(
+      priv,
+      ktime_get_ns() + (u64) tdma->superframe_us * NSEC_PER_USEC
+    );
+
+    return;
+  }
+
+  u64 beacon_ns = READ_ONCE(priv->irq_ns);
+  struct sx1280_tdma_sched sched = sx1280_tdma_sched(priv);
+  sx1280_tdma_sync_beacon(&tdma->sync, &sched, beacon_ns);
+  sx1280_fhss_anchor(priv, tdma->seq, beacon_ns);
+  tdma->beacons++;
+
+  sx1280_tdma_event(priv);
+  wake_up_all(&priv->idle_wait);
+}
+
+/**
+ * Starts TDMA over, e.g. after its configuration has changed: the coordinator
+ * sends a beacon straight away, while nodes wait for one. Disabling it returns
+ * the chip to listening and sending whenever there's something to send.
+ * @context process & locked
+ */
+static void sx1280_tdma_restart(struct sx1280_priv *priv) {
+  struct sx1280_tdma *tdma = &priv->tdma;
+
+  struct sx1280_tdma_sched sched = sx1280_tdma_sched(priv);
+
+  hrtimer_try_to_cancel(&tdma->timer);
+  sx1280_tdma_sync_reset(&tdma->sync, &sched);
+
+  if (!tdma->enabled) {
+    priv->fhss.rendezvous = false;
+
+    if (priv->state == SX1280_STATE_STANDBY) {
+      sx1280_listen(priv);
+    }
+
+    kthread_queue_work(priv->worker, &priv->tx_work);
+    return;
+  }
+
+  kthread_queue_work(priv->worker, &tdma->work);
+}
+
+/**
+ * Handles TDMA slot boundaries.
+ * @context process
+ */
+static void sx1280_tdma_work(struct kthread_work *work) {
+  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, tdma.work);
+
+  mutex_lock(&priv->lock);
+
+  if (
+    priv->initialized
+    && netif_running(priv->netdev)
+    && priv->tdma.enabled
+  ) {
+    sx1280_tdma_event(priv);
+  }
+
+  mutex_unlock(&priv->lock);
+}
+
+/**
+ * Hands TDMA slot boundaries off to the worker.
+ * @context hardirq
+ */
+static enum hrtimer_restart sx1280_tdma_timer(struct hrtimer *timer) {
+  struct sx1280_priv *priv = container_of(timer, struct sx1280_priv, tdma.timer);
+
+  kthread_queue_work(priv->worker, &priv->tdma.work);
+  return HRTIMER_NORESTART;
+}
+
+static int sx1280_acquire_idle(struct sx1280_priv *priv, bool locked);
+
+/**
+ * Readies the chip for taking RSSI samples across channels. Nothing can be
+ * received meanwhile, and AutoTx is disarmed so that a packet caught on the
+ * way doesn't set it off.
+ * @context process & locked
+ */
+static int sx1280_survey_begin(struct sx1280_priv *priv) {
+  int err;
+  u8 auto_tx[3] = { SX1280_CMD_SET_AUTO_TX, 0, 0 };
+
+  if (
+    (err = sx1280_set_standby(priv, SX1280_STDBY_RC))
+    || (err = sx1280_write_shadowed(
+      priv,
+      SX1280_SHADOW_AUTO_TX,
+      auto_tx,
+      sizeof(auto_tx)
+    ))
+  ) {
+    return err;
+  }
+
+  priv->arq.auto_ack = false;
+  priv->state = SX1280_STATE_STANDBY;
+  return 0;
+}
+
+/**
+ * Tunes to a channel and takes `samples` RSSI readings there, once the
+ * receiver has had `settle_us` to settle. Tuning is one SetRfFrequency and
+ * SetRx sequence, and the samples are then taken back-to-back.
+ * @context process & locked
+ */
+static int sx1280_survey_sample(
+  struct sx1280_priv *priv,
+  u32 freq,
+  unsigned int samples,
+  unsigned int settle_us,
+  u8 *rssi
+) {
+  int err;
+  struct sx1280_async_cmd *freq_cmd = &priv->cmds->set_rf_frequency;
+
+  freq_cmd->tx[1] = freq >> 16;
+  freq_cmd->tx[2] = (freq >> 8) & 0xFF;
+  freq_cmd->tx[3] = freq & 0xFF;
+
+  sx1280_async_reset(priv);
+  sx1280_async_add(priv, freq_cmd);
+  sx1280_async_add(priv, &priv->cmds->set_rx);
+
+  err = sx1280_async_run(priv);
+  sx1280_shadow_cmd_update(
+    priv,
+    SX1280_SHADOW_RF_FREQUENCY,
+    freq_cmd->tx,
+    4,
+    !err
+  );
+
+  if (err) {
+    return err;
+  }
+
+  fsleep(settle_us);
+
+  for (unsigned int i = 0; i < samples && !err; i++) {
+    err = sx1280_get_rssi_inst(priv, &rssi[i]);
+  }
+
+  return err;
+}
+
+/**
+ * Puts the chip back on its channel and into the state it was in before
+ * sampling, dropping anything it happened to pick up.
+ * @context process & locked
+ */
+static void sx1280_survey_end(struct sx1280_priv *priv, bool listening) {
+  sx1280_set_standby(priv, SX1280_STDBY_RC);
+  sx1280_clear_irq_status(priv, 0xFFFF);
+  priv->state = SX1280_STATE_STANDBY;
+
+  if (listening) {
+    sx1280_listen(priv);
+  }
+}
+
+/**
+ * Sweeps the survey's frequency range, taking RSSI samples at each step, and
+ * keeps the result for reading out.
+ * @context process & locked
+ */
+static int sx1280_survey_run(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_survey *survey = &priv->survey;
+  bool listening = priv->state == SX1280_STATE_RX;
+
+  if (survey->stop_hz < survey->start_hz) {
+    return -EINVAL;
+  }
+
+  unsigned int steps = (survey->stop_hz - survey->start_hz) / survey->step_hz + 1;
+  if (steps > SX1280_SURVEY_STEPS_MAX) {
+    return -E2BIG;
+  }
+
+  size_t len = sizeof(struct sx1280_survey_hdr) + steps * survey->samples;
+  u8 *result = kvzalloc(len, GFP_KERNEL);
+  if (!result) {
+    return -ENOMEM;
+  }
+
+  struct sx1280_survey_hdr *hdr = (struct sx1280_survey_hdr *) result;
+  hdr->start_hz = cpu_to_le32(survey->start_hz);
+  hdr->step_hz = cpu_to_le32(survey->step_hz);
+  hdr->steps = cpu_to_le16(steps);
+  hdr->samples = cpu_to_le16(survey->samples);
+
+  u8 *rssi = &result[sizeof(*hdr)];
+
+  if (!(err = sx1280_survey_begin(priv))) {
+    for (unsigned int i = 0; i < steps && !err; i++) {
+      err = sx1280_survey_sample(
+        priv,
+        SX1280_FREQ_HZ_TO_PLL(survey->start_hz + i * survey->step_hz),
+        survey->samples,
+        survey->settle_us,
+        &rssi[i * survey->samples]
+      );
+    }
+  }
+
+  sx1280_survey_end(priv, listening);
+
+  if (err) {
+    kvfree(result);
+    return err;
+  }
+
+  kvfree(survey->result);
+  survey->result = result;
+  survey->result_len = len;
+
+  return 0;
+}
+
+/**
+ * Measures the noise floor of each candidate channel and moves to the quietest
+ * one, unless the current channel is within SX1280_ACS_HYSTERESIS of it.
+ * @context process & locked
+ */
+static int sx1280_acs_select(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_acs *acs = &priv->acs;
+  struct sx1280_survey *survey = &priv->survey;
+  bool listening = priv->state == SX1280_STATE_RX;
+  u8 rssi[SX1280_SURVEY_SAMPLES_MAX];
+
+  /* RSSI readings are -2 × dBm, so the quietest channel reads the highest. */
+  unsigned int best = 0;
+  unsigned int best_level = 0;
+  unsigned int current_level = 0;
+
+  if (!acs->n_channels) {
+    return 0;
+  }
+
+  if (!(err = sx1280_survey_begin(priv))) {
+    for (unsigned int i = 0; i < acs->n_channels && !err; i++) {
+      err = sx1280_survey_sample(
+        priv,
+        acs->channels[i],
+        survey->samples,
+        survey->settle_us,
+        rssi
+      );
+
+      unsigned int level = 0;
+      for (unsigned int j = 0; j < survey->samples; j++) {
+        level += rssi[j];
+      }
+
+      level /= survey->samples;
+
+      if (level > best_level) {
+        best = i;
+        best_level = level;
+      }
+
+      if (acs->channels[i] == priv->cfg.freq) {
+        current_level = level;
+      }
+    }
+  }
+
+  if (
+    !err
+    && acs->channels[best] != priv->cfg.freq
+    && best_level >= current_level + SX1280_ACS_HYSTERESIS
+  ) {
+    netdev_info(
+      priv->netdev,
+      "moving to quieter channel at %u Hz (%d dBm vs %d dBm)\n",
+      SX1280_FREQ_PLL_TO_HZ(acs->channels[best]),
+      -(int) best_level / 2,
+      -(int) current_level / 2
+    );
+
+    /* Picked up as the chip is put back into RX. */
+    priv->cfg.freq = acs->channels[best];
+    acs->switches++;
+  }
+
+  sx1280_survey_end(priv, listening);
+  return err;
+}
+
+/**
+ * Takes a baseline of the frame counts, against which the packet error rate
+ * is worked out at the end of each interval.
+ * @context process & locked
+ */
+static void sx1280_acs_baseline(struct sx1280_priv *priv, u64 *good, u64 *bad) {
+  *good = sx1280_stats_read(priv, offsetof(struct sx1280_pcpu_stats, rx_packets))
+    + sx1280_stats_read(priv, offsetof(struct sx1280_pcpu_stats, tx_packets));
+  *bad = sx1280_stats_read(priv, offsetof(struct sx1280_pcpu_stats, rx_errors))
+    + priv->arq.retransmissions;
+}
+
+/**
+ * Arms the timer for the next check of the packet error rate, if any.
+ * @context process & locked
+ */
+static void sx1280_acs_arm(struct sx1280_priv *priv) {
+  struct sx1280_acs *acs = &priv->acs;
+
+  if (
+    acs->enabled
+    && acs->interval_s
+    && priv->initialized
+    && netif_running(priv->netdev)
+  ) {
+    hrtimer_start(
+      &acs->timer,
+      ktime_set(acs->interval_s, 0),
+      HRTIMER_MODE_REL
+    );
+  }
+}
+
+/**
+ * Starts a fresh interval after the settings have changed.
+ * @context process & locked
+ */
+static void sx1280_acs_restart(struct sx1280_priv *priv) {
+  struct sx1280_acs *acs = &priv->acs;
+
+  hrtimer_try_to_cancel(&acs->timer);
+  sx1280_acs_baseline(priv, &acs->good, &acs->bad);
+  sx1280_acs_arm(priv);
+}
+
+/**
+ * Picks the quietest candidate channel as the interface comes up, before the
+ * carrier does.
+ * @context process
+ */
+static int sx1280_acs_open(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_acs *acs = &priv->acs;
+
+  if ((err = sx1280_acquire_idle(priv, false))) {
+    return err;
+  }
+
+  if (acs->enabled && (err = sx1280_acs_select(priv))) {
+    netdev_warn(priv->netdev, "channel selection failed: %d\n", err);
+  }
+
+  sx1280_acs_baseline(priv, &acs->good, &acs->bad);
+  sx1280_acs_arm(priv);
+  mutex_unlock(&priv->lock);
+
+  return 0;
+}
+
+/**
+ * Checks the packet error rate over the last interval, and looks for a quieter
+ * channel if it has climbed past the threshold.
+ * @context process
+ */
+static void sx1280_acs_work(struct work_struct *work) {
+  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, acs.work);
+  struct sx1280_acs *acs = &priv->acs;
+
+  if (sx1280_acquire_idle(priv, false)) {
+    return;
+  }
+
+  if (!acs->enabled) {
+    goto unlock;
+  }
+
+  u64 good;
+  u64 bad;
+  sx1280_acs_baseline(priv, &good, &bad);
+
+  u64 frames = good - acs->good + bad - acs->bad;
+  bool climbed = frames >= SX1280_ACS_MIN_FRAMES
+    && (bad - acs->bad) * 100 >= frames * acs->per_percent;
+
+  if (climbed) {
+    sx1280_acs_select(priv);
+    sx1280_acs_baseline(priv, &good, &bad);
+  }
+
+  acs->good = good;
+  acs->bad = bad;
+  sx1280_acs_arm(priv);
+
+unlock:
+  mutex_unlock(&priv->lock);
+}
+
+/**
+ * Hands the periodic packet error rate check off to the system workqueue.
+ * @context hardirq
+ */
+static enum hrtimer_restart sx1280_acs_timer(struct hrtimer *timer) {
+  struct sx1280_priv *priv = container_of(timer, struct sx1280_priv, acs.timer);
+
+  schedule_work(&priv->acs.work);
+  return HRTIMER_NORESTART;
+}
+
+/**
+ * Goes back to the rate in use if an announced frame never came, or falls
+ * back on the most robust rate after hearing nothing for a while. The other
+ * end does the same, so the two find each other again even if they ended up
+ * on different rates.
+ * @context process
+ */
+static void sx1280_adr_work(struct kthread_work *work) {
+  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, adr.work);
+  struct sx1280_adr *adr = &priv->adr;
+  unsigned int n;
+
+  mutex_lock(&priv->lock);
+
+  const struct sx1280_adr_rate *rates = sx1280_adr_sync(priv, &n);
+  if (!rates) {
+    goto unlock;
+  }
+
+  /* A frame sent at the announced rate is waited out first. */
+  if (adr->trying) {
+    sx1280_adr_arm(priv, SX1280_ADR_FALLBACK_MS);
+    goto unlock;
+  }
+
+  if (adr->following) {
+    sx1280_adr_followed(priv, false);
+  } else {
+    sx1280_adr_change(priv, rates, sx1280_adr_index(rates, n, adr->target), 0);
+    adr->packets = 0;
+  }
+
+  if (priv->state == SX1280_STATE_RX) {
+    sx1280_listen(priv);
+  }
+
+unlock:
+  mutex_unlock(&priv->lock);
+}
+
+/**
+ * Hands the fall back on the most robust rate off to the worker.
+ * @context hardirq
+ */
+static enum hrtimer_restart sx1280_adr_timer(struct hrtimer *timer) {
+  struct sx1280_priv *priv = container_of(timer, struct sx1280_priv, adr.timer);
+
+  kthread_queue_work(priv->worker, &priv->adr.work);
+  return HRTIMER_NORESTART;
+}
+
+/**
+ * Sends the ARQ frame an announcement was for.
+ * @context process & locked
+ */
+static void sx1280_rc_send(struct sx1280_priv *priv) {
+  int err;
+  struct sx1280_arq *arq = &priv->arq;
+
+  /* The channel is still held from the announcement. */
+  err = sx1280_tx_start(
+    priv,
+    arq->hdr,
+    SX1280_ARQ_HDR_LEN,
+    arq->data,
+    arq->len
+  );
+  if (err) {
+    netdev_warn(priv->netdev, "dropped invalid tx packet: %d\n", err);
+    sx1280_mac_drop(priv);
+    return;
+  }
+
+  priv->state = SX1280_STATE_TX;
+}
+
+/**
+ * Sends the ARQ frame the announcement was for, at the rate announced if it
+ * went out. The frame is then held back for the other end to change rate,
+ * with the chip kept busy in the meantime.
+ * @context process & locked
+ */
+static void sx1280_rc_announced(struct sx1280_priv *priv, bool sent) {
+  struct sx1280_rc *rc = &priv->rc;
+
+  rc->announcing = false;
+
+  if (sent && priv->adr.enabled) {
+    priv->adr.trial = rc->msg[2];
+    priv->adr.trying = true;
+  } else if (sent) {
+    rc->rate = rc->msg[2];
+
+    if (rc->msg[3]) {
+      rc->probing = true;
+      WRITE_ONCE(rc->probes, rc->probes + 1);
+    } else {
+      rc->base = rc->rate;
+      WRITE_ONCE(rc->changes, rc->changes + 1);
+    }
+  }
+
+  if (!sent || !priv->initialized) {
+    sx1280_rc_send(priv);
+    return;
+  }
+
+  rc->turnaround = true;
+  priv->state = SX1280_STATE_TX;
+  hrtimer_start(
+    &rc->turnaround_timer,
+    us_to_ktime(SX1280_RC_TURNAROUND_US),
+    HRTIMER_MODE_REL
+  );
+}
+
+/**
+ * Sends the frame held back after an announcement, or drops it if the
+ * interface has gone down in the meantime.
+ * @context process
+ */
+static void sx1280_rc_turnaround_work(struct kthread_work *work) {
+  struct sx1280_priv *priv =
+    container_of(work, struct sx1280_priv, rc.turnaround_work);
+
+  mutex_lock(&priv->lock);
+
+  if (!priv->initialized || !priv->rc.turnaround) {
+    goto unlock;
+  }
+
+  priv->rc.turnaround = false;
+
+  if (netif_running(priv->netdev)) {
+    sx1280_rc_send(priv);
+  } else {
+    sx1280_mac_drop(priv);
+  }
+
+unlock:
+  mutex_unlock(&priv->lock);
+}
+
+/**
+ * Hands the end of the turnaround off to the worker.
+ * @context hardirq
+ */
+static enum hrtimer_restart sx1280_rc_turnaround_timer(struct hrtimer *timer) {
+  struct sx1280_priv *priv =
+    container_of(timer, struct sx1280_priv, rc.turnaround_timer);
+
+  kthread_queue_work(priv->worker, &priv->rc.turnaround_work);
+  return HRTIMER_NORESTART;
+}
+
+/**
+ * Switches to the rate another node announced, for good or for its probe.
+ * @context process & locked
+ */
+static void sx1280_rc_rx_announce(struct sx1280_priv *priv, struct sk_buff *skb) {
+  struct sx1280_rc *rc = &priv->rc;
+  unsigned int n;
+  const struct sx1280_adr_rate *rates = sx1280_rc_sync(priv, &n);
+
+  /* ADR changes are announced the same way, and are never probes. */
+  if (priv->adr.enabled) {
+    if (skb->len >= SX1280_RC_MSG_LEN) {
+      sx1280_adr_follow(priv, skb->data[2]);
+    }
+
+    dev_kfree_skb(skb);
+
+    if (priv->state == SX1280_STATE_RX) {
+      sx1280_listen(priv);
+    }
+
+    return;
+  }
+
+  bool valid = rates && skb->len >= SX1280_RC_MSG_LEN;
+  u8 param = valid ? skb->data[2] : 0;
+  bool probe = valid && skb->data[3];
+
+  dev_kfree_skb(skb);
+
+  if (!valid || rates[sx1280_adr_index(rates, n, param)].param != param) {
+    return;
+  }
+
+  rc->rate = param;
+
+  /* Go back once the probe is acknowledged, or before it's sent again. */
+  if (probe) {
+    rc->following = true;
+    sx1280_rc_arm(priv, priv->arq.ack_timeout_ms);
+  } else {
+    rc->base = param;
+    rc->following = false;
+    WRITE_ONCE(rc->changes, rc->changes + 1);
+  }
+
+  if (priv->state == SX1280_STATE_RX) {
+    sx1280_listen(priv);
+  }
+}
+
+/**
+ * Goes back to the link's rate once a probe that was followed is over.
+ * @context process & locked
+ */
+static void sx1280_rc_followed(struct sx1280_priv *priv) {
+  struct sx1280_rc *rc = &priv->rc;
+
+  if (rc->following) {
+    rc->following = false;
+    rc->rate = rc->base;
+    sx1280_rc_arm(priv, SX1280_ADR_FALLBACK_MS);
+  }
+}
+
+/**
+ * Puts off falling back on the most robust rate, as something was heard.
+ * @context process & locked
+ */
+static void sx1280_rc_rx(struct sx1280_priv *priv) {
+  unsigned int n;
+
+  if (sx1280_rc_sync(priv, &n) && !priv->rc.following) {
+    sx1280_rc_arm(priv, SX1280_ADR_FALLBACK_MS);
+  }
+}
+
+/**
+ * Goes back to the link's rate if a probe being followed never came, or falls
+ * back on the most robust rate after hearing nothing for a while. As with
+ * ADR, the other end does the same, so the two find each other again if an
+ * announcement was missed.
+ * @context process
+ */
+static void sx1280_rc_work(struct kthread_work *work) {
+  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, rc.work);
+  struct sx1280_rc *rc = &priv->rc;
+  unsigned int n;
+
+  mutex_lock(&priv->lock);
+
+  const struct sx1280_adr_rate *rates = sx1280_rc_sync(priv, &n);
+  if (!rates || rc->announcing || rc->probing) {
+    goto unlock;
+  }
+
+  if (rc->following) {
+    sx1280_rc_followed(priv);
+  } else if (rc->base != rates[0].param) {
+    rc->base = rates[0].param;
+    rc->rate = rc->base;
+    rc->best = 0;
+    WRITE_ONCE(rc->changes, rc->changes + 1);
+  }
+
+  if (priv->state == SX1280_STATE_RX) {
+    sx1280_listen(priv);
+  }
+
+unlock:
+  mutex_unlock(&priv->lock);
+}
+
+/**
+ * Hands the end of a followed probe, or the fall back, off to the worker.
+ * @context hardirq
+ */
+static enum hrtimer_restart sx1280_rc_timer(struct hrtimer *timer) {
+  struct sx1280_priv *priv = container_of(timer, struct sx1280_priv, rc.timer);
+
+  kthread_queue_work(priv->worker, &priv->rc.work);
+  return HRTIMER_NORESTART;
+}
+
+/**
+ * Has the chip follow a change of channel made while it was listening. A frame
+ * on the air finishes on its channel, and the next one is sent on the new one.
+ * @context process & locked
+ */
+static void sx1280_fhss_relisten(struct sx1280_priv *priv) {
+  if (priv->state == SX1280_STATE_RX) {
+    sx1280_listen(priv);
+  }
+}
+
+/**
+ * Starts hopping over from the beginning of the sequence, e.g. once the
+ * channels or the way of hopping have changed, until the next beacon anchors
+ * it again.
+ * @context process & locked
+ */
+static void sx1280_fhss_restart(struct sx1280_priv *priv) {
+  struct sx1280_fhss *fhss = &priv->fhss;
+
+  hrtimer_try_to_cancel(&fhss->timer);
+  fhss->pos = 0;
+  fhss->base = 0;
+  fhss->start_ns = ktime_get_ns();
+
+  if (fhss->enabled && fhss->dwell_us) {
+    kthread_queue_work(priv->worker, &fhss->work);
+  }
+
+  sx1280_fhss_relisten(priv);
+}
+
+/**
+ * Hops to the channel for the current dwell period, and arms the timer for the
+ * start of the next one.
+ * @context process
+ */
+static void sx1280_fhss_work(struct kthread_work *work) {
+  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, fhss.work);
+  struct sx1280_fhss *fhss = &priv->fhss;
+
+  mutex_lock(&priv->lock);
+
+  if (!fhss->enabled || !fhss->dwell_us || !fhss->seq_len) {
+    goto unlock;
+  }
+
+  u64 dwell_ns = (u64) fhss->dwell_us * NSEC_PER_USEC;
+  u64 period = div64_u64(ktime_get_ns() - fhss->start_ns, dwell_ns);
+
+  u32 pos;
+  div_u64_rem(period + fhss->base, fhss->seq_len, &pos);
+
+  if (pos != fhss->pos) {
+    fhss->pos = pos;
+    fhss->hops++;
+    sx1280_fhss_relisten(priv);
+  }
+
+  if (priv->initialized && netif_running(priv->netdev)) {
+    hrtimer_start(
+      &fhss->timer,
+      ns_to_ktime(fhss->start_ns + (period + 1) * dwell_ns),
+      HRTIMER_MODE_ABS
+    );
+  }
+
+unlock:
+  mutex_unlock(&priv->lock);
+}
+
+/**
+ * Hands the hop at the end of a dwell period off to the worker.
+ * @context hardirq
+ */
+static enum hrtimer_restart sx1280_fhss_timer(struct hrtimer *timer) {
+  struct sx1280_priv *priv = container_of(timer, struct sx1280_priv, fhss.timer);
+
+  kthread_queue_work(priv->worker, &priv->fhss.work);
+  return HRTIMER_NORESTART;
+}
+
+/**
+ * @context process & locked
+ */
+static void sx1280_irq_tx(struct sx1280_priv *priv, u16 mask) {
+  struct net_device *netdev = priv->netdev;
+
+  if ((mask & SX1280_IRQ_TX_DONE) || (mask & SX1280_IRQ_RX_TX_TIMEOUT)) {
+    /* A timeout results in the packet being dropped. */
+    if (!(mask & SX1280_IRQ_TX_DONE)) {
+      netdev_warn(netdev, "tx timeout (packet dropped)\n");
+    } else {
+      sx1280_tx_airtime(priv, priv->tx_airtime_ns);
+    }
+
+    /* The beacon anchors the hop sequence rather than moving it on. */
+    if (priv->tdma.beaconing) {
+      sx1280_tdma_beacon_sent(priv, mask & SX1280_IRQ_TX_DONE);
+      return;
+    }
+
+    if (priv->rc.announcing) {
+      if (mask & SX1280_IRQ_TX_DONE) {
+        sx1280_fhss_next(priv);
+      }
+
+      sx1280_rc_announced(priv, mask & SX1280_IRQ_TX_DONE);
+      return;
+    }
+
+    /* The exchange is over once the ACK is out, sent or not. */
+    if (priv->arq.acking) {
+      sx1280_fhss_next(priv);
+      sx1280_adr_followed(priv, mask & SX1280_IRQ_TX_DONE);
+      sx1280_rc_followed(priv);
+      sx1280_arq_ack_sent(priv);
+      return;
+    }
+
+    /* ARQ frames are only done with once they've been acknowledged. */
+    if ((mask & SX1280_IRQ_TX_DONE) && priv->arq.frame) {
+      sx1280_arq_wait(priv);
+      return;
+    }
+
+    if (mask & SX1280_IRQ_TX_DONE) {
+      sx1280_fhss_next(priv);
+    }
+
+    sx1280_link_tx_done(priv, mask & SX1280_IRQ_TX_DONE);
+
+    /*
+     * Send any remaining fragments and queued packets back-to-back, only
+     * putting the chip back into RX once the ring is empty.
+     */
+    sx1280_tx_next(priv);
+  } else {
+    netdev_warn(netdev, "  unhandled tx irq\n");
+  }
+}
+
+/**
+ * Records the IRQ status read at the start of an interrupt readout.
+ * @context any
+ */
+static int sx1280_irq_status_done(
+  struct sx1280_priv *priv,
+  struct sx1280_async_cmd *cmd
+) {
+  /* The IRQ status is returned in big-endian format. */
+  priv->async.irq_mask = ((u16) cmd->rx[2] << 8) | cmd->rx[3];
+  return 0;
+}
+
+/**
+ * Issues the RX readout and returns the IRQ status it read.
+ * @context process & locked
+ */
+static int sx1280_rx_readout(struct sx1280_priv *priv, u16 *irq_mask) {
+  int err;
+  struct sx1280_rx_readout *readout = priv->rx_readout;
+
+  if (
+    (err = sx1280_wait_busy(priv))
+    || (err = spi_sync(priv->spi, &readout->msg))
+  ) {
+    return err;
+  }
+
+  /* The IRQ status is returned in big-endian format. */
+  *irq_mask = ((u16) readout->irq_status_rx[2] << 8)
+    | readout->irq_status_rx[3];
+
+  return 0;
+}
+
+/**
+ * NAPI poll, which delivers packets queued by the interrupt bottom half.
+ *
+ * Packets have to be read out over SPI, which sleeps, so that part stays on
+ * the worker and only delivery is done here.
+ *
+ * @context softirq
+ */
+static int sx1280_poll(struct napi_struct *napi, int budget) {
+  struct sx1280_priv *priv = container_of(napi, struct sx1280_priv, napi);
+  struct sk_buff *skb;
+  int done = 0;
+
+  while (done < budget && (skb = skb_dequeue(&priv->rx_queue))) {
+    netif_receive_skb(skb);
+    done++;
+  }
+
+  /* Catch packets queued after the queue was found empty. */
+  if (
+    done < budget
+    && napi_complete_done(napi, done)
+    && !skb_queue_empty_lockless(&priv->rx_queue)
+  ) {
+    napi_schedule(napi);
+  }
+
+  return done;
+}
+
+/**
+ * Queues the packet read out by the RX readout for delivery, if any.
+ * @context process & locked
+ */
+static void sx1280_irq_rx(struct sx1280_priv *priv, u16 mask) {
+  int err = 0;
+  struct net_device *netdev = priv->netdev;
+  struct sx1280_rx_readout *readout = priv->rx_readout;
+  struct sk_buff *skb = NULL;
+
+  if (mask & SX1280_IRQ_RX_DONE) {
+    union sx1280_packet_status status;
+    memcpy(status.raw, &readout->packet_status_rx[2], sizeof(status.raw));
+
+    /* TODO: Set the RSSI to be publicly accessible. */
+    switch (priv->cfg.mode) {
+    case SX1280_MODE_FLRC:
+    case SX1280_MODE_GFSK:
+      netdev_dbg(
+        netdev,
+        "rx: rssi_sync=0x%02x, errors=0x%02x, status=0x%02x, sync=0x%02x\n",
+        status.gfsk_flrc.rssi_sync,
+        status.gfsk_flrc.errors,
+        status.gfsk_flrc.status,
+        status.gfsk_flrc.sync
+      );
+
+      break;
+    case SX1280_MODE_LORA:
+      netdev_dbg(
+        netdev,
+        "rx: rssi=%d, snr=%d\n",
+        status.lora.rssi_sync,
+        status.lora.snr
+      );
+
+      break;
+    case SX1280_MODE_RANGING:
+      netdev_err(netdev, "received packet in ranging mode\n");
+      err = -EIO;
+      goto fail;
+    }
+
+    /* Check errors after checking packet status for accurate debugging. */
+    if (mask & SX1280_IRQ_RX_ERRORS) {
+      netdev_dbg(netdev, "rx error: mask=0x%04x\n", mask);
+      SX1280_STATS_INC(priv, rx_errors);
+      goto fail;
+    }
+
+    sx1280_adr_rx(priv, &status);
+    sx1280_rc_rx(priv);
+
+    /*
+     * Get the start and length of the received packet.
+     *
+     * The start should always be the same due to how the buffer is partitioned
+     * in setup, but length has to be fetched so it might as well use the
+     * offset provided.
+     */
+    u8 len = readout->buffer_status_rx[2];
+    u8 start = readout->buffer_status_rx[3];
+
+    netdev_dbg(netdev, "  start=0x%02x, len=%u\n", start, len);
+
+    if (!len) {
+      SX1280_STATS_INC(priv, rx_length_errors);
+      goto fail;
+    }
+
+    SX1280_STATS_ADD(priv, rx_airtime_ns, sx1280_time_on_air_ns(priv, len));
+
+    /* Allocate an SKB to hold the packet data and pass it to userspace. */
+    skb = dev_alloc_skb((unsigned int) len);
+    if (!skb) {
+      netdev_err(netdev, "failed to allocate SKB for RX packet\n");
+      err = -ENOMEM;
+      goto fail;
+    }
+
+    u8 *rx_data = skb_put(skb, (unsigned int) len);
+
+    /*
+     * Take as much as possible from the speculative read of the buffer start,
+     * then read whatever is left directly into the SKB.
+     */
+    u8 prefix = 0;
+    if (start == readout->read_buffer[1]) {
+      prefix = min_t(u8, len, SX1280_RX_READOUT_PREFIX_LEN);
+      memcpy(rx_data, readout->data, prefix);
+    }
+
+    if (prefix < len) {
+      struct sx1280_async_cmd *read = &priv->cmds->read_buffer;
+      read->tx[1] = (u8) (start + prefix);
+      read->xfers[1].rx_buf = rx_data + prefix;
+      read->xfers[1].len = len - prefix;
+
+      sx1280_async_reset(priv);
+      sx1280_async_add(priv, read);
+
+      if ((err = sx1280_async_run(priv))) {
+        goto fail;
+      }
+    }
+
+    netdev_dbg(netdev, "rx: %*ph\n", len, rx_data);
+
+    /* Acknowledge before anything else, as AutoTx may be counting down. */
+    u8 dispatch = rx_data[0];
+    sx1280_arq_respond(priv, rx_data, len);
+    sx1280_link_rx(priv, skb, 0);
+
+    /*
+     * A frame that isn't acknowledged ends its exchange as it arrives. Those
+     * that are end once the ACK is out, and ACKs end the sender's through the
+     * ARQ.
+     */
+    if (
+      dispatch != SX1280_DISPATCH_ACK
+      && dispatch != SX1280_DISPATCH_BEACON
+      && !priv->arq.acking
+      && priv->fhss.enabled
+      && !priv->fhss.dwell_us
+    ) {
+      sx1280_fhss_next(priv);
+      sx1280_fhss_relisten(priv);
+    }
+  } else if (mask & SX1280_IRQ_TX_DONE) {
+    /* AutoTx went off before it could be stopped, leaving the chip idle. */
+    sx1280_tx_airtime(priv, sx1280_time_on_air_ns(priv, SX1280_ARQ_ACK_LEN));
+
+    sx1280_listen(priv);
+  } else {
+    netdev_warn(netdev, "  unhandled rx irq\n");
+  }
+
+  return;
+
+fail:
+  if (err) {
+    netdev_err(netdev, "failed to read out rx packet: %d\n", err);
+  }
+
+  if (skb) {
+    dev_kfree_skb(skb);
+  }
+
+  /* Nothing is to be acknowledged, so stop AutoTx if it's counting down. */
+  if (priv->arq.auto_ack) {
+    sx1280_set_standby(priv, SX1280_STDBY_RC);
+  }
+
+  sx1280_listen(priv);
+}
+
+/**
+ * Bottom half for DIO interrupt requests, run on the worker.
+ *
+ * While listening, the whole readout is a single pre-built SPI message (see
+ * struct sx1280_rx_readout). Otherwise only the IRQ status is needed, which is
+ * fetched and cleared as one asynchronous sequence.
+ *
+ * @context process
+ */
+static void sx1280_irq_work(struct kthread_work *work) {
+  int err;
+  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, irq_work);
+  struct spi_device *spi = priv->spi;
+  u16 mask = 0;
+
+  mutex_lock(&priv->lock);
+
+  /*
+   * The SX1280 can give spurious interrupts during reset, and these should be
+   * ignored.
+   */
+  if (!priv->initialized) {
+    goto unlock;
+  }
+
+  if (priv->state == SX1280_STATE_RX) {
+    err = sx1280_rx_readout(priv, &mask);
+  } else {
+    /* Acknowledge all interrupts immediately. */
+    sx1280_async_reset(priv);
+    sx1280_async_add(priv, &priv->cmds->get_irq_status);
+    sx1280_async_add(priv, &priv->cmds->clear_irq_status);
+
+    err = sx1280_async_run(priv);
+    mask = priv->async.irq_mask;
+  }
+
+  if (err) {
+    dev_err(&spi->dev, "interrupt readout failed: %d\n", err);
+
+    /*
+     * Make sure the chip isn't left deaf by a failed RX readout, or the MAC
+     * stuck on a CAD whose result was lost.
+     */
+    if (priv->state == SX1280_STATE_RX) {
+      sx1280_listen(priv);
+    } else if (priv->state == SX1280_STATE_CAD) {
+      sx1280_irq_cad(priv, 0);
+    }
+
+    goto unlock;
+  }
+
+  dev_dbg(&spi->dev, "interrupt: mask=0x%04x\n", mask);
+
+  switch (priv->state) {
+  case SX1280_STATE_RX: sx1280_irq_rx(priv, mask); break;
+  case SX1280_STATE_TX: sx1280_irq_tx(priv, mask); break;
+  case SX1280_STATE_CAD: sx1280_irq_cad(priv, mask); break;
+  default:
+    dev_warn(&spi->dev, "  (unhandled)\n");
+  }
+
+unlock:
+  mutex_unlock(&priv->lock);
+}
+
+/**
+ * Interrupt handler for DIO interrupt requests, which hands off to the worker.
+ * @context atomic
+ */
+static irqreturn_t sx1280_irq(int irq, void *dev_id) {
+  struct sx1280_priv *priv = (struct sx1280_priv *) dev_id;
+
+  WRITE_ONCE(priv->irq_ns, ktime_get_ns());
+  kthread_queue_work(priv->worker, &priv->irq_work);
+  return IRQ_HANDLED;
+}
+
+/**
+ * Parses busy GPIO and DIO GPIOs.
+ * @param priv - The internal SX1280 driver structure.
+ * @param dt - Whether a device tree configuration or platform data is used.
+ */
+static int sx1280_setup_gpios(struct sx1280_priv *priv) {
+  int err;
+  struct device *dev = &priv->spi->dev;
+
+  /*
+   * 1. Configure the busy pin GPIO.
+   * 2. Configure the DIO1, DIO2, DIO3 GPIOs.
+   */
+
+  struct sx1280_platform_data *pdata = dev_get_platdata(dev);
+  priv->dio = NULL;
+
+  if (!pdata) {
+    /*
+     * If a device tree is used, then the GPIOs are directly registered with the
+     * SPI device and freed upon the SPI device being unregistered.
+     */
+
+    priv->busy = devm_gpiod_get(dev, "busy", GPIOD_IN);
+    if (IS_ERR(priv->busy)) {
+      dev_err(dev, "Failed to configure GPIO for busy pin.\n");
+      return PTR_ERR(priv->busy);
+    }
+
+    const char *dio_names[] = { "dio1", "dio2", "dio3" };
+    for (int i = 0; i < ARRAY_SIZE(dio_names); i++) {
+      struct gpio_desc *dio =
+        devm_gpiod_get_optional(dev, dio_names[i], GPIOD_IN);
+
+      if (IS_ERR(dio)) {
+        dev_err(dev, "Failed to configure GPIO for DIO%d.\n", i + 1);
+        return PTR_ERR(dio);
+      } else if (!dio) {
+        dev_dbg(dev, "Optional DIO%d not specified.\n", i + 1);
+        continue;
+      }
+
+      priv->dio_index = i + 1;
+      priv->dio = dio;
+      break;
+    }
+
+    priv->reset = devm_gpiod_get(dev, "reset", GPIOD_OUT_LOW);
+    if (IS_ERR(priv->reset)) {
+      dev_err(dev, "Failed to configure GPIO for the reset pin.\n");
+      return PTR_ERR(priv->reset);
+    }
+  } else {
+    /*
+     * If platform data is used, the GPIOs are passed as integers.
+     * This is not the preferred way for GPIOs to be specified in device trees
+     * anymore, so the conversion of GPIOs into descriptors must be done
+     * separately.
+     */
+
+    err = -EINVAL;
+
+    priv->busy = gpio_to_desc(pdata->busy_gpio);
+    if (!priv->busy || (err = gpiod_direction_input(priv->busy))) {
+      dev_err(dev, "Failed to configure GPIO for busy pin.\n");
+      return err;
+    }
+
+    for (int i = 0; i < 3; i++) {
+      int gpio_num = pdata->dio_gpios[i];
+      if (gpio_num < 0) {
+        continue;
+      }
+
+      struct gpio_desc *dio = gpio_to_desc((unsigned int) gpio_num);
+
+      if (!dio || (err = gpiod_direction_input(dio))) {
+        dev_err(dev, "Failed to configure GPIO for DIO%d.\n", i);
+        return err;
+      }
+
+      priv->dio_index = i + 1;
+      priv->dio = dio;
+      break;
+    }
+
+    priv->reset = gpio_to_desc(pdata->reset_gpio);
+    if (!priv->reset || (err = gpiod_direction_output(priv->reset, 1))) {
+      dev_err(dev, "Failed to configure GPIO for reset.\n");
+      return err;
+    }
+  }
+
+  /* Check that at least one DIO was set. */
+  if (!priv->dio) {
+    dev_err(dev, "no DIOs are set in the configuration\n");
+    return -EINVAL;
+  }
+
+  priv->irq = gpiod_to_irq(priv->dio);
+  if ((err = priv->irq) < 0) {
+    dev_err(dev, "failed to register IRQ for DIO\n");
+    return err;
+  }
+
+  /*
+   * Register the DIO IRQs to their interrupt handlers.
+   * TODO: Change this to split interrupts across all DIOs.
+   */
+  err = devm_request_any_context_irq(
+    dev,
+    priv->irq,
+    sx1280_irq,
+    IRQF_TRIGGER_RISING,
+    "sx1280_irq",
+    priv
+  );
+
+  if (err < 0) {
+    dev_err(dev, "Failed to set IRQ handler.\n");
+    return err;
+  }
+
+  /*
+   * Optionally interrupt on the falling edge of BUSY. If the GPIO can't
+   * interrupt, BUSY waits fall back to polling.
+   */
+  priv->busy_irq = gpiod_to_irq(priv->busy);
+  if (priv->busy_irq >= 0) {
+    err = devm_request_any_context_irq(
+      dev,
+      priv->busy_irq,
+      sx1280_busy_irq,
+      IRQF_TRIGGER_FALLING | IRQF_NO_AUTOEN,
+      "sx1280_busy",
+      priv
+    );
+
+    if (err < 0) {
+      dev_dbg(dev, "BUSY interrupt unavailable (%d), polling instead\n", err);
+      priv->busy_irq = err;
+    }
+  }
+
+  /*
+   * Commands can only be chained from SPI completion callbacks if BUSY can be
+   * read there, which rules out GPIOs behind a slow bus (e.g. I2C expanders).
+   */
+  priv->async_capable = !gpiod_cansleep(priv->busy);
+
+  return 0;
+}
+
+/**
+ * Performs a hardware reset by toggling the NRESET pin and waiting for BUSY.
+ * @param priv - The internal SX1280 driver structure.
+ */
+static int sx1280_reset(struct sx1280_priv *priv) {
+  int err;
+
+  netdev_dbg(priv->netdev, "resetting hardware\n");
+
+  /* The chip comes back up with its default configuration. */
+  sx1280_shadow_invalidate(priv);
+
+  /* Toggle NRESET. */
+  gpiod_set_value_cansleep(priv->reset, 1);
+  usleep_range(500, 1000);
+  gpiod_set_value_cansleep(priv->reset, 0);
+
+#ifdef DEBUG
+  ktime_t start = ktime_get();
+#endif
+
+  /* Wait for BUSY = 0. */
+  if ((err = sx1280_wait_busy(priv))) {
+    netdev_err(priv->netdev, "failed to reset, timeout exceeded\n");
+    return err;
+  }
+
+#ifdef DEBUG
+  ktime_t end = ktime_get();
+  s64 reset_time = ktime_to_us(ktime_sub(end, start));
+  netdev_dbg(priv->netdev, "reset completed in %lld us\n", reset_time);
+#endif
+
+  return 0;
+}
+
+/**
+ * Checks that registers can be written and read back intact at the current SPI
+ * clock, using the sync word registers as scratch space. They are rewritten
+ * with the real configuration during setup.
+ *
+ * @context - process & pre-lock
+ * @param priv - The internal SX1280 driver structure.
+ */
+static int sx1280_test_spi(struct sx1280_priv *priv) {
+  int err;
+  u8 pattern[SX1280_SPI_TEST_LEN];
+  u8 readback[SX1280_SPI_TEST_LEN];
+
+  for (int round = 0; round < SX1280_SPI_TEST_ROUNDS; round++) {
+    /* Alternate bit patterns, with each round differing from the last. */
+    for (int i = 0; i < SX1280_SPI_TEST_LEN; i++) {
+      pattern[i] = ((i + round) & 1 ? 0xA5 : 0x5A) ^ (u8) (i * 17 + round);
+    }
+
+    /* The shadow would otherwise elide writes that repeat an earlier round. */
+    sx1280_shadow_invalidate(priv);
+
+    if (
+      (err = sx1280_write_register(
+        priv,
+        SX1280_REG_SYNC_ADDRESS_1_BYTE_4,
+        pattern,
+        sizeof(pattern)
+      ))
+      || (err = sx1280_read_register(
+        priv,
+        SX1280_REG_SYNC_ADDRESS_1_BYTE_4,
+        readback,
+        sizeof(readback)
+      ))
+    ) {
+      return err;
+    }
+
+    if (memcmp(pattern, readback, sizeof(pattern))) {
+      return -EIO;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Settles on the fastest working SPI clock, starting from the one given by the
+ * device tree (spi-max-frequency) and capped at the datasheet maximum. The
+ * requested clock is always tried, and then halved down to the minimum until
+ * the self test passes. The chip is reset before each retry, as a garbled
+ * stream may have run any command.
+ *
+ * @context - process & pre-lock
+ * @param priv - The internal SX1280 driver structure.
+ */
+static int sx1280_setup_spi_speed(struct sx1280_priv *priv) {
+  int err;
+  struct spi_device *spi = priv->spi;
+  u32 requested = spi->max_speed_hz;
+
+  if (!requested || requested > SX1280_SPI_SPEED_MAX_HZ) {
+    requested = SX1280_SPI_SPEED_MAX_HZ;
+  }
+
+  if ((err = sx1280_reset(priv))) {
+    return err;
+  }
+
+  for (u32 hz = requested;;) {
+    spi->max_speed_hz = hz;
+
+    if ((err = spi_setup(spi))) {
+      return err;
+    }
+
+    if (!(err = sx1280_test_spi(priv))) {
+      if (hz == requested) {
+        dev_info(&spi->dev, "SPI clock at %u Hz\n", hz);
+      } else {
+        dev_info(
+          &spi->dev,
+          "SPI clock at %u Hz (self test failed at %u Hz)\n",
+          hz,
+          requested
+        );
+      }
+
+      return 0;
+    }
+
+    dev_warn(&spi->dev, "SPI self test failed at %u Hz: %d\n", hz, err);
+
+    if (hz <= SX1280_SPI_SPEED_MIN_HZ) {
+      break;
+    }
+
+    hz = max_t(u32, hz / 2, SX1280_SPI_SPEED_MIN_HZ);
+
+    if ((err = sx1280_reset(priv))) {
+      return err;
+    }
+  }
+
+  dev_err(&spi->dev, "SPI self test failed at every clock\n");
+  return -EIO;
+}
+
+/**
+ * Calibrates how long BUSY waits spin before sleeping, by timing how long BUSY
+ * stays high after a cheap configuration command. The spin covers twice the
+ * longest time observed, so that typical commands never pay for a sleep.
+ *
+ * @context - process & pre-lock
+ * @param priv - The internal SX1280 driver structure.
+ */
+static int sx1280_calibrate_busy(struct sx1280_priv *priv) {
+  int err;
+  s64 longest = 0;
+
+  for (int i = 0; i < SX1280_BUSY_CALIBRATION_ROUNDS; i++) {
+    u8 tx[] = { SX1280_CMD_SET_BUFFER_BASE_ADDRESS, 0x00, 0x00 };
+
+    /*
+     * Start from idle, as the last round may have given up before BUSY fell,
+     * and time from the start of the transfer, which BUSY waits also cover.
+     */
+    if ((err = sx1280_wait_busy(priv))) {
+      return err;
+    }
+
+    ktime_t start = ktime_get();
+    s64 wait = 0;
+
+    if ((err = spi_write(priv->spi, tx, ARRAY_SIZE(tx)))) {
+      return err;
+    }
+
+    while (
+      gpiod_get_value_cansleep(priv->busy)
+      && wait < SX1280_BUSY_SPIN_MAX_US
+    ) {
+      cpu_relax();
+      wait = ktime_us_delta(ktime_get(), start);
+    }
+
+    wait = ktime_us_delta(ktime_get(), start);
+    longest = max(longest, wait);
+  }
+
+  priv->busy_spin_us = clamp_t(
+    unsigned int,
+    2 * longest,
+    SX1280_BUSY_SPIN_MIN_US,
+    SX1280_BUSY_SPIN_MAX_US
+  );
+
+  dev_dbg(
+    &priv->spi->dev,
+    "busy spin calibrated to %u us (longest wait %lld us)\n",
+    priv->busy_spin_us,
+    longest
+  );
+
+  /* Leave BUSY low for the next command. */
+  return sx1280_wait_busy(priv);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+static void sx1280_unoptimize_message(void *msg) {
+  spi_unoptimize_message((struct spi_message *) msg);
+}
+#endif
+
+/**
+ * Lets the SPI controller do its per-message setup (validation, DMA mapping
+ * decisions, etc.) once, rather than on every use of the message.
+ *
+ * Only messages whose transfers never change may be optimized. Failure just
+ * leaves the message to be set up on every use as usual.
+ *
+ * @context - process & pre-lock
+ */
+static void sx1280_optimize_message(
+  struct sx1280_priv *priv,
+  struct spi_message *msg
+) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+  struct device *dev = &priv->spi->dev;
+  int err;
+
+  if ((err = spi_optimize_message(priv->spi, msg))) {
+    dev_dbg(dev, "failed to optimize SPI message: %d\n", err);
+    return;
+  }
+
+  devm_add_action_or_reset(dev, sx1280_unoptimize_message, msg);
+#endif
+}
+
+/**
+ * Builds a pre-built command with the given opcode and header length. If
+ * `data` is set, a second transfer is added for the payload, which is filled
+ * in on each use.
+ */
+static void sx1280_init_cmd(
+  struct sx1280_async_cmd *cmd,
+  u8 opcode,
+  size_t hdr_len,
+  bool data,
+  sx1280_async_hook_t done
+) {
+  cmd->tx[0] = opcode;
+  cmd->done = done;
+
+  cmd->xfers[0].tx_buf = cmd->tx;
+  cmd->xfers[0].rx_buf = cmd->rx;
+  cmd->xfers[0].len = hdr_len;
+
+  spi_message_init_with_transfers(&cmd->msg, cmd->xfers, data ? 2 : 1);
+}
+
+/**
+ * Allocates and builds the hot-path commands.
+ * @context - process & pre-lock
+ * @param priv - The internal SX1280 driver structure.
+ */
+static int sx1280_setup_cmds(struct sx1280_priv *priv) {
+  struct sx1280_cmds *cmds = devm_kzalloc(
+    &priv->spi->dev,
+    sizeof(*cmds),
+    GFP_KERNEL
+  );
+
+  if (!cmds) {
+    return -ENOMEM;
+  }
+
+  sx1280_init_cmd(
+    &cmds->set_packet_params,
+    SX1280_CMD_SET_PACKET_PARAMS,
+    8,
+    false,
+    NULL
+  );
+
+  /* Packets are always written from and read from the base addresses. */
+  sx1280_init_cmd(&cmds->write_buffer, SX1280_CMD_WRITE_BUFFER, 2, true, NULL);
+  sx1280_init_cmd(&cmds->read_buffer, SX1280_CMD_READ_BUFFER, 3, true, NULL);
+
+  sx1280_init_cmd(&cmds->set_tx, SX1280_CMD_SET_TX, 4, false, NULL);
+  sx1280_init_cmd(&cmds->set_rx, SX1280_CMD_SET_RX, 4, false, NULL);
+
+  /* Continuous RX, as there is no RX timeout. */
+  cmds->set_rx.tx[2] = 0xFF;
+  cmds->set_rx.tx[3] = 0xFF;
+
+  sx1280_init_cmd(&cmds->set_auto_tx, SX1280_CMD_SET_AUTO_TX, 3, false, NULL);
+
+  sx1280_init_cmd(
+    &cmds->set_rf_frequency,
+    SX1280_CMD_SET_RF_FREQUENCY,
+    4,
+    false,
+    NULL
+  );
+
+  sx1280_init_cmd(
+    &cmds->get_irq_status,
+    SX1280_CMD_GET_IRQ_STATUS,
+    4,
+    false,
+    sx1280_irq_status_done
+  );
+
+  sx1280_init_cmd(
+    &cmds->clear_irq_status,
+    SX1280_CMD_CLR_IRQ_STATUS,
+    3,
+    false,
+    NULL
+  );
+
+  cmds->clear_irq_status.tx[1] = 0xFF;
+  cmds->clear_irq_status.tx[2] = 0xFF;
+
+  sx1280_optimize_message(priv, &cmds->set_packet_params.msg);
+  sx1280_optimize_message(priv, &cmds->set_tx.msg);
+  sx1280_optimize_message(priv, &cmds->set_rx.msg);
+  sx1280_optimize_message(priv, &cmds->set_auto_tx.msg);
+  sx1280_optimize_message(priv, &cmds->set_rf_frequency.msg);
+  sx1280_optimize_message(priv, &cmds->get_irq_status.msg);
+  sx1280_optimize_message(priv, &cmds->clear_irq_status.msg);
+
+  priv->cmds = cmds;
+  return 0;
+}
+
+/**
+ * Allocates and builds the single-message RX readout.
+ *
+ * Each command ends by releasing chip select, and the next one isn't clocked
+ * out until BUSY will have dropped. This uses the calibrated BUSY time, so it
+ * must be built after setup.
+ *
+ * @context - process & pre-lock
+ * @param priv - The internal SX1280 driver structure.
+ */
+static int sx1280_setup_rx_readout(struct sx1280_priv *priv) {
+  struct sx1280_rx_readout *readout = devm_kzalloc(
+    &priv->spi->dev,
+    sizeof(*readout),
+    GFP_KERNEL
+  );
+
+  if (!readout) {
+    return -ENOMEM;
+  }
+
+  readout->irq_status_tx[0] = SX1280_CMD_GET_IRQ_STATUS;
+  readout->clear_irq[0] = SX1280_CMD_CLR_IRQ_STATUS;
+  readout->clear_irq[1] = 0xFF;
+  readout->clear_irq[2] = 0xFF;
+  readout->packet_status_tx[0] = SX1280_CMD_GET_PACKET_STATUS;
+  readout->buffer_status_tx[0] = SX1280_CMD_GET_RX_BUFFER_STATUS;
+
+  /* The RX buffer starts at offset 0x00, as set in setup. */
+  readout->read_buffer[0] = SX1280_CMD_READ_BUFFER;
+  readout->read_buffer[1] = 0x00;
+
+  struct spi_transfer *xfers = readout->xfers;
+
+  xfers[SX1280_RX_READOUT_IRQ_STATUS].tx_buf = readout->irq_status_tx;
+  xfers[SX1280_RX_READOUT_IRQ_STATUS].rx_buf = readout->irq_status_rx;
+  xfers[SX1280_RX_READOUT_IRQ_STATUS].len = sizeof(readout->irq_status_tx);
+
+  xfers[SX1280_RX_READOUT_CLEAR_IRQ].tx_buf = readout->clear_irq;
+  xfers[SX1280_RX_READOUT_CLEAR_IRQ].len = sizeof(readout->clear_irq);
+
+  xfers[SX1280_RX_READOUT_PACKET_STATUS].tx_buf = readout->packet_status_tx;
+  xfers[SX1280_RX_READOUT_PACKET_STATUS].rx_buf = readout->packet_status_rx;
+  xfers[SX1280_RX_READOUT_PACKET_STATUS].len =
+    sizeof(readout->packet_status_tx);
+
+  xfers[SX1280_RX_READOUT_BUFFER_STATUS].tx_buf = readout->buffer_status_tx;
+  xfers[SX1280_RX_READOUT_BUFFER_STATUS].rx_buf = readout->buffer_status_rx;
+  xfers[SX1280_RX_READOUT_BUFFER_STATUS].len =
+    sizeof(readout->buffer_status_tx);
+
+  xfers[SX1280_RX_READOUT_READ_BUFFER].tx_buf = readout->read_buffer;
+  xfers[SX1280_RX_READOUT_READ_BUFFER].len = sizeof(readout->read_buffer);
+
+  xfers[SX1280_RX_READOUT_DATA].rx_buf = readout->data;
+  xfers[SX1280_RX_READOUT_DATA].len = sizeof(readout->data);
+
+  /* Separate the commands, other than the ReadBuffer header and its data. */
+  unsigned int gap_us = max_t(
+    unsigned int,
+    SX1280_RX_READOUT_GAP_MIN_US,
+    priv->busy_spin_us
+  );
+
+  for (int i = 0; i < SX1280_RX_READOUT_READ_BUFFER; i++) {
+    xfers[i].cs_change = 1;
+    xfers[i].cs_change_delay.value = gap_us;
+    xfers[i].cs_change_delay.unit = SPI_DELAY_UNIT_USECS;
+  }
+
+  spi_message_init_with_transfers(
+    &readout->msg,
+    xfers,
+    SX1280_RX_READOUT_XFERS
+  );
+
+  sx1280_optimize_message(priv, &readout->msg);
+
+  priv->rx_readout = readout;
+  return 0;
+}
+
+/**
+ * Allocates the link layer's buffers, picks this node's identity, and sets up
+ * aggregation and ARQ.
+ * @context - process & pre-lock
+ * @param priv - The internal SX1280 driver structure.
+ */
+static int sx1280_setup_link(struct sx1280_priv *priv) {
+  struct sx1280_link *link = &priv->link;
+
+  link->frame = devm_kzalloc(
+    &priv->spi->dev,
+    SX1280_GFSK_PAYLOAD_LENGTH_MAX,
+    GFP_KERNEL
+  );
+
+  link->encoded = devm_kzalloc(
+    &priv->spi->dev,
+    SX1280_LINK_PAYLOAD_MAX,
+    GFP_KERNEL
+  );
+
+  link->lz4_out = devm_kzalloc(
+    &priv->spi->dev,
+    SX1280_LINK_PAYLOAD_MAX,
+    GFP_KERNEL
+  );
+
+  link->lz4_wrkmem = devm_kzalloc(
+    &priv->spi->dev,
+    LZ4_MEM_COMPRESS,
+    GFP_KERNEL
+  );
+
+  priv->arq.ack = devm_kzalloc(
+    &priv->spi->dev,
+    SX1280_ARQ_ACK_BUF_LEN,
+    GFP_KERNEL
+  );
+
+  if (
+    !link->frame
+    || !link->encoded
+    || !link->lz4_out
+    || !link->lz4_wrkmem
+    || !priv->arq.ack
+  ) {
+    return -ENOMEM;
+  }
+
+  /*
+   * Fragments are told apart by node and tag, so both start out random to
+   * avoid colliding with other nodes and with datagrams from before a reload.
+   */
+  link->node_id = get_random_u8() % SX1280_NODE_BROADCAST;
+  link->tag = get_random_u8();
+  link->reasm_timeout_ms = SX1280_REASM_TIMEOUT_MS_DEFAULT;
+  priv->airtime_query_len = SX1280_LINK_MTU_DEFAULT;
+  link->iphc_enabled = true;
+
+  /*
+   * Aggregate whatever is already queued by default, without holding frames
+   * back for more packets to arrive.
+   */
+  link->agg_enabled = true;
+  link->agg_delay_us = 0;
+
+  /* ARQ is off by default, as every node on the channel has to agree. */
+  struct sx1280_arq *arq = &priv->arq;
+  arq->enabled = false;
+  arq->dst = SX1280_NODE_BROADCAST;
+  arq->retries_max = SX1280_ARQ_RETRIES_DEFAULT;
+  arq->ack_delay_us = SX1280_ARQ_ACK_DELAY_US_DEFAULT;
+  arq->ack_timeout_ms = SX1280_ARQ_ACK_TIMEOUT_MS_DEFAULT;
+  arq->seq = get_random_u8();
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+  hrtimer_setup(
+    &link->agg_timer,
+    sx1280_agg_timer,
+    CLOCK_MONOTONIC,
+    HRTIMER_MODE_REL
+  );
+
+  hrtimer_setup(
+    &arq->timer,
+    sx1280_arq_timer,
+    CLOCK_MONOTONIC,
+    HRTIMER_MODE_REL
+  );
+#else
+  hrtimer_init(&link->agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  link->agg_timer.function = sx1280_agg_timer;
+
+  hrtimer_init(&arq->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  arq->timer.function = sx1280_arq_timer;
+#endif
+
+  return 0;
+}
+
+/**
+ * Sets up CSMA/CA, TDMA, the duty cycle limiter and frequency hopping, all of
+ * which are off by default, and the spectrum survey. The airtime queue limit
+ * is fitted to the initial settings.
+ * @context - process & pre-lock
+ * @param priv - The internal SX1280 driver structure.
+ */
+static int sx1280_setup_mac(struct sx1280_priv *priv) {
+  struct sx1280_mac *mac = &priv->mac;
+
+  mac->enabled = false;
+  mac->cad = true;
+  mac->cca_threshold_dbm = SX1280_MAC_CCA_THRESHOLD_DBM_DEFAULT;
+  mac->slot_us = SX1280_MAC_SLOT_US_DEFAULT;
+  mac->min_be = SX1280_MAC_MIN_BE_DEFAULT;
+  mac->max_be = SX1280_MAC_MAX_BE_DEFAULT;
+  mac->max_backoffs = SX1280_MAC_MAX_BACKOFFS_DEFAULT;
+
+  /* TDMA is off by default too, and listens in every slot when enabled. */
+  struct sx1280_tdma *tdma = &priv->tdma;
+  tdma->beacon = devm_kzalloc(
+    &priv->spi->dev,
+    SX1280_TDMA_BEACON_BUF_LEN,
+    GFP_KERNEL
+  );
+
+  if (!tdma->beacon) {
+    return -ENOMEM;
+  }
+
+  tdma->enabled = false;
+  tdma->coordinator = false;
+  tdma->superframe_us = SX1280_TDMA_SUPERFRAME_US_DEFAULT;
+  tdma->slot_us = SX1280_TDMA_SLOT_US_DEFAULT;
+  tdma->guard_us = SX1280_TDMA_GUARD_US_DEFAULT;
+  tdma->tx_slots = 0;
+  tdma->rx_slots = U32_MAX;
+  tdma->seq = get_random_u8();
+
+  struct sx1280_duty *duty = &priv->duty;
+  duty->millipercent = SX1280_DUTY_MILLIPERCENT_MAX;
+  duty->window_s = SX1280_DUTY_WINDOW_S_DEFAULT;
+  sx1280_duty_reset(duty);
+
+  struct sx1280_fhss *fhss = &priv->fhss;
+  fhss->start_ns = ktime_get_ns();
+
+  struct sx1280_adr *adr = &priv->adr;
+  adr->margin_db = SX1280_ADR_MARGIN_DB_DEFAULT;
+
+  struct sx1280_survey *survey = &priv->survey;
+  survey->start_hz = SX1280_SURVEY_FREQ_HZ_MIN;
+  survey->stop_hz = SX1280_SURVEY_FREQ_HZ_MAX;
+  survey->step_hz = SX1280_SURVEY_STEP_HZ_DEFAULT;
+  survey->samples = SX1280_SURVEY_SAMPLES_DEFAULT;
+  survey->settle_us = SX1280_SURVEY_SETTLE_US_DEFAULT;
+
+  struct sx1280_acs *acs = &priv->acs;
+  acs->interval_s = SX1280_ACS_INTERVAL_S_DEFAULT;
+  acs->per_percent = SX1280_ACS_PER_PERCENT_DEFAULT;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+  hrtimer_setup(
+    &mac->timer,
+    sx1280_mac_timer,
+    CLOCK_MONOTONIC,
+    HRTIMER_MODE_REL
+  );
+  hrtimer_setup(
+    &tdma->timer,
+    sx1280_tdma_timer,
+    CLOCK_MONOTONIC,
+    HRTIMER_MODE_ABS
+  );
+  hrtimer_setup(
+    &duty->timer,
+    sx1280_duty_timer,
+    CLOCK_MONOTONIC,
+    HRTIMER_MODE_REL
+  );
+  hrtimer_setup(
+    &fhss->timer,
+    sx1280_fhss_timer,
+    CLOCK_MONOTONIC,
+    HRTIMER_MODE_ABS
+  );
+  hrtimer_setup(
+    &acs->timer,
+    sx1280_acs_timer,
+    CLOCK_MONOTONIC,
+    HRTIMER_MODE_REL
+  );
+  hrtimer_setup(
+    &adr->timer,
+    sx1280_adr_timer,
+    CLOCK_MONOTONIC,
+    HRTIMER_MODE_REL
+  );
+  hrtimer_setup(
+    &priv->rc.timer,
+    sx1280_rc_timer,
+    CLOCK_MONOTONIC,
+    HRTIMER_MODE_REL
+  );
+  hrtimer_setup(
+    &priv->rc.turnaround_timer,
+    sx1280_rc_turnaround_timer,
+    CLOCK_MONOTONIC,
+    HRTIMER_MODE_REL
+  );
+#else
+  hrtimer_init(&mac->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  mac->timer.function = sx1280_mac_timer;
+
+  hrtimer_init(&tdma->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+  tdma->timer.function = sx1280_tdma_timer;
+
+  hrtimer_init(&duty->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  duty->timer.function = sx1280_duty_timer;
+
+  hrtimer_init(&fhss->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+  fhss->timer.function = sx1280_fhss_timer;
+
+  hrtimer_init(&acs->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  acs->timer.function = sx1280_acs_timer;
+
+  hrtimer_init(&adr->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  adr->timer.function = sx1280_adr_timer;
+
+  hrtimer_init(&priv->rc.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  priv->rc.timer.function = sx1280_rc_timer;
+
+  hrtimer_init(&priv->rc.turnaround_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+  priv->rc.turnaround_timer.function = sx1280_rc_turnaround_timer;
+#endif
+
+  sx1280_aql_update(priv);
+  return 0;
+}
+
+/**
+ * Performs the chip setup.
+ * @context - process & pre-lock
+ * @param priv - The internal SX1280 driver structure.
+ */
+static int sx1280_setup(struct sx1280_priv *priv) {
+  struct spi_device *spi = priv->spi;
+  struct sx1280_config *cfg = &priv->cfg;
+  int err;
+
+  dev_dbg(&spi->dev, "starting setup\n");
+
+  /* Reset the chip and check its status after reset. */
+  u8 status;
+  if (
+    (err = sx1280_reset(priv))
+    || (err = sx1280_set_standby(priv, SX1280_STDBY_RC))
+    || (err = sx1280_get_status(priv, &status))
+  ) {
+    return err;
+  }
+
+  dev_dbg(&spi->dev, "status: 0x%02x\n", status);
+  priv->state = SX1280_STATE_STANDBY;
+
+  /* Extract circuit mode and command status and check for valid values. */
+  u8 circuit_mode = FIELD_GET(SX1280_STATUS_CIRCUIT_MODE_MASK, status);
+  u8 command_status = FIELD_GET(SX1280_STATUS_COMMAND_STATUS_MASK, status);
+
+  if (circuit_mode != SX1280_CIRCUIT_MODE_STDBY_RC) {
+    dev_err(&spi->dev, "unexpected circuit mode: 0x%02x.\n", circuit_mode);
+    return -EIO;
+  } else if (
+    command_status == SX1280_COMMAND_STATUS_TIMEOUT
+    || command_status == SX1280_COMMAND_STATUS_PROCESSING_ERROR
+    || command_status == SX1280_COMMAND_STATUS_EXEC_FAILURE
+  ) {
+    dev_err(&spi->dev, "unexpected command status: 0x%02x\n", command_status);
+    return -EIO;
+  }
+
+  if ((err = sx1280_calibrate_busy(priv))) {
+    dev_err(&spi->dev, "busy calibration failed: %d\n", err);
+    return err;
+  }
+
+  /*
+   * Extract the modulation and packet params from the platform data, depending
+   * on the mode that the chip is being commanded into.
+   */
+  struct sx1280_modulation_params mod_params = {
+    .mode = SX1280_MODE_GFSK,
+    .gfsk = cfg->gfsk.modulation,
+  };
+
+  if (
+    (err = sx1280_set_packet_type(priv, SX1280_MODE_GFSK))
+    || (err = sx1280_set_rf_frequency(priv, cfg->freq))
+
+    /*
+     * Set the Tx and Rx buffer base addresses to 0x0.
+     * This allows the chip to use the full 256-byte data buffer.
+     * The size of the data buffer also restricts the MTU to 256 bytes.
+     *
+     * Since the chip supports half-duplex, the data must be sent/read before
+     * performing another operation, but otherwise will not be overwritten.
+     */
+    || (err = sx1280_set_buffer_base_address(priv, 0x0, 0x0))
+    || (err = sx1280_set_modulation_params(priv, mod_params))
+    || (
+      err = sx1280_write_register(
+        priv,
+        SX1280_REG_SYNC_ADDRESS_1_BYTE_4,
+        (u8 *) cfg->sync_words,
+        15
+      )
+    ) || (
+      err = sx1280_write_register(
+        priv,
+        SX1280_REG_CRC_POLYNOMIAL_DEFINITION_MSB,
+        cfg->gfsk.crc_polynomial,
+        2
+      )
+    ) || (
+      err = sx1280_write_register(
+        priv,
+        SX1280_REG_CRC_MSB_INITIAL_VALUE,
+        cfg->crc_seed,
+        2
+      )
+    ) || (err = sx1280_set_tx_params(priv, cfg->power, cfg->ramp_time))
+    || (err = sx1280_set_auto_fs(priv, true))
+  ) {
+    dev_err(&spi->dev, "setup failed: %d\n", err);
+    return err;
+  }
+
+  return 0;
+}
+
+/**
+ * Sums the per-CPU statistics of the interface.
+ * @context any
+ */
+static void sx1280_get_stats64(
+  struct net_device *netdev,
+  struct rtnl_link_stats64 *stats
+) {
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  int cpu;
+
+  for_each_possible_cpu(cpu) {
+    const struct sx1280_pcpu_stats *pcpu = per_cpu_ptr(priv->stats, cpu);
+    u64 rx_packets, rx_bytes, rx_errors, rx_length_errors, rx_dropped;
+    u64 tx_packets, tx_bytes, tx_dropped;
+    unsigned int start;
+
+    do {
+      start = u64_stats_fetch_begin(&pcpu->syncp);
+      rx_packets = u64_stats_read(&pcpu->rx_packets);
+      rx_bytes = u64_stats_read(&pcpu->rx_bytes);
+      rx_errors = u64_stats_read(&pcpu->rx_errors);
+      rx_length_errors = u64_stats_read(&pcpu->rx_length_errors);
+      rx_dropped = u64_stats_read(&pcpu->rx_dropped);
+      tx_packets = u64_stats_read(&pcpu->tx_packets);
+      tx_bytes = u64_stats_read(&pcpu->tx_bytes);
+      tx_dropped = u64_stats_read(&pcpu->tx_dropped);
+    } while (u64_stats_fetch_retry(&pcpu->syncp, start));
+
+    stats->rx_packets += rx_packets;
+    stats->rx_bytes += rx_bytes;
+    stats->rx_errors += rx_errors + rx_length_errors;
+    stats->rx_length_errors += rx_length_errors;
+    stats->rx_dropped += rx_dropped;
+    stats->tx_packets += tx_packets;
+    stats->tx_bytes += tx_bytes;
+    stats->tx_dropped += tx_dropped;
+  }
+}
+
+static const struct net_device_ops sx1280_netdev_ops = {
+  .ndo_open = sx1280_open,
+  .ndo_start_xmit = sx1280_xmit,
+  .ndo_stop = sx1280_stop,
+  .ndo_get_stats64 = sx1280_get_stats64,
+};
+
+/**
+ * Acquires the shared lock by waiting until idle, which is when the chip is not
+ * actively transmitting, so that configuration can be changed.
+ *
+ * NOTE: This function acquires the lock but does not release it unless it fails
+ * and returns an error code. The shared lock must be released by the caller.
+ * Upon failure, the lock is _never_ held, even if it was previously held by the
+ * caller.
+ *
+ * @context - process & (locked | unlocked)
+ */
+static int sx1280_acquire_idle(struct sx1280_priv *priv, bool locked) {
+  int err;
+
+  if (!locked && mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  while (priv->state == SX1280_STATE_TX || priv->state == SX1280_STATE_CAD) {
+    mutex_unlock(&priv->lock);
+
+    if (
+      (err = wait_event_interruptible(
+        priv->idle_wait,
+        priv->state != SX1280_STATE_TX && priv->state != SX1280_STATE_CAD
+      ))
+    ) {
+      return err;
+    }
+
+    if (mutex_lock_interruptible(&priv->lock)) {
+      return -ERESTARTSYS;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Acquires the shared lock no matter the mode, but additionally waits for idle
+ * if the mode is the one specified.
+ *
+ * Note that the mode must still be checked after this function exits, as the
+ * mode may have changed since released and re-acquiring the mutex while waiting
+ * for idle.
+ */
+static int sx1280_acquire_idle_if_mode(
+  struct sx1280_priv *priv,
+  enum sx1280_mode mode,
+  bool locked
+) {
+  int err;
+
+  /* The mutex must be locked before accessing priv->cfg.mode. */
+  if (!locked && mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  if (priv->cfg.mode == mode && (err = sx1280_acquire_idle(priv, true))) {
+    return err;
+  }
+
+  return 0;
+}
+
+/**
+ * Acquires the shared lock by waiting until idle before switching into standby
+ * mode, so that the chip configuration can be changed. The wait times out after
+ * 1 second.
+ *
+ * NOTE: This function acquires the lock but does not release it unless it fails
+ * and returns an error code. The shared lock must be released by the caller.
+ *
+ * @context - process & unlocked
+ */
+static int sx1280_acquire_stdby(struct sx1280_priv *priv, bool locked) {
+  int err;
+
+  if ((err = sx1280_acquire_idle(priv, locked))) {
+    return err;
+  }
+
+  if ((err = sx1280_set_standby(priv, SX1280_STDBY_XOSC))) {
+    mutex_unlock(&priv->lock);
+    return err;
+  }
+
+  return 0;
+}
+
+/*********/
+/* sysfs */
+/*********/
+
+static ssize_t mode_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_mode mode = priv->cfg.mode;
+  mutex_unlock(&priv->lock);
+
+  const char *mode_str;
+  switch (mode) {
+  case SX1280_MODE_FLRC:    mode_str = "flrc"; break;
+  case SX1280_MODE_GFSK:    mode_str = "gfsk"; break;
+  case SX1280_MODE_LORA:    mode_str = "lora"; break;
+  case SX1280_MODE_RANGING: mode_str = "ranging"; break;
+  default:
+    WARN(1, "invalid internal cfg.mode: %d\n", mode);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%s\n", mode_str);
+}
+
+static ssize_t mode_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  enum sx1280_mode new_mode;
+  if (sysfs_streq(buf, "flrc")) {
+    new_mode = SX1280_MODE_FLRC;
+  } else if (sysfs_streq(buf, "gfsk")) {
+    new_mode = SX1280_MODE_GFSK;
+  } else if (sysfs_streq(buf, "lora")) {
+    new_mode = SX1280_MODE_LORA;
+  } else if (sysfs_streq(buf, "ranging")) {
+    new_mode = SX1280_MODE_RANGING;
+  } else {
+    return -EINVAL;
+  }
+
+  if (
+    (err = sx1280_acquire_stdby(priv, false))
+    || (err = sx1280_set_packet_type(priv, new_mode))
+  ) {
+    goto fail;
+  }
+
+  priv->cfg.mode = new_mode;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t tx_power_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  int power_dbm = (int) priv->cfg.power - 18;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%d\n", power_dbm);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t tx_power_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  int power_dbm;
+  if ((err = kstrtoint(buf, 10, &power_dbm))) {
+    return err;
+  }
+
+  if (power_dbm < -18 || power_dbm > 13) {
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle(priv, false))) {
+    return err;
+  }
+
+  priv->cfg.power = (u32) (power_dbm + 18);
+  mutex_unlock(&priv->lock);
+  return count;
+}
+
+/**
+ * @context - process
+ */
+static ssize_t busy_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  int value = gpiod_get_value_cansleep(priv->busy);
+  if (value < 0) {
+    return value;
+  }
+
+  return sprintf(buf, "%d\n", value);
+}
+
+static ssize_t crc_seed_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  u8 crc_seed[2];
+  memcpy(crc_seed, priv->cfg.crc_seed, sizeof(crc_seed));
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%*phN\n", (int) sizeof(crc_seed), crc_seed);
+}
+
+static ssize_t crc_seed_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (count != 5 && count != 4) {
+    return -EINVAL;
+  }
+
+  u8 crc_seed[2];
+  if ((err = hex2bin(crc_seed, buf, 2))) {
+    return err;
+  }
+
+  /* Effectively an acquire_idle_if_mode, but for either GFSK or FLRC. */
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_mode mode = priv->cfg.mode;
+
+  if (
+    (mode == SX1280_MODE_GFSK || mode == SX1280_MODE_FLRC)
+    && (err = sx1280_acquire_idle(priv, true))
+  ) {
+    return err;
+  }
+
+  if ((err = sx1280_write_register(
+    priv,
+    SX1280_REG_CRC_POLYNOMIAL_DEFINITION_MSB,
+    crc_seed,
+    2
+  ))) {
+    goto fail;
+  }
+
+  memcpy(priv->cfg.crc_seed, crc_seed, sizeof(priv->cfg.crc_seed));
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t ramp_time_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_ramp_time ramp_time = priv->cfg.ramp_time;
+  mutex_unlock(&priv->lock);
+
+  int ramp_time_us;
+  switch (ramp_time) {
+  case SX1280_RADIO_RAMP_02_US: ramp_time_us = 2; break;
+  case SX1280_RADIO_RAMP_04_US: ramp_time_us = 4; break;
+  case SX1280_RADIO_RAMP_06_US: ramp_time_us = 6; break;
+  case SX1280_RADIO_RAMP_08_US: ramp_time_us = 8; break;
+  case SX1280_RADIO_RAMP_10_US: ramp_time_us = 10; break;
+  case SX1280_RADIO_RAMP_12_US: ramp_time_us = 12; break;
+  case SX1280_RADIO_RAMP_16_US: ramp_time_us = 16; break;
+  case SX1280_RADIO_RAMP_20_US: ramp_time_us = 20; break;
+  default:
+    WARN(1, "invalid internal ramp_time: %d\n", ramp_time);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%d\n", ramp_time_us);
+}
+
+static ssize_t ramp_time_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  int ramp_time_us;
+  if ((err = kstrtoint(buf, 10, &ramp_time_us))) {
+    return err;
+  }
+
+  enum sx1280_ramp_time ramp_time;
+  switch (ramp_time_us) {
+  case 2:  ramp_time = SX1280_RADIO_RAMP_02_US; break;
+  case 4:  ramp_time = SX1280_RADIO_RAMP_04_US; break;
+  case 6:  ramp_time = SX1280_RADIO_RAMP_06_US; break;
+  case 8:  ramp_time = SX1280_RADIO_RAMP_08_US; break;
+  case 10: ramp_time = SX1280_RADIO_RAMP_10_US; break;
+  case 12: ramp_time = SX1280_RADIO_RAMP_12_US; break;
+  case 16: ramp_time = SX1280_RADIO_RAMP_16_US; break;
+  case 20: ramp_time = SX1280_RADIO_RAMP_20_US; break;
+  default:
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle(priv, false))) {
+    return err;
+  }
+
+  priv->cfg.ramp_time = ramp_time;
+  mutex_unlock(&priv->lock);
+  return count;
+}
+
+static ssize_t frequency_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  u32 freq = priv->cfg.freq;
+  mutex_unlock(&priv->lock);
+
+  u32 freq_hz = SX1280_FREQ_PLL_TO_HZ(freq);
+  return sprintf(buf, "%u\n", freq_hz);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t frequency_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  u32 freq_hz;
+  if ((err = kstrtou32(buf, 10, &freq_hz))) {
+    return err;
+  }
+
+  if (freq_hz < 2400000000 || freq_hz > 2500000000) {
+    return -EINVAL;
+  }
+
+  u32 freq_pll = SX1280_FREQ_HZ_TO_PLL(freq_hz);
+
+  if ((err = sx1280_acquire_idle(priv, false))) {
+    return err;
+  }
+
+  if ((err = sx1280_set_rf_frequency(priv, freq_pll))) {
+    goto fail;
+  }
+
+  priv->cfg.freq = freq_pll;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+/**
+ * Gets how much airtime the TX ring may hold before the queue is stopped, in
+ * microseconds.
+ * @context - process
+ */
+static ssize_t tx_airtime_target_us_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  spin_lock_bh(&priv->tx_lock);
+  unsigned int target_us = priv->aql.target_us;
+  spin_unlock_bh(&priv->tx_lock);
+
+  return sprintf(buf, "%u\n", target_us);
+}
+
+/**
+ * Sets how much airtime the TX ring may hold before the queue is stopped, in
+ * microseconds, which bounds the queueing delay. A packet is always let in
+ * while the ring holds less than this, so one longer packet still fits. With
+ * 0, only tx_ring_depth limits the ring.
+ * @context - process
+ */
+static ssize_t tx_airtime_target_us_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  unsigned int target_us;
+  if ((err = kstrtouint(buf, 10, &target_us))) {
+    return err;
+  }
+
+  if (target_us > SX1280_AQL_TARGET_US_MAX) {
+    return -EINVAL;
+  }
+
+  spin_lock_bh(&priv->tx_lock);
+  priv->aql.target_us = target_us;
+
+  if (
+    netif_queue_stopped(netdev)
+    && !sx1280_tx_ring_full(priv)
+    && !READ_ONCE(priv->duty.throttled)
+  ) {
+    netif_wake_queue(netdev);
+  }
+
+  spin_unlock_bh(&priv->tx_lock);
+  return count;
+}
+
+static ssize_t tx_ring_depth_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  spin_lock_bh(&priv->tx_lock);
+  unsigned int depth = priv->tx_ring_depth;
+  spin_unlock_bh(&priv->tx_lock);
+
+  return sprintf(buf, "%u\n", depth);
+}
+
+/**
+ * Sets the number of packets that may be queued on the TX ring at once.
+ * @context - process
+ */
+static ssize_t tx_ring_depth_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  unsigned int depth;
+  if ((err = kstrtouint(buf, 10, &depth))) {
+    return err;
+  }
+
+  if (depth < 1 || depth > SX1280_TX_RING_SIZE) {
+    return -EINVAL;
+  }
+
+  spin_lock_bh(&priv->tx_lock);
+  priv->tx_ring_depth = depth;
+
+  /*
+   * Shrinking the ring takes effect as packets drain, but growing it may make
+   * room for the stack immediately.
+   */
+  if (
+    netif_queue_stopped(netdev)
+    && !sx1280_tx_ring_full(priv)
+    && !READ_ONCE(priv->duty.throttled)
+  ) {
+    netif_wake_queue(netdev);
+  }
+
+  spin_unlock_bh(&priv->tx_lock);
+  return count;
+}
+
+/**
+ * Gets whether the worker servicing the chip runs with real-time priority.
+ * @context - process
+ */
+static ssize_t realtime_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  return sprintf(buf, "%d\n", READ_ONCE(priv->realtime));
+}
+
+/**
+ * Switches the worker servicing the chip between SCHED_FIFO and SCHED_NORMAL.
+ *
+ * Only the default real-time priority is available to modules. A different
+ * priority can still be given to the worker thread (sx1280-<spi device>) with
+ * chrt.
+ *
+ * @context - process
+ */
+static ssize_t realtime_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  bool realtime;
+  if ((err = kstrtobool(buf, &realtime))) {
+    return err;
+  }
+
+  if (realtime) {
+    sched_set_fifo(priv->worker->task);
+  } else {
+    sched_set_normal(priv->worker->task, 0);
+  }
+
+  WRITE_ONCE(priv->realtime, realtime);
+  return count;
+}
+
+/**
+ * Gets the CPUs that the worker servicing the chip may run on, as a list.
+ * @context - process
+ */
+static ssize_t cpu_affinity_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  return cpumap_print_to_pagebuf(true, buf, priv->worker->task->cpus_ptr);
+}
+
+/**
+ * Restricts the worker servicing the chip to a list of CPUs, e.g. "3" or
+ * "2-3", so that it can be pinned to an isolated core.
+ *
+ * @context - process
+ */
+static ssize_t cpu_affinity_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  cpumask_var_t mask;
+  if (!alloc_cpumask_var(&mask, GFP_KERNEL)) {
+    return -ENOMEM;
+  }
+
+  if (!(err = cpulist_parse(buf, mask))) {
+    err = set_cpus_allowed_ptr(priv->worker->task, mask);
+  }
+
+  free_cpumask_var(mask);
+  return err ? err : count;
+}
+
+/**************/
+/* FLRC sysfs */
+/**************/
+
+static ssize_t flrc_bandwidth_time_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_bandwidth_time bt = priv->cfg.flrc.modulation.bandwidth_time;
+  mutex_unlock(&priv->lock);
+
+  const char *bt_str;
+  switch (bt) {
+  case SX1280_BT_OFF: bt_str = "off"; break;
+  case SX1280_BT_0_5: bt_str = "0.5"; break;
+  case SX1280_BT_1_0: bt_str = "1.0"; break;
+  default:
+    WARN(1, "invalid internal cfg.flrc.modulation.bandwidth_time: %d\n", bt);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%s\n", bt_str);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t flrc_bandwidth_time_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  enum sx1280_bandwidth_time bt;
+  if (sysfs_streq(buf, "off")) {
+    bt = SX1280_BT_OFF;
+  } else if (sysfs_streq(buf, "0.5")) {
+    bt = SX1280_BT_0_5;
+  } else if (sysfs_streq(buf, "1.0")) {
+    bt = SX1280_BT_1_0;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_FLRC) {
+    struct sx1280_modulation_params mod_params = {
+      .mode = SX1280_MODE_FLRC,
+      .gfsk = priv->cfg.gfsk.modulation,
+    };
+    mod_params.gfsk.bandwidth_time = bt;
+
+    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.gfsk.modulation.bandwidth_time = bt;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t flrc_bitrate_bandwidth_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_flrc_bitrate_bandwidth brbw =
+    priv->cfg.flrc.modulation.bitrate_bandwidth;
+  mutex_unlock(&priv->lock);
+
+  int br, bw;
+  switch (brbw) {
+  case SX1280_FLRC_BR_1_300_BW_1_2: br = 1300000; bw = 1200000; break;
+  case SX1280_FLRC_BR_1_000_BW_1_2: br = 1000000; bw = 1200000; break;
+  case SX1280_FLRC_BR_0_650_BW_0_6: br = 650000;  bw = 600000;  break;
+  case SX1280_FLRC_BR_0_520_BW_0_6: br = 520000;  bw = 600000;  break;
+  case SX1280_FLRC_BR_0_325_BW_0_3: br = 325000;  bw = 300000;  break;
+  case SX1280_FLRC_BR_0_260_BW_0_3: br = 260000;  bw = 300000;  break;
+  default:
+    WARN(1, "invalid internal cfg.flrc.modulation.bitrate_bandwidth: %d\n", brbw);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%d,%d\n", br, bw);
+}
+
+static ssize_t flrc_bitrate_bandwidth_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  enum sx1280_flrc_bitrate_bandwidth brbw;
+  if (sysfs_streq(buf, "1300000,1200000")) {
+    brbw = SX1280_FLRC_BR_1_300_BW_1_2;
+  } else if (sysfs_streq(buf, "1000000,1200000")) {
+    brbw = SX1280_FLRC_BR_1_000_BW_1_2;
+  } else if (sysfs_streq(buf, "650000,600000")) {
+    brbw = SX1280_FLRC_BR_0_650_BW_0_6;
+  } else if (sysfs_streq(buf,"520000,600000")) {
+    brbw = SX1280_FLRC_BR_0_520_BW_0_6;
+  } else if (sysfs_streq(buf, "325000,300000")) {
+    brbw = SX1280_FLRC_BR_0_325_BW_0_3;
+  } else if (sysfs_streq(buf, "260000,300000")) {
+    brbw = SX1280_FLRC_BR_0_260_BW_0_3;
+  } else {
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_FLRC) {
+    struct sx1280_modulation_params mod_params = {
+      .mode = SX1280_MODE_FLRC,
+      .flrc = priv->cfg.flrc.modulation,
+    };
+    mod_params.flrc.bitrate_bandwidth = brbw;
+
+    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.flrc.modulation.bitrate_bandwidth = brbw;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t flrc_coding_rate_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_flrc_coding_rate coding_rate =
+    priv->cfg.flrc.modulation.coding_rate;
+  mutex_unlock(&priv->lock);
+
+  const char *coding_rate_str;
+  switch (coding_rate) {
+  case SX1280_FLRC_CR_1_2: coding_rate_str = "1/2"; break;
+  case SX1280_FLRC_CR_3_4: coding_rate_str = "3/4"; break;
+  case SX1280_FLRC_CR_1_1: coding_rate_str = "1/1"; break;
+  default:
+    WARN(
+      1,
+      "invalid internal cfg.flrc.modulation.coding_rate: %d\n",
+      coding_rate
+    );
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%s\n", coding_rate_str);
+}
+
+static ssize_t flrc_coding_rate_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  enum sx1280_flrc_coding_rate coding_rate;
+  if (sysfs_streq(buf, "1/2")) {
+    coding_rate = SX1280_FLRC_CR_1_2;
+  } else if (sysfs_streq(buf, "3/4")) {
+    coding_rate = SX1280_FLRC_CR_3_4;
+  } else if (sysfs_streq(buf, "1/1")) {
+    coding_rate = SX1280_FLRC_CR_1_1;
+  } else {
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_FLRC) {
+    struct sx1280_modulation_params mod_params = {
+      .mode = SX1280_MODE_FLRC,
+      .flrc = priv->cfg.flrc.modulation,
+    };
+    mod_params.flrc.coding_rate = coding_rate;
+
+    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.flrc.modulation.coding_rate = coding_rate;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t flrc_crc_bytes_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_flrc_crc crc_length = priv->cfg.flrc.packet.crc_length;
+  mutex_unlock(&priv->lock);
+
+  int bytes;
+  switch (crc_length) {
+  case SX1280_FLRC_CRC_OFF:    bytes = 0; break;
+  case SX1280_FLRC_CRC_2_BYTE: bytes = 2; break;
+  case SX1280_FLRC_CRC_3_BYTE: bytes = 3; break;
+  case SX1280_FLRC_CRC_4_BYTE: bytes = 4; break;
+  default:
+    WARN(1, "invalid internal cfg.flrc.packet.crc_length: %d\n", crc_length);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%d\n", bytes);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t flrc_crc_bytes_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  int crc_bytes;
+  if ((err = kstrtoint(buf, 10, &crc_bytes))) {
+    return err;
+  }
+
+  enum sx1280_flrc_crc crc_length;
+  switch (crc_bytes) {
+  case 0: crc_length = SX1280_FLRC_CRC_OFF; break;
+  case 2: crc_length = SX1280_FLRC_CRC_2_BYTE; break;
+  case 3: crc_length = SX1280_FLRC_CRC_3_BYTE; break;
+  case 4: crc_length = SX1280_FLRC_CRC_4_BYTE; break;
+  default:
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_FLRC) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_FLRC,
+      .flrc = priv->cfg.flrc.packet,
+    };
+    packet_params.flrc.crc_length = crc_length;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.flrc.packet.crc_length = crc_length;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t flrc_preamble_bits_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_preamble_length preamble_length =
+    priv->cfg.flrc.packet.agc_preamble_length;
+  mutex_unlock(&priv->lock);
+
+  int bits;
+  switch (preamble_length) {
+  case SX1280_PREAMBLE_LENGTH_04_BITS: bits = 4;  break;
+  case SX1280_PREAMBLE_LENGTH_08_BITS: bits = 8;  break;
+  case SX1280_PREAMBLE_LENGTH_12_BITS: bits = 12; break;
+  case SX1280_PREAMBLE_LENGTH_16_BITS: bits = 16; break;
+  case SX1280_PREAMBLE_LENGTH_20_BITS: bits = 20; break;
+  case SX1280_PREAMBLE_LENGTH_24_BITS: bits = 24; break;
+  case SX1280_PREAMBLE_LENGTH_28_BITS: bits = 28; break;
+  case SX1280_PREAMBLE_LENGTH_32_BITS: bits = 32; break;
+  default:
+    WARN(
+      1,
+      "invalid internal cfg.flrc.packet.preamble_length: %d\n",
+      preamble_length
+    );
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%d\n", bits);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t flrc_preamble_bits_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  int preamble_bits;
+  if ((err = kstrtoint(buf, 10, &preamble_bits))) {
+    return err;
+  }
+
+  enum sx1280_preamble_length preamble_length;
+  switch (preamble_bits) {
+  case 4:  preamble_length = SX1280_PREAMBLE_LENGTH_04_BITS; break;
+  case 8:  preamble_length = SX1280_PREAMBLE_LENGTH_08_BITS; break;
+  case 12: preamble_length = SX1280_PREAMBLE_LENGTH_12_BITS; break;
+  case 16: preamble_length = SX1280_PREAMBLE_LENGTH_16_BITS; break;
+  case 20: preamble_length = SX1280_PREAMBLE_LENGTH_20_BITS; break;
+  case 24: preamble_length = SX1280_PREAMBLE_LENGTH_24_BITS; break;
+  case 28: preamble_length = SX1280_PREAMBLE_LENGTH_28_BITS; break;
+  case 32: preamble_length = SX1280_PREAMBLE_LENGTH_32_BITS; break;
+  default:
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_FLRC) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_FLRC,
+      .flrc = priv->cfg.flrc.packet,
+    };
+    packet_params.flrc.agc_preamble_length = preamble_length;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.flrc.packet.agc_preamble_length = preamble_length;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t flrc_whitening_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  bool whitening = priv->cfg.flrc.packet.whitening == SX1280_WHITENING_ENABLE;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%d\n", whitening);
+}
+
+static ssize_t flrc_whitening_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  bool whitening_bool;
+  if ((err = kstrtobool(buf, &whitening_bool))) {
+    return err;
+  }
+
+  enum sx1280_whitening whitening = whitening_bool
+    ? SX1280_WHITENING_ENABLE
+    : SX1280_WHITENING_DISABLE;
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_FLRC) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_FLRC,
+      .flrc = priv->cfg.flrc.packet,
+    };
+    packet_params.flrc.whitening = whitening;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.flrc.packet.whitening = whitening;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static struct device_attribute dev_attr_flrc_bandwidth_time =
+  __ATTR(bandwidth_time, 0644, flrc_bandwidth_time_show, flrc_bandwidth_time_store);
+static struct device_attribute dev_attr_flrc_bitrate_bandwidth =
+  __ATTR(bitrate_bandwidth, 0644, flrc_bitrate_bandwidth_show, flrc_bitrate_bandwidth_store);
+static struct device_attribute dev_attr_flrc_coding_rate =
+  __ATTR(coding_rate, 0644, flrc_coding_rate_show, flrc_coding_rate_store);
+static struct device_attribute dev_attr_flrc_crc_bytes =
+  __ATTR(crc_bytes, 0644, flrc_crc_bytes_show, flrc_crc_bytes_store);
+static struct device_attribute dev_attr_flrc_preamble_bits =
+  __ATTR(preamble_bits, 0644, flrc_preamble_bits_show, flrc_preamble_bits_store);
+static struct device_attribute dev_attr_flrc_whitening =
+  __ATTR(whitening, 0644, flrc_whitening_show, flrc_whitening_store);
+
+static struct attribute *sx1280_flrc_attrs[] = {
+  &dev_attr_flrc_bandwidth_time.attr,
+  &dev_attr_flrc_bitrate_bandwidth.attr,
+  &dev_attr_flrc_coding_rate.attr,
+  &dev_attr_flrc_crc_bytes.attr,
+  &dev_attr_flrc_preamble_bits.attr,
+  &dev_attr_flrc_whitening.attr,
+  NULL,
+};
+
+static struct attribute_group sx1280_flrc_group = {
+  .attrs = sx1280_flrc_attrs,
+  .name = "flrc",
+};
+
+/**************/
+/* GFSK sysfs */
+/**************/
+
+static ssize_t gfsk_bandwidth_time_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_bandwidth_time bt = priv->cfg.gfsk.modulation.bandwidth_time;
+  mutex_unlock(&priv->lock);
+
+  const char *bt_str;
+  switch (bt) {
+  case SX1280_BT_OFF: bt_str = "off"; break;
+  case SX1280_BT_0_5: bt_str = "0.5"; break;
+  case SX1280_BT_1_0: bt_str = "1.0"; break;
+  default:
+    WARN(1, "invalid internal gfsk bandwidth-time: %d\n", bt);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%s\n", bt_str);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t gfsk_bandwidth_time_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  u8 bt;
+  if (sysfs_streq(buf, "off")) {
+    bt = SX1280_BT_OFF;
+  } else if (sysfs_streq(buf, "0.5")) {
+    bt = SX1280_BT_0_5;
+  } else if (sysfs_streq(buf, "1.0")) {
+    bt = SX1280_BT_1_0;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_GFSK) {
+    struct sx1280_modulation_params mod_params = {
+      .mode = SX1280_MODE_GFSK,
+      .gfsk = priv->cfg.gfsk.modulation,
+    };
+    mod_params.gfsk.bandwidth_time = bt;
+
+    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.gfsk.modulation.bandwidth_time = bt;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t gfsk_bitrate_bandwidth_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+  
+  enum sx1280_fsk_bitrate_bandwidth brbw =
+    priv->cfg.gfsk.modulation.bitrate_bandwidth;
+  mutex_unlock(&priv->lock);
+
+  int br, bw;
+  switch (brbw) {
+  case SX1280_FSK_BR_2_000_BW_2_4: br = 2000000; bw = 2400000; break;
+  case SX1280_FSK_BR_1_600_BW_2_4: br = 1600000; bw = 2400000; break;
+  case SX1280_FSK_BR_1_000_BW_2_4: br = 1000000; bw = 2400000; break;
+  case SX1280_FSK_BR_1_000_BW_1_2: br = 1000000; bw = 1200000; break;
+  case SX1280_FSK_BR_0_800_BW_2_4: br = 800000;  bw = 2400000; break;
+  case SX1280_FSK_BR_0_800_BW_1_2: br = 800000;  bw = 1200000; break;
+  case SX1280_FSK_BR_0_500_BW_1_2: br = 500000;  bw = 1200000; break;
+  case SX1280_FSK_BR_0_500_BW_0_6: br = 500000;  bw = 600000;  break;
+  case SX1280_FSK_BR_0_400_BW_1_2: br = 400000;  bw = 1200000; break;
+  case SX1280_FSK_BR_0_400_BW_0_6: br = 400000;  bw = 600000;  break;
+  case SX1280_FSK_BR_0_250_BW_0_6: br = 250000;  bw = 600000;  break;
+  case SX1280_FSK_BR_0_250_BW_0_3: br = 250000;  bw = 300000;  break;
+  case SX1280_FSK_BR_0_125_BW_0_3: br = 125000;  bw = 300000;  break;
+  default:
+    WARN(1, "invalid internal gfsk bitrate-bandwidth: %d\n", brbw);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%d,%d\n", br, bw);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t gfsk_bitrate_bandwidth_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  enum sx1280_fsk_bitrate_bandwidth brbw;
+  if (sysfs_streq(buf, "2000000,2400000")) {
+    brbw = SX1280_FSK_BR_2_000_BW_2_4;
+  } else if (sysfs_streq(buf, "1600000,2400000")) {
+    brbw = SX1280_FSK_BR_1_600_BW_2_4;
+  } else if (sysfs_streq(buf, "1000000,2400000")) {
+    brbw = SX1280_FSK_BR_1_000_BW_2_4;
+  } else if (sysfs_streq(buf, "1000000,1200000")) {
+    brbw = SX1280_FSK_BR_1_000_BW_1_2;
+  } else if (sysfs_streq(buf, "800000,2400000")) {
+    brbw = SX1280_FSK_BR_0_800_BW_2_4;
+  } else if (sysfs_streq(buf, "800000,1200000")) {
+    brbw = SX1280_FSK_BR_0_800_BW_1_2;
+  } else if (sysfs_streq(buf, "500000,1200000")) {
+    brbw = SX1280_FSK_BR_0_500_BW_1_2;
+  } else if (sysfs_streq(buf, "500000,600000")) {
+    brbw = SX1280_FSK_BR_0_500_BW_0_6;
+  } else if (sysfs_streq(buf, "400000,1200000")) {
+    brbw = SX1280_FSK_BR_0_400_BW_1_2;
+  } else if (sysfs_streq(buf, "400000,600000")) {
+    brbw = SX1280_FSK_BR_0_400_BW_0_6;
+  } else if (sysfs_streq(buf, "250000,600000")) {
+    brbw = SX1280_FSK_BR_0_250_BW_0_6;
+  } else if (sysfs_streq(buf, "250000,300000")) {
+    brbw = SX1280_FSK_BR_0_250_BW_0_3;
+  } else if (sysfs_streq(buf, "125000,300000")) {
+    brbw = SX1280_FSK_BR_0_125_BW_0_3;
+  } else {
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_GFSK) {
+    struct sx1280_modulation_params mod_params = {
+      .mode = SX1280_MODE_GFSK,
+      .gfsk = priv->cfg.gfsk.modulation,
+    };
+    mod_params.gfsk.bitrate_bandwidth = brbw;
+
+    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.gfsk.modulation.bitrate_bandwidth = brbw;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+
+static ssize_t gfsk_crc_bytes_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_radio_crc crc_length = priv->cfg.gfsk.packet.crc_length;
+  mutex_unlock(&priv->lock);
+
+  int bytes;
+  switch (crc_length) {
+  case SX1280_RADIO_CRC_OFF:     bytes = 0; break;
+  case SX1280_RADIO_CRC_1_BYTE:  bytes = 1; break;
+  case SX1280_RADIO_CRC_2_BYTES: bytes = 2; break;
+  default:
+    WARN(1, "invalid internal cfg.gfsk.packet.crc_length: %d\n", crc_length);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%d\n", bytes);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t gfsk_crc_bytes_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  int crc_bytes;
+  if ((err = kstrtoint(buf, 10, &crc_bytes))) {
+    return err;
+  }
+
+  enum sx1280_radio_crc crc_length;
+  switch (crc_bytes) {
+  case 0: crc_length = SX1280_RADIO_CRC_OFF; break;
+  case 1: crc_length = SX1280_RADIO_CRC_1_BYTE; break;
+  case 2: crc_length = SX1280_RADIO_CRC_2_BYTES; break;
+  default:
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_GFSK) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_GFSK,
+      .gfsk = priv->cfg.gfsk.packet,
+    };
+    packet_params.gfsk.crc_length = crc_length;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.gfsk.packet.crc_length = crc_length;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t gfsk_crc_polynomial_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  u8 crc_polynomial[2];
+  memcpy(crc_polynomial, priv->cfg.gfsk.crc_polynomial, sizeof(crc_polynomial));
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%*phN\n", 2, crc_polynomial);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t gfsk_crc_polynomial_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (count != 5 && count != 4) {
+    return -EINVAL;
+  }
+
+  u8 crc_polynomial[2];
+  if ((err = hex2bin(crc_polynomial, buf, 2))) {
+    return err;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+    return err;
+  }
+
+  err = sx1280_write_register(
+    priv,
+    SX1280_REG_CRC_POLYNOMIAL_DEFINITION_MSB,
+    crc_polynomial,
+    2
+  );
+  if (err) {
+    goto fail;
+  }
+
+  memcpy(priv->cfg.gfsk.crc_polynomial, crc_polynomial, 2);
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t gfsk_whitening_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  bool whitening = priv->cfg.gfsk.packet.whitening == SX1280_WHITENING_ENABLE;
+  int count = sprintf(buf, "%d\n", whitening);
+
+  mutex_unlock(&priv->lock);
+  return count;
+}
+
+static ssize_t gfsk_whitening_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  bool whitening_bool;
+  if ((err = kstrtobool(buf, &whitening_bool))) {
+    return err;
+  }
+
+  enum sx1280_whitening whitening = whitening_bool
+    ? SX1280_WHITENING_ENABLE
+    : SX1280_WHITENING_DISABLE;
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_GFSK) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_GFSK,
+      .gfsk = priv->cfg.gfsk.packet,
+    };
+    packet_params.gfsk.whitening = whitening;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.gfsk.packet.whitening = whitening;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t gfsk_modulation_index_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_modulation_index mod_index =
+    priv->cfg.gfsk.modulation.modulation_index;
+  mutex_unlock(&priv->lock);
+
+  const char *mod_index_str;
+  switch (mod_index) {
+  case SX1280_MOD_IND_0_35: mod_index_str = "0.35"; break;
+  case SX1280_MOD_IND_0_50: mod_index_str = "0.50"; break;
+  case SX1280_MOD_IND_0_75: mod_index_str = "0.75"; break;
+  case SX1280_MOD_IND_1_00: mod_index_str = "1.00"; break;
+  case SX1280_MOD_IND_1_25: mod_index_str = "1.25"; break;
+  case SX1280_MOD_IND_1_50: mod_index_str = "1.50"; break;
+  case SX1280_MOD_IND_1_75: mod_index_str = "1.75"; break;
+  case SX1280_MOD_IND_2_00: mod_index_str = "2.00"; break;
+  case SX1280_MOD_IND_2_25: mod_index_str = "2.25"; break;
+  case SX1280_MOD_IND_2_50: mod_index_str = "2.50"; break;
+  case SX1280_MOD_IND_2_75: mod_index_str = "2.75"; break;
+  case SX1280_MOD_IND_3_00: mod_index_str = "3.00"; break;
+  case SX1280_MOD_IND_3_25: mod_index_str = "3.25"; break;
+  case SX1280_MOD_IND_3_50: mod_index_str = "3.50"; break;
+  case SX1280_MOD_IND_3_75: mod_index_str = "3.75"; break;
+  case SX1280_MOD_IND_4_00: mod_index_str = "4.00"; break;
+  default:
+    WARN(1, "invalid internal gfsk modulation index: %d\n", mod_index);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%s\n", mod_index_str);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t gfsk_modulation_index_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  
+  u8 mod_index;
+  if (sysfs_streq(buf, "0.35")) {
+    mod_index = SX1280_MOD_IND_0_35;
+  } else if (sysfs_streq(buf, "0.50")) {
+    mod_index = SX1280_MOD_IND_0_50;
+  } else if (sysfs_streq(buf, "0.75")) {
+    mod_index = SX1280_MOD_IND_0_75;
+  } else if (sysfs_streq(buf, "1.00")) {
+    mod_index = SX1280_MOD_IND_1_00;
+  } else if (sysfs_streq(buf, "1.25")) {
+    mod_index = SX1280_MOD_IND_1_25;
+  } else if (sysfs_streq(buf, "1.50")) {
+    mod_index = SX1280_MOD_IND_1_50;
+  } else if (sysfs_streq(buf, "1.75")) {
+    mod_index = SX1280_MOD_IND_1_75;
+  } else if (sysfs_streq(buf, "2.00")) {
+    mod_index = SX1280_MOD_IND_2_00;
+  } else if (sysfs_streq(buf, "2.25")) {
+    mod_index = SX1280_MOD_IND_2_25;
+  } else if (sysfs_streq(buf, "2.50")) {
+    mod_index = SX1280_MOD_IND_2_50;
+  } else if (sysfs_streq(buf, "2.75")) {
+    mod_index = SX1280_MOD_IND_2_75;
+  } else if (sysfs_streq(buf, "3.00")) {
+    mod_index = SX1280_MOD_IND_3_00;
+  } else if (sysfs_streq(buf, "3.25")) {
+    mod_index = SX1280_MOD_IND_3_25;
+  } else if (sysfs_streq(buf, "3.50")) {
+    mod_index = SX1280_MOD_IND_3_50;
+  } else if (sysfs_streq(buf, "3.75")) {
+    mod_index = SX1280_MOD_IND_3_75;
+  } else if (sysfs_streq(buf, "4.00")) {
+    mod_index = SX1280_MOD_IND_4_00;
+  } else {
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_GFSK) {
+    struct sx1280_modulation_params mod_params = {
+      .mode = SX1280_MODE_GFSK,
+      .gfsk = priv->cfg.gfsk.modulation,
+    };
+    mod_params.gfsk.modulation_index = mod_index;
+
+    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.gfsk.modulation.modulation_index = mod_index;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t gfsk_preamble_bits_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_preamble_length preamble_length =
+    priv->cfg.gfsk.packet.preamble_length;
+  mutex_unlock(&priv->lock);
+
+  int bits;
+  switch (preamble_length) {
+  case SX1280_PREAMBLE_LENGTH_04_BITS: bits = 4;  break;
+  case SX1280_PREAMBLE_LENGTH_08_BITS: bits = 8;  break;
+  case SX1280_PREAMBLE_LENGTH_12_BITS: bits = 12; break;
+  case SX1280_PREAMBLE_LENGTH_16_BITS: bits = 16; break;
+  case SX1280_PREAMBLE_LENGTH_20_BITS: bits = 20; break;
+  case SX1280_PREAMBLE_LENGTH_24_BITS: bits = 24; break;
+  case SX1280_PREAMBLE_LENGTH_28_BITS: bits = 28; break;
+  case SX1280_PREAMBLE_LENGTH_32_BITS: bits = 32; break;
+  default:
+    WARN(
+      1,
+      "invalid internal gfsk.packet.preamble_length: %d\n",
+      preamble_length
+    );
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%d\n", bits);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t gfsk_preamble_bits_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  int preamble_bits;
+  if ((err = kstrtoint(buf, 10, &preamble_bits))) {
+    return err;
+  }
+
+  enum sx1280_preamble_length preamble_length;
+  switch (preamble_bits) {
+  case 4:  preamble_length = SX1280_PREAMBLE_LENGTH_04_BITS; break;
+  case 8:  preamble_length = SX1280_PREAMBLE_LENGTH_08_BITS; break;
+  case 12: preamble_length = SX1280_PREAMBLE_LENGTH_12_BITS; break;
+  case 16: preamble_length = SX1280_PREAMBLE_LENGTH_16_BITS; break;
+  case 20: preamble_length = SX1280_PREAMBLE_LENGTH_20_BITS; break;
+  case 24: preamble_length = SX1280_PREAMBLE_LENGTH_24_BITS; break;
+  case 28: preamble_length = SX1280_PREAMBLE_LENGTH_28_BITS; break;
+  case 32: preamble_length = SX1280_PREAMBLE_LENGTH_32_BITS; break;
+  default:
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_GFSK) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_GFSK,
+      .gfsk = priv->cfg.gfsk.packet,
+    };
+    packet_params.gfsk.preamble_length = preamble_length;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.gfsk.packet.preamble_length = preamble_length;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t gfsk_sync_word_length_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_gfsk_sync_word_length sync_word_length =
+    priv->cfg.gfsk.packet.sync_word_length;
+  mutex_unlock(&priv->lock);
+
+  int bytes;
+  switch (sync_word_length) {
+  case SX1280_SYNC_WORD_LEN_1_B: bytes = 1; break;
+  case SX1280_SYNC_WORD_LEN_2_B: bytes = 2; break;
+  case SX1280_SYNC_WORD_LEN_3_B: bytes = 3; break;
+  case SX1280_SYNC_WORD_LEN_4_B: bytes = 4; break;
+  case SX1280_SYNC_WORD_LEN_5_B: bytes = 5; break;
+  default:
+    WARN(
+      1,
+      "invalid internal gfsk.packet.sync_word_length: %d\n",
+      sync_word_length
+    );
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%d\n", bytes);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t gfsk_sync_word_length_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  int sync_word_bytes;
+  if ((err = kstrtoint(buf, 10, &sync_word_bytes))) {
+    return err;
+  }
+
+  enum sx1280_gfsk_sync_word_length sync_word_length;
+  switch (sync_word_bytes) {
+  case 1: sync_word_length = SX1280_SYNC_WORD_LEN_1_B; break;
+  case 2: sync_word_length = SX1280_SYNC_WORD_LEN_2_B; break;
+  case 3: sync_word_length = SX1280_SYNC_WORD_LEN_3_B; break;
+  case 4: sync_word_length = SX1280_SYNC_WORD_LEN_4_B; break;
+  case 5: sync_word_length = SX1280_SYNC_WORD_LEN_5_B; break;
+  default: return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_GFSK) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_GFSK,
+      .gfsk = priv->cfg.gfsk.packet,
+    };
+    packet_params.gfsk.sync_word_length = sync_word_length;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.gfsk.packet.sync_word_length = sync_word_length;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t gfsk_sync_word_match_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  const char *mask;
+  switch (priv->cfg.gfsk.packet.sync_word_match) {
+  case SX1280_RADIO_SELECT_SYNCWORD_OFF  : mask = "000"; break;
+  case SX1280_RADIO_SELECT_SYNCWORD_1    : mask = "100"; break;
+  case SX1280_RADIO_SELECT_SYNCWORD_2    : mask = "010"; break;
+  case SX1280_RADIO_SELECT_SYNCWORD_1_2  : mask = "110"; break;
+  case SX1280_RADIO_SELECT_SYNCWORD_3    : mask = "001"; break;
+  case SX1280_RADIO_SELECT_SYNCWORD_1_3  : mask = "101"; break;
+  case SX1280_RADIO_SELECT_SYNCWORD_2_3  : mask = "011"; break;
+  case SX1280_RADIO_SELECT_SYNCWORD_1_2_3: mask = "111"; break;
+  }
+
+  int count = sprintf(buf, "%s\n", mask);
+
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t gfsk_sync_word_match_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  enum sx1280_sync_word_match sync_word_match;
+  if (sysfs_streq(buf, "000") || sysfs_streq(buf, "off")) {
+    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_OFF;
+  } else if (sysfs_streq(buf, "100")) {
+    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_1;
+  } else if (sysfs_streq(buf, "010")) {
+    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_2;
+  } else if (sysfs_streq(buf, "110")) {
+    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_1_2;
+  } else if (sysfs_streq(buf, "001")) {
+    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_3;
+  } else if (sysfs_streq(buf, "101")) {
+    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_1_3;
+  } else if (sysfs_streq(buf, "011")) {
+    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_2_3;
+  } else if (sysfs_streq(buf, "111")) {
+    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_1_2_3;
+  } else {
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_GFSK) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_GFSK,
+      .gfsk = priv->cfg.gfsk.packet,
+    };
+    packet_params.gfsk.sync_word_match = sync_word_match;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.gfsk.packet.sync_word_match = sync_word_match;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+/* GFSK-specific device attributes */
+static struct device_attribute dev_attr_gfsk_bandwidth_time =
+  __ATTR(bandwidth_time, 0644, gfsk_bandwidth_time_show, gfsk_bandwidth_time_store);
+static struct device_attribute dev_attr_gfsk_bitrate_bandwidth =
+  __ATTR(bitrate_bandwidth, 0644, gfsk_bitrate_bandwidth_show, gfsk_bitrate_bandwidth_store);
+static struct device_attribute dev_attr_gfsk_crc_bytes =
+  __ATTR(crc_bytes, 0644, gfsk_crc_bytes_show, gfsk_crc_bytes_store);
+static struct device_attribute dev_attr_gfsk_crc_polynomial =
+  __ATTR(crc_polynomial, 0644, gfsk_crc_polynomial_show, gfsk_crc_polynomial_store);
+static struct device_attribute dev_attr_gfsk_modulation_index =
+  __ATTR(modulation_index, 0644, gfsk_modulation_index_show, gfsk_modulation_index_store);
+static struct device_attribute dev_attr_gfsk_preamble_bits =
+  __ATTR(preamble_bits, 0644, gfsk_preamble_bits_show, gfsk_preamble_bits_store);
+static struct device_attribute dev_attr_gfsk_sync_word_length =
+  __ATTR(sync_word_length, 0644, gfsk_sync_word_length_show, gfsk_sync_word_length_store);
+static struct device_attribute dev_attr_gfsk_sync_word_match =
+  __ATTR(sync_word_match, 0644, gfsk_sync_word_match_show, gfsk_sync_word_match_store);
+static struct device_attribute dev_attr_gfsk_whitening =
+  __ATTR(whitening, 0644, gfsk_whitening_show, gfsk_whitening_store);
+
+static struct attribute *sx1280_gfsk_attrs[] = {
+  &dev_attr_gfsk_bandwidth_time.attr,
+  &dev_attr_gfsk_bitrate_bandwidth.attr,
+  &dev_attr_gfsk_crc_bytes.attr,
+  &dev_attr_gfsk_crc_polynomial.attr,
+  &dev_attr_gfsk_modulation_index.attr,
+  &dev_attr_gfsk_preamble_bits.attr,
+  &dev_attr_gfsk_sync_word_length.attr,
+  &dev_attr_gfsk_sync_word_match.attr,
+  &dev_attr_gfsk_whitening.attr,
+  NULL,
+};
+
+static struct attribute_group sx1280_gfsk_group = {
+  .attrs = sx1280_gfsk_attrs,
+  .name = "gfsk",
+};
+
+/**************/
+/* LoRa sysfs */
+/**************/
+
+static ssize_t lora_bandwidth_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_lora_bandwidth bandwidth = priv->cfg.lora.modulation.bandwidth;
+  mutex_unlock(&priv->lock);
+
+  int bandwidth_hz;
+  switch (bandwidth) {
+  case SX1280_LORA_BW_1600: bandwidth_hz = 1600000; break;
+  case SX1280_LORA_BW_800: bandwidth_hz = 800000; break;
+  case SX1280_LORA_BW_400: bandwidth_hz = 400000; break;
+  case SX1280_LORA_BW_200: bandwidth_hz = 200000; break;
+  default:
+    WARN(1, "invalid internal cfg.lora.modulation.bandwidth: %d\n", bandwidth);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%d\n", bandwidth_hz);
+}
+
+static ssize_t lora_bandwidth_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  int bandwidth_hz;
+  if ((err = kstrtoint(buf, 10, &bandwidth_hz))) {
+    return err;
+  }
+
+  enum sx1280_lora_bandwidth bandwidth;
+  switch (bandwidth_hz) {
+  case 1600000: bandwidth = SX1280_LORA_BW_1600; break;
+  case 800000:  bandwidth = SX1280_LORA_BW_800;  break;
+  case 400000:  bandwidth = SX1280_LORA_BW_400;  break;
+  case 200000:  bandwidth = SX1280_LORA_BW_200;  break;
+  default:
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_LORA) {
+    struct sx1280_modulation_params mod_params = {
+      .mode = SX1280_MODE_LORA,
+      .lora = priv->cfg.lora.modulation,
+    };
+    mod_params.lora.bandwidth = bandwidth;
+
+    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.lora.modulation.bandwidth = bandwidth;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t lora_coding_rate_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_lora_coding_rate coding_rate =
+    priv->cfg.lora.modulation.coding_rate;
+  mutex_unlock(&priv->lock);
+
+  const char *coding_rate_str;
+  switch (coding_rate) {
+  case SX1280_LORA_CR_4_5: coding_rate_str = "4/5"; break;
+  case SX1280_LORA_CR_4_6: coding_rate_str = "4/6"; break;
+  case SX1280_LORA_CR_4_7: coding_rate_str = "4/7"; break;
+  case SX1280_LORA_CR_4_8: coding_rate_str = "4/8"; break;
+  case SX1280_LORA_CR_LI_4_5: coding_rate_str = "4/5*"; break;
+  case SX1280_LORA_CR_LI_4_6: coding_rate_str = "4/6*"; break;
+  case SX1280_LORA_CR_LI_4_8: coding_rate_str = "4/8*"; break;
+  default:
+    WARN(
+      1,
+      "invalid internal cfg.lora.modulation.coding_rate: %d\n",
+      coding_rate
+    );
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%s\n", coding_rate_str);
+}
+
+static ssize_t lora_coding_rate_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  enum sx1280_lora_coding_rate coding_rate;
+  if (sysfs_streq(buf, "4/5")) {
+    coding_rate = SX1280_LORA_CR_4_5;
+  } else if (sysfs_streq(buf, "4/6")) {
+    coding_rate = SX1280_LORA_CR_4_6;
+  } else if (sysfs_streq(buf, "4/7")) {
+    coding_rate = SX1280_LORA_CR_4_7;
+  } else if (sysfs_streq(buf, "4/8")) {
+    coding_rate = SX1280_LORA_CR_4_8;
+  } else if (sysfs_streq(buf, "4/5*")) {
+    coding_rate = SX1280_LORA_CR_LI_4_5;
+  } else if (sysfs_streq(buf, "4/6*")) {
+    coding_rate = SX1280_LORA_CR_LI_4_6;
+  } else if (sysfs_streq(buf, "4/8*")) {
+    coding_rate = SX1280_LORA_CR_LI_4_8;
+  } else {
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_LORA) {
+    struct sx1280_modulation_params mod_params = {
+      .mode = SX1280_MODE_LORA,
+      .lora = priv->cfg.lora.modulation,
+    };
+    mod_params.lora.coding_rate = coding_rate;
+
+    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.lora.modulation.coding_rate = coding_rate;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t lora_crc_enable_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  bool crc_enable = priv->cfg.lora.packet.crc == SX1280_LORA_CRC_ENABLE;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%d\n", crc_enable);
+}
+
+static ssize_t lora_crc_enable_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  bool crc_enable;
+  if ((err = kstrtobool(buf, &crc_enable))) {
+    return err;
+  }
+
+  enum sx1280_lora_crc crc = crc_enable
+    ? SX1280_LORA_CRC_ENABLE
+    : SX1280_LORA_CRC_DISABLE;
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_LORA) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_LORA,
+      .lora = priv->cfg.lora.packet,
+    };
+    packet_params.lora.crc = crc;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.lora.packet.crc = crc;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t lora_invert_iq_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  bool invert_iq = priv->cfg.lora.packet.iq == SX1280_LORA_IQ_INVERTED;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%d\n", invert_iq);
+}
+
+static ssize_t lora_invert_iq_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  bool invert_iq;
+  if ((err = kstrtobool(buf, &invert_iq))) {
+    return err;
+  }
+
+  enum sx1280_lora_iq iq = invert_iq
+    ? SX1280_LORA_IQ_INVERTED
+    : SX1280_LORA_IQ_STD;
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_LORA) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_LORA,
+      .lora = priv->cfg.lora.packet,
+    };
+    packet_params.lora.iq = iq;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.lora.packet.iq = iq;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t lora_preamble_bits_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  u8 preamble_length = priv->cfg.lora.packet.preamble_length;
+  mutex_unlock(&priv->lock);
+
+  u8 mantissa = preamble_length & 0xF;
+  u8 exponent = preamble_length >> 4;
+  u32 bits = (u32) mantissa << (u32) exponent;
+  return sprintf(buf, "%d\n", bits);
+}
+
+/**
+ *
+ * @context - process
+ */
+static ssize_t lora_preamble_bits_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  u32 preamble_bits;
+  if ((err = kstrtou32(buf, 10, &preamble_bits))) {
+    return err;
+  }
+
+  /*
+   * The LoRa preamble length format is different from the others:
+   * Bits [3:0] - mantissa
+   * Bits [7:4] - exponent
+   *
+   * The mantissa and exponent most both be in the range [1, 15].
+   * */
+  u8 preamble_length = 0;
+  if (preamble_bits > 0) {
+    u32 exponent = __ffs(preamble_bits);
+    u32 mantissa = preamble_bits >> exponent;
+    if (exponent < 1 || exponent > 15 || mantissa < 1 || mantissa > 15) {
+      return -EINVAL;
+    }
+
+    preamble_length = SX1280_LORA_PREAMBLE_LENGTH(exponent, mantissa);
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_LORA) {
+    struct sx1280_packet_params packet_params = {
+      .mode = SX1280_MODE_LORA,
+      .lora = priv->cfg.lora.packet,
+    };
+    packet_params.lora.preamble_length = preamble_length;
+
+    if ((err = sx1280_set_packet_params(priv, packet_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.lora.packet.preamble_length = preamble_length;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static ssize_t lora_spreading_factor_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  enum sx1280_lora_spreading_factor sf =
+    priv->cfg.lora.modulation.spreading_factor;
+  mutex_unlock(&priv->lock);
+
+  int f;
+  switch (sf) {
+  case SX1280_LORA_SF_5:  f = 5;  break;
+  case SX1280_LORA_SF_6:  f = 6;  break;
+  case SX1280_LORA_SF_7:  f = 7;  break;
+  case SX1280_LORA_SF_8:  f = 8;  break;
+  case SX1280_LORA_SF_9:  f = 9;  break;
+  case SX1280_LORA_SF_10: f = 10; break;
+  case SX1280_LORA_SF_11: f = 11; break;
+  case SX1280_LORA_SF_12: f = 12; break;
+  default:
+    WARN(1, "invalid internal cfg.lora.modulation.spreading_factor: %d\n", sf);
+    return -EINVAL;
+  }
+
+  return sprintf(buf, "%d\n", f);
+}
+
+static ssize_t lora_spreading_factor_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  int factor;
+  if ((err = kstrtoint(buf, 10, &factor))) {
+    return err;
+  }
+
+  enum sx1280_lora_spreading_factor spreading_factor;
+  switch (factor) {
+  case 5:  spreading_factor = SX1280_LORA_SF_5;  break;
+  case 6:  spreading_factor = SX1280_LORA_SF_6;  break;
+  case 7:  spreading_factor = SX1280_LORA_SF_7;  break;
+  case 8:  spreading_factor = SX1280_LORA_SF_8;  break;
+  case 9:  spreading_factor = SX1280_LORA_SF_9;  break;
+  case 10: spreading_factor = SX1280_LORA_SF_10; break;
+  case 11: spreading_factor = SX1280_LORA_SF_11; break;
+  case 12: spreading_factor = SX1280_LORA_SF_12; break;
+  default:
+    return -EINVAL;
+  }
+
+  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
+    return err;
+  }
+
+  if (priv->cfg.mode == SX1280_MODE_LORA) {
+    struct sx1280_modulation_params mod_params = {
+      .mode = SX1280_MODE_LORA,
+      .lora = priv->cfg.lora.modulation,
+    };
+    mod_params.lora.spreading_factor = spreading_factor;
+
+    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
+      goto fail;
+    }
+  }
+
+  priv->cfg.lora.modulation.spreading_factor = spreading_factor;
+
+fail:
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+static struct device_attribute dev_attr_lora_bandwidth =
+  __ATTR(bandwidth, 0644, lora_bandwidth_show, lora_bandwidth_store);
+static struct device_attribute dev_attr_lora_coding_rate =
+  __ATTR(coding_rate, 0644, lora_coding_rate_show, lora_coding_rate_store);
+static struct device_attribute dev_attr_lora_crc_enable =
+  __ATTR(crc_enable, 0644, lora_crc_enable_show, lora_crc_enable_store);
+static struct device_attribute dev_attr_lora_invert_iq =
+  __ATTR(invert_iq, 0644, lora_invert_iq_show, lora_invert_iq_store);
+static struct device_attribute dev_attr_lora_preamble_bits =
+  __ATTR(preamble_bits, 0644, lora_preamble_bits_show, lora_preamble_bits_store);
+static struct device_attribute dev_attr_lora_spreading_factor =
+  __ATTR(spreading_factor, 0644, lora_spreading_factor_show, lora_spreading_factor_store);
+
+static struct attribute *sx1280_lora_attrs[] = {
+  &dev_attr_lora_bandwidth.attr,
+  &dev_attr_lora_coding_rate.attr,
+  &dev_attr_lora_crc_enable.attr,
+  &dev_attr_lora_invert_iq.attr,
+  &dev_attr_lora_preamble_bits.attr,
+  &dev_attr_lora_spreading_factor.attr,
+  NULL,
+};
+
+static struct attribute_group sx1280_lora_group = {
+  .attrs = sx1280_lora_attrs,
+  .name = "lora",
+};
+
+/**************/
+/* Link sysfs */
+/**************/
+
+/**
+ * Gets whether the data rate is adapted to the link.
+ * @context - process
+ */
+static ssize_t link_adr_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  bool value = priv->adr.enabled;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%d\n", value);
+}
+
+/**
+ * Sets whether the data rate is adapted to the link. While it is, the LoRa
+ * spreading factor or FLRC bitrate is picked from the SNR or RSSI of received
+ * packets, starting from the one configured, which is gone back to when it's
+ * turned off. Changes are agreed on through ARQ frame exchanges, so only
+ * happen while ARQ frames are sent.
+ * @context - process
+ */
+static ssize_t link_adr_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
 ) {
   int err;
-  u8 cmd_tx[] = {
-    SX1280_CMD_WRITE_BUFFER,
-    offset
-  };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  struct spi_transfer xfers[] = {
-    {
-      .tx_buf = cmd_tx,
-      .len = ARRAY_SIZE(cmd_tx),
-      .cs_change = 0
-    },
-    {
-      .tx_buf = data,
-      .len = len
-    }
-  };
+  bool enabled;
+  if ((err = kstrtobool(buf, &enabled))) {
+    return err;
+  }
 
-  if ((err = sx1280_transfer(priv, xfers, ARRAY_SIZE(xfers)))) {
-    dev_err(&priv->spi->dev, "WriteBuffer failed: %d\n", err);
+  if ((err = sx1280_acquire_idle(priv, false))) {
     return err;
   }
 
-  return 0;
+  /* Only one of ADR and rate control can be picking the rate. */
+  if (enabled && priv->rc.enabled) {
+    mutex_unlock(&priv->lock);
+    return -EBUSY;
+  }
+
+  priv->adr.enabled = enabled;
+  sx1280_adr_reset(priv);
+
+  if (enabled) {
+    sx1280_adr_arm(priv, SX1280_ADR_FALLBACK_MS);
+  } else {
+    hrtimer_try_to_cancel(&priv->adr.timer);
+    err = sx1280_rate_restore(priv);
+  }
+
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
 }
 
-static int sx1280_read_buffer(
-  struct sx1280_priv *priv,
-  u8 offset,
-  u8 *data,
-  size_t len
+/**
+ * Gets the history of rate changes, oldest first: one per line with the time
+ * (ns, monotonic), the rate changed from and to, and the averaged level (dB)
+ * it was changed at.
+ * @context - process
+ */
+static ssize_t link_adr_history_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
 ) {
-  int err;
-  u8 cmd_tx[3] = { SX1280_CMD_READ_BUFFER, offset };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_adr *adr = &priv->adr;
+  int len = 0;
 
-  struct spi_transfer xfers[] = {
-    {
-      .tx_buf = cmd_tx,
-      .len = ARRAY_SIZE(cmd_tx),
-      .cs_change = 0
-    },
-    {
-      .rx_buf = data,
-      .len = len
-    }
-  };
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-  if ((err = sx1280_transfer(priv, xfers, ARRAY_SIZE(xfers)))) {
-    dev_err(&priv->spi->dev, "ReadBuffer failed: %d\n", err);
-    return err;
+  unsigned long i = adr->changes > SX1280_ADR_HISTORY_LEN
+    ? adr->changes - SX1280_ADR_HISTORY_LEN
+    : 0;
+
+  for (; i < adr->changes; i++) {
+    struct sx1280_adr_change *change =
+      &adr->history[i % SX1280_ADR_HISTORY_LEN];
+
+    len += sprintf(
+      &buf[len],
+      "%llu %u %u %d\n",
+      change->ns,
+      change->from,
+      change->to,
+      DIV_ROUND_CLOSEST(change->level_qdb, 4)
+    );
   }
 
-  return 0;
+  mutex_unlock(&priv->lock);
+  return len;
 }
 
-static int sx1280_set_sleep(
-  struct sx1280_priv *priv,
-  bool save_buffer,
-  bool save_ram
+/**
+ * Gets the averaged level of received packets, in dB: the SNR in LoRa mode,
+ * and the RSSI (dBm) in FLRC mode.
+ * @context - process
+ */
+static ssize_t link_adr_level_db_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
 ) {
-  int err;
-  u8 sleep_config = (save_buffer << 1) | save_ram;
-  u8 tx[] = { SX1280_CMD_SET_SLEEP, sleep_config };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_adr *adr = &priv->adr;
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetSleep failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  bool valid = adr->enabled && adr->packets && adr->mode == priv->cfg.mode;
+  s32 level_qdb = adr->level >> SX1280_ADR_EWMA_SHIFT;
+  mutex_unlock(&priv->lock);
+
+  if (!valid) {
+    return -ENODATA;
+  }
+
+  return sprintf(buf, "%d\n", DIV_ROUND_CLOSEST(level_qdb, 4));
 }
 
-static int sx1280_set_standby(struct sx1280_priv *priv, u8 mode) {
+/**
+ * Gets the margin kept above the level a rate needs, in dB.
+ * @context - process
+ */
+static ssize_t link_adr_margin_db_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  unsigned int value = priv->adr.margin_db;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%u\n", value);
+}
+
+/**
+ * Sets the margin kept above the level a rate needs, in dB. A larger margin
+ * trades speed for fewer lost packets when the link fades.
+ * @context - process
+ */
+static ssize_t link_adr_margin_db_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
-  u8 tx[] = { SX1280_CMD_SET_STANDBY, mode };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetStandby failed: %d\n", err);
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
     return err;
   }
 
-  return 0;
+  if (value > SX1280_ADR_MARGIN_DB_MAX) {
+    return -EINVAL;
+  }
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  priv->adr.margin_db = value;
+  mutex_unlock(&priv->lock);
+
+  return count;
 }
 
-static int sx1280_set_fs(struct sx1280_priv *priv) {
+/**
+ * Gets the rate in use: the spreading factor in LoRa mode, and the bitrate in
+ * FLRC mode.
+ * @context - process
+ */
+static ssize_t link_adr_rate_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_adr *adr = &priv->adr;
+  unsigned int n;
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  const struct sx1280_adr_rate *rates = sx1280_adr_rates(priv->cfg.mode, &n);
+  u8 param = adr->enabled && adr->mode == priv->cfg.mode
+    ? adr->target
+    : sx1280_rate_current(priv);
+
+  u32 value = rates ? rates[sx1280_adr_index(rates, n, param)].value : 0;
+  mutex_unlock(&priv->lock);
+
+  if (!rates) {
+    return -EOPNOTSUPP;
+  }
+
+  return sprintf(buf, "%u\n", value);
+}
+
+/**
+ * Gets whether the GFSK or FLRC bitrate is learned by probing.
+ * @context - process
+ */
+static ssize_t link_rate_control_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  bool value = priv->rc.enabled;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%d\n", value);
+}
+
+/**
+ * Sets whether the GFSK or FLRC bitrate is learned by probing, starting from
+ * the one configured, which is gone back to when it's turned off. This relies
+ * on the delivery feedback of ARQ, and can't be enabled along with ADR.
+ * @context - process
+ */
+static ssize_t link_rate_control_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
-  u8 tx[] = { SX1280_CMD_SET_FS };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetFs failed: %d\n", err);
+  bool enabled;
+  if ((err = kstrtobool(buf, &enabled))) {
     return err;
   }
 
-  return 0;
+  if ((err = sx1280_acquire_idle(priv, false))) {
+    return err;
+  }
+
+  if (enabled && priv->adr.enabled) {
+    mutex_unlock(&priv->lock);
+    return -EBUSY;
+  }
+
+  priv->rc.enabled = enabled;
+  sx1280_rc_reset(priv);
+
+  if (enabled) {
+    sx1280_rc_arm(priv, SX1280_ADR_FALLBACK_MS);
+  } else {
+    hrtimer_try_to_cancel(&priv->rc.timer);
+    err = sx1280_rate_restore(priv);
+  }
+
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
+}
+
+/**
+ * Gets the link's bitrate, as picked by rate control.
+ * @context - process
+ */
+static ssize_t link_rate_control_rate_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  unsigned int n;
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  const struct sx1280_adr_rate *rates = sx1280_rc_sync(priv, &n);
+  u32 value = rates ? rates[sx1280_adr_index(rates, n, priv->rc.base)].value : 0;
+  mutex_unlock(&priv->lock);
+
+  if (!rates) {
+    return -ENODATA;
+  }
+
+  return sprintf(buf, "%u\n", value);
 }
 
-static int sx1280_set_tx(
-  struct sx1280_priv *priv,
-  u8 period_base,
-  u16 period_base_count
+/**
+ * Gets the delivery statistics of each bitrate, most robust first: one per
+ * line with the bitrate, attempts, successes and the averaged success
+ * probability (%).
+ * @context - process
+ */
+static ssize_t link_rate_control_stats_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
 ) {
-  int err;
-  u8 tx[] = {
-    SX1280_CMD_SET_TX,
-    period_base,
-    period_base_count >> 8,
-    period_base_count & 0xFF
-  };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  unsigned int n;
+  int len = 0;
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetTx failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
-}
-
-static int sx1280_set_rx(
-  struct sx1280_priv *priv,
-  u8 period_base,
-  u16 period_base_count
-) {
-  int err;
-  u8 tx[] = {
-    SX1280_CMD_SET_RX,
-    period_base,
-    period_base_count >> 8,
-    period_base_count & 0xFF
-  };
+  const struct sx1280_adr_rate *rates = sx1280_rc_sync(priv, &n);
+  for (unsigned int i = 0; rates && i < n; i++) {
+    struct sx1280_rc_stats *stats = &priv->rc.stats[i];
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetRx failed: %d\n", err);
-    return err;
+    len += sprintf(
+      &buf[len],
+      "%u %lu %lu %u\n",
+      rates[i].value,
+      stats->attempts,
+      stats->successes,
+      (unsigned int) DIV_ROUND_CLOSEST((u64) stats->prob * 100, SX1280_RC_PROB_ONE)
+    );
   }
 
-  return 0;
+  mutex_unlock(&priv->lock);
+  return len;
 }
 
-static int sx1280_set_rx_duty_cycle(
-  struct sx1280_priv *priv,
-  u8 period_base,
-  u16 rx_period_base_count,
-  u16 sleep_period_base_count
+/**
+ * Gets whether small packets are packed together into shared frames.
+ * @context - process
+ */
+static ssize_t link_aggregation_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
 ) {
-  int err;
-  u8 tx[] = {
-    SX1280_CMD_SET_RX_DUTY_CYCLE,
-    period_base,
-    rx_period_base_count >> 8,
-    rx_period_base_count & 0xFF,
-    sleep_period_base_count >> 8,
-    sleep_period_base_count & 0xFF
-  };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_dbg(&priv->spi->dev, "SetRxDutyCycle failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  bool enabled = priv->link.agg_enabled;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%d\n", enabled);
 }
 
-static int sx1280_set_long_preamble(struct sx1280_priv *priv, bool enable) {
+/**
+ * Sets whether small packets are packed together into shared frames.
+ * @context - process
+ */
+static ssize_t link_aggregation_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
-  u8 tx[] = { SX1280_CMD_SET_LONG_PREAMBLE, enable };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetLongPreamble failed: %d\n", err);
+  bool enabled;
+  if ((err = kstrtobool(buf, &enabled))) {
     return err;
   }
 
-  return 0;
-}
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-static int sx1280_set_cad(struct sx1280_priv *priv) {
-  int err;
-  u8 tx[] = { SX1280_CMD_SET_CAD };
+  priv->link.agg_enabled = enabled;
+  mutex_unlock(&priv->lock);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetCad failed: %d\n", err);
-    return err;
+  /* Send anything that was being held back. */
+  if (!enabled) {
+    kthread_queue_work(priv->worker, &priv->tx_work);
   }
 
-  return 0;
+  return count;
 }
 
-static int sx1280_set_tx_continuous_wave(struct sx1280_priv *priv) {
-  int err;
-  u8 tx[] = { SX1280_CMD_SET_TX_CONTINUOUS_WAVE };
+/**
+ * Gets how long a frame with room to spare may be held back for more packets.
+ * @context - process
+ */
+static ssize_t link_aggregation_delay_us_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetTxContinuousWave failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  unsigned int delay_us = priv->link.agg_delay_us;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%u\n", delay_us);
 }
 
-static int sx1280_set_tx_continuous_preamble(struct sx1280_priv *priv) {
+/**
+ * Sets how long a frame with room to spare may be held back for more packets.
+ * Zero only aggregates packets that are already queued.
+ * @context - process
+ */
+static ssize_t link_aggregation_delay_us_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
-  u8 tx[] = { SX1280_CMD_SET_TX_CONTINUOUS_PREAMBLE };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetTxContinuousPreamble failed: %d\n", err);
+  unsigned int delay_us;
+  if ((err = kstrtouint(buf, 10, &delay_us))) {
     return err;
   }
 
-  return 0;
-}
-
-static int sx1280_set_auto_tx(struct sx1280_priv *priv, u16 time) {
-  int err;
-  u8 tx[] = {
-    SX1280_CMD_SET_AUTO_TX,
-    time >> 8,
-    time & 0xFF
-  };
+  if (delay_us > SX1280_AGG_DELAY_US_MAX) {
+    return -EINVAL;
+  }
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetAutoTx failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  priv->link.agg_delay_us = delay_us;
+  mutex_unlock(&priv->lock);
+
+  return count;
 }
 
-static int sx1280_set_auto_fs(struct sx1280_priv *priv, bool enable) {
-  int err;
-  u8 tx[] = { SX1280_CMD_SET_AUTO_FS, enable };
+/**
+ * Gets the size of the datagram whose cost link/airtime_us reports.
+ * @context - process
+ */
+static ssize_t link_airtime_bytes_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetAutoFs failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  unsigned int len = priv->airtime_query_len;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%u\n", len);
 }
 
-static int sx1280_set_packet_type(
-  struct sx1280_priv *priv,
-  enum sx1280_mode packet_type
+/**
+ * Sets the size of the datagram whose cost link/airtime_us reports.
+ * @context - process
+ */
+static ssize_t link_airtime_bytes_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
 ) {
   int err;
-  u8 tx[] = { SX1280_CMD_SET_PACKET_TYPE, (u8) packet_type };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetPacketType failed: %d\n", err);
+  unsigned int len;
+  if ((err = kstrtouint(buf, 10, &len))) {
     return err;
   }
 
-  return 0;
+  if (len < 1 || len > SX1280_LINK_PAYLOAD_MAX) {
+    return -EINVAL;
+  }
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  priv->airtime_query_len = len;
+  mutex_unlock(&priv->lock);
+
+  return count;
 }
 
-static int sx1280_get_packet_type(
-  struct sx1280_priv *priv,
-  enum sx1280_mode *packet_type
+/**
+ * Gets how long sending a datagram of link/airtime_bytes would take on the air
+ * with the current configuration, or 0 if it can't be sent.
+ * @context - process
+ */
+static ssize_t link_airtime_us_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
 ) {
-  int err;
-  u8 tx[3] = { SX1280_CMD_GET_PACKET_TYPE };
-  u8 rx[3];
-
-  struct spi_transfer xfer = {
-    .tx_buf = tx,
-    .rx_buf = rx,
-    .len = ARRAY_SIZE(rx)
-  };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_transfer(priv, &xfer, 1))) {
-    dev_err(&priv->spi->dev, "GetPacketType failed: %d\n", err);
-    return err;
-  } else if (rx[2] > 0x04) {
-    dev_err(&priv->spi->dev, "GetPacketType returned invalid value: %d\n", rx[2]);
-    return -EINVAL;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  if (packet_type) {
-    *packet_type = (enum sx1280_mode) rx[2];
-  }
+  u64 airtime_ns = sx1280_link_airtime_ns(priv, priv->airtime_query_len);
+  mutex_unlock(&priv->lock);
 
-  return 0;
+  return sprintf(buf, "%llu\n", DIV_ROUND_UP_ULL(airtime_ns, NSEC_PER_USEC));
 }
 
-static int sx1280_set_rf_frequency(
-  struct sx1280_priv *priv,
-  u32 freq
+/**
+ * Gets whether frames are sent with ARQ, i.e. acknowledged and retransmitted.
+ * @context - process
+ */
+static ssize_t link_arq_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
 ) {
-  int err;
-  u8 tx[] = {
-    SX1280_CMD_SET_RF_FREQUENCY,
-    freq >> 16,
-    (freq >> 8) & 0xFF,
-    freq & 0xFF
-  };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetRfFrequency failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  bool value = priv->arq.enabled;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%d\n", value);
 }
 
-static int sx1280_set_tx_params(
-  struct sx1280_priv *priv,
-  u8 power,
-  enum sx1280_ramp_time ramp_time
+/**
+ * Sets whether frames are sent with ARQ, i.e. acknowledged and retransmitted.
+ * ARQ frames addressed to this node are always acknowledged on receive,
+ * whatever this is set to.
+ * @context - process
+ */
+static ssize_t link_arq_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
 ) {
   int err;
-  u8 tx[] = { SX1280_CMD_SET_TX_PARAMS, power, (u8) ramp_time };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetTxParams failed: %d\n", err);
+  bool enabled;
+  if ((err = kstrtobool(buf, &enabled))) {
     return err;
   }
 
-  return 0;
-}
+  if ((err = sx1280_acquire_idle(priv, false))) {
+    return err;
+  }
 
-static int sx1280_set_cad_params(
-  struct sx1280_priv *priv,
-  enum sx1280_cad_symbol_num cad_symbol_num
-) {
-  int err;
-  u8 tx[] = { SX1280_CMD_SET_CAD_PARAMS, (u8) cad_symbol_num };
+  priv->arq.enabled = enabled;
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetCadParams failed: %d\n", err);
-    return err;
+  /* Arm or disarm AutoTx straight away. */
+  if (priv->state == SX1280_STATE_RX) {
+    err = sx1280_listen(priv);
   }
 
-  return 0;
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
 }
 
-static int sx1280_set_buffer_base_address(
-  struct sx1280_priv *priv,
-  u8 tx_base_addr,
-  u8 rx_base_addr
+/**
+ * Gets how long after receiving an ARQ frame the chip sends its ACK.
+ * @context - process
+ */
+static ssize_t link_arq_ack_delay_us_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
 ) {
-  int err;
-  u8 tx[] = {
-    SX1280_CMD_SET_BUFFER_BASE_ADDRESS,
-    tx_base_addr,
-    rx_base_addr
-  };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetBufferBaseAddress failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  unsigned int value = priv->arq.ack_delay_us;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%u\n", value);
 }
 
-static int sx1280_set_modulation_params(
-  struct sx1280_priv *priv,
-  struct sx1280_modulation_params params
+/**
+ * Sets how long after receiving an ARQ frame the chip sends its ACK. This must
+ * leave the driver enough time to fill the ACK in, and be the same throughout
+ * the network for ACK timeouts to be meaningful.
+ * @context - process
+ */
+static ssize_t link_arq_ack_delay_us_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
 ) {
   int err;
-  u8 tx[4] = { SX1280_CMD_SET_MODULATION_PARAMS };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  switch (params.mode) {
-  case SX1280_MODE_FLRC:
-    tx[1] = (u8) params.flrc.bitrate_bandwidth;
-    tx[2] = (u8) params.flrc.coding_rate;
-    tx[3] = (u8) params.flrc.bandwidth_time;
-    break;
-  case SX1280_MODE_GFSK:
-    tx[1] = (u8) params.gfsk.bitrate_bandwidth;
-    tx[2] = (u8) params.gfsk.modulation_index;
-    tx[3] = (u8) params.gfsk.bandwidth_time;
-    break;
-  case SX1280_MODE_LORA:
-  case SX1280_MODE_RANGING:
-    tx[1] = (u8) params.lora.spreading_factor;
-    tx[2] = (u8) params.lora.bandwidth;
-    tx[3] = (u8) params.lora.coding_rate;
-    break;
-  default:
+  u16 delay_us;
+  if ((err = kstrtou16(buf, 10, &delay_us))) {
+    return err;
+  }
+
+  if (delay_us < SX1280_ARQ_ACK_DELAY_US_MIN) {
     return -EINVAL;
   }
 
-  if ((err = sx1280_write(priv, tx, ARRAY_SIZE(tx)))) {
-    dev_err(&priv->spi->dev, "SetModulationParams failed: %d\n", err);
+  if ((err = sx1280_acquire_idle(priv, false))) {
     return err;
   }
 
-  return 0;
+  priv->arq.ack_delay_us = delay_us;
+
+  if (priv->state == SX1280_STATE_RX) {
+    err = sx1280_listen(priv);
+  }
+
+  mutex_unlock(&priv->lock);
+  return err ? err : count;
 }
 
-static int sx1280_set_packet_params(
-  struct sx1280_priv *priv,
-  struct sx1280_packet_params params
+/**
+ * Gets how long to wait for an ACK before trying again.
+ * @context - process
+ */
+static ssize_t link_arq_ack_timeout_ms_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
 ) {
-  int err;
-  u8 tx[8] = { SX1280_CMD_SET_PACKET_PARAMS };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  switch (params.mode) {
-  case SX1280_MODE_FLRC:
-    tx[1] = (u8) params.flrc.agc_preamble_length;
-    tx[2] = (u8) params.flrc.sync_word_length;
-    tx[3] = (u8) params.flrc.sync_word_match;
-    tx[4] = (u8) params.flrc.packet_type;
-    tx[5] = (u8) params.flrc.payload_length;
-    tx[6] = (u8) params.flrc.crc_length;
-    tx[7] = (u8) params.flrc.whitening;
-    break;
-  case SX1280_MODE_GFSK:
-    tx[1] = (u8) params.gfsk.preamble_length;
-    tx[2] = (u8) params.gfsk.sync_word_length;
-    tx[3] = (u8) params.gfsk.sync_word_match;
-    tx[4] = (u8) params.gfsk.packet_type;
-    tx[5] = (u8) params.gfsk.payload_length;
-    tx[6] = (u8) params.gfsk.crc_length;
-    tx[7] = (u8) params.gfsk.whitening;
-    break;
-  case SX1280_MODE_LORA:
-  case SX1280_MODE_RANGING:
-    tx[1] = (u8) params.lora.preamble_length;
-    tx[2] = (u8) params.lora.header_type;
-    tx[3] = (u8) params.lora.payload_length;
-    tx[4] = (u8) params.lora.crc;
-    tx[5] = (u8) params.lora.iq;
-    break;
-  default:
-    return -EINVAL;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  if ((err = sx1280_write(priv, tx, sizeof(tx)))) {
-    dev_err(&priv->spi->dev, "SetPacketParams: %d\n", err);
-    return err;
-  }
+  unsigned int value = priv->arq.ack_timeout_ms;
+  mutex_unlock(&priv->lock);
 
-  return 0;
+  return sprintf(buf, "%u\n", value);
 }
 
-static int sx1280_get_rx_buffer_status(
-  struct sx1280_priv *priv,
-  u8 *rx_payload_len,
-  u8 *rx_start_buffer_ptr
+/**
+ * Sets how long to wait for an ACK before trying again. This has to cover the
+ * ACK delay and the ACK's time on air.
+ * @context - process
+ */
+static ssize_t link_arq_ack_timeout_ms_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
 ) {
   int err;
-  u8 tx[4] = { SX1280_CMD_GET_RX_BUFFER_STATUS };
-  u8 rx[4];
-
-  struct spi_transfer xfer = {
-    .tx_buf = tx,
-    .rx_buf = rx,
-    .len = ARRAY_SIZE(rx)
-  };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_transfer(priv, &xfer, 1))) {
-    dev_err(&priv->spi->dev, "GetRxBufferStatus failed: %d\n", err);
+  unsigned int timeout_ms;
+  if ((err = kstrtouint(buf, 10, &timeout_ms))) {
     return err;
   }
 
-  if (rx_payload_len) {
-    *rx_payload_len = rx[2];
+  if (timeout_ms < 1 || timeout_ms > SX1280_ARQ_ACK_TIMEOUT_MS_MAX) {
+    return -EINVAL;
   }
 
-  if (rx_start_buffer_ptr) {
-    *rx_start_buffer_ptr = rx[3];
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  priv->arq.ack_timeout_ms = timeout_ms;
+  mutex_unlock(&priv->lock);
+
+  return count;
 }
 
-static int sx1280_get_packet_status(
-  struct sx1280_priv *priv,
-  union sx1280_packet_status *packet_status
+/**
+ * Gets the node ID that ARQ frames are addressed to.
+ * @context - process
+ */
+static ssize_t link_arq_dst_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
 ) {
-  int err;
-  u8 tx[7] = { SX1280_CMD_GET_PACKET_STATUS };
-  u8 rx[7];
-
-  struct spi_transfer xfer = {
-    .tx_buf = tx,
-    .rx_buf = rx,
-    .len = ARRAY_SIZE(rx)
-  };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_transfer(priv, &xfer, 1))) {
-    dev_err(&priv->spi->dev, "GetPacketStatus failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  memcpy(&packet_status->raw, &rx[2], 5);
-  return 0;
+  u8 dst = priv->arq.dst;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%u\n", dst);
 }
 
-static int sx1280_get_rssi_inst(struct sx1280_priv *priv, u8 *rssi_inst) {
+/**
+ * Sets the node ID that ARQ frames are addressed to, from the next frame on.
+ * Frames addressed to the broadcast ID are sent without ARQ.
+ * @context - process
+ */
+static ssize_t link_arq_dst_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
-  u8 tx[3] = { SX1280_CMD_GET_RSSI_INST };
-  u8 rx[3];
-
-  struct spi_transfer xfer = {
-    .tx_buf = tx,
-    .rx_buf = rx,
-    .len = ARRAY_SIZE(rx)
-  };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_transfer(priv, &xfer, 1))) {
-    dev_err(&priv->spi->dev, "GetRssiInst failed: %d\n", err);
+  u8 dst;
+  if ((err = kstrtou8(buf, 0, &dst))) {
     return err;
   }
 
-  if (rssi_inst) {
-    *rssi_inst = rx[2];
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  priv->arq.dst = dst;
+  mutex_unlock(&priv->lock);
+
+  return count;
 }
 
-/** Configures the DIO pins to act as interrupts according to their masks. */
-static int sx1280_set_dio_irq_params(
-  struct sx1280_priv *priv,
-  u16 irq_mask,
-  u16 dio_mask[3]
-) {
-  int err;
-  u8 tx[] = {
-    SX1280_CMD_SET_DIO_IRQ_PARAMS,
-    irq_mask >> 8,
-    irq_mask & 0xFF,
-    dio_mask[0] >> 8,
-    dio_mask[0] & 0xFF,
-    dio_mask[1] >> 8,
-    dio_mask[1] & 0xFF,
-    dio_mask[2] >> 8,
-    dio_mask[2] & 0xFF
-  };
+/**
+ * Gets how many times a frame is retransmitted before it is given up on.
+ * @context - process
+ */
+static ssize_t link_arq_retries_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, sizeof(tx)))) {
-    dev_err(&priv->spi->dev, "SetDioIrqParams failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  unsigned int value = priv->arq.retries_max;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%u\n", value);
 }
 
-/** Gets the current state of the IRQ register. */
-static int sx1280_get_irq_status(struct sx1280_priv *priv, u16 *irq_status) {
+/**
+ * Sets how many times a frame is retransmitted before it is given up on.
+ * @context - process
+ */
+static ssize_t link_arq_retries_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
-  u8 tx[4] = { SX1280_CMD_GET_IRQ_STATUS };
-  u8 rx[4];
-
-  struct spi_transfer xfer = {
-    .tx_buf = tx,
-    .rx_buf = rx,
-    .len = ARRAY_SIZE(rx),
-  };
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_transfer(priv, &xfer, 1))) {
-    dev_err(&priv->spi->dev, "GetIrqStatus failed: %d\n", err);
+  unsigned int retries;
+  if ((err = kstrtouint(buf, 10, &retries))) {
     return err;
   }
 
-  if (irq_status) {
-    /* The IRQ status is returned in big-endian format. */
-    *irq_status = ((u16) rx[2] << 8) | rx[3];
+  if (retries > SX1280_ARQ_RETRIES_MAX) {
+    return -EINVAL;
   }
 
-  return 0;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  priv->arq.retries_max = retries;
+  mutex_unlock(&priv->lock);
+
+  return count;
 }
 
-/** Clears flags in the IRQ register according to the mask. */
-static int sx1280_clear_irq_status(struct sx1280_priv *priv, u16 irq_mask) {
-  int err;
-  u8 tx[] = {
-    SX1280_CMD_CLR_IRQ_STATUS,
-    irq_mask >> 8,
-    irq_mask & 0xFF
-  };
+/**
+ * Gets whether IP headers are compressed on the air.
+ * @context - process
+ */
+static ssize_t link_header_compression_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((err = sx1280_write(priv, tx, sizeof(tx)))) {
-    dev_err(&priv->spi->dev, "ClearIrqStatus failed: %d\n", err);
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return 0;
+  bool enabled = priv->link.iphc_enabled;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%d\n", enabled);
 }
 
-/*******************
-* Driver functions *
-*******************/
+/**
+ * Sets whether IP headers are compressed on the air. Compressed frames are
+ * always understood on receive, whatever this is set to.
+ * @context - process
+ */
+static ssize_t link_header_compression_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-static int sx1280_open(struct net_device *netdev) {
-  netdev_dbg(
-    netdev,
-    "ndo_open called by process: %s (pid %d)\n",
-    current->comm,
-    current->pid
-  );
+  bool enabled;
+  if ((err = kstrtobool(buf, &enabled))) {
+    return err;
+  }
 
-  if (current->parent) {
-    netdev_dbg(
-      netdev,
-      "  parent process: %s (pid %d)\n",
-      current->parent->comm,
-      current->parent->pid
-    );
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  netif_carrier_on(netdev);
-  netif_start_queue(netdev);
-  return 0;
+  priv->link.iphc_enabled = enabled;
+  mutex_unlock(&priv->lock);
+
+  return count;
 }
 
-static int sx1280_stop(struct net_device *netdev) {
-  netdev_dbg(
-    netdev,
-    "ndo_stop called by process: %s (pid %d)\n",
-    current->comm,
-    current->pid
-  );
+/**
+ * Gets the node ID that identifies this node's fragments and ARQ frames.
+ * @context - process
+ */
+static ssize_t link_node_id_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (current->parent) {
-    netdev_dbg(
-      netdev,
-      "  parent process: %s (pid %d)\n",
-      current->parent->comm,
-      current->parent->pid
-    );
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  netif_stop_queue(netdev);
-  netif_carrier_off(netdev);
-  return 0;
+  u8 node_id = priv->link.node_id;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%u\n", node_id);
 }
 
 /**
- * Called to transmit a single packet buffer.
- * @context atomic | process
+ * Sets the node ID that identifies this node's fragments and ARQ frames. Nodes
+ * sharing a channel should have distinct IDs, or their fragments may be mixed
+ * up. The broadcast ID can't be taken.
+ * @context - process
  */
-static netdev_tx_t sx1280_xmit(struct sk_buff *skb, struct net_device *netdev) {
+static ssize_t link_node_id_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
-  u16 protocol = ntohs(skb->protocol);
-
-  /* Log information about the packet for debugging. */
-  netdev_dbg(netdev, "xmit: proto=0x%04x, len=%d\n", protocol, skb->len);
-
-  switch (protocol) {
-  case ETH_P_IP:;
-    struct iphdr *iph = (struct iphdr *) skb->data;
-    netdev_dbg(
-      netdev,
-      "  ipv4: src=%pI4, dst=%pI4\n",
-      &iph->saddr,
-      &iph->daddr
-    );
-
-    break;
-  case ETH_P_IPV6:;
-    struct ipv6hdr *ip6h = (struct ipv6hdr *) skb->data;
-    netdev_dbg(
-      netdev,
-      "  ipv6: src=%pI6c, dst=%pI6c\n",
-      &ip6h->saddr,
-      &ip6h->daddr
-    );
 
-    break;
+  u8 node_id;
+  if ((err = kstrtou8(buf, 0, &node_id))) {
+    return err;
   }
 
-  /*
-   * Stop the packet queue, applying backpressure to the kernel networking stack
-   * that allows the driver to send one packet at a time. Packets that arrive in
-   * the intervening time will be queued by the networking stack.
-   *
-   * Once the corresponding packet has been sent and the chip is ready for a new
-   * one, `netif_wake_queue` is called to tell the kernel that it is permitted
-   * to call `sx1280_xmit` once again.
-   */
-  netif_stop_queue(netdev);
-  spin_lock(&priv->tx_lock);
+  if (node_id == SX1280_NODE_BROADCAST) {
+    return -EINVAL;
+  }
 
-  /*
-   * Check if there is already a packet being transmitted.
-   *
-   * Generally, the kernel will not call `ndo_start_xmit` if the packet queue is
-   * stopped. However, if there are packets in flight before the queue was
-   * stopped, they will still arrive here. In that case, apply backpressure to
-   * the networking stack.
-   */
-  if (priv->tx_skb) {
-    netdev_err(netdev, "packet transmission requested after queue frozen\n");
-    return NETDEV_TX_BUSY;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  /* Queue the work so that it can be performed in a non-atomic context. */
-  priv->tx_skb = skb;
-  queue_work(priv->xmit_queue, &priv->tx_work);
+  priv->link.node_id = node_id;
+  mutex_unlock(&priv->lock);
 
-  spin_unlock(&priv->tx_lock);
-  return NETDEV_TX_OK;
+  return count;
 }
 
-static void sx1280_tx_work(struct work_struct *work) {
-  int err;
-  struct sx1280_priv *priv = container_of(work, struct sx1280_priv, tx_work);
-  struct net_device *netdev = priv->netdev;
-
-  mutex_lock(&priv->lock);
-  spin_lock(&priv->tx_lock);
-  struct sk_buff *skb = priv->tx_skb;
-  spin_unlock(&priv->tx_lock);
+/**
+ * Gets how datagram payloads are compressed: "none" or "lz4".
+ * @context - process
+ */
+static ssize_t link_payload_compression_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (!skb) {
-    netdev_warn(netdev, "transmission queued without packet skb\n");
-    goto quit;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  struct sx1280_packet_params params = { .mode = priv->cfg.mode };
-  switch (params.mode) {
-  case SX1280_MODE_FLRC:
-    /* TODO: Pad FLRC packets less than 6 bytes. */
-    if (
-      skb->len < SX1280_FLRC_PAYLOAD_LENGTH_MIN
-      || skb->len > SX1280_FLRC_PAYLOAD_LENGTH_MAX
-    ) {
-      netdev_warn(netdev, "invalid FLRC packet size: %d bytes\n", skb->len);
-      goto drop;
-    }
+  bool lz4 = priv->link.lz4_enabled;
+  mutex_unlock(&priv->lock);
 
-    priv->cfg.flrc.packet.payload_length = skb->len;
-    params.flrc = priv->cfg.flrc.packet;
-    break;
-  case SX1280_MODE_GFSK:
-    if (skb->len > SX1280_GFSK_PAYLOAD_LENGTH_MAX) {
-      netdev_warn(netdev, "invalid GFSK packet size: %d bytes\n", skb->len);
-      goto drop;
-    }
+  return sprintf(buf, "%s\n", lz4 ? "lz4" : "none");
+}
 
-    priv->cfg.gfsk.packet.payload_length = skb->len;
-    params.gfsk = priv->cfg.gfsk.packet;
-    break;
-  case SX1280_MODE_LORA:
-    if (
-      skb->len < SX1280_LORA_PAYLOAD_LENGTH_MIN
-      || skb->len > SX1280_LORA_PAYLOAD_LENGTH_MAX
-    ) {
-      netdev_warn(netdev, "invalid LoRa packet size: %d bytes\n", skb->len);
-      goto drop;
-    }
+/**
+ * Sets how datagram payloads are compressed: "none" or "lz4". Compressed frames
+ * are always understood on receive, whatever this is set to.
+ * @context - process
+ */
+static ssize_t link_payload_compression_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-    priv->cfg.lora.packet.payload_length = skb->len;
-    params.lora = priv->cfg.lora.packet;
-    break;
-  default:
-    /* Packets can't be sent in ranging mode. */
-    netdev_warn(netdev, "packet transmission requested in ranging mode\n");
-    goto drop;
+  bool lz4;
+  if (sysfs_streq(buf, "none")) {
+    lz4 = false;
+  } else if (sysfs_streq(buf, "lz4")) {
+    lz4 = true;
+  } else {
+    return -EINVAL;
   }
 
-  netdev_dbg(netdev, "tx: %*ph\n", skb->len, skb->data);
-
-  /* Write packet data and packet parameters onto the chip. */
-  if (
-    (err = sx1280_set_packet_params(priv, params))
-    || (err = sx1280_write_buffer(priv, 0x00, skb->data, skb->len))
-    || (err = sx1280_set_tx(priv, priv->cfg.period_base, priv->cfg.period_base_count))
-  ) {
-    goto drop;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  priv->state = SX1280_STATE_TX;
+  priv->link.lz4_enabled = lz4;
   mutex_unlock(&priv->lock);
-  return;
 
-drop:
-  /* Free the SKB. */
-  spin_lock(&priv->tx_lock);
-  dev_kfree_skb(skb);
-  priv->tx_skb = NULL;
-  spin_unlock(&priv->tx_lock);
+  return count;
+}
+
+/**
+ * Gets how long a partially received datagram waits for its missing fragments.
+ * @context - process
+ */
+static ssize_t link_reassembly_timeout_ms_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  /* Register the packet as dropped. */
-  netdev->stats.tx_dropped++;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-quit:
+  unsigned int timeout_ms = priv->link.reasm_timeout_ms;
   mutex_unlock(&priv->lock);
-  netif_wake_queue(priv->netdev);
-  netdev_warn(netdev, "dropped invalid tx packet: %d\n", err);
+
+  return sprintf(buf, "%u\n", timeout_ms);
 }
 
-#ifdef DEBUG
-static void sx1280_check_status(struct work_struct *work) {
-  struct sx1280_priv *priv = container_of(
-    work,
-    struct sx1280_priv,
-    status_check.work
-  );
+/**
+ * Sets how long a partially received datagram waits for its missing fragments.
+ * Datagrams already being reassembled keep their current deadline.
+ * @context - process
+ */
+static ssize_t link_reassembly_timeout_ms_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  struct spi_device *spi = priv->spi;
+  unsigned int timeout_ms;
+  if ((err = kstrtouint(buf, 10, &timeout_ms))) {
+    return err;
+  }
 
-  u8 status;
-  enum sx1280_mode packet_type;
-  u8 rx_len;
-  u8 rx_start;
-  union sx1280_packet_status packet_status;
-  u8 rssi_inst;
-  u16 irq_status;
+  if (timeout_ms < 1 || timeout_ms > 60000) {
+    return -EINVAL;
+  }
 
-  ktime_t start = ktime_get();
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-  mutex_lock(&priv->lock);
+  priv->link.reasm_timeout_ms = timeout_ms;
+  mutex_unlock(&priv->lock);
 
-  /* Get all statuses throughout the chip. */
-  sx1280_get_status(priv, &status);
-  sx1280_get_packet_type(priv, &packet_type);
-  sx1280_get_rx_buffer_status(priv, &rx_len, &rx_start);
-  sx1280_get_packet_status(priv, &packet_status);
-  sx1280_get_rssi_inst(priv, &rssi_inst);
-  sx1280_get_irq_status(priv, &irq_status);
+  return count;
+}
 
-  u8 payload_len;
-  u8 preamble_settings;
-  sx1280_read_register(priv, SX1280_REG_PAYLOAD_LENGTH, &payload_len, 1);
-  sx1280_read_register(priv, SX1280_REG_PACKET_PREAMBLE_SETTINGS, &preamble_settings, 1);
+static struct device_attribute dev_attr_link_adr =
+  __ATTR(adr, 0644, link_adr_show, link_adr_store);
+static struct device_attribute dev_attr_link_adr_history =
+  __ATTR(adr_history, 0444, link_adr_history_show, NULL);
+static struct device_attribute dev_attr_link_adr_level_db =
+  __ATTR(adr_level_db, 0444, link_adr_level_db_show, NULL);
+static struct device_attribute dev_attr_link_adr_margin_db =
+  __ATTR(
+    adr_margin_db,
+    0644,
+    link_adr_margin_db_show,
+    link_adr_margin_db_store
+  );
+static struct device_attribute dev_attr_link_adr_rate =
+  __ATTR(adr_rate, 0444, link_adr_rate_show, NULL);
+static struct device_attribute dev_attr_link_aggregation =
+  __ATTR(aggregation, 0644, link_aggregation_show, link_aggregation_store);
+static struct device_attribute dev_attr_link_aggregation_delay_us =
+  __ATTR(
+    aggregation_delay_us,
+    0644,
+    link_aggregation_delay_us_show,
+    link_aggregation_delay_us_store
+  );
+static struct device_attribute dev_attr_link_airtime_bytes =
+  __ATTR(
+    airtime_bytes,
+    0644,
+    link_airtime_bytes_show,
+    link_airtime_bytes_store
+  );
+static struct device_attribute dev_attr_link_airtime_us =
+  __ATTR(airtime_us, 0444, link_airtime_us_show, NULL);
+static struct device_attribute dev_attr_link_arq =
+  __ATTR(arq, 0644, link_arq_show, link_arq_store);
+static struct device_attribute dev_attr_link_arq_ack_delay_us =
+  __ATTR(
+    arq_ack_delay_us,
+    0644,
+    link_arq_ack_delay_us_show,
+    link_arq_ack_delay_us_store
+  );
+static struct device_attribute dev_attr_link_arq_ack_timeout_ms =
+  __ATTR(
+    arq_ack_timeout_ms,
+    0644,
+    link_arq_ack_timeout_ms_show,
+    link_arq_ack_timeout_ms_store
+  );
+static struct device_attribute dev_attr_link_arq_dst =
+  __ATTR(arq_dst, 0644, link_arq_dst_show, link_arq_dst_store);
+static struct device_attribute dev_attr_link_arq_retries =
+  __ATTR(arq_retries, 0644, link_arq_retries_show, link_arq_retries_store);
+static struct device_attribute dev_attr_link_header_compression =
+  __ATTR(
+    header_compression,
+    0644,
+    link_header_compression_show,
+    link_header_compression_store
+  );
+static struct device_attribute dev_attr_link_node_id =
+  __ATTR(node_id, 0644, link_node_id_show, link_node_id_store);
+static struct device_attribute dev_attr_link_payload_compression =
+  __ATTR(
+    payload_compression,
+    0644,
+    link_payload_compression_show,
+    link_payload_compression_store
+  );
+static struct device_attribute dev_attr_link_rate_control =
+  __ATTR(rate_control, 0644, link_rate_control_show, link_rate_control_store);
+static struct device_attribute dev_attr_link_rate_control_rate =
+  __ATTR(rate_control_rate, 0444, link_rate_control_rate_show, NULL);
+static struct device_attribute dev_attr_link_rate_control_stats =
+  __ATTR(rate_control_stats, 0444, link_rate_control_stats_show, NULL);
+static struct device_attribute dev_attr_link_reassembly_timeout_ms =
+  __ATTR(
+    reassembly_timeout_ms,
+    0644,
+    link_reassembly_timeout_ms_show,
+    link_reassembly_timeout_ms_store
+  );
 
-  dev_dbg(&spi->dev, "status check:\n");
-  dev_dbg(&spi->dev, "  status=0x%02x\n", status);
-  dev_dbg(&spi->dev, "  mode=%u\n", packet_type);
-  dev_dbg(&spi->dev, "  rx_start=0x%02x, rx_len=%u\n", rx_start, rx_len);
-  dev_dbg(&spi->dev, "  pkt_status=%*ph\n", 5, packet_status.raw);
-  dev_dbg(&spi->dev, "  rssi_inst=%u\n", rssi_inst);
-  dev_dbg(&spi->dev, "  irq=0x%04x\n", irq_status);
-  dev_dbg(&spi->dev, "  payload_len=%u\n", payload_len);
-  dev_dbg(&spi->dev, "  preamble_settings=0x%02x\n", preamble_settings);
+static struct attribute *sx1280_link_attrs[] = {
+  &dev_attr_link_adr.attr,
+  &dev_attr_link_adr_history.attr,
+  &dev_attr_link_adr_level_db.attr,
+  &dev_attr_link_adr_margin_db.attr,
+  &dev_attr_link_adr_rate.attr,
+  &dev_attr_link_aggregation.attr,
+  &dev_attr_link_aggregation_delay_us.attr,
+  &dev_attr_link_airtime_bytes.attr,
+  &dev_attr_link_airtime_us.attr,
+  &dev_attr_link_arq.attr,
+  &dev_attr_link_arq_ack_delay_us.attr,
+  &dev_attr_link_arq_ack_timeout_ms.attr,
+  &dev_attr_link_arq_dst.attr,
+  &dev_attr_link_arq_retries.attr,
+  &dev_attr_link_header_compression.attr,
+  &dev_attr_link_node_id.attr,
+  &dev_attr_link_payload_compression.attr,
+  &dev_attr_link_rate_control.attr,
+  &dev_attr_link_rate_control_rate.attr,
+  &dev_attr_link_rate_control_stats.attr,
+  &dev_attr_link_reassembly_timeout_ms.attr,
+  NULL,
+};
 
-  ktime_t end = ktime_get();
-  s64 time = ktime_to_us(ktime_sub(end, start));
-  dev_dbg(&spi->dev, "  time=%lld us\n", time);
+static struct attribute_group sx1280_link_group = {
+  .attrs = sx1280_link_attrs,
+  .name = "link",
+};
+
+/*************/
+/* MAC sysfs */
+/*************/
+
+/**
+ * Gets the length of a CSMA backoff slot.
+ * @context - process
+ */
+static ssize_t mac_backoff_slot_us_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  unsigned int value = priv->mac.slot_us;
   mutex_unlock(&priv->lock);
-  schedule_delayed_work(&priv->status_check, 5 * HZ);
-}
 
-#endif
+  return sprintf(buf, "%u\n", value);
+}
 
 /**
- * Sets the chip into continuous RX mode to listen for packets.
- * @context process & locked
+ * Sets the length of a CSMA backoff slot, which should be around the time
+ * it takes to assess the channel and start transmitting.
+ * @context - process
  */
-static int sx1280_listen(struct sx1280_priv *priv) {
+static ssize_t mac_backoff_slot_us_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  struct sx1280_packet_params packet_params = { .mode = priv->cfg.mode };
-  switch (packet_params.mode) {
-  case SX1280_MODE_FLRC:
-    priv->cfg.flrc.packet.payload_length = SX1280_FLRC_PAYLOAD_LENGTH_MAX;
-    packet_params.flrc = priv->cfg.flrc.packet;
-    break;
-  case SX1280_MODE_GFSK:
-    priv->cfg.gfsk.packet.payload_length = SX1280_GFSK_PAYLOAD_LENGTH_MAX;
-    packet_params.gfsk = priv->cfg.gfsk.packet;
-    break;
-  case SX1280_MODE_LORA:
-    priv->cfg.lora.packet.payload_length = SX1280_LORA_PAYLOAD_LENGTH_MAX;
-    packet_params.lora = priv->cfg.lora.packet;
-    break;
-  case SX1280_MODE_RANGING:
-    /* TODO */
-    break;
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
+    return err;
   }
 
-  if (
-    (err = sx1280_set_packet_params(priv, packet_params))
-    || (err = sx1280_set_rx(priv, priv->cfg.period_base, 0xFFFF))
-  ) {
-    dev_err(&priv->spi->dev, "failed to transition to listen\n");
+  if (value < 1 || value > SX1280_MAC_SLOT_US_MAX) {
+    return -EINVAL;
   }
 
-  /* Wake up all waiters that are waiting for idle (anything but Tx). */
-  priv->state = SX1280_STATE_RX;
-  wake_up_all(&priv->idle_wait);
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-  return err;
+  priv->mac.slot_us = value;
+  mutex_unlock(&priv->lock);
+
+  return count;
 }
 
 /**
- * @context process & locked
+ * Gets whether the channel is assessed with CAD in LoRa mode.
+ * @context - process
  */
-static void sx1280_irq_tx(struct sx1280_priv *priv, u16 mask) {
-  struct net_device *netdev = priv->netdev;
+static ssize_t mac_cad_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if ((mask & SX1280_IRQ_TX_DONE) || (mask & SX1280_IRQ_RX_TX_TIMEOUT)) {
-    /* Free the previous Tx packet in preparation for the next. */
-    spin_lock(&priv->tx_lock);
-    unsigned int skb_len = priv->tx_skb->len;
-    dev_kfree_skb(priv->tx_skb);
-    priv->tx_skb = NULL;
-    spin_unlock(&priv->tx_lock);
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-    if (mask & SX1280_IRQ_TX_DONE) {
-      netdev->stats.tx_packets++;
-      netdev->stats.tx_bytes += skb_len;
-    } else {
-      /* A timeout results in the packet being dropped. */
-      netdev->stats.tx_dropped++;
-      netdev_warn(netdev, "tx timeout (packet dropped)\n");
-    }
+  bool value = priv->mac.cad;
+  mutex_unlock(&priv->lock);
 
-    /* Put the chip back into Rx mode and wake the packet queue. */
-    /*
-     * TODO: If there are packets queued, send them immediately instead of
-     * switching back into Rx.
-     */
-    sx1280_listen(priv);
-    netif_wake_queue(netdev);
-  } else {
-    netdev_warn(netdev, "  unhandled tx irq\n");
-  }
+  return sprintf(buf, "%d\n", value);
 }
 
-static void sx1280_irq_rx(struct sx1280_priv *priv, u16 mask) {
+/**
+ * Sets whether the channel is assessed with channel activity detection in LoRa
+ * mode, rather than the instantaneous RSSI. CAD picks up LoRa signals below the
+ * noise floor, but takes a few symbols.
+ * @context - process
+ */
+static ssize_t mac_cad_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
-  struct net_device *netdev = priv->netdev;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (mask & SX1280_IRQ_RX_DONE) {
-    union sx1280_packet_status status;
-    if ((err = sx1280_get_packet_status(priv, &status))) {
-      goto fail;
-    }
+  bool value;
+  if ((err = kstrtobool(buf, &value))) {
+    return err;
+  }
 
-    /* TODO: Set the RSSI to be publicly accessible. */
-    switch (priv->cfg.mode) {
-    case SX1280_MODE_FLRC:
-    case SX1280_MODE_GFSK:
-      netdev_dbg(
-        netdev,
-        "rx: rssi_sync=0x%02x, errors=0x%02x, status=0x%02x, sync=0x%02x\n",
-        status.gfsk_flrc.rssi_sync,
-        status.gfsk_flrc.errors,
-        status.gfsk_flrc.status,
-        status.gfsk_flrc.sync
-      );
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-      break;
-    case SX1280_MODE_LORA:
-      netdev_dbg(
-        netdev,
-        "rx: rssi=%d, snr=%d\n",
-        status.lora.rssi_sync,
-        status.lora.snr
-      );
+  priv->mac.cad = value;
+  mutex_unlock(&priv->lock);
 
-      break;
-    case SX1280_MODE_RANGING:
-      netdev_err(netdev, "received packet in ranging mode\n");
-      err = -EIO;
-      goto fail;
-    }
+  return count;
+}
 
-    /* Check errors after checking packet status for accurate debugging. */
-    if (
-      (mask & SX1280_IRQ_SYNC_WORD_ERROR)
-      || (mask & SX1280_IRQ_HEADER_ERROR)
-      || (mask & SX1280_IRQ_CRC_ERROR)
-    ) {
-      netdev_dbg(netdev, "rx error: mask=0x%04x\n", mask);
-      netdev->stats.rx_errors++;
-      goto fail;
-    }
+/**
+ * Gets the RSSI at or above which the channel is considered busy.
+ * @context - process
+ */
+static ssize_t mac_cca_threshold_dbm_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-    u8 start, len;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-    /*
-     * Get the start and length of the received packet.
-     *
-     * The start should always be the same due to how the buffer is partitioned
-     * in setup, but length has to be fetched so it might as well use the
-     * offset provided.
-     */
-    if ((err = sx1280_get_rx_buffer_status(priv, &len, &start))) {
-      goto fail;
-    }
+  int value = priv->mac.cca_threshold_dbm;
+  mutex_unlock(&priv->lock);
 
-    netdev_dbg(netdev, "  start=0x%02x, len=%u\n", start, len);
+  return sprintf(buf, "%d\n", value);
+}
 
-    /* Allocate an SKB to hold the packet data and pass it to userspace. */
-    struct sk_buff *skb = dev_alloc_skb((unsigned int) len);
-    if (!skb) {
-      netdev_err(netdev, "failed to allocate SKB for RX packet\n");
-      err = -ENOMEM;
-      goto fail;
-    }
+/**
+ * Sets the RSSI at or above which the channel is considered busy.
+ * @context - process
+ */
+static ssize_t mac_cca_threshold_dbm_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-    /* Read the RX packet data directly into the SKB. */
-    void *rx_data = skb_put(skb, (unsigned int) len);
-    err = sx1280_read_buffer(priv, start, (u8 *) rx_data, (size_t) len);
-    if (err) {
-      goto fail;
-    }
+  int value;
+  if ((err = kstrtoint(buf, 10, &value))) {
+    return err;
+  }
 
-    /* Inspect the IP header to determine the version. */
-    u8 version = (((u8 *) rx_data)[0] >> 4) & 0x0F;
+  if (value < -128 || value > 0) {
+    return -EINVAL;
+  }
 
-    netdev_dbg(netdev, "rx: %*ph\n", len, rx_data);
-    skb->dev = netdev;
-    skb->protocol = version == 6 ? htons(ETH_P_IPV6) : htons(ETH_P_IP);
-    skb->ip_summed = CHECKSUM_NONE;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-    /* Update netdev stats. */
-    netdev->stats.rx_packets++;
-    netdev->stats.rx_bytes += len;
+  priv->mac.cca_threshold_dbm = value;
+  mutex_unlock(&priv->lock);
 
-    netif_rx(skb);
-  } else {
-    netdev_warn(netdev, "  unhandled rx irq\n");
+  return count;
+}
+
+/**
+ * Gets whether frames are only sent once the channel is clear (CSMA/CA).
+ * @context - process
+ */
+static ssize_t mac_csma_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return;
+  bool enabled = priv->mac.enabled;
+  mutex_unlock(&priv->lock);
 
-fail:
-  sx1280_listen(priv);
+  return sprintf(buf, "%d\n", enabled);
 }
 
 /**
- * Threaded interrupt handler for DIO interrupt requests.
- * @context process
+ * Sets whether frames are only sent once the channel is clear (CSMA/CA). A
+ * frame already waiting for the channel is still sent with CSMA/CA.
+ * @context - process
  */
-static irqreturn_t sx1280_irq(int irq, void *dev_id) {
+static ssize_t mac_csma_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
-  struct sx1280_priv *priv = (struct sx1280_priv *) dev_id;
-  struct spi_device *spi = priv->spi;
-
-  mutex_lock(&priv->lock);
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  /*
-   * The SX1280 can give spurious interrupts during reset, and these should be
-   * ignored.
-   */
-  u16 mask;
-  if (
-    !priv->initialized
-    || (err = sx1280_get_irq_status(priv, &mask))
-  ) {
-    goto fail;
+  bool enabled;
+  if ((err = kstrtobool(buf, &enabled))) {
+    return err;
   }
 
-  dev_dbg(&spi->dev, "interrupt: mask=0x%04x\n", mask);
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-  /* Acknowledge all interrupts immediately. */
-  sx1280_clear_irq_status(priv, 0xFFFF);
+  priv->mac.enabled = enabled;
+  mutex_unlock(&priv->lock);
 
-  switch (priv->state) {
-  case SX1280_STATE_RX: sx1280_irq_rx(priv, mask); break;
-  case SX1280_STATE_TX: sx1280_irq_tx(priv, mask); break;
-  default:
-    dev_warn(&spi->dev, "  (unhandled)\n");
-  }
+  return count;
+}
 
-  /*
-   * Handle interrupts specified by the mask.
-   */
+/**
+ * Gets the share of time the transmitter may be on, in percent.
+ * @context - process
+ */
+static ssize_t mac_duty_cycle_percent_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  // if ((mask & SX1280_IRQ_TX_DONE) || (mask & SX1280_IRQ_RX_TX_TIMEOUT)) {
-  //  /* Free the previous Tx packet in preparation for the next. */
-  //   spin_lock(&priv->tx_lock);
-  //   unsigned int skb_len = priv->tx_skb->len;
-  //   dev_kfree_skb(priv->tx_skb);
-  //   priv->tx_skb = NULL;
-  //   spin_unlock(&priv->tx_lock);
-  //
-  //   /* Update netdev stats. */
-  //   if (mask & SX1280_IRQ_TX_DONE) {
-  //     netdev->stats.tx_packets++;
-  //     netdev->stats.tx_bytes += skb_len;
-  //   } else {
-  //     /*
-  //      * Rx cannot timeout because it's constantly listening.
-  //      * Any timeouts must be Tx, so the packet should be dropped in this case.
-  //      */
-  //     netdev->stats.tx_dropped++;
-  //     netdev_warn(netdev, "tx timeout (packet dropped)\n");
-  //   }
-  //
-  //   /* Allow for changing of packet parameters if queued from userspace. */
-  //   sx1280_listen(priv);
-  //   wake_up_all(&priv->idle_wait);
-  //
-  //   /* Restart the Tx packet queue. */
-  //   netif_wake_queue(netdev);
-  // }
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-fail:
+  unsigned int value = priv->duty.millipercent;
   mutex_unlock(&priv->lock);
-  return IRQ_HANDLED;
+
+  return sprintf(buf, "%u.%03u\n", value / 1000, value % 1000);
 }
 
 /**
- * Parses busy GPIO and DIO GPIOs.
- * @param priv - The internal SX1280 driver structure.
- * @param dt - Whether a device tree configuration or platform data is used.
+ * Parses a percentage with up to three decimals, like "0.1" or "10", into
+ * thousandths of a percent.
  */
-static int sx1280_setup_gpios(struct sx1280_priv *priv) {
+static int sx1280_parse_millipercent(const char *buf, unsigned int *value) {
   int err;
-  struct device *dev = &priv->spi->dev;
+  char whole[8] = {};
+  char frac[4] = "000";
 
-  /*
-   * 1. Configure the busy pin GPIO.
-   * 2. Configure the DIO1, DIO2, DIO3 GPIOs.
-   */
+  size_t len = strcspn(buf, ".\n");
+  if (!len || len >= sizeof(whole)) {
+    return -EINVAL;
+  }
 
-  struct sx1280_platform_data *pdata = dev_get_platdata(dev);
-  priv->dio = NULL;
+  memcpy(whole, buf, len);
 
-  if (!pdata) {
-    /*
-     * If a device tree is used, then the GPIOs are directly registered with the
-     * SPI device and freed upon the SPI device being unregistered.
-     */
+  unsigned int percent;
+  if ((err = kstrtouint(whole, 10, &percent))) {
+    return err;
+  }
 
-    priv->busy = devm_gpiod_get(dev, "busy", GPIOD_IN);
-    if (IS_ERR(priv->busy)) {
-      dev_err(dev, "Failed to configure GPIO for busy pin.\n");
-      return PTR_ERR(priv->busy);
+  if (buf[len] == '.') {
+    const char *digits = &buf[len + 1];
+    size_t n = strcspn(digits, "\n");
+
+    if (!n || n > 3 || digits[n + strspn(&digits[n], "\n")]) {
+      return -EINVAL;
     }
 
-    const char *dio_names[] = { "dio1", "dio2", "dio3" };
-    for (int i = 0; i < ARRAY_SIZE(dio_names); i++) {
-      struct gpio_desc *dio =
-        devm_gpiod_get_optional(dev, dio_names[i], GPIOD_IN);
+    memcpy(frac, digits, n);
 
-      if (IS_ERR(dio)) {
-        dev_err(dev, "Failed to configure GPIO for DIO%d.\n", i + 1);
-        return PTR_ERR(dio);
-      } else if (!dio) {
-        dev_dbg(dev, "Optional DIO%d not specified.\n", i + 1);
-        continue;
+    unsigned int i;
+    for (i = 0; i < 3; i++) {
+      if (!isdigit(frac[i])) {
+        return -EINVAL;
       }
-
-      priv->dio_index = i + 1;
-      priv->dio = dio;
-      break;
     }
+  }
 
-    priv->reset = devm_gpiod_get(dev, "reset", GPIOD_OUT_LOW);
-    if (IS_ERR(priv->reset)) {
-      dev_err(dev, "Failed to configure GPIO for the reset pin.\n");
-      return PTR_ERR(priv->reset);
-    }
-  } else {
-    /*
-     * If platform data is used, the GPIOs are passed as integers.
-     * This is not the preferred way for GPIOs to be specified in device trees
-     * anymore, so the conversion of GPIOs into descriptors must be done
-     * separately.
-     */
+  if (percent > SX1280_DUTY_MILLIPERCENT_MAX / 1000) {
+    return -EINVAL;
+  }
 
-    err = -EINVAL;
+  unsigned int fraction;
+  if ((err = kstrtouint(frac, 10, &fraction))) {
+    return err;
+  }
 
-    priv->busy = gpio_to_desc(pdata->busy_gpio);
-    if (!priv->busy || (err = gpiod_direction_input(priv->busy))) {
-      dev_err(dev, "Failed to configure GPIO for busy pin.\n");
-      return err;
-    }
+  *value = percent * 1000 + fraction;
+  return *value <= SX1280_DUTY_MILLIPERCENT_MAX ? 0 : -EINVAL;
+}
 
-    for (int i = 0; i < 3; i++) {
-      int gpio_num = pdata->dio_gpios[i];
-      if (gpio_num < 0) {
-        continue;
-      }
+/**
+ * Re-evaluates the duty cycle after its limit has changed, starting over with
+ * a full bucket.
+ * @context process & locked
+ */
+static void sx1280_duty_update(struct sx1280_priv *priv) {
+  sx1280_duty_reset(&priv->duty);
 
-      struct gpio_desc *dio = gpio_to_desc((unsigned int) gpio_num);
+  if (priv->duty.throttled) {
+    hrtimer_cancel(&priv->duty.timer);
+    kthread_queue_work(priv->worker, &priv->duty.work);
+  }
+}
 
-      if (!dio || (err = gpiod_direction_input(dio))) {
-        dev_err(dev, "Failed to configure GPIO for DIO%d.\n", i);
-        return err;
-      }
+/**
+ * Sets the share of time the transmitter may be on, in percent with up to
+ * three decimals, e.g. 1 or 0.1 for the usual sub-GHz limits. With 100, the
+ * duty cycle isn't limited.
+ * @context - process
+ */
+static ssize_t mac_duty_cycle_percent_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-      priv->dio_index = i + 1;
-      priv->dio = dio;
-      break;
-    }
+  unsigned int value;
+  if ((err = sx1280_parse_millipercent(buf, &value))) {
+    return err;
+  }
+
+  if (!value) {
+    return -EINVAL;
+  }
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  priv->duty.millipercent = value;
+  sx1280_duty_update(priv);
+  mutex_unlock(&priv->lock);
+
+  return count;
+}
+
+/**
+ * Gets the window the duty cycle is enforced over, in seconds.
+ * @context - process
+ */
+static ssize_t mac_duty_cycle_window_s_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  unsigned int value = priv->duty.window_s;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%u\n", value);
+}
+
+/**
+ * Sets the window the duty cycle is enforced over, in seconds. This is how
+ * much airtime can be used in one burst: a longer window allows longer bursts
+ * after the channel has been left alone.
+ * @context - process
+ */
+static ssize_t mac_duty_cycle_window_s_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-    priv->reset = gpio_to_desc(pdata->reset_gpio);
-    if (!priv->reset || (err = gpiod_direction_output(priv->reset, 1))) {
-      dev_err(dev, "Failed to configure GPIO for reset.\n");
-      return err;
-    }
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
+    return err;
   }
 
-  /* Check that at least one DIO was set. */
-  if (!priv->dio) {
-    dev_err(dev, "no DIOs are set in the configuration\n");
+  if (!value || value > SX1280_DUTY_WINDOW_S_MAX) {
     return -EINVAL;
   }
 
-  priv->irq = gpiod_to_irq(priv->dio);
-  if ((err = priv->irq) < 0) {
-    dev_err(dev, "failed to register IRQ for DIO\n");
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  /*
-   * Register the DIO IRQs to their interrupt handlers.
-   * TODO: Change this to split interrupts across all DIOs.
-   */
-  err = devm_request_threaded_irq(
-    dev,
-    priv->irq,
-    NULL,
-    sx1280_irq,
-    IRQF_TRIGGER_RISING | IRQF_ONESHOT,
-    "sx1280_irq",
-    priv
-  );
-
-  if (err) {
-    dev_err(dev, "Failed to set IRQ handler.\n");
-    return err;
-  }
+  priv->duty.window_s = value;
+  sx1280_duty_update(priv);
+  mutex_unlock(&priv->lock);
 
-  return 0;
+  return count;
 }
 
 /**
- * Performs a hardware reset by toggling the NRESET pin and waiting for BUSY.
- * @param priv - The internal SX1280 driver structure.
+ * Gets whether the channel is hopped.
+ * @context - process
  */
-static int sx1280_reset(struct sx1280_priv *priv) {
-  int err;
-
-  netdev_dbg(priv->netdev, "resetting hardware\n");
-
-  /* Toggle NRESET. */
-  gpiod_set_value_cansleep(priv->reset, 1);
-  usleep_range(500, 1000);
-  gpiod_set_value_cansleep(priv->reset, 0);
-
-#ifdef DEBUG
-  ktime_t start = ktime_get();
-#endif
+static ssize_t mac_fhss_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  /* Wait for BUSY = 0. */
-  if ((err = sx1280_wait_busy(priv))) {
-    netdev_err(priv->netdev, "failed to reset, timeout exceeded\n");
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-#ifdef DEBUG
-  ktime_t end = ktime_get();
-  s64 reset_time = ktime_to_us(ktime_sub(end, start));
-  netdev_dbg(priv->netdev, "reset completed in %lld us\n", reset_time);
-#endif
+  bool value = priv->fhss.enabled;
+  mutex_unlock(&priv->lock);
 
-  return 0;
+  return sprintf(buf, "%d\n", value);
 }
 
 /**
- * Performs the chip setup.
- * @context - process & pre-lock
- * @param priv - The internal SX1280 driver structure.
+ * Enables or disables frequency hopping. Without any channels, the fixed
+ * frequency is kept. Hopping follows TDMA's beacons, so TDMA has to be enabled
+ * first, and automatic channel selection can't be enabled as well.
+ * @context - process
  */
-static int sx1280_setup(struct sx1280_priv *priv) {
-  struct spi_device *spi = priv->spi;
-  struct sx1280_config *cfg = &priv->cfg;
+static ssize_t mac_fhss_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  dev_dbg(&spi->dev, "starting setup\n");
-
-  /* Reset the chip and check its status after reset. */
-  u8 status;
-  if (
-    (err = sx1280_reset(priv))
-    || (err = sx1280_set_standby(priv, SX1280_STDBY_RC))
-    || (err = sx1280_get_status(priv, &status))
-  ) {
+  bool value;
+  if ((err = kstrtobool(buf, &value))) {
     return err;
   }
 
-  dev_dbg(&spi->dev, "status: 0x%02x\n", status);
-  priv->state = SX1280_STATE_STANDBY;
-
-  /* Extract circuit mode and command status and check for valid values. */
-  u8 circuit_mode = FIELD_GET(SX1280_STATUS_CIRCUIT_MODE_MASK, status);
-  u8 command_status = FIELD_GET(SX1280_STATUS_COMMAND_STATUS_MASK, status);
-
-  if (circuit_mode != SX1280_CIRCUIT_MODE_STDBY_RC) {
-    dev_err(&spi->dev, "unexpected circuit mode: 0x%02x.\n", circuit_mode);
-    return -EIO;
-  } else if (
-    command_status == SX1280_COMMAND_STATUS_TIMEOUT
-    || command_status == SX1280_COMMAND_STATUS_PROCESSING_ERROR
-    || command_status == SX1280_COMMAND_STATUS_EXEC_FAILURE
-  ) {
-    dev_err(&spi->dev, "unexpected command status: 0x%02x\n", command_status);
-    return -EIO;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  /*
-   * Extract the modulation and packet params from the platform data, depending
-   * on the mode that the chip is being commanded into.
-   */
-  struct sx1280_modulation_params mod_params = {
-    .mode = SX1280_MODE_GFSK,
-    .gfsk = cfg->gfsk.modulation,
-  };
-
-  if (
-    (err = sx1280_set_packet_type(priv, SX1280_MODE_GFSK))
-    || (err = sx1280_set_rf_frequency(priv, cfg->freq))
+  if (value && !priv->tdma.enabled) {
+    mutex_unlock(&priv->lock);
+    return -EINVAL;
+  }
 
-    /*
-     * Set the Tx and Rx buffer base addresses to 0x0.
-     * This allows the chip to use the full 256-byte data buffer.
-     * The size of the data buffer also restricts the MTU to 256 bytes.
-     *
-     * Since the chip supports half-duplex, the data must be sent/read before
-     * performing another operation, but otherwise will not be overwritten.
-     */
-    || (err = sx1280_set_buffer_base_address(priv, 0x0, 0x0))
-    || (err = sx1280_set_modulation_params(priv, mod_params))
-    || (
-      err = sx1280_write_register(
-        priv,
-        SX1280_REG_SYNC_ADDRESS_1_BYTE_4,
-        (u8 *) cfg->sync_words,
-        15
-      )
-    ) || (
-      err = sx1280_write_register(
-        priv,
-        SX1280_REG_CRC_POLYNOMIAL_DEFINITION_MSB,
-        cfg->gfsk.crc_polynomial,
-        2
-      )
-    ) || (
-      err = sx1280_write_register(
-        priv,
-        SX1280_REG_CRC_MSB_INITIAL_VALUE,
-        cfg->crc_seed,
-        2
-      )
-    ) || (err = sx1280_set_tx_params(priv, cfg->power, cfg->ramp_time))
-    || (err = sx1280_set_auto_fs(priv, true))
-  ) {
-    dev_err(&spi->dev, "setup failed: %d\n", err);
-    return err;
+  if (value && priv->acs.enabled) {
+    mutex_unlock(&priv->lock);
+    return -EBUSY;
   }
 
-  return 0;
-}
+  priv->fhss.enabled = value;
+  sx1280_fhss_restart(priv);
+  mutex_unlock(&priv->lock);
 
-static const struct net_device_ops sx1280_netdev_ops = {
-  .ndo_open = sx1280_open,
-  .ndo_start_xmit = sx1280_xmit,
-  .ndo_stop = sx1280_stop,
-};
+  return count;
+}
 
 /**
- * Acquires the shared lock by waiting until idle, which is when the chip is not
- * actively transmitting, so that configuration can be changed.
- *
- * NOTE: This function acquires the lock but does not release it unless it fails
- * and returns an error code. The shared lock must be released by the caller.
- * Upon failure, the lock is _never_ held, even if it was previously held by the
- * caller.
- *
- * @context - process & (locked | unlocked)
+ * Parses a list of numbers separated by spaces or commas.
+ * @returns 0 with `n` set, or an error if the list is malformed or longer than
+ *          `max` entries.
  */
-static int sx1280_acquire_idle(struct sx1280_priv *priv, bool locked) {
-  int err;
+static int sx1280_parse_u32_list(
+  const char *buf,
+  u32 *values,
+  unsigned int max,
+  unsigned int *n
+) {
+  int err = 0;
+  char *copy = kstrdup(buf, GFP_KERNEL);
+  char *cur = copy;
+  char *token;
 
-  if (!locked && mutex_lock_interruptible(&priv->lock)) {
-    return -ERESTARTSYS;
+  if (!copy) {
+    return -ENOMEM;
   }
 
-  while (priv->state == SX1280_STATE_TX) {
-    mutex_unlock(&priv->lock);
+  *n = 0;
+  while ((token = strsep(&cur, " ,\n"))) {
+    if (!*token) {
+      continue;
+    }
 
-    if (
-      (err = wait_event_interruptible(
-        priv->idle_wait,
-        priv->state != SX1280_STATE_TX
-      ))
-    ) {
-      return err;
+    if (*n == max) {
+      err = -EINVAL;
+      break;
     }
 
-    if (mutex_lock_interruptible(&priv->lock)) {
-      return -ERESTARTSYS;
+    if ((err = kstrtou32(token, 10, &values[*n]))) {
+      break;
     }
+
+    (*n)++;
   }
 
-  return 0;
+  kfree(copy);
+  return err;
 }
 
 /**
- * Acquires the shared lock no matter the mode, but additionally waits for idle
- * if the mode is the one specified.
- *
- * Note that the mode must still be checked after this function exits, as the
- * mode may have changed since released and re-acquiring the mutex while waiting
- * for idle.
+ * Gets the channels hopped over, in Hz.
+ * @context - process
  */
-static int sx1280_acquire_idle_if_mode(
-  struct sx1280_priv *priv,
-  enum sx1280_mode mode,
-  bool locked
+static ssize_t mac_fhss_channels_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
 ) {
-  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_fhss *fhss = &priv->fhss;
+  int len = 0;
 
-  /* The mutex must be locked before accessing priv->cfg.mode. */
-  if (!locked && mutex_lock_interruptible(&priv->lock)) {
+  if (mutex_lock_interruptible(&priv->lock)) {
     return -ERESTARTSYS;
   }
 
-  if (priv->cfg.mode == mode && (err = sx1280_acquire_idle(priv, true))) {
-    return err;
+  for (unsigned int i = 0; i < fhss->n_channels; i++) {
+    len += sprintf(
+      &buf[len],
+      "%s%u",
+      i ? " " : "",
+      SX1280_FREQ_PLL_TO_HZ(fhss->channels[i])
+    );
   }
 
-  return 0;
+  mutex_unlock(&priv->lock);
+
+  len += sprintf(&buf[len], "\n");
+  return len;
 }
 
 /**
- * Acquires the shared lock by waiting until idle before switching into standby
- * mode, so that the chip configuration can be changed. The wait times out after
- * 1 second.
- *
- * NOTE: This function acquires the lock but does not release it unless it fails
- * and returns an error code. The shared lock must be released by the caller.
- *
- * @context - process & unlocked
+ * Sets the channels hopped over, as up to SX1280_FHSS_CHANNELS_MAX frequencies
+ * in Hz. The hop sequence is drawn from the seed again, replacing any that
+ * was set explicitly.
+ * @context - process
  */
-static int sx1280_acquire_stdby(struct sx1280_priv *priv, bool locked) {
+static ssize_t mac_fhss_channels_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
   int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_fhss *fhss = &priv->fhss;
 
-  if ((err = sx1280_acquire_idle(priv, locked))) {
+  u32 freqs_hz[SX1280_FHSS_CHANNELS_MAX];
+  unsigned int n;
+  if ((err = sx1280_parse_u32_list(buf, freqs_hz, ARRAY_SIZE(freqs_hz), &n))) {
     return err;
   }
 
-  if ((err = sx1280_set_standby(priv, SX1280_STDBY_XOSC))) {
-    mutex_unlock(&priv->lock);
-    return err;
+  for (unsigned int i = 0; i < n; i++) {
+    if (freqs_hz[i] < 2400000000 || freqs_hz[i] > 2500000000) {
+      return -EINVAL;
+    }
+  }
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
+
+  /* Work the PLL words out now, so that hopping doesn't have to. */
+  for (unsigned int i = 0; i < n; i++) {
+    fhss->channels[i] = SX1280_FREQ_HZ_TO_PLL(freqs_hz[i]);
   }
 
-  return 0;
-}
+  fhss->n_channels = n;
+  sx1280_fhss_shuffle(fhss);
+  sx1280_fhss_restart(priv);
+  mutex_unlock(&priv->lock);
 
-/*********/
-/* sysfs */
-/*********/
+  return count;
+}
 
-static ssize_t mode_show(
+/**
+ * Gets how long each channel is used for when hopping by time, in
+ * microseconds, or 0 if hopping per frame exchange.
+ * @context - process
+ */
+static ssize_t mac_fhss_dwell_us_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -2323,24 +13429,18 @@ static ssize_t mode_show(
     return -ERESTARTSYS;
   }
 
-  enum sx1280_mode mode = priv->cfg.mode;
+  unsigned int value = priv->fhss.dwell_us;
   mutex_unlock(&priv->lock);
 
-  const char *mode_str;
-  switch (mode) {
-  case SX1280_MODE_FLRC:    mode_str = "flrc"; break;
-  case SX1280_MODE_GFSK:    mode_str = "gfsk"; break;
-  case SX1280_MODE_LORA:    mode_str = "lora"; break;
-  case SX1280_MODE_RANGING: mode_str = "ranging"; break;
-  default:
-    WARN(1, "invalid internal cfg.mode: %d\n", mode);
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%s\n", mode_str);
+  return sprintf(buf, "%u\n", value);
 }
 
-static ssize_t mode_store(
+/**
+ * Sets how long each channel is used for, in microseconds, to hop by time.
+ * With 0, the channel changes after every frame exchange instead.
+ * @context - process
+ */
+static ssize_t mac_fhss_dwell_us_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -2350,34 +13450,34 @@ static ssize_t mode_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  enum sx1280_mode new_mode;
-  if (sysfs_streq(buf, "flrc")) {
-    new_mode = SX1280_MODE_FLRC;
-  } else if (sysfs_streq(buf, "gfsk")) {
-    new_mode = SX1280_MODE_GFSK;
-  } else if (sysfs_streq(buf, "lora")) {
-    new_mode = SX1280_MODE_LORA;
-  } else if (sysfs_streq(buf, "ranging")) {
-    new_mode = SX1280_MODE_RANGING;
-  } else {
-    return -EINVAL;
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
+    return err;
   }
 
   if (
-    (err = sx1280_acquire_stdby(priv, false))
-    || (err = sx1280_set_packet_type(priv, new_mode))
+    value
+    && (value < SX1280_FHSS_DWELL_US_MIN || value > SX1280_FHSS_DWELL_US_MAX)
   ) {
-    goto fail;
+    return -EINVAL;
   }
 
-  priv->cfg.mode = new_mode;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-fail:
+  priv->fhss.dwell_us = value;
+  sx1280_fhss_restart(priv);
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t tx_power_show(
+/**
+ * Gets the seed the hop sequence is drawn from.
+ * @context - process
+ */
+static ssize_t mac_fhss_seed_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -2389,17 +13489,18 @@ static ssize_t tx_power_show(
     return -ERESTARTSYS;
   }
 
-  int power_dbm = (int) priv->cfg.power - 18;
+  u32 value = priv->fhss.seed;
   mutex_unlock(&priv->lock);
 
-  return sprintf(buf, "%d\n", power_dbm);
+  return sprintf(buf, "%u\n", value);
 }
 
 /**
- *
+ * Sets the seed the hop sequence is drawn from, which has to be the same on
+ * every node. An explicitly set sequence is kept.
  * @context - process
  */
-static ssize_t tx_power_store(
+static ssize_t mac_fhss_seed_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -2408,45 +13509,121 @@ static ssize_t tx_power_store(
   int err;
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_fhss *fhss = &priv->fhss;
 
-  int power_dbm;
-  if ((err = kstrtoint(buf, 10, &power_dbm))) {
+  u32 value;
+  if ((err = kstrtou32(buf, 0, &value))) {
     return err;
   }
 
-  if (power_dbm < -18 || power_dbm > 13) {
-    return -EINVAL;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  if ((err = sx1280_acquire_idle(priv, false))) {
-    return err;
+  fhss->seed = value;
+
+  if (!fhss->seq_explicit) {
+    sx1280_fhss_shuffle(fhss);
+    sx1280_fhss_restart(priv);
   }
 
-  priv->cfg.power = (u32) (power_dbm + 18);
   mutex_unlock(&priv->lock);
+
   return count;
 }
 
 /**
+ * Gets the hop sequence, as indices into the channels.
  * @context - process
  */
-static ssize_t busy_show(
+static ssize_t mac_fhss_sequence_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
 ) {
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_fhss *fhss = &priv->fhss;
+  int len = 0;
 
-  int value = gpiod_get_value_cansleep(priv->busy);
-  if (value < 0) {
-    return value;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  return sprintf(buf, "%d\n", value);
+  for (unsigned int i = 0; i < fhss->seq_len; i++) {
+    len += sprintf(&buf[len], "%s%u", i ? " " : "", fhss->seq[i]);
+  }
+
+  mutex_unlock(&priv->lock);
+
+  len += sprintf(&buf[len], "\n");
+  return len;
 }
 
-static ssize_t crc_seed_show(
+/**
+ * Sets the hop sequence explicitly, as up to SX1280_FHSS_SEQ_MAX indices into
+ * the channels, which may repeat. Writing an empty list goes back to drawing
+ * the sequence from the seed.
+ * @context - process
+ */
+static ssize_t mac_fhss_sequence_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_fhss *fhss = &priv->fhss;
+
+  u32 *seq = kmalloc_array(SX1280_FHSS_SEQ_MAX, sizeof(*seq), GFP_KERNEL);
+  if (!seq) {
+    return -ENOMEM;
+  }
+
+  unsigned int n;
+  if ((err = sx1280_parse_u32_list(buf, seq, SX1280_FHSS_SEQ_MAX, &n))) {
+    goto free;
+  }
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    err = -ERESTARTSYS;
+    goto free;
+  }
+
+  for (unsigned int i = 0; i < n; i++) {
+    if (seq[i] >= fhss->n_channels) {
+      err = -EINVAL;
+      goto unlock;
+    }
+  }
+
+  if (n) {
+    for (unsigned int i = 0; i < n; i++) {
+      fhss->seq[i] = seq[i];
+    }
+
+    fhss->seq_len = n;
+    fhss->seq_explicit = true;
+  } else {
+    sx1280_fhss_shuffle(fhss);
+  }
+
+  sx1280_fhss_restart(priv);
+
+unlock:
+  mutex_unlock(&priv->lock);
+free:
+  kfree(seq);
+  return err ? err : count;
+}
+
+/**
+ * Gets the largest backoff exponent.
+ * @context - process
+ */
+static ssize_t mac_max_backoff_exponent_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -2458,14 +13635,17 @@ static ssize_t crc_seed_show(
     return -ERESTARTSYS;
   }
 
-  u8 crc_seed[2];
-  memcpy(crc_seed, priv->cfg.crc_seed, sizeof(crc_seed));
+  unsigned int value = priv->mac.max_be;
   mutex_unlock(&priv->lock);
 
-  return sprintf(buf, "%*phN\n", (int) sizeof(crc_seed), crc_seed);
+  return sprintf(buf, "%u\n", value);
 }
 
-static ssize_t crc_seed_store(
+/**
+ * Sets the largest backoff exponent, so at most 2^n - 1 slots are waited.
+ * @context - process
+ */
+static ssize_t mac_max_backoff_exponent_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -2475,46 +13655,85 @@ static ssize_t crc_seed_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (count != 5 && count != 4) {
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
+    return err;
+  }
+
+  if (value > SX1280_MAC_BE_MAX) {
     return -EINVAL;
   }
 
-  u8 crc_seed[2];
-  if ((err = hex2bin(crc_seed, buf, 2))) {
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  /* Effectively an acquire_idle_if_mode, but for either GFSK or FLRC. */
+  priv->mac.max_be = value;
+  mutex_unlock(&priv->lock);
+
+  return count;
+}
+
+/**
+ * Gets how many times the channel may be found busy before a frame is dropped.
+ * @context - process
+ */
+static ssize_t mac_max_backoffs_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
   if (mutex_lock_interruptible(&priv->lock)) {
     return -ERESTARTSYS;
   }
 
-  enum sx1280_mode mode = priv->cfg.mode;
+  unsigned int value = priv->mac.max_backoffs;
+  mutex_unlock(&priv->lock);
 
-  if (
-    (mode == SX1280_MODE_GFSK || mode == SX1280_MODE_FLRC)
-    && (err = sx1280_acquire_idle(priv, true))
-  ) {
+  return sprintf(buf, "%u\n", value);
+}
+
+/**
+ * Sets how many times the channel may be found busy before a frame is dropped.
+ * @context - process
+ */
+static ssize_t mac_max_backoffs_store(
+  struct device *dev,
+  struct device_attribute *attr,
+  const char *buf,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
     return err;
   }
 
-  if ((err = sx1280_write_register(
-    priv,
-    SX1280_REG_CRC_POLYNOMIAL_DEFINITION_MSB,
-    crc_seed,
-    2
-  ))) {
-    goto fail;
+  if (value > SX1280_MAC_MAX_BACKOFFS_MAX) {
+    return -EINVAL;
   }
 
-  memcpy(priv->cfg.crc_seed, crc_seed, sizeof(priv->cfg.crc_seed));
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-fail:
+  priv->mac.max_backoffs = value;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t ramp_time_show(
+/**
+ * Gets the initial backoff exponent.
+ * @context - process
+ */
+static ssize_t mac_min_backoff_exponent_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -2526,28 +13745,18 @@ static ssize_t ramp_time_show(
     return -ERESTARTSYS;
   }
 
-  enum sx1280_ramp_time ramp_time = priv->cfg.ramp_time;
+  unsigned int value = priv->mac.min_be;
   mutex_unlock(&priv->lock);
 
-  int ramp_time_us;
-  switch (ramp_time) {
-  case SX1280_RADIO_RAMP_02_US: ramp_time_us = 2; break;
-  case SX1280_RADIO_RAMP_04_US: ramp_time_us = 4; break;
-  case SX1280_RADIO_RAMP_06_US: ramp_time_us = 6; break;
-  case SX1280_RADIO_RAMP_08_US: ramp_time_us = 8; break;
-  case SX1280_RADIO_RAMP_10_US: ramp_time_us = 10; break;
-  case SX1280_RADIO_RAMP_12_US: ramp_time_us = 12; break;
-  case SX1280_RADIO_RAMP_16_US: ramp_time_us = 16; break;
-  case SX1280_RADIO_RAMP_20_US: ramp_time_us = 20; break;
-  default:
-    WARN(1, "invalid internal ramp_time: %d\n", ramp_time);
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%d\n", ramp_time_us);
+  return sprintf(buf, "%u\n", value);
 }
 
-static ssize_t ramp_time_store(
+/**
+ * Sets the initial backoff exponent. With 0, the channel is assessed straight
+ * away the first time.
+ * @context - process
+ */
+static ssize_t mac_min_backoff_exponent_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -2557,35 +13766,30 @@ static ssize_t ramp_time_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  int ramp_time_us;
-  if ((err = kstrtoint(buf, 10, &ramp_time_us))) {
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
     return err;
   }
 
-  enum sx1280_ramp_time ramp_time;
-  switch (ramp_time_us) {
-  case 2:  ramp_time = SX1280_RADIO_RAMP_02_US; break;
-  case 4:  ramp_time = SX1280_RADIO_RAMP_04_US; break;
-  case 6:  ramp_time = SX1280_RADIO_RAMP_06_US; break;
-  case 8:  ramp_time = SX1280_RADIO_RAMP_08_US; break;
-  case 10: ramp_time = SX1280_RADIO_RAMP_10_US; break;
-  case 12: ramp_time = SX1280_RADIO_RAMP_12_US; break;
-  case 16: ramp_time = SX1280_RADIO_RAMP_16_US; break;
-  case 20: ramp_time = SX1280_RADIO_RAMP_20_US; break;
-  default:
+  if (value > SX1280_MAC_BE_MAX) {
     return -EINVAL;
   }
 
-  if ((err = sx1280_acquire_idle(priv, false))) {
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  priv->cfg.ramp_time = ramp_time;
+  priv->mac.min_be = value;
   mutex_unlock(&priv->lock);
+
   return count;
 }
 
-static ssize_t frequency_show(
+/**
+ * Gets whether the channel is shared by TDMA.
+ * @context - process
+ */
+static ssize_t mac_tdma_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -2597,18 +13801,19 @@ static ssize_t frequency_show(
     return -ERESTARTSYS;
   }
 
-  u32 freq = priv->cfg.freq;
+  bool value = priv->tdma.enabled;
   mutex_unlock(&priv->lock);
 
-  u32 freq_hz = SX1280_FREQ_PLL_TO_HZ(freq);
-  return sprintf(buf, "%u\n", freq_hz);
+  return sprintf(buf, "%d\n", value);
 }
 
 /**
- *
+ * Sets whether the channel is shared by TDMA, with each node only sending in
+ * its own slots. This takes precedence over CSMA/CA. It can't be disabled
+ * while frequency hopping relies on its beacons.
  * @context - process
  */
-static ssize_t frequency_store(
+static ssize_t mac_tdma_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -2618,37 +13823,33 @@ static ssize_t frequency_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  u32 freq_hz;
-  if ((err = kstrtou32(buf, 10, &freq_hz))) {
+  bool value;
+  if ((err = kstrtobool(buf, &value))) {
     return err;
   }
-
-  if (freq_hz < 2400000000 || freq_hz > 2500000000) {
-    return -EINVAL;
-  }
-
-  u32 freq_pll = SX1280_FREQ_HZ_TO_PLL(freq_hz);
-
-  if ((err = sx1280_acquire_idle(priv, false))) {
-    return err;
+
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  if ((err = sx1280_set_rf_frequency(priv, freq_pll))) {
-    goto fail;
+  if (!value && priv->fhss.enabled) {
+    mutex_unlock(&priv->lock);
+    return -EBUSY;
   }
 
-  priv->cfg.freq = freq_pll;
+  priv->tdma.enabled = value;
 
-fail:
+  sx1280_tdma_restart(priv);
   mutex_unlock(&priv->lock);
-  return err ? err : count;
-}
 
-/**************/
-/* FLRC sysfs */
-/**************/
+  return count;
+}
 
-static ssize_t flrc_bandwidth_time_show(
+/**
+ * Gets whether this node sends the beacons that TDMA nodes sync to.
+ * @context - process
+ */
+static ssize_t mac_tdma_coordinator_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -2660,27 +13861,18 @@ static ssize_t flrc_bandwidth_time_show(
     return -ERESTARTSYS;
   }
 
-  enum sx1280_bandwidth_time bt = priv->cfg.flrc.modulation.bandwidth_time;
+  bool value = priv->tdma.coordinator;
   mutex_unlock(&priv->lock);
 
-  const char *bt_str;
-  switch (bt) {
-  case SX1280_BT_OFF: bt_str = "off"; break;
-  case SX1280_BT_0_5: bt_str = "0.5"; break;
-  case SX1280_BT_1_0: bt_str = "1.0"; break;
-  default:
-    WARN(1, "invalid internal cfg.flrc.modulation.bandwidth_time: %d\n", bt);
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%s\n", bt_str);
+  return sprintf(buf, "%d\n", value);
 }
 
 /**
- *
+ * Sets whether this node sends the beacons that TDMA nodes sync to. There
+ * should be exactly one coordinator on the channel.
  * @context - process
  */
-static ssize_t flrc_bandwidth_time_store(
+static ssize_t mac_tdma_coordinator_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -2690,39 +13882,31 @@ static ssize_t flrc_bandwidth_time_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  enum sx1280_bandwidth_time bt;
-  if (sysfs_streq(buf, "off")) {
-    bt = SX1280_BT_OFF;
-  } else if (sysfs_streq(buf, "0.5")) {
-    bt = SX1280_BT_0_5;
-  } else if (sysfs_streq(buf, "1.0")) {
-    bt = SX1280_BT_1_0;
+  bool value;
+  if ((err = kstrtobool(buf, &value))) {
+    return err;
   }
 
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_FLRC) {
-    struct sx1280_modulation_params mod_params = {
-      .mode = SX1280_MODE_FLRC,
-      .gfsk = priv->cfg.gfsk.modulation,
-    };
-    mod_params.gfsk.bandwidth_time = bt;
+  priv->tdma.coordinator = value;
 
-    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
-      goto fail;
-    }
+  if (priv->tdma.enabled) {
+    sx1280_tdma_restart(priv);
   }
 
-  priv->cfg.gfsk.modulation.bandwidth_time = bt;
-
-fail:
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t flrc_bitrate_bandwidth_show(
+/**
+ * Gets how far either side of when the beacon is due nodes listen for it.
+ * @context - process
+ */
+static ssize_t mac_tdma_guard_us_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -2734,27 +13918,19 @@ static ssize_t flrc_bitrate_bandwidth_show(
     return -ERESTARTSYS;
   }
 
-  enum sx1280_flrc_bitrate_bandwidth brbw =
-    priv->cfg.flrc.modulation.bitrate_bandwidth;
+  unsigned int value = priv->tdma.guard_us;
   mutex_unlock(&priv->lock);
 
-  int br, bw;
-  switch (brbw) {
-  case SX1280_FLRC_BR_1_300_BW_1_2: br = 1300000; bw = 1200000; break;
-  case SX1280_FLRC_BR_1_000_BW_1_2: br = 1000000; bw = 1200000; break;
-  case SX1280_FLRC_BR_0_650_BW_0_6: br = 650000;  bw = 600000;  break;
-  case SX1280_FLRC_BR_0_520_BW_0_6: br = 520000;  bw = 600000;  break;
-  case SX1280_FLRC_BR_0_325_BW_0_3: br = 325000;  bw = 300000;  break;
-  case SX1280_FLRC_BR_0_260_BW_0_3: br = 260000;  bw = 300000;  break;
-  default:
-    WARN(1, "invalid internal cfg.flrc.modulation.bitrate_bandwidth: %d\n", brbw);
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%d,%d\n", br, bw);
+  return sprintf(buf, "%u\n", value);
 }
 
-static ssize_t flrc_bitrate_bandwidth_store(
+/**
+ * Sets how far either side of when the beacon is due nodes listen for it,
+ * which covers clock drift and the beacon's time on air. It is capped at half
+ * a superframe.
+ * @context - process
+ */
+static ssize_t mac_tdma_guard_us_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -2764,47 +13940,30 @@ static ssize_t flrc_bitrate_bandwidth_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  enum sx1280_flrc_bitrate_bandwidth brbw;
-  if (sysfs_streq(buf, "1300000,1200000")) {
-    brbw = SX1280_FLRC_BR_1_300_BW_1_2;
-  } else if (sysfs_streq(buf, "1000000,1200000")) {
-    brbw = SX1280_FLRC_BR_1_000_BW_1_2;
-  } else if (sysfs_streq(buf, "650000,600000")) {
-    brbw = SX1280_FLRC_BR_0_650_BW_0_6;
-  } else if (sysfs_streq(buf,"520000,600000")) {
-    brbw = SX1280_FLRC_BR_0_520_BW_0_6;
-  } else if (sysfs_streq(buf, "325000,300000")) {
-    brbw = SX1280_FLRC_BR_0_325_BW_0_3;
-  } else if (sysfs_streq(buf, "260000,300000")) {
-    brbw = SX1280_FLRC_BR_0_260_BW_0_3;
-  } else {
-    return -EINVAL;
-  }
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
     return err;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_FLRC) {
-    struct sx1280_modulation_params mod_params = {
-      .mode = SX1280_MODE_FLRC,
-      .flrc = priv->cfg.flrc.modulation,
-    };
-    mod_params.flrc.bitrate_bandwidth = brbw;
-
-    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
-      goto fail;
-    }
+  if (value > SX1280_TDMA_SUPERFRAME_US_MAX) {
+    return -EINVAL;
   }
 
-  priv->cfg.flrc.modulation.bitrate_bandwidth = brbw;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-fail:
+  priv->tdma.guard_us = value;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t flrc_coding_rate_show(
+/**
+ * Gets the slots listened in, as a bitmask.
+ * @context - process
+ */
+static ssize_t mac_tdma_rx_slots_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -2816,28 +13975,18 @@ static ssize_t flrc_coding_rate_show(
     return -ERESTARTSYS;
   }
 
-  enum sx1280_flrc_coding_rate coding_rate =
-    priv->cfg.flrc.modulation.coding_rate;
+  u32 value = priv->tdma.rx_slots;
   mutex_unlock(&priv->lock);
 
-  const char *coding_rate_str;
-  switch (coding_rate) {
-  case SX1280_FLRC_CR_1_2: coding_rate_str = "1/2"; break;
-  case SX1280_FLRC_CR_3_4: coding_rate_str = "3/4"; break;
-  case SX1280_FLRC_CR_1_1: coding_rate_str = "1/1"; break;
-  default:
-    WARN(
-      1,
-      "invalid internal cfg.flrc.modulation.coding_rate: %d\n",
-      coding_rate
-    );
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%s\n", coding_rate_str);
+  return sprintf(buf, "0x%08x\n", value);
 }
 
-static ssize_t flrc_coding_rate_store(
+/**
+ * Sets the slots listened in, as a bitmask. The chip stands by through slots
+ * that are neither listened in nor owned.
+ * @context - process
+ */
+static ssize_t mac_tdma_rx_slots_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -2847,41 +13996,26 @@ static ssize_t flrc_coding_rate_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  enum sx1280_flrc_coding_rate coding_rate;
-  if (sysfs_streq(buf, "1/2")) {
-    coding_rate = SX1280_FLRC_CR_1_2;
-  } else if (sysfs_streq(buf, "3/4")) {
-    coding_rate = SX1280_FLRC_CR_3_4;
-  } else if (sysfs_streq(buf, "1/1")) {
-    coding_rate = SX1280_FLRC_CR_1_1;
-  } else {
-    return -EINVAL;
-  }
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
+  u32 value;
+  if ((err = kstrtou32(buf, 0, &value))) {
     return err;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_FLRC) {
-    struct sx1280_modulation_params mod_params = {
-      .mode = SX1280_MODE_FLRC,
-      .flrc = priv->cfg.flrc.modulation,
-    };
-    mod_params.flrc.coding_rate = coding_rate;
-
-    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
-      goto fail;
-    }
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  priv->cfg.flrc.modulation.coding_rate = coding_rate;
-
-fail:
+  priv->tdma.rx_slots = value;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t flrc_crc_bytes_show(
+/**
+ * Gets the length of a TDMA slot.
+ * @context - process
+ */
+static ssize_t mac_tdma_slot_us_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -2893,28 +14027,19 @@ static ssize_t flrc_crc_bytes_show(
     return -ERESTARTSYS;
   }
 
-  enum sx1280_flrc_crc crc_length = priv->cfg.flrc.packet.crc_length;
+  unsigned int value = priv->tdma.slot_us;
   mutex_unlock(&priv->lock);
 
-  int bytes;
-  switch (crc_length) {
-  case SX1280_FLRC_CRC_OFF:    bytes = 0; break;
-  case SX1280_FLRC_CRC_2_BYTE: bytes = 2; break;
-  case SX1280_FLRC_CRC_3_BYTE: bytes = 3; break;
-  case SX1280_FLRC_CRC_4_BYTE: bytes = 4; break;
-  default:
-    WARN(1, "invalid internal cfg.flrc.packet.crc_length: %d\n", crc_length);
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%d\n", bytes);
+  return sprintf(buf, "%u\n", value);
 }
 
 /**
- *
+ * Sets the length of a TDMA slot, which has to fit the longest frame along
+ * with its ACK. It can't be longer than the superframe, which holds at most
+ * SX1280_TDMA_SLOTS_MAX slots.
  * @context - process
  */
-static ssize_t flrc_crc_bytes_store(
+static ssize_t mac_tdma_slot_us_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -2924,45 +14049,40 @@ static ssize_t flrc_crc_bytes_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  int crc_bytes;
-  if ((err = kstrtoint(buf, 10, &crc_bytes))) {
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
     return err;
   }
 
-  enum sx1280_flrc_crc crc_length;
-  switch (crc_bytes) {
-  case 0: crc_length = SX1280_FLRC_CRC_OFF; break;
-  case 2: crc_length = SX1280_FLRC_CRC_2_BYTE; break;
-  case 3: crc_length = SX1280_FLRC_CRC_3_BYTE; break;
-  case 4: crc_length = SX1280_FLRC_CRC_4_BYTE; break;
-  default:
+  if (value < SX1280_TDMA_SLOT_US_MIN) {
     return -EINVAL;
   }
 
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_FLRC) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_FLRC,
-      .flrc = priv->cfg.flrc.packet,
-    };
-    packet_params.flrc.crc_length = crc_length;
-
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
-    }
+  if (value > priv->tdma.superframe_us) {
+    mutex_unlock(&priv->lock);
+    return -EINVAL;
   }
 
-  priv->cfg.flrc.packet.crc_length = crc_length;
+  priv->tdma.slot_us = value;
+
+  if (priv->tdma.enabled) {
+    sx1280_tdma_restart(priv);
+  }
 
-fail:
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t flrc_preamble_bits_show(
+/**
+ * Gets the time from one beacon to the next, not counting the beacon itself.
+ * @context - process
+ */
+static ssize_t mac_tdma_superframe_us_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -2974,37 +14094,18 @@ static ssize_t flrc_preamble_bits_show(
     return -ERESTARTSYS;
   }
 
-  enum sx1280_preamble_length preamble_length =
-    priv->cfg.flrc.packet.agc_preamble_length;
+  unsigned int value = priv->tdma.superframe_us;
   mutex_unlock(&priv->lock);
 
-  int bits;
-  switch (preamble_length) {
-  case SX1280_PREAMBLE_LENGTH_04_BITS: bits = 4;  break;
-  case SX1280_PREAMBLE_LENGTH_08_BITS: bits = 8;  break;
-  case SX1280_PREAMBLE_LENGTH_12_BITS: bits = 12; break;
-  case SX1280_PREAMBLE_LENGTH_16_BITS: bits = 16; break;
-  case SX1280_PREAMBLE_LENGTH_20_BITS: bits = 20; break;
-  case SX1280_PREAMBLE_LENGTH_24_BITS: bits = 24; break;
-  case SX1280_PREAMBLE_LENGTH_28_BITS: bits = 28; break;
-  case SX1280_PREAMBLE_LENGTH_32_BITS: bits = 32; break;
-  default:
-    WARN(
-      1,
-      "invalid internal cfg.flrc.packet.preamble_length: %d\n",
-      preamble_length
-    );
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%d\n", bits);
+  return sprintf(buf, "%u\n", value);
 }
 
 /**
- *
+ * Sets the time from one beacon to the next, not counting the beacon itself.
+ * It has to hold at least one slot.
  * @context - process
  */
-static ssize_t flrc_preamble_bits_store(
+static ssize_t mac_tdma_superframe_us_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3014,49 +14115,40 @@ static ssize_t flrc_preamble_bits_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  int preamble_bits;
-  if ((err = kstrtoint(buf, 10, &preamble_bits))) {
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
     return err;
   }
 
-  enum sx1280_preamble_length preamble_length;
-  switch (preamble_bits) {
-  case 4:  preamble_length = SX1280_PREAMBLE_LENGTH_04_BITS; break;
-  case 8:  preamble_length = SX1280_PREAMBLE_LENGTH_08_BITS; break;
-  case 12: preamble_length = SX1280_PREAMBLE_LENGTH_12_BITS; break;
-  case 16: preamble_length = SX1280_PREAMBLE_LENGTH_16_BITS; break;
-  case 20: preamble_length = SX1280_PREAMBLE_LENGTH_20_BITS; break;
-  case 24: preamble_length = SX1280_PREAMBLE_LENGTH_24_BITS; break;
-  case 28: preamble_length = SX1280_PREAMBLE_LENGTH_28_BITS; break;
-  case 32: preamble_length = SX1280_PREAMBLE_LENGTH_32_BITS; break;
-  default:
+  if (value < SX1280_TDMA_SUPERFRAME_US_MIN || value > SX1280_TDMA_SUPERFRAME_US_MAX) {
     return -EINVAL;
   }
 
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_FLRC) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_FLRC,
-      .flrc = priv->cfg.flrc.packet,
-    };
-    packet_params.flrc.agc_preamble_length = preamble_length;
-
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
-    }
+  if (value < priv->tdma.slot_us) {
+    mutex_unlock(&priv->lock);
+    return -EINVAL;
   }
 
-  priv->cfg.flrc.packet.agc_preamble_length = preamble_length;
+  priv->tdma.superframe_us = value;
+
+  if (priv->tdma.enabled) {
+    sx1280_tdma_restart(priv);
+  }
 
-fail:
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t flrc_whitening_show(
+/**
+ * Gets the slots owned by this node, as a bitmask.
+ * @context - process
+ */
+static ssize_t mac_tdma_tx_slots_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -3068,13 +14160,18 @@ static ssize_t flrc_whitening_show(
     return -ERESTARTSYS;
   }
 
-  bool whitening = priv->cfg.flrc.packet.whitening == SX1280_WHITENING_ENABLE;
+  u32 value = priv->tdma.tx_slots;
   mutex_unlock(&priv->lock);
 
-  return sprintf(buf, "%d\n", whitening);
+  return sprintf(buf, "0x%08x\n", value);
 }
 
-static ssize_t flrc_whitening_store(
+/**
+ * Sets the slots owned by this node, as a bitmask. Slot 0 starts as the beacon
+ * ends.
+ * @context - process
+ */
+static ssize_t mac_tdma_tx_slots_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3084,71 +14181,143 @@ static ssize_t flrc_whitening_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  bool whitening_bool;
-  if ((err = kstrtobool(buf, &whitening_bool))) {
-    return err;
-  }
-
-  enum sx1280_whitening whitening = whitening_bool
-    ? SX1280_WHITENING_ENABLE
-    : SX1280_WHITENING_DISABLE;
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_FLRC, false))) {
+  u32 value;
+  if ((err = kstrtou32(buf, 0, &value))) {
     return err;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_FLRC) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_FLRC,
-      .flrc = priv->cfg.flrc.packet,
-    };
-    packet_params.flrc.whitening = whitening;
-
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
-    }
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  priv->cfg.flrc.packet.whitening = whitening;
-
-fail:
+  priv->tdma.tx_slots = value;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
-}
 
-static struct device_attribute dev_attr_flrc_bandwidth_time =
-  __ATTR(bandwidth_time, 0644, flrc_bandwidth_time_show, flrc_bandwidth_time_store);
-static struct device_attribute dev_attr_flrc_bitrate_bandwidth =
-  __ATTR(bitrate_bandwidth, 0644, flrc_bitrate_bandwidth_show, flrc_bitrate_bandwidth_store);
-static struct device_attribute dev_attr_flrc_coding_rate =
-  __ATTR(coding_rate, 0644, flrc_coding_rate_show, flrc_coding_rate_store);
-static struct device_attribute dev_attr_flrc_crc_bytes =
-  __ATTR(crc_bytes, 0644, flrc_crc_bytes_show, flrc_crc_bytes_store);
-static struct device_attribute dev_attr_flrc_preamble_bits =
-  __ATTR(preamble_bits, 0644, flrc_preamble_bits_show, flrc_preamble_bits_store);
-static struct device_attribute dev_attr_flrc_whitening =
-  __ATTR(whitening, 0644, flrc_whitening_show, flrc_whitening_store);
+  return count;
+}
 
-static struct attribute *sx1280_flrc_attrs[] = {
-  &dev_attr_flrc_bandwidth_time.attr,
-  &dev_attr_flrc_bitrate_bandwidth.attr,
-  &dev_attr_flrc_coding_rate.attr,
-  &dev_attr_flrc_crc_bytes.attr,
-  &dev_attr_flrc_preamble_bits.attr,
-  &dev_attr_flrc_whitening.attr,
+static struct device_attribute dev_attr_mac_backoff_slot_us =
+  __ATTR(
+    backoff_slot_us,
+    0644,
+    mac_backoff_slot_us_show,
+    mac_backoff_slot_us_store
+  );
+static struct device_attribute dev_attr_mac_cad =
+  __ATTR(cad, 0644, mac_cad_show, mac_cad_store);
+static struct device_attribute dev_attr_mac_cca_threshold_dbm =
+  __ATTR(
+    cca_threshold_dbm,
+    0644,
+    mac_cca_threshold_dbm_show,
+    mac_cca_threshold_dbm_store
+  );
+static struct device_attribute dev_attr_mac_csma =
+  __ATTR(csma, 0644, mac_csma_show, mac_csma_store);
+static struct device_attribute dev_attr_mac_duty_cycle_percent =
+  __ATTR(
+    duty_cycle_percent,
+    0644,
+    mac_duty_cycle_percent_show,
+    mac_duty_cycle_percent_store
+  );
+static struct device_attribute dev_attr_mac_duty_cycle_window_s =
+  __ATTR(
+    duty_cycle_window_s,
+    0644,
+    mac_duty_cycle_window_s_show,
+    mac_duty_cycle_window_s_store
+  );
+static struct device_attribute dev_attr_mac_fhss =
+  __ATTR(fhss, 0644, mac_fhss_show, mac_fhss_store);
+static struct device_attribute dev_attr_mac_fhss_channels =
+  __ATTR(fhss_channels, 0644, mac_fhss_channels_show, mac_fhss_channels_store);
+static struct device_attribute dev_attr_mac_fhss_dwell_us =
+  __ATTR(fhss_dwell_us, 0644, mac_fhss_dwell_us_show, mac_fhss_dwell_us_store);
+static struct device_attribute dev_attr_mac_fhss_seed =
+  __ATTR(fhss_seed, 0644, mac_fhss_seed_show, mac_fhss_seed_store);
+static struct device_attribute dev_attr_mac_fhss_sequence =
+  __ATTR(fhss_sequence, 0644, mac_fhss_sequence_show, mac_fhss_sequence_store);
+static struct device_attribute dev_attr_mac_max_backoff_exponent =
+  __ATTR(
+    max_backoff_exponent,
+    0644,
+    mac_max_backoff_exponent_show,
+    mac_max_backoff_exponent_store
+  );
+static struct device_attribute dev_attr_mac_max_backoffs =
+  __ATTR(max_backoffs, 0644, mac_max_backoffs_show, mac_max_backoffs_store);
+static struct device_attribute dev_attr_mac_min_backoff_exponent =
+  __ATTR(
+    min_backoff_exponent,
+    0644,
+    mac_min_backoff_exponent_show,
+    mac_min_backoff_exponent_store
+  );
+static struct device_attribute dev_attr_mac_tdma =
+  __ATTR(tdma, 0644, mac_tdma_show, mac_tdma_store);
+static struct device_attribute dev_attr_mac_tdma_coordinator =
+  __ATTR(
+    tdma_coordinator,
+    0644,
+    mac_tdma_coordinator_show,
+    mac_tdma_coordinator_store
+  );
+static struct device_attribute dev_attr_mac_tdma_guard_us =
+  __ATTR(tdma_guard_us, 0644, mac_tdma_guard_us_show, mac_tdma_guard_us_store);
+static struct device_attribute dev_attr_mac_tdma_rx_slots =
+  __ATTR(tdma_rx_slots, 0644, mac_tdma_rx_slots_show, mac_tdma_rx_slots_store);
+static struct device_attribute dev_attr_mac_tdma_slot_us =
+  __ATTR(tdma_slot_us, 0644, mac_tdma_slot_us_show, mac_tdma_slot_us_store);
+static struct device_attribute dev_attr_mac_tdma_superframe_us =
+  __ATTR(
+    tdma_superframe_us,
+    0644,
+    mac_tdma_superframe_us_show,
+    mac_tdma_superframe_us_store
+  );
+static struct device_attribute dev_attr_mac_tdma_tx_slots =
+  __ATTR(tdma_tx_slots, 0644, mac_tdma_tx_slots_show, mac_tdma_tx_slots_store);
+
+static struct attribute *sx1280_mac_attrs[] = {
+  &dev_attr_mac_backoff_slot_us.attr,
+  &dev_attr_mac_cad.attr,
+  &dev_attr_mac_cca_threshold_dbm.attr,
+  &dev_attr_mac_csma.attr,
+  &dev_attr_mac_duty_cycle_percent.attr,
+  &dev_attr_mac_duty_cycle_window_s.attr,
+  &dev_attr_mac_fhss.attr,
+  &dev_attr_mac_fhss_channels.attr,
+  &dev_attr_mac_fhss_dwell_us.attr,
+  &dev_attr_mac_fhss_seed.attr,
+  &dev_attr_mac_fhss_sequence.attr,
+  &dev_attr_mac_max_backoff_exponent.attr,
+  &dev_attr_mac_max_backoffs.attr,
+  &dev_attr_mac_min_backoff_exponent.attr,
+  &dev_attr_mac_tdma.attr,
+  &dev_attr_mac_tdma_coordinator.attr,
+  &dev_attr_mac_tdma_guard_us.attr,
+  &dev_attr_mac_tdma_rx_slots.attr,
+  &dev_attr_mac_tdma_slot_us.attr,
+  &dev_attr_mac_tdma_superframe_us.attr,
+  &dev_attr_mac_tdma_tx_slots.attr,
   NULL,
 };
 
-static struct attribute_group sx1280_flrc_group = {
-  .attrs = sx1280_flrc_attrs,
-  .name = "flrc",
+static struct attribute_group sx1280_mac_group = {
+  .attrs = sx1280_mac_attrs,
+  .name = "mac",
 };
 
-/**************/
-/* GFSK sysfs */
-/**************/
+/****************/
+/* Survey sysfs */
+/****************/
 
-static ssize_t gfsk_bandwidth_time_show(
+/**
+ * Gets the number of RSSI samples taken at each step of the survey.
+ * @context - process
+ */
+static ssize_t survey_samples_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -3160,27 +14329,18 @@ static ssize_t gfsk_bandwidth_time_show(
     return -ERESTARTSYS;
   }
 
-  enum sx1280_bandwidth_time bt = priv->cfg.gfsk.modulation.bandwidth_time;
+  unsigned int value = priv->survey.samples;
   mutex_unlock(&priv->lock);
 
-  const char *bt_str;
-  switch (bt) {
-  case SX1280_BT_OFF: bt_str = "off"; break;
-  case SX1280_BT_0_5: bt_str = "0.5"; break;
-  case SX1280_BT_1_0: bt_str = "1.0"; break;
-  default:
-    WARN(1, "invalid internal gfsk bandwidth-time: %d\n", bt);
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%s\n", bt_str);
+  return sprintf(buf, "%u\n", value);
 }
 
 /**
- *
+ * Sets the number of RSSI samples taken at each step of the survey, up to
+ * SX1280_SURVEY_SAMPLES_MAX.
  * @context - process
  */
-static ssize_t gfsk_bandwidth_time_store(
+static ssize_t survey_samples_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3190,39 +14350,30 @@ static ssize_t gfsk_bandwidth_time_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  u8 bt;
-  if (sysfs_streq(buf, "off")) {
-    bt = SX1280_BT_OFF;
-  } else if (sysfs_streq(buf, "0.5")) {
-    bt = SX1280_BT_0_5;
-  } else if (sysfs_streq(buf, "1.0")) {
-    bt = SX1280_BT_1_0;
-  }
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
     return err;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_GFSK) {
-    struct sx1280_modulation_params mod_params = {
-      .mode = SX1280_MODE_GFSK,
-      .gfsk = priv->cfg.gfsk.modulation,
-    };
-    mod_params.gfsk.bandwidth_time = bt;
-
-    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
-      goto fail;
-    }
+  if (!value || value > SX1280_SURVEY_SAMPLES_MAX) {
+    return -EINVAL;
   }
 
-  priv->cfg.gfsk.modulation.bandwidth_time = bt;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-fail:
+  priv->survey.samples = value;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t gfsk_bitrate_bandwidth_show(
+/**
+ * Gets how long the receiver is left to settle at each step before sampling.
+ * @context - process
+ */
+static ssize_t survey_settle_us_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -3233,39 +14384,20 @@ static ssize_t gfsk_bitrate_bandwidth_show(
   if (mutex_lock_interruptible(&priv->lock)) {
     return -ERESTARTSYS;
   }
-  
-  enum sx1280_fsk_bitrate_bandwidth brbw =
-    priv->cfg.gfsk.modulation.bitrate_bandwidth;
-  mutex_unlock(&priv->lock);
 
-  int br, bw;
-  switch (brbw) {
-  case SX1280_FSK_BR_2_000_BW_2_4: br = 2000000; bw = 2400000; break;
-  case SX1280_FSK_BR_1_600_BW_2_4: br = 1600000; bw = 2400000; break;
-  case SX1280_FSK_BR_1_000_BW_2_4: br = 1000000; bw = 2400000; break;
-  case SX1280_FSK_BR_1_000_BW_1_2: br = 1000000; bw = 1200000; break;
-  case SX1280_FSK_BR_0_800_BW_2_4: br = 800000;  bw = 2400000; break;
-  case SX1280_FSK_BR_0_800_BW_1_2: br = 800000;  bw = 1200000; break;
-  case SX1280_FSK_BR_0_500_BW_1_2: br = 500000;  bw = 1200000; break;
-  case SX1280_FSK_BR_0_500_BW_0_6: br = 500000;  bw = 600000;  break;
-  case SX1280_FSK_BR_0_400_BW_1_2: br = 400000;  bw = 1200000; break;
-  case SX1280_FSK_BR_0_400_BW_0_6: br = 400000;  bw = 600000;  break;
-  case SX1280_FSK_BR_0_250_BW_0_6: br = 250000;  bw = 600000;  break;
-  case SX1280_FSK_BR_0_250_BW_0_3: br = 250000;  bw = 300000;  break;
-  case SX1280_FSK_BR_0_125_BW_0_3: br = 125000;  bw = 300000;  break;
-  default:
-    WARN(1, "invalid internal gfsk bitrate-bandwidth: %d\n", brbw);
-    return -EINVAL;
-  }
+  unsigned int value = priv->survey.settle_us;
+  mutex_unlock(&priv->lock);
 
-  return sprintf(buf, "%d,%d\n", br, bw);
+  return sprintf(buf, "%u\n", value);
 }
 
 /**
- *
+ * Sets how long the receiver is left to settle at each step before sampling,
+ * in microseconds. Shorter sweeps are faster, but the first samples of each
+ * step may read low.
  * @context - process
  */
-static ssize_t gfsk_bitrate_bandwidth_store(
+static ssize_t survey_settle_us_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3275,62 +14407,30 @@ static ssize_t gfsk_bitrate_bandwidth_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  enum sx1280_fsk_bitrate_bandwidth brbw;
-  if (sysfs_streq(buf, "2000000,2400000")) {
-    brbw = SX1280_FSK_BR_2_000_BW_2_4;
-  } else if (sysfs_streq(buf, "1600000,2400000")) {
-    brbw = SX1280_FSK_BR_1_600_BW_2_4;
-  } else if (sysfs_streq(buf, "1000000,2400000")) {
-    brbw = SX1280_FSK_BR_1_000_BW_2_4;
-  } else if (sysfs_streq(buf, "1000000,1200000")) {
-    brbw = SX1280_FSK_BR_1_000_BW_1_2;
-  } else if (sysfs_streq(buf, "800000,2400000")) {
-    brbw = SX1280_FSK_BR_0_800_BW_2_4;
-  } else if (sysfs_streq(buf, "800000,1200000")) {
-    brbw = SX1280_FSK_BR_0_800_BW_1_2;
-  } else if (sysfs_streq(buf, "500000,1200000")) {
-    brbw = SX1280_FSK_BR_0_500_BW_1_2;
-  } else if (sysfs_streq(buf, "500000,600000")) {
-    brbw = SX1280_FSK_BR_0_500_BW_0_6;
-  } else if (sysfs_streq(buf, "400000,1200000")) {
-    brbw = SX1280_FSK_BR_0_400_BW_1_2;
-  } else if (sysfs_streq(buf, "400000,600000")) {
-    brbw = SX1280_FSK_BR_0_400_BW_0_6;
-  } else if (sysfs_streq(buf, "250000,600000")) {
-    brbw = SX1280_FSK_BR_0_250_BW_0_6;
-  } else if (sysfs_streq(buf, "250000,300000")) {
-    brbw = SX1280_FSK_BR_0_250_BW_0_3;
-  } else if (sysfs_streq(buf, "125000,300000")) {
-    brbw = SX1280_FSK_BR_0_125_BW_0_3;
-  } else {
-    return -EINVAL;
-  }
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
     return err;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_GFSK) {
-    struct sx1280_modulation_params mod_params = {
-      .mode = SX1280_MODE_GFSK,
-      .gfsk = priv->cfg.gfsk.modulation,
-    };
-    mod_params.gfsk.bitrate_bandwidth = brbw;
-
-    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
-      goto fail;
-    }
+  if (value > SX1280_SURVEY_SETTLE_US_MAX) {
+    return -EINVAL;
   }
 
-  priv->cfg.gfsk.modulation.bitrate_bandwidth = brbw;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-fail:
+  priv->survey.settle_us = value;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
-}
 
+  return count;
+}
 
-static ssize_t gfsk_crc_bytes_show(
+/**
+ * Gets the frequency the survey starts at.
+ * @context - process
+ */
+static ssize_t survey_start_hz_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -3339,30 +14439,20 @@ static ssize_t gfsk_crc_bytes_show(
   struct sx1280_priv *priv = netdev_priv(netdev);
 
   if (mutex_lock_interruptible(&priv->lock)) {
-    return -ERESTARTSYS;
-  }
-
-  enum sx1280_radio_crc crc_length = priv->cfg.gfsk.packet.crc_length;
-  mutex_unlock(&priv->lock);
-
-  int bytes;
-  switch (crc_length) {
-  case SX1280_RADIO_CRC_OFF:     bytes = 0; break;
-  case SX1280_RADIO_CRC_1_BYTE:  bytes = 1; break;
-  case SX1280_RADIO_CRC_2_BYTES: bytes = 2; break;
-  default:
-    WARN(1, "invalid internal cfg.gfsk.packet.crc_length: %d\n", crc_length);
-    return -EINVAL;
+    return -ERESTARTSYS;
   }
 
-  return sprintf(buf, "%d\n", bytes);
+  u32 value = priv->survey.start_hz;
+  mutex_unlock(&priv->lock);
+
+  return sprintf(buf, "%u\n", value);
 }
 
 /**
- *
+ * Sets the frequency the survey starts at, in Hz.
  * @context - process
  */
-static ssize_t gfsk_crc_bytes_store(
+static ssize_t survey_start_hz_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3372,44 +14462,30 @@ static ssize_t gfsk_crc_bytes_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  int crc_bytes;
-  if ((err = kstrtoint(buf, 10, &crc_bytes))) {
+  u32 value;
+  if ((err = kstrtou32(buf, 10, &value))) {
     return err;
   }
 
-  enum sx1280_radio_crc crc_length;
-  switch (crc_bytes) {
-  case 0: crc_length = SX1280_RADIO_CRC_OFF; break;
-  case 1: crc_length = SX1280_RADIO_CRC_1_BYTE; break;
-  case 2: crc_length = SX1280_RADIO_CRC_2_BYTES; break;
-  default:
+  if (value < SX1280_SURVEY_FREQ_HZ_MIN || value > SX1280_SURVEY_FREQ_HZ_MAX) {
     return -EINVAL;
   }
 
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
-    return err;
-  }
-
-  if (priv->cfg.mode == SX1280_MODE_GFSK) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_GFSK,
-      .gfsk = priv->cfg.gfsk.packet,
-    };
-    packet_params.gfsk.crc_length = crc_length;
-
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
-    }
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  priv->cfg.gfsk.packet.crc_length = crc_length;
-
-fail:
+  priv->survey.start_hz = value;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t gfsk_crc_polynomial_show(
+/**
+ * Gets the spacing of the survey's steps.
+ * @context - process
+ */
+static ssize_t survey_step_hz_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -3421,18 +14497,18 @@ static ssize_t gfsk_crc_polynomial_show(
     return -ERESTARTSYS;
   }
 
-  u8 crc_polynomial[2];
-  memcpy(crc_polynomial, priv->cfg.gfsk.crc_polynomial, sizeof(crc_polynomial));
+  u32 value = priv->survey.step_hz;
   mutex_unlock(&priv->lock);
 
-  return sprintf(buf, "%*phN\n", 2, crc_polynomial);
+  return sprintf(buf, "%u\n", value);
 }
 
 /**
- *
+ * Sets the spacing of the survey's steps, in Hz. The range may be cut into at
+ * most SX1280_SURVEY_STEPS_MAX steps.
  * @context - process
  */
-static ssize_t gfsk_crc_polynomial_store(
+static ssize_t survey_step_hz_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3442,37 +14518,30 @@ static ssize_t gfsk_crc_polynomial_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (count != 5 && count != 4) {
-    return -EINVAL;
-  }
-
-  u8 crc_polynomial[2];
-  if ((err = hex2bin(crc_polynomial, buf, 2))) {
+  u32 value;
+  if ((err = kstrtou32(buf, 10, &value))) {
     return err;
   }
 
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
-    return err;
+  if (value < SX1280_SURVEY_STEP_HZ_MIN) {
+    return -EINVAL;
   }
 
-  err = sx1280_write_register(
-    priv,
-    SX1280_REG_CRC_POLYNOMIAL_DEFINITION_MSB,
-    crc_polynomial,
-    2
-  );
-  if (err) {
-    goto fail;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  memcpy(priv->cfg.gfsk.crc_polynomial, crc_polynomial, 2);
-
-fail:
+  priv->survey.step_hz = value;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t gfsk_whitening_show(
+/**
+ * Gets the frequency the survey stops at.
+ * @context - process
+ */
+static ssize_t survey_stop_hz_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -3484,14 +14553,18 @@ static ssize_t gfsk_whitening_show(
     return -ERESTARTSYS;
   }
 
-  bool whitening = priv->cfg.gfsk.packet.whitening == SX1280_WHITENING_ENABLE;
-  int count = sprintf(buf, "%d\n", whitening);
-
+  u32 value = priv->survey.stop_hz;
   mutex_unlock(&priv->lock);
-  return count;
+
+  return sprintf(buf, "%u\n", value);
 }
 
-static ssize_t gfsk_whitening_store(
+/**
+ * Sets the frequency the survey stops at, in Hz, which is included if it falls
+ * on a step.
+ * @context - process
+ */
+static ssize_t survey_stop_hz_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3501,39 +14574,30 @@ static ssize_t gfsk_whitening_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  bool whitening_bool;
-  if ((err = kstrtobool(buf, &whitening_bool))) {
+  u32 value;
+  if ((err = kstrtou32(buf, 10, &value))) {
     return err;
   }
 
-  enum sx1280_whitening whitening = whitening_bool
-    ? SX1280_WHITENING_ENABLE
-    : SX1280_WHITENING_DISABLE;
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
-    return err;
+  if (value < SX1280_SURVEY_FREQ_HZ_MIN || value > SX1280_SURVEY_FREQ_HZ_MAX) {
+    return -EINVAL;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_GFSK) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_GFSK,
-      .gfsk = priv->cfg.gfsk.packet,
-    };
-    packet_params.gfsk.whitening = whitening;
-
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
-    }
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  priv->cfg.gfsk.packet.whitening = whitening;
-
-fail:
+  priv->survey.stop_hz = value;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t gfsk_modulation_index_show(
+/**
+ * Gets whether the channel is picked automatically.
+ * @context - process
+ */
+static ssize_t survey_acs_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -3545,41 +14609,19 @@ static ssize_t gfsk_modulation_index_show(
     return -ERESTARTSYS;
   }
 
-  enum sx1280_modulation_index mod_index =
-    priv->cfg.gfsk.modulation.modulation_index;
+  bool value = priv->acs.enabled;
   mutex_unlock(&priv->lock);
 
-  const char *mod_index_str;
-  switch (mod_index) {
-  case SX1280_MOD_IND_0_35: mod_index_str = "0.35"; break;
-  case SX1280_MOD_IND_0_50: mod_index_str = "0.50"; break;
-  case SX1280_MOD_IND_0_75: mod_index_str = "0.75"; break;
-  case SX1280_MOD_IND_1_00: mod_index_str = "1.00"; break;
-  case SX1280_MOD_IND_1_25: mod_index_str = "1.25"; break;
-  case SX1280_MOD_IND_1_50: mod_index_str = "1.50"; break;
-  case SX1280_MOD_IND_1_75: mod_index_str = "1.75"; break;
-  case SX1280_MOD_IND_2_00: mod_index_str = "2.00"; break;
-  case SX1280_MOD_IND_2_25: mod_index_str = "2.25"; break;
-  case SX1280_MOD_IND_2_50: mod_index_str = "2.50"; break;
-  case SX1280_MOD_IND_2_75: mod_index_str = "2.75"; break;
-  case SX1280_MOD_IND_3_00: mod_index_str = "3.00"; break;
-  case SX1280_MOD_IND_3_25: mod_index_str = "3.25"; break;
-  case SX1280_MOD_IND_3_50: mod_index_str = "3.50"; break;
-  case SX1280_MOD_IND_3_75: mod_index_str = "3.75"; break;
-  case SX1280_MOD_IND_4_00: mod_index_str = "4.00"; break;
-  default:
-    WARN(1, "invalid internal gfsk modulation index: %d\n", mod_index);
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%s\n", mod_index_str);
+  return sprintf(buf, "%d\n", value);
 }
 
 /**
- *
+ * Enables or disables automatic channel selection. It first takes effect when
+ * the interface is next brought up, and can't be enabled while frequency
+ * hopping.
  * @context - process
  */
-static ssize_t gfsk_modulation_index_store(
+static ssize_t survey_acs_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3588,110 +14630,67 @@ static ssize_t gfsk_modulation_index_store(
   int err;
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
-  
-  u8 mod_index;
-  if (sysfs_streq(buf, "0.35")) {
-    mod_index = SX1280_MOD_IND_0_35;
-  } else if (sysfs_streq(buf, "0.50")) {
-    mod_index = SX1280_MOD_IND_0_50;
-  } else if (sysfs_streq(buf, "0.75")) {
-    mod_index = SX1280_MOD_IND_0_75;
-  } else if (sysfs_streq(buf, "1.00")) {
-    mod_index = SX1280_MOD_IND_1_00;
-  } else if (sysfs_streq(buf, "1.25")) {
-    mod_index = SX1280_MOD_IND_1_25;
-  } else if (sysfs_streq(buf, "1.50")) {
-    mod_index = SX1280_MOD_IND_1_50;
-  } else if (sysfs_streq(buf, "1.75")) {
-    mod_index = SX1280_MOD_IND_1_75;
-  } else if (sysfs_streq(buf, "2.00")) {
-    mod_index = SX1280_MOD_IND_2_00;
-  } else if (sysfs_streq(buf, "2.25")) {
-    mod_index = SX1280_MOD_IND_2_25;
-  } else if (sysfs_streq(buf, "2.50")) {
-    mod_index = SX1280_MOD_IND_2_50;
-  } else if (sysfs_streq(buf, "2.75")) {
-    mod_index = SX1280_MOD_IND_2_75;
-  } else if (sysfs_streq(buf, "3.00")) {
-    mod_index = SX1280_MOD_IND_3_00;
-  } else if (sysfs_streq(buf, "3.25")) {
-    mod_index = SX1280_MOD_IND_3_25;
-  } else if (sysfs_streq(buf, "3.50")) {
-    mod_index = SX1280_MOD_IND_3_50;
-  } else if (sysfs_streq(buf, "3.75")) {
-    mod_index = SX1280_MOD_IND_3_75;
-  } else if (sysfs_streq(buf, "4.00")) {
-    mod_index = SX1280_MOD_IND_4_00;
-  } else {
-    return -EINVAL;
-  }
 
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+  bool value;
+  if ((err = kstrtobool(buf, &value))) {
     return err;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_GFSK) {
-    struct sx1280_modulation_params mod_params = {
-      .mode = SX1280_MODE_GFSK,
-      .gfsk = priv->cfg.gfsk.modulation,
-    };
-    mod_params.gfsk.modulation_index = mod_index;
-
-    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
-      goto fail;
-    }
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  priv->cfg.gfsk.modulation.modulation_index = mod_index;
+  if (value && priv->fhss.enabled) {
+    mutex_unlock(&priv->lock);
+    return -EBUSY;
+  }
 
-fail:
+  priv->acs.enabled = value;
+  sx1280_acs_restart(priv);
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t gfsk_preamble_bits_show(
+/**
+ * Gets the candidate channels, in Hz.
+ * @context - process
+ */
+static ssize_t survey_acs_channels_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
 ) {
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_acs *acs = &priv->acs;
+  int len = 0;
 
   if (mutex_lock_interruptible(&priv->lock)) {
     return -ERESTARTSYS;
   }
 
-  enum sx1280_preamble_length preamble_length =
-    priv->cfg.gfsk.packet.preamble_length;
-  mutex_unlock(&priv->lock);
-
-  int bits;
-  switch (preamble_length) {
-  case SX1280_PREAMBLE_LENGTH_04_BITS: bits = 4;  break;
-  case SX1280_PREAMBLE_LENGTH_08_BITS: bits = 8;  break;
-  case SX1280_PREAMBLE_LENGTH_12_BITS: bits = 12; break;
-  case SX1280_PREAMBLE_LENGTH_16_BITS: bits = 16; break;
-  case SX1280_PREAMBLE_LENGTH_20_BITS: bits = 20; break;
-  case SX1280_PREAMBLE_LENGTH_24_BITS: bits = 24; break;
-  case SX1280_PREAMBLE_LENGTH_28_BITS: bits = 28; break;
-  case SX1280_PREAMBLE_LENGTH_32_BITS: bits = 32; break;
-  default:
-    WARN(
-      1,
-      "invalid internal gfsk.packet.preamble_length: %d\n",
-      preamble_length
+  for (unsigned int i = 0; i < acs->n_channels; i++) {
+    len += sprintf(
+      &buf[len],
+      "%s%u",
+      i ? " " : "",
+      SX1280_FREQ_PLL_TO_HZ(acs->channels[i])
     );
-    return -EINVAL;
   }
 
-  return sprintf(buf, "%d\n", bits);
+  mutex_unlock(&priv->lock);
+
+  len += sprintf(&buf[len], "\n");
+  return len;
 }
 
 /**
- *
+ * Sets the candidate channels, as up to SX1280_ACS_CHANNELS_MAX frequencies in
+ * Hz.
  * @context - process
  */
-static ssize_t gfsk_preamble_bits_store(
+static ssize_t survey_acs_channels_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3700,50 +14699,42 @@ static ssize_t gfsk_preamble_bits_store(
   int err;
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_acs *acs = &priv->acs;
 
-  int preamble_bits;
-  if ((err = kstrtoint(buf, 10, &preamble_bits))) {
-    return err;
-  }
-
-  enum sx1280_preamble_length preamble_length;
-  switch (preamble_bits) {
-  case 4:  preamble_length = SX1280_PREAMBLE_LENGTH_04_BITS; break;
-  case 8:  preamble_length = SX1280_PREAMBLE_LENGTH_08_BITS; break;
-  case 12: preamble_length = SX1280_PREAMBLE_LENGTH_12_BITS; break;
-  case 16: preamble_length = SX1280_PREAMBLE_LENGTH_16_BITS; break;
-  case 20: preamble_length = SX1280_PREAMBLE_LENGTH_20_BITS; break;
-  case 24: preamble_length = SX1280_PREAMBLE_LENGTH_24_BITS; break;
-  case 28: preamble_length = SX1280_PREAMBLE_LENGTH_28_BITS; break;
-  case 32: preamble_length = SX1280_PREAMBLE_LENGTH_32_BITS; break;
-  default:
-    return -EINVAL;
-  }
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
+  u32 freqs_hz[SX1280_ACS_CHANNELS_MAX];
+  unsigned int n;
+  if ((err = sx1280_parse_u32_list(buf, freqs_hz, ARRAY_SIZE(freqs_hz), &n))) {
     return err;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_GFSK) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_GFSK,
-      .gfsk = priv->cfg.gfsk.packet,
-    };
-    packet_params.gfsk.preamble_length = preamble_length;
-
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
+  for (unsigned int i = 0; i < n; i++) {
+    if (
+      freqs_hz[i] < SX1280_SURVEY_FREQ_HZ_MIN
+      || freqs_hz[i] > SX1280_SURVEY_FREQ_HZ_MAX
+    ) {
+      return -EINVAL;
     }
   }
 
-  priv->cfg.gfsk.packet.preamble_length = preamble_length;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
+  }
 
-fail:
+  for (unsigned int i = 0; i < n; i++) {
+    acs->channels[i] = SX1280_FREQ_HZ_TO_PLL(freqs_hz[i]);
+  }
+
+  acs->n_channels = n;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t gfsk_sync_word_length_show(
+/**
+ * Gets how often the packet error rate is checked, in seconds.
+ * @context - process
+ */
+static ssize_t survey_acs_interval_s_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -3755,34 +14746,18 @@ static ssize_t gfsk_sync_word_length_show(
     return -ERESTARTSYS;
   }
 
-  enum sx1280_gfsk_sync_word_length sync_word_length =
-    priv->cfg.gfsk.packet.sync_word_length;
+  unsigned int value = priv->acs.interval_s;
   mutex_unlock(&priv->lock);
 
-  int bytes;
-  switch (sync_word_length) {
-  case SX1280_SYNC_WORD_LEN_1_B: bytes = 1; break;
-  case SX1280_SYNC_WORD_LEN_2_B: bytes = 2; break;
-  case SX1280_SYNC_WORD_LEN_3_B: bytes = 3; break;
-  case SX1280_SYNC_WORD_LEN_4_B: bytes = 4; break;
-  case SX1280_SYNC_WORD_LEN_5_B: bytes = 5; break;
-  default:
-    WARN(
-      1,
-      "invalid internal gfsk.packet.sync_word_length: %d\n",
-      sync_word_length
-    );
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%d\n", bytes);
+  return sprintf(buf, "%u\n", value);
 }
 
 /**
- *
+ * Sets how often the packet error rate is checked, in seconds. With 0, the
+ * channel is only picked as the interface comes up.
  * @context - process
  */
-static ssize_t gfsk_sync_word_length_store(
+static ssize_t survey_acs_interval_s_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3792,50 +14767,35 @@ static ssize_t gfsk_sync_word_length_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  int sync_word_bytes;
-  if ((err = kstrtoint(buf, 10, &sync_word_bytes))) {
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
     return err;
   }
 
-  enum sx1280_gfsk_sync_word_length sync_word_length;
-  switch (sync_word_bytes) {
-  case 1: sync_word_length = SX1280_SYNC_WORD_LEN_1_B; break;
-  case 2: sync_word_length = SX1280_SYNC_WORD_LEN_2_B; break;
-  case 3: sync_word_length = SX1280_SYNC_WORD_LEN_3_B; break;
-  case 4: sync_word_length = SX1280_SYNC_WORD_LEN_4_B; break;
-  case 5: sync_word_length = SX1280_SYNC_WORD_LEN_5_B; break;
-  default: return -EINVAL;
-  }
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
-    return err;
+  if (value > SX1280_ACS_INTERVAL_S_MAX) {
+    return -EINVAL;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_GFSK) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_GFSK,
-      .gfsk = priv->cfg.gfsk.packet,
-    };
-    packet_params.gfsk.sync_word_length = sync_word_length;
-
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
-    }
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  priv->cfg.gfsk.packet.sync_word_length = sync_word_length;
-
-fail:
+  priv->acs.interval_s = value;
+  sx1280_acs_restart(priv);
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return count;
 }
 
-static ssize_t gfsk_sync_word_match_show(
+/**
+ * Gets the packet error rate past which another channel is looked for.
+ * @context - process
+ */
+static ssize_t survey_acs_per_percent_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
 ) {
-  int err;
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
@@ -3843,29 +14803,18 @@ static ssize_t gfsk_sync_word_match_show(
     return -ERESTARTSYS;
   }
 
-  const char *mask;
-  switch (priv->cfg.gfsk.packet.sync_word_match) {
-  case SX1280_RADIO_SELECT_SYNCWORD_OFF  : mask = "000"; break;
-  case SX1280_RADIO_SELECT_SYNCWORD_1    : mask = "100"; break;
-  case SX1280_RADIO_SELECT_SYNCWORD_2    : mask = "010"; break;
-  case SX1280_RADIO_SELECT_SYNCWORD_1_2  : mask = "110"; break;
-  case SX1280_RADIO_SELECT_SYNCWORD_3    : mask = "001"; break;
-  case SX1280_RADIO_SELECT_SYNCWORD_1_3  : mask = "101"; break;
-  case SX1280_RADIO_SELECT_SYNCWORD_2_3  : mask = "011"; break;
-  case SX1280_RADIO_SELECT_SYNCWORD_1_2_3: mask = "111"; break;
-  }
-
-  int count = sprintf(buf, "%s\n", mask);
-
+  unsigned int value = priv->acs.per_percent;
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+
+  return sprintf(buf, "%u\n", value);
 }
 
 /**
- *
+ * Sets the packet error rate, as a percentage, past which another channel is
+ * looked for.
  * @context - process
  */
-static ssize_t gfsk_sync_word_match_store(
+static ssize_t survey_acs_per_percent_store(
   struct device *dev,
   struct device_attribute *attr,
   const char *buf,
@@ -3875,93 +14824,204 @@ static ssize_t gfsk_sync_word_match_store(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  enum sx1280_sync_word_match sync_word_match;
-  if (sysfs_streq(buf, "000") || sysfs_streq(buf, "off")) {
-    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_OFF;
-  } else if (sysfs_streq(buf, "100")) {
-    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_1;
-  } else if (sysfs_streq(buf, "010")) {
-    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_2;
-  } else if (sysfs_streq(buf, "110")) {
-    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_1_2;
-  } else if (sysfs_streq(buf, "001")) {
-    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_3;
-  } else if (sysfs_streq(buf, "101")) {
-    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_1_3;
-  } else if (sysfs_streq(buf, "011")) {
-    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_2_3;
-  } else if (sysfs_streq(buf, "111")) {
-    sync_word_match = SX1280_RADIO_SELECT_SYNCWORD_1_2_3;
-  } else {
+  unsigned int value;
+  if ((err = kstrtouint(buf, 10, &value))) {
+    return err;
+  }
+
+  if (!value || value > 100) {
     return -EINVAL;
   }
 
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_GFSK, false))) {
-    return err;
+  if (mutex_lock_interruptible(&priv->lock)) {
+    return -ERESTARTSYS;
   }
 
-  if (priv->cfg.mode == SX1280_MODE_GFSK) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_GFSK,
-      .gfsk = priv->cfg.gfsk.packet,
-    };
-    packet_params.gfsk.sync_word_match = sync_word_match;
+  priv->acs.per_percent = value;
+  mutex_unlock(&priv->lock);
 
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
-    }
+  return count;
+}
+
+/**
+ * Sweeps the spectrum and reads out the result: a struct sx1280_survey_hdr,
+ * then the RSSI samples of each step. A read from the start runs a new sweep,
+ * and reads further on return the rest of it.
+ * @context - process
+ */
+static ssize_t spectrum_read(
+  struct file *file,
+  struct kobject *kobj,
+  SX1280_BIN_ATTR_CONST struct bin_attribute *attr,
+  char *buf,
+  loff_t off,
+  size_t count
+) {
+  int err;
+  struct net_device *netdev = to_net_dev(kobj_to_dev(kobj));
+  struct sx1280_priv *priv = netdev_priv(netdev);
+  struct sx1280_survey *survey = &priv->survey;
+
+  if ((err = sx1280_acquire_idle(priv, false))) {
+    return err;
   }
 
-  priv->cfg.gfsk.packet.sync_word_match = sync_word_match;
+  if (!off && (err = sx1280_survey_run(priv))) {
+    mutex_unlock(&priv->lock);
+    return err;
+  }
+
+  ssize_t len = memory_read_from_buffer(
+    buf,
+    count,
+    &off,
+    survey->result,
+    survey->result_len
+  );
 
-fail:
   mutex_unlock(&priv->lock);
-  return err ? err : count;
+  return len;
 }
 
-/* GFSK-specific device attributes */
-static struct device_attribute dev_attr_gfsk_bandwidth_time =
-  __ATTR(bandwidth_time, 0644, gfsk_bandwidth_time_show, gfsk_bandwidth_time_store);
-static struct device_attribute dev_attr_gfsk_bitrate_bandwidth =
-  __ATTR(bitrate_bandwidth, 0644, gfsk_bitrate_bandwidth_show, gfsk_bitrate_bandwidth_store);
-static struct device_attribute dev_attr_gfsk_crc_bytes =
-  __ATTR(crc_bytes, 0644, gfsk_crc_bytes_show, gfsk_crc_bytes_store);
-static struct device_attribute dev_attr_gfsk_crc_polynomial =
-  __ATTR(crc_polynomial, 0644, gfsk_crc_polynomial_show, gfsk_crc_polynomial_store);
-static struct device_attribute dev_attr_gfsk_modulation_index =
-  __ATTR(modulation_index, 0644, gfsk_modulation_index_show, gfsk_modulation_index_store);
-static struct device_attribute dev_attr_gfsk_preamble_bits =
-  __ATTR(preamble_bits, 0644, gfsk_preamble_bits_show, gfsk_preamble_bits_store);
-static struct device_attribute dev_attr_gfsk_sync_word_length =
-  __ATTR(sync_word_length, 0644, gfsk_sync_word_length_show, gfsk_sync_word_length_store);
-static struct device_attribute dev_attr_gfsk_sync_word_match =
-  __ATTR(sync_word_match, 0644, gfsk_sync_word_match_show, gfsk_sync_word_match_store);
-static struct device_attribute dev_attr_gfsk_whitening =
-  __ATTR(whitening, 0644, gfsk_whitening_show, gfsk_whitening_store);
-
-static struct attribute *sx1280_gfsk_attrs[] = {
-  &dev_attr_gfsk_bandwidth_time.attr,
-  &dev_attr_gfsk_bitrate_bandwidth.attr,
-  &dev_attr_gfsk_crc_bytes.attr,
-  &dev_attr_gfsk_crc_polynomial.attr,
-  &dev_attr_gfsk_modulation_index.attr,
-  &dev_attr_gfsk_preamble_bits.attr,
-  &dev_attr_gfsk_sync_word_length.attr,
-  &dev_attr_gfsk_sync_word_match.attr,
-  &dev_attr_gfsk_whitening.attr,
+static struct device_attribute dev_attr_survey_acs =
+  __ATTR(acs, 0644, survey_acs_show, survey_acs_store);
+static struct device_attribute dev_attr_survey_acs_channels =
+  __ATTR(
+    acs_channels,
+    0644,
+    survey_acs_channels_show,
+    survey_acs_channels_store
+  );
+static struct device_attribute dev_attr_survey_acs_interval_s =
+  __ATTR(
+    acs_interval_s,
+    0644,
+    survey_acs_interval_s_show,
+    survey_acs_interval_s_store
+  );
+static struct device_attribute dev_attr_survey_acs_per_percent =
+  __ATTR(
+    acs_per_percent,
+    0644,
+    survey_acs_per_percent_show,
+    survey_acs_per_percent_store
+  );
+static struct device_attribute dev_attr_survey_samples =
+  __ATTR(samples, 0644, survey_samples_show, survey_samples_store);
+static struct device_attribute dev_attr_survey_settle_us =
+  __ATTR(settle_us, 0644, survey_settle_us_show, survey_settle_us_store);
+static struct device_attribute dev_attr_survey_start_hz =
+  __ATTR(start_hz, 0644, survey_start_hz_show, survey_start_hz_store);
+static struct device_attribute dev_attr_survey_step_hz =
+  __ATTR(step_hz, 0644, survey_step_hz_show, survey_step_hz_store);
+static struct device_attribute dev_attr_survey_stop_hz =
+  __ATTR(stop_hz, 0644, survey_stop_hz_show, survey_stop_hz_store);
+
+static struct attribute *sx1280_survey_attrs[] = {
+  &dev_attr_survey_acs.attr,
+  &dev_attr_survey_acs_channels.attr,
+  &dev_attr_survey_acs_interval_s.attr,
+  &dev_attr_survey_acs_per_percent.attr,
+  &dev_attr_survey_samples.attr,
+  &dev_attr_survey_settle_us.attr,
+  &dev_attr_survey_start_hz.attr,
+  &dev_attr_survey_step_hz.attr,
+  &dev_attr_survey_stop_hz.attr,
   NULL,
 };
 
-static struct attribute_group sx1280_gfsk_group = {
-  .attrs = sx1280_gfsk_attrs,
-  .name = "gfsk",
+static struct attribute_group sx1280_survey_group = {
+  .attrs = sx1280_survey_attrs,
+  .name = "survey",
 };
 
-/**************/
-/* LoRa sysfs */
-/**************/
+/* The sweep's result is read out in one go, rather than a file per point. */
+static BIN_ATTR_RO(spectrum, 0);
 
-static ssize_t lora_bandwidth_show(
+/******************/
+/* Counters sysfs */
+/******************/
+
+/**
+ * Gets the number of times a quieter channel was moved to.
+ * @context - process
+ */
+static ssize_t acs_switches_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->acs.switches));
+}
+
+/**
+ * Gets the number of times the data rate was changed.
+ * @context - process
+ */
+static ssize_t adr_changes_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->adr.changes));
+}
+
+/**
+ * Gets the number of packets sent packed together with others in one frame.
+ * @context - process
+ */
+static ssize_t aggregated_packets_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->link.agg_packets));
+}
+
+/**
+ * Gets the number of ARQ frames that were acknowledged.
+ * @context - process
+ */
+static ssize_t arq_acked_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->arq.acked));
+}
+
+/**
+ * Gets the number of received ARQ frames dropped as retransmissions.
+ * @context - process
+ */
+static ssize_t arq_duplicates_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->arq.duplicates));
+}
+
+/**
+ * Gets the number of ARQ frames given up on after running out of retries.
+ * @context - process
+ */
+static ssize_t arq_failures_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -3969,76 +15029,45 @@ static ssize_t lora_bandwidth_show(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (mutex_lock_interruptible(&priv->lock)) {
-    return -ERESTARTSYS;
-  }
-
-  enum sx1280_lora_bandwidth bandwidth = priv->cfg.lora.modulation.bandwidth;
-  mutex_unlock(&priv->lock);
-
-  int bandwidth_hz;
-  switch (bandwidth) {
-  case SX1280_LORA_BW_1600: bandwidth_hz = 1600000; break;
-  case SX1280_LORA_BW_800: bandwidth_hz = 800000; break;
-  case SX1280_LORA_BW_400: bandwidth_hz = 400000; break;
-  case SX1280_LORA_BW_200: bandwidth_hz = 200000; break;
-  default:
-    WARN(1, "invalid internal cfg.lora.modulation.bandwidth: %d\n", bandwidth);
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%d\n", bandwidth_hz);
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->arq.failures));
 }
 
-static ssize_t lora_bandwidth_store(
+/**
+ * Gets the number of ARQ frames retransmitted for lack of an ACK.
+ * @context - process
+ */
+static ssize_t arq_retransmissions_show(
   struct device *dev,
   struct device_attribute *attr,
-  const char *buf,
-  size_t count
+  char *buf
 ) {
-  int err;
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  int bandwidth_hz;
-  if ((err = kstrtoint(buf, 10, &bandwidth_hz))) {
-    return err;
-  }
-
-  enum sx1280_lora_bandwidth bandwidth;
-  switch (bandwidth_hz) {
-  case 1600000: bandwidth = SX1280_LORA_BW_1600; break;
-  case 800000:  bandwidth = SX1280_LORA_BW_800;  break;
-  case 400000:  bandwidth = SX1280_LORA_BW_400;  break;
-  case 200000:  bandwidth = SX1280_LORA_BW_200;  break;
-  default:
-    return -EINVAL;
-  }
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
-    return err;
-  }
-
-  if (priv->cfg.mode == SX1280_MODE_LORA) {
-    struct sx1280_modulation_params mod_params = {
-      .mode = SX1280_MODE_LORA,
-      .lora = priv->cfg.lora.modulation,
-    };
-    mod_params.lora.bandwidth = bandwidth;
-
-    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
-      goto fail;
-    }
-  }
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->arq.retransmissions));
+}
 
-  priv->cfg.lora.modulation.bandwidth = bandwidth;
+/**
+ * Gets the number of datagram bytes offered for payload compression.
+ * @context - process
+ */
+static ssize_t compression_bytes_in_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-fail:
-  mutex_unlock(&priv->lock);
-  return err ? err : count;
+  return sprintf(buf, "%llu\n", READ_ONCE(priv->link.lz4_bytes_in));
 }
 
-static ssize_t lora_coding_rate_show(
+/**
+ * Gets the number of bytes those datagrams took up on the air, compressed or
+ * not. The ratio to compression_bytes_in is the overall compression ratio.
+ * @context - process
+ */
+static ssize_t compression_bytes_out_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -4046,88 +15075,74 @@ static ssize_t lora_coding_rate_show(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (mutex_lock_interruptible(&priv->lock)) {
-    return -ERESTARTSYS;
-  }
-
-  enum sx1280_lora_coding_rate coding_rate =
-    priv->cfg.lora.modulation.coding_rate;
-  mutex_unlock(&priv->lock);
+  return sprintf(buf, "%llu\n", READ_ONCE(priv->link.lz4_bytes_out));
+}
 
-  const char *coding_rate_str;
-  switch (coding_rate) {
-  case SX1280_LORA_CR_4_5: coding_rate_str = "4/5"; break;
-  case SX1280_LORA_CR_4_6: coding_rate_str = "4/6"; break;
-  case SX1280_LORA_CR_4_7: coding_rate_str = "4/7"; break;
-  case SX1280_LORA_CR_4_8: coding_rate_str = "4/8"; break;
-  case SX1280_LORA_CR_LI_4_5: coding_rate_str = "4/5*"; break;
-  case SX1280_LORA_CR_LI_4_6: coding_rate_str = "4/6*"; break;
-  case SX1280_LORA_CR_LI_4_8: coding_rate_str = "4/8*"; break;
-  default:
-    WARN(
-      1,
-      "invalid internal cfg.lora.modulation.coding_rate: %d\n",
-      coding_rate
-    );
-    return -EINVAL;
-  }
+/**
+ * Gets the CPU time spent compressing payloads, in nanoseconds.
+ * @context - process
+ */
+static ssize_t compression_ns_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  return sprintf(buf, "%s\n", coding_rate_str);
+  return sprintf(buf, "%llu\n", READ_ONCE(priv->link.lz4_compress_ns));
 }
 
-static ssize_t lora_coding_rate_store(
+/**
+ * Gets the time frames spent waiting for a busy channel, in nanoseconds.
+ * @context - process
+ */
+static ssize_t csma_busy_ns_show(
   struct device *dev,
   struct device_attribute *attr,
-  const char *buf,
-  size_t count
+  char *buf
 ) {
-  int err;
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  enum sx1280_lora_coding_rate coding_rate;
-  if (sysfs_streq(buf, "4/5")) {
-    coding_rate = SX1280_LORA_CR_4_5;
-  } else if (sysfs_streq(buf, "4/6")) {
-    coding_rate = SX1280_LORA_CR_4_6;
-  } else if (sysfs_streq(buf, "4/7")) {
-    coding_rate = SX1280_LORA_CR_4_7;
-  } else if (sysfs_streq(buf, "4/8")) {
-    coding_rate = SX1280_LORA_CR_4_8;
-  } else if (sysfs_streq(buf, "4/5*")) {
-    coding_rate = SX1280_LORA_CR_LI_4_5;
-  } else if (sysfs_streq(buf, "4/6*")) {
-    coding_rate = SX1280_LORA_CR_LI_4_6;
-  } else if (sysfs_streq(buf, "4/8*")) {
-    coding_rate = SX1280_LORA_CR_LI_4_8;
-  } else {
-    return -EINVAL;
-  }
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
-    return err;
-  }
+  return sprintf(buf, "%llu\n", READ_ONCE(priv->mac.busy_ns));
+}
 
-  if (priv->cfg.mode == SX1280_MODE_LORA) {
-    struct sx1280_modulation_params mod_params = {
-      .mode = SX1280_MODE_LORA,
-      .lora = priv->cfg.lora.modulation,
-    };
-    mod_params.lora.coding_rate = coding_rate;
+/**
+ * Gets the number of times a frame was held back by a busy channel.
+ * @context - process
+ */
+static ssize_t csma_deferrals_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
-      goto fail;
-    }
-  }
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->mac.deferrals));
+}
 
-  priv->cfg.lora.modulation.coding_rate = coding_rate;
+/**
+ * Gets the number of frames dropped because the channel stayed busy.
+ * @context - process
+ */
+static ssize_t csma_failures_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-fail:
-  mutex_unlock(&priv->lock);
-  return err ? err : count;
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->mac.failures));
 }
 
-static ssize_t lora_crc_enable_show(
+/**
+ * Gets the CPU time spent decompressing payloads, in nanoseconds.
+ * @context - process
+ */
+static ssize_t decompression_ns_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -4135,59 +15150,91 @@ static ssize_t lora_crc_enable_show(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (mutex_lock_interruptible(&priv->lock)) {
-    return -ERESTARTSYS;
-  }
+  return sprintf(buf, "%llu\n", READ_ONCE(priv->link.lz4_decompress_ns));
+}
 
-  bool crc_enable = priv->cfg.lora.packet.crc == SX1280_LORA_CRC_ENABLE;
-  mutex_unlock(&priv->lock);
+/**
+ * Gets the total time the queue was stopped by the duty cycle limit, in
+ * nanoseconds.
+ * @context - process
+ */
+static ssize_t duty_cycle_throttled_ns_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  return sprintf(buf, "%d\n", crc_enable);
+  return sprintf(buf, "%llu\n", READ_ONCE(priv->duty.throttled_ns));
 }
 
-static ssize_t lora_crc_enable_store(
+/**
+ * Gets the number of times the queue was stopped by the duty cycle limit.
+ * @context - process
+ */
+static ssize_t duty_cycle_throttles_show(
   struct device *dev,
   struct device_attribute *attr,
-  const char *buf,
-  size_t count
+  char *buf
 ) {
-  int err;
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  bool crc_enable;
-  if ((err = kstrtobool(buf, &crc_enable))) {
-    return err;
-  }
-
-  enum sx1280_lora_crc crc = crc_enable
-    ? SX1280_LORA_CRC_ENABLE
-    : SX1280_LORA_CRC_DISABLE;
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->duty.throttles));
+}
 
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
-    return err;
-  }
+/**
+ * Gets the number of commands and register writes skipped because they
+ * wouldn't have changed the chip's configuration.
+ * @context - process
+ */
+static ssize_t elided_commands_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (priv->cfg.mode == SX1280_MODE_LORA) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_LORA,
-      .lora = priv->cfg.lora.packet,
-    };
-    packet_params.lora.crc = crc;
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->shadow.elided));
+}
 
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
-    }
-  }
+/**
+ * Gets the number of times the channel was hopped.
+ * @context - process
+ */
+static ssize_t fhss_hops_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-  priv->cfg.lora.packet.crc = crc;
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->fhss.hops));
+}
 
-fail:
-  mutex_unlock(&priv->lock);
-  return err ? err : count;
+/**
+ * Gets the number of bytes saved by compressing the headers of sent packets.
+ * @context - process
+ */
+static ssize_t header_bytes_saved_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
+
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->link.iphc_saved));
 }
 
-static ssize_t lora_invert_iq_show(
+/**
+ * Gets the number of changes of the rate picked by rate control.
+ * @context - process
+ */
+static ssize_t rate_control_changes_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -4195,59 +15242,29 @@ static ssize_t lora_invert_iq_show(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (mutex_lock_interruptible(&priv->lock)) {
-    return -ERESTARTSYS;
-  }
-
-  bool invert_iq = priv->cfg.lora.packet.iq == SX1280_LORA_IQ_INVERTED;
-  mutex_unlock(&priv->lock);
-
-  return sprintf(buf, "%d\n", invert_iq);
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->rc.changes));
 }
 
-static ssize_t lora_invert_iq_store(
+/**
+ * Gets the number of frames sent at a neighbouring rate by rate control.
+ * @context - process
+ */
+static ssize_t rate_control_probes_show(
   struct device *dev,
   struct device_attribute *attr,
-  const char *buf,
-  size_t count
+  char *buf
 ) {
-  int err;
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  bool invert_iq;
-  if ((err = kstrtobool(buf, &invert_iq))) {
-    return err;
-  }
-
-  enum sx1280_lora_iq iq = invert_iq
-    ? SX1280_LORA_IQ_INVERTED
-    : SX1280_LORA_IQ_STD;
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
-    return err;
-  }
-
-  if (priv->cfg.mode == SX1280_MODE_LORA) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_LORA,
-      .lora = priv->cfg.lora.packet,
-    };
-    packet_params.lora.iq = iq;
-
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
-    }
-  }
-
-  priv->cfg.lora.packet.iq = iq;
-
-fail:
-  mutex_unlock(&priv->lock);
-  return err ? err : count;
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->rc.probes));
 }
 
-static ssize_t lora_preamble_bits_show(
+/**
+ * Gets the total time spent receiving packets, in nanoseconds.
+ * @context - process
+ */
+static ssize_t rx_airtime_ns_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -4255,80 +15272,33 @@ static ssize_t lora_preamble_bits_show(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (mutex_lock_interruptible(&priv->lock)) {
-    return -ERESTARTSYS;
-  }
-
-  u8 preamble_length = priv->cfg.lora.packet.preamble_length;
-  mutex_unlock(&priv->lock);
-
-  u8 mantissa = preamble_length & 0xF;
-  u8 exponent = preamble_length >> 4;
-  u32 bits = (u32) mantissa << (u32) exponent;
-  return sprintf(buf, "%d\n", bits);
+  return sprintf(
+    buf,
+    "%llu\n",
+    sx1280_stats_read(priv, offsetof(struct sx1280_pcpu_stats, rx_airtime_ns))
+  );
 }
 
 /**
- *
+ * Gets the number of TDMA beacons sent or received.
  * @context - process
  */
-static ssize_t lora_preamble_bits_store(
+static ssize_t tdma_beacons_show(
   struct device *dev,
   struct device_attribute *attr,
-  const char *buf,
-  size_t count
+  char *buf
 ) {
-  int err;
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  u32 preamble_bits;
-  if ((err = kstrtou32(buf, 10, &preamble_bits))) {
-    return err;
-  }
-
-  /*
-   * The LoRa preamble length format is different from the others:
-   * Bits [3:0] - mantissa
-   * Bits [7:4] - exponent
-   *
-   * The mantissa and exponent most both be in the range [1, 15].
-   * */
-  u8 preamble_length = 0;
-  if (preamble_bits > 0) {
-    u32 exponent = __ffs(preamble_bits);
-    u32 mantissa = preamble_bits >> exponent;
-    if (exponent < 1 || exponent > 15 || mantissa < 1 || mantissa > 15) {
-      return -EINVAL;
-    }
-
-    preamble_length = SX1280_LORA_PREAMBLE_LENGTH(exponent, mantissa);
-  }
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
-    return err;
-  }
-
-  if (priv->cfg.mode == SX1280_MODE_LORA) {
-    struct sx1280_packet_params packet_params = {
-      .mode = SX1280_MODE_LORA,
-      .lora = priv->cfg.lora.packet,
-    };
-    packet_params.lora.preamble_length = preamble_length;
-
-    if ((err = sx1280_set_packet_params(priv, packet_params))) {
-      goto fail;
-    }
-  }
-
-  priv->cfg.lora.packet.preamble_length = preamble_length;
-
-fail:
-  mutex_unlock(&priv->lock);
-  return err ? err : count;
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->tdma.beacons));
 }
 
-static ssize_t lora_spreading_factor_show(
+/**
+ * Gets the number of TDMA beacons that didn't arrive when expected.
+ * @context - process
+ */
+static ssize_t tdma_beacons_missed_show(
   struct device *dev,
   struct device_attribute *attr,
   char *buf
@@ -4336,124 +15306,126 @@ static ssize_t lora_spreading_factor_show(
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  if (mutex_lock_interruptible(&priv->lock)) {
-    return -ERESTARTSYS;
-  }
-
-  enum sx1280_lora_spreading_factor sf =
-    priv->cfg.lora.modulation.spreading_factor;
-  mutex_unlock(&priv->lock);
-
-  int f;
-  switch (sf) {
-  case SX1280_LORA_SF_5:  f = 5;  break;
-  case SX1280_LORA_SF_6:  f = 6;  break;
-  case SX1280_LORA_SF_7:  f = 7;  break;
-  case SX1280_LORA_SF_8:  f = 8;  break;
-  case SX1280_LORA_SF_9:  f = 9;  break;
-  case SX1280_LORA_SF_10: f = 10; break;
-  case SX1280_LORA_SF_11: f = 11; break;
-  case SX1280_LORA_SF_12: f = 12; break;
-  default:
-    WARN(1, "invalid internal cfg.lora.modulation.spreading_factor: %d\n", sf);
-    return -EINVAL;
-  }
-
-  return sprintf(buf, "%d\n", f);
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->tdma.beacons_missed));
 }
 
-static ssize_t lora_spreading_factor_store(
+/**
+ * Gets the total time spent transmitting, in nanoseconds.
+ * @context - process
+ */
+static ssize_t tx_airtime_ns_show(
   struct device *dev,
   struct device_attribute *attr,
-  const char *buf,
-  size_t count
+  char *buf
 ) {
-  int err;
   struct net_device *netdev = to_net_dev(dev);
   struct sx1280_priv *priv = netdev_priv(netdev);
 
-  int factor;
-  if ((err = kstrtoint(buf, 10, &factor))) {
-    return err;
-  }
-
-  enum sx1280_lora_spreading_factor spreading_factor;
-  switch (factor) {
-  case 5:  spreading_factor = SX1280_LORA_SF_5;  break;
-  case 6:  spreading_factor = SX1280_LORA_SF_6;  break;
-  case 7:  spreading_factor = SX1280_LORA_SF_7;  break;
-  case 8:  spreading_factor = SX1280_LORA_SF_8;  break;
-  case 9:  spreading_factor = SX1280_LORA_SF_9;  break;
-  case 10: spreading_factor = SX1280_LORA_SF_10; break;
-  case 11: spreading_factor = SX1280_LORA_SF_11; break;
-  case 12: spreading_factor = SX1280_LORA_SF_12; break;
-  default:
-    return -EINVAL;
-  }
-
-  if ((err = sx1280_acquire_idle_if_mode(priv, SX1280_MODE_LORA, false))) {
-    return err;
-  }
-
-  if (priv->cfg.mode == SX1280_MODE_LORA) {
-    struct sx1280_modulation_params mod_params = {
-      .mode = SX1280_MODE_LORA,
-      .lora = priv->cfg.lora.modulation,
-    };
-    mod_params.lora.spreading_factor = spreading_factor;
-
-    if ((err = sx1280_set_modulation_params(priv, mod_params))) {
-      goto fail;
-    }
-  }
+  return sprintf(
+    buf,
+    "%llu\n",
+    sx1280_stats_read(priv, offsetof(struct sx1280_pcpu_stats, tx_airtime_ns))
+  );
+}
 
-  priv->cfg.lora.modulation.spreading_factor = spreading_factor;
+/**
+ * Gets the number of times the queue was stopped by the airtime queue limit,
+ * before the ring was full of packets.
+ * @context - process
+ */
+static ssize_t tx_airtime_stops_show(
+  struct device *dev,
+  struct device_attribute *attr,
+  char *buf
+) {
+  struct net_device *netdev = to_net_dev(dev);
+  struct sx1280_priv *priv = netdev_priv(netdev);
 
-fail:
-  mutex_unlock(&priv->lock);
-  return err ? err : count;
+  return sprintf(buf, "%lu\n", READ_ONCE(priv->aql.stops));
 }
 
-static struct device_attribute dev_attr_lora_bandwidth =
-  __ATTR(bandwidth, 0644, lora_bandwidth_show, lora_bandwidth_store);
-static struct device_attribute dev_attr_lora_coding_rate =
-  __ATTR(coding_rate, 0644, lora_coding_rate_show, lora_coding_rate_store);
-static struct device_attribute dev_attr_lora_crc_enable =
-  __ATTR(crc_enable, 0644, lora_crc_enable_show, lora_crc_enable_store);
-static struct device_attribute dev_attr_lora_invert_iq =
-  __ATTR(invert_iq, 0644, lora_invert_iq_show, lora_invert_iq_store);
-static struct device_attribute dev_attr_lora_preamble_bits =
-  __ATTR(preamble_bits, 0644, lora_preamble_bits_show, lora_preamble_bits_store);
-static struct device_attribute dev_attr_lora_spreading_factor =
-  __ATTR(spreading_factor, 0644, lora_spreading_factor_show, lora_spreading_factor_store);
-
-static struct attribute *sx1280_lora_attrs[] = {
-  &dev_attr_lora_bandwidth.attr,
-  &dev_attr_lora_coding_rate.attr,
-  &dev_attr_lora_crc_enable.attr,
-  &dev_attr_lora_invert_iq.attr,
-  &dev_attr_lora_preamble_bits.attr,
-  &dev_attr_lora_spreading_factor.attr,
+static DEVICE_ATTR_RO(aggregated_packets);
+static DEVICE_ATTR_RO(acs_switches);
+static DEVICE_ATTR_RO(adr_changes);
+static DEVICE_ATTR_RO(arq_acked);
+static DEVICE_ATTR_RO(arq_duplicates);
+static DEVICE_ATTR_RO(arq_failures);
+static DEVICE_ATTR_RO(arq_retransmissions);
+static DEVICE_ATTR_RO(compression_bytes_in);
+static DEVICE_ATTR_RO(compression_bytes_out);
+static DEVICE_ATTR_RO(compression_ns);
+static DEVICE_ATTR_RO(csma_busy_ns);
+static DEVICE_ATTR_RO(csma_deferrals);
+static DEVICE_ATTR_RO(csma_failures);
+static DEVICE_ATTR_RO(decompression_ns);
+static DEVICE_ATTR_RO(duty_cycle_throttled_ns);
+static DEVICE_ATTR_RO(duty_cycle_throttles);
+static DEVICE_ATTR_RO(elided_commands);
+static DEVICE_ATTR_RO(fhss_hops);
+static DEVICE_ATTR_RO(header_bytes_saved);
+static DEVICE_ATTR_RO(rate_control_changes);
+static DEVICE_ATTR_RO(rate_control_probes);
+static DEVICE_ATTR_RO(rx_airtime_ns);
+static DEVICE_ATTR_RO(tdma_beacons);
+static DEVICE_ATTR_RO(tdma_beacons_missed);
+static DEVICE_ATTR_RO(tx_airtime_ns);
+static DEVICE_ATTR_RO(tx_airtime_stops);
+
+static struct attribute *sx1280_counters_attrs[] = {
+  &dev_attr_acs_switches.attr,
+  &dev_attr_adr_changes.attr,
+  &dev_attr_aggregated_packets.attr,
+  &dev_attr_arq_acked.attr,
+  &dev_attr_arq_duplicates.attr,
+  &dev_attr_arq_failures.attr,
+  &dev_attr_arq_retransmissions.attr,
+  &dev_attr_compression_bytes_in.attr,
+  &dev_attr_compression_bytes_out.attr,
+  &dev_attr_compression_ns.attr,
+  &dev_attr_csma_busy_ns.attr,
+  &dev_attr_csma_deferrals.attr,
+  &dev_attr_csma_failures.attr,
+  &dev_attr_decompression_ns.attr,
+  &dev_attr_duty_cycle_throttled_ns.attr,
+  &dev_attr_duty_cycle_throttles.attr,
+  &dev_attr_elided_commands.attr,
+  &dev_attr_fhss_hops.attr,
+  &dev_attr_header_bytes_saved.attr,
+  &dev_attr_rate_control_changes.attr,
+  &dev_attr_rate_control_probes.attr,
+  &dev_attr_rx_airtime_ns.attr,
+  &dev_attr_tdma_beacons.attr,
+  &dev_attr_tdma_beacons_missed.attr,
+  &dev_attr_tx_airtime_ns.attr,
+  &dev_attr_tx_airtime_stops.attr,
   NULL,
 };
 
-static struct attribute_group sx1280_lora_group = {
-  .attrs = sx1280_lora_attrs,
-  .name = "lora",
+static struct attribute_group sx1280_counters_group = {
+  .attrs = sx1280_counters_attrs,
+  .name = "counters",
 };
 
 static DEVICE_ATTR_RO(busy);
+static DEVICE_ATTR_RW(cpu_affinity);
 static DEVICE_ATTR_RW(crc_seed);
 static DEVICE_ATTR_RW(frequency);
 static DEVICE_ATTR_RW(mode);
+static DEVICE_ATTR_RW(realtime);
+static DEVICE_ATTR_RW(tx_airtime_target_us);
 static DEVICE_ATTR_RW(tx_power);
+static DEVICE_ATTR_RW(tx_ring_depth);
 
 static struct attribute *sx1280_attrs[] = {
   &dev_attr_busy.attr,
+  &dev_attr_cpu_affinity.attr,
   &dev_attr_crc_seed.attr,
   &dev_attr_frequency.attr,
   &dev_attr_mode.attr,
+  &dev_attr_realtime.attr,
+  &dev_attr_tx_airtime_target_us.attr,
   &dev_attr_tx_power.attr,
+  &dev_attr_tx_ring_depth.attr,
   NULL,
 };
 
@@ -4466,6 +15438,10 @@ static const struct attribute_group *sx1280_groups[] = {
   &sx1280_flrc_group,
   &sx1280_gfsk_group,
   &sx1280_lora_group,
+  &sx1280_link_group,
+  &sx1280_mac_group,
+  &sx1280_survey_group,
+  &sx1280_counters_group,
   NULL,
 };
 
@@ -4483,9 +15459,9 @@ static void sx1280_configure(struct net_device *dev) {
   dev->addr_len = 0;
 
   /* MTU defaults and bounds */
-  dev->mtu = SX1280_GFSK_PAYLOAD_LENGTH_MAX;
+  dev->mtu = SX1280_LINK_MTU_DEFAULT;
   dev->min_mtu = 1;
-  dev->max_mtu = SX1280_GFSK_PAYLOAD_LENGTH_MAX;
+  dev->max_mtu = SX1280_LINK_PAYLOAD_MAX;
 
   /* Point-to-point interface, no broadcasting */
   dev->flags = IFF_POINTOPOINT | IFF_NOARP;
@@ -4519,24 +15495,71 @@ static int sx1280_probe(struct spi_device *spi) {
   struct sx1280_priv *priv = netdev_priv(netdev);
   priv->cfg = sx1280_default_config;
   priv->initialized = false;
+  priv->tx_ring_depth = SX1280_TX_RING_DEPTH_DEFAULT;
+  priv->aql.target_us = SX1280_AQL_TARGET_US_DEFAULT;
   priv->netdev = netdev;
   priv->spi = spi;
   mutex_init(&priv->lock);
   spin_lock_init(&priv->tx_lock);
   init_waitqueue_head(&priv->idle_wait);
+  init_completion(&priv->busy_done);
+  init_completion(&priv->async.done);
+  skb_queue_head_init(&priv->rx_queue);
+  netif_napi_add(netdev, &priv->napi, sx1280_poll);
+  atomic_set(&priv->busy_armed, 0);
+  priv->busy_spin_us = SX1280_BUSY_SPIN_MAX_US;
+
+  priv->stats = netdev_alloc_pcpu_stats(struct sx1280_pcpu_stats);
+  if (!priv->stats) {
+    err = -ENOMEM;
+    goto error_free;
+  }
+
+  /*
+   * Create the worker that services the chip. This has to come before the
+   * interrupts are requested, as the DIO interrupt hands off to it.
+   */
+  kthread_init_work(&priv->tx_work, sx1280_tx_work);
+  kthread_init_work(&priv->irq_work, sx1280_irq_work);
+  kthread_init_work(&priv->arq.work, sx1280_arq_work);
+  kthread_init_work(&priv->mac.work, sx1280_mac_work);
+  kthread_init_work(&priv->tdma.work, sx1280_tdma_work);
+  kthread_init_work(&priv->duty.work, sx1280_duty_work);
+  kthread_init_work(&priv->fhss.work, sx1280_fhss_work);
+  INIT_WORK(&priv->acs.work, sx1280_acs_work);
+  kthread_init_work(&priv->adr.work, sx1280_adr_work);
+  kthread_init_work(&priv->rc.work, sx1280_rc_work);
+  kthread_init_work(&priv->rc.turnaround_work, sx1280_rc_turnaround_work);
+
+  /* Since 6.14, kthread_create_worker leaves the thread for the caller to wake. */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+  priv->worker = kthread_run_worker(0, "sx1280-%s", dev_name(&spi->dev));
+#else
+  priv->worker = kthread_create_worker(0, "sx1280-%s", dev_name(&spi->dev));
+#endif
+  if (IS_ERR(priv->worker)) {
+    dev_err(&spi->dev, "failed to create worker\n");
+    err = PTR_ERR(priv->worker);
+    goto error_stats;
+  }
+
+  sched_set_fifo(priv->worker->task);
+  priv->realtime = true;
 
   /*
    * Parse GPIOs according to whether a device tree or platform data is used.
    */
   if ((err = sx1280_setup_gpios(priv))) {
     dev_err(&spi->dev, "failed to configure GPIOs\n");
-    goto error_free;
+    goto error_worker;
   }
 
-  /* Define SPI settings according to SX1280 datasheet. */
+  /*
+   * Define SPI settings according to SX1280 datasheet. The clock is taken from
+   * the device tree, and validated before setup.
+   */
   spi_set_drvdata(spi, priv);
   spi->bits_per_word = 8;
-  spi->max_speed_hz = 5000000;  /* TODO: change to 18 MHz */
   spi->mode = 0;                 /* CPOL = 0, CPHA = 0 */
 
   /* Apply the SPI settings above and handle errors. */
@@ -4544,23 +15567,19 @@ static int sx1280_probe(struct spi_device *spi) {
   irq_mask[priv->dio_index - 1] = 0xFFFF;
   if (
     (err = spi_setup(spi))
+    || (err = sx1280_setup_spi_speed(priv))
     || (err = sx1280_setup(priv))
     || (err = sx1280_set_dio_irq_params(priv, 0xFFFF, irq_mask))
+    || (err = sx1280_setup_cmds(priv))
+    || (err = sx1280_setup_rx_readout(priv))
+    || (err = sx1280_setup_link(priv))
+    || (err = sx1280_setup_mac(priv))
   ) {
-    goto error_free;
+    goto error_irq;
   }
 
   netdev_dbg(netdev, "configured DIO%d as IRQ", priv->dio_index);
 
-  /* Initialize the work queue and work items for packet transmission. */
-  priv->xmit_queue = alloc_workqueue(
-    "%s",
-    WQ_MEM_RECLAIM,
-    0,
-    netdev_name(netdev)
-  );
-
-  INIT_WORK(&priv->tx_work, sx1280_tx_work);
   mutex_lock(&priv->lock);
 
   /*
@@ -4583,12 +15602,17 @@ static int sx1280_probe(struct spi_device *spi) {
     goto error_unregister;
   }
 
+  if ((err = sysfs_create_bin_file(&netdev->dev.kobj, &bin_attr_spectrum))) {
+    netdev_err(netdev, "failed to create sysfs entries\n");
+    goto error_groups;
+  }
+
   /*
    * Set into continuous RX mode. Constantly look for packets and only switch to
    * TX when a packet is queued by userspace.
    */
   if ((err = sx1280_listen(priv))) {
-    goto error_groups;
+    goto error_bin;
   }
 
   /*
@@ -4606,13 +15630,20 @@ static int sx1280_probe(struct spi_device *spi) {
   dev_dbg(&spi->dev, "%s is listening for packets\n", netdev->name);
   return 0;
 
+error_bin:
+  sysfs_remove_bin_file(&netdev->dev.kobj, &bin_attr_spectrum);
 error_groups:
   sysfs_remove_groups(&netdev->dev.kobj, sx1280_groups);
 error_unregister:
   unregister_netdev(netdev);
 error_unlock:
   mutex_unlock(&priv->lock);
-  destroy_workqueue(priv->xmit_queue);
+error_irq:
+  disable_irq(priv->irq);
+error_worker:
+  kthread_destroy_worker(priv->worker);
+error_stats:
+  free_percpu(priv->stats);
 error_free:
   free_netdev(netdev);
   return err;
@@ -4623,21 +15654,45 @@ static void sx1280_remove(struct spi_device *spi) {
 
   /* TODO: Potentially need to free GPIOs for platform data instances. */
 
-  mutex_lock(&priv->lock);
-
-  if (priv->initialized) {
 #ifdef DEBUG
-    cancel_delayed_work_sync(&priv->status_check);
+  cancel_delayed_work_sync(&priv->status_check);
 #endif
 
-    sysfs_remove_groups(&priv->netdev->dev.kobj, sx1280_groups);
-    cancel_work_sync(&priv->tx_work);
-    destroy_workqueue(priv->xmit_queue);
-    unregister_netdev(priv->netdev);
-    free_netdev(priv->netdev);
-  }
+  sysfs_remove_bin_file(&priv->netdev->dev.kobj, &bin_attr_spectrum);
+  sysfs_remove_groups(&priv->netdev->dev.kobj, sx1280_groups);
+
+  /* Once unregistered, nothing more can be queued for transmission. */
+  unregister_netdev(priv->netdev);
+
+  /*
+   * Stop servicing the chip. The lock can't be held while the worker is
+   * flushed, since its work takes the lock too.
+   */
+  disable_irq(priv->irq);
 
+  mutex_lock(&priv->lock);
+  priv->initialized = false;
   mutex_unlock(&priv->lock);
+
+  hrtimer_cancel(&priv->link.agg_timer);
+  hrtimer_cancel(&priv->arq.timer);
+  hrtimer_cancel(&priv->mac.timer);
+  hrtimer_cancel(&priv->tdma.timer);
+  hrtimer_cancel(&priv->duty.timer);
+  hrtimer_cancel(&priv->fhss.timer);
+  hrtimer_cancel(&priv->acs.timer);
+  cancel_work_sync(&priv->acs.work);
+  hrtimer_cancel(&priv->adr.timer);
+  hrtimer_cancel(&priv->rc.timer);
+  hrtimer_cancel(&priv->rc.turnaround_timer);
+  kthread_destroy_worker(priv->worker);
+  sx1280_tx_purge(priv, false);
+  sx1280_reasm_flush(priv);
+  skb_queue_purge(&priv->rx_queue);
+  kvfree(priv->survey.result);
+  netif_napi_del(&priv->napi);
+  free_percpu(priv->stats);
+  free_netdev(priv->netdev);
 }
 
 static const struct of_device_id sx1280_of_match[] = {
@@ -0,0 +1,240 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+/*
+ * sx1280_tdma.h - TDMA superframe arithmetic for the SX1280 driver.
+ *
+ * This only works out where a node is in the superframe and what it should be
+ * doing there, from times passed in, so that it can be run against a simulated
+ * channel in userspace (tests/tdma_test.c) as well as by the driver. All times
+ * are CLOCK_MONOTONIC, in nanoseconds.
+ *
+ * Copyright (C) 2025 Jeff Shelton
+ */
+
+#ifndef SX1280_TDMA_H
+#define SX1280_TDMA_H
+
+#include <linux/bits.h>
+#include <linux/math64.h>
+#include <linux/types.h>
+
+/* Most slots a superframe is split into, as owned slots are a 32-bit mask. */
+#define SX1280_TDMA_SLOTS_MAX 32
+
+/* Beacons that may be missed in a row before a node considers itself lost. */
+#define SX1280_TDMA_BEACON_LOSS_MAX 3
+
+/* The shape of a superframe, the beacon's time on air, and a node's part. */
+struct sx1280_tdma_sched {
+  bool coordinator;
+  u64 superframe_ns;
+  u64 slot_ns;
+  u64 guard_ns;
+  u64 beacon_ns;
+  unsigned int slots;
+  u32 tx_slots;
+  u32 rx_slots;
+};
+
+/*
+ * Where a node stands against the coordinator: the start of the current
+ * superframe, the measured beacon period for coasting over missed beacons, and
+ * the start of the last owned slot a frame was sent in.
+ */
+struct sx1280_tdma_sync {
+  bool synced;
+  u64 epoch_ns;
+  u64 period_ns;
+  unsigned int misses;
+  u64 tx_slot_ns;
+};
+
+/* What a node is to do next. */
+enum sx1280_tdma_action {
+  /* Send the beacon, which starts the next superframe once it's done. */
+  SX1280_TDMA_BEACON,
+  /* Leave the chip as it is. */
+  SX1280_TDMA_WAIT,
+  /* Listen. */
+  SX1280_TDMA_LISTEN,
+  /* Stand by, unless there's still something to finish. */
+  SX1280_TDMA_STANDBY,
+  /* Send a frame in the owned slot at `slot_ns`, then listen for the ACK. */
+  SX1280_TDMA_TX,
+};
+
+struct sx1280_tdma_step {
+  enum sx1280_tdma_action action;
+
+  /* When to act again, or 0 if only a beacon will tell. */
+  u64 next_ns;
+  u64 slot_ns;
+
+  /* Whether a beacon was found missing, and whether that lost the sync. */
+  bool missed;
+  bool lost;
+};
+
+/**
+ * Works out the shape of a superframe from its configuration. The guard is
+ * capped at half a superframe, and slots that don't fit whole are left out.
+ */
+static inline void sx1280_tdma_sched_init(
+  struct sx1280_tdma_sched *sched,
+  bool coordinator,
+  u64 superframe_ns,
+  u64 slot_ns,
+  u64 guard_ns,
+  u64 beacon_ns,
+  u32 tx_slots,
+  u32 rx_slots
+) {
+  u64 slots = div64_u64(superframe_ns, slot_ns);
+
+  sched->coordinator = coordinator;
+  sched->superframe_ns = superframe_ns;
+  sched->slot_ns = slot_ns;
+  sched->guard_ns = guard_ns < superframe_ns / 2 ? guard_ns : superframe_ns / 2;
+  sched->beacon_ns = beacon_ns;
+  sched->slots = slots < SX1280_TDMA_SLOTS_MAX ? slots : SX1280_TDMA_SLOTS_MAX;
+  sched->tx_slots = tx_slots;
+  sched->rx_slots = rx_slots;
+}
+
+/**
+ * Forgets the superframe, until the next beacon is sent or heard. Until a
+ * period is measured, it's taken to be the superframe and the beacon.
+ */
+static inline void sx1280_tdma_sync_reset(
+  struct sx1280_tdma_sync *sync,
+  const struct sx1280_tdma_sched *sched
+) {
+  sync->synced = false;
+  sync->misses = 0;
+  sync->period_ns = sched->superframe_ns + sched->beacon_ns;
+}
+
+/**
+ * Starts the superframe that a beacon sent or received at `beacon_ns` marks
+ * the start of.
+ *
+ * The beacon period is the superframe plus the beacon's own time on air, so
+ * it's measured between consecutive beacons for coasting over missed ones.
+ * Periods that span a missed beacon, or that are out of all proportion to the
+ * superframe, are left out.
+ */
+static inline void sx1280_tdma_sync_beacon(
+  struct sx1280_tdma_sync *sync,
+  const struct sx1280_tdma_sched *sched,
+  u64 beacon_ns
+) {
+  u64 period_ns = beacon_ns - sync->epoch_ns;
+
+  if (
+    sync->synced
+    && !sync->misses
+    && period_ns >= sched->superframe_ns
+    && period_ns < 2 * sched->superframe_ns
+  ) {
+    sync->period_ns = period_ns;
+  }
+
+  sync->epoch_ns = beacon_ns;
+  sync->synced = true;
+  sync->misses = 0;
+}
+
+/**
+ * Works out what to do at `now_ns`: send or wait for the beacon, open an owned
+ * slot, or listen or stand by, and when to act again.
+ *
+ * The coordinator sends the beacon as soon as the superframe is over. Other
+ * nodes listen for it from `guard_ns` before it's due to start until
+ * `guard_ns` after it's due to be done, a period after the last one. If it
+ * doesn't come, they carry on from when it should have, until
+ * SX1280_TDMA_BEACON_LOSS_MAX have been missed in a row.
+ */
+static inline struct sx1280_tdma_step sx1280_tdma_step(
+  struct sx1280_tdma_sync *sync,
+  const struct sx1280_tdma_sched *sched,
+  u64 now_ns
+) {
+  struct sx1280_tdma_step step = { .action = SX1280_TDMA_WAIT };
+
+  /* Without a beacon to go by, nodes can only listen for one. */
+  if (!sync->synced) {
+    step.action = sched->coordinator ? SX1280_TDMA_BEACON : SX1280_TDMA_LISTEN;
+    return step;
+  }
+
+  u64 end_ns = sync->epoch_ns + sched->superframe_ns;
+
+  if (now_ns + sched->guard_ns >= end_ns) {
+    if (sched->coordinator) {
+      if (now_ns >= end_ns) {
+        step.action = SX1280_TDMA_BEACON;
+      } else {
+        step.next_ns = end_ns;
+      }
+
+      return step;
+    }
+
+    /* Listen out for the beacon, either side of when it's expected. */
+    u64 due_ns = sync->epoch_ns + sync->period_ns + sched->guard_ns;
+    if (now_ns < due_ns) {
+      step.action = SX1280_TDMA_LISTEN;
+      step.next_ns = due_ns;
+      return step;
+    }
+
+    step.missed = true;
+    if (++sync->misses > SX1280_TDMA_BEACON_LOSS_MAX) {
+      sync->synced = false;
+      step.action = SX1280_TDMA_LISTEN;
+      step.lost = true;
+      return step;
+    }
+
+    /* Carry on from when the beacon should have been. */
+    sync->epoch_ns += sync->period_ns;
+    if (now_ns < sync->epoch_ns) {
+      step.next_ns = sync->epoch_ns;
+      return step;
+    }
+  }
+
+  /* Nodes are to be listening for the beacon a guard before it's due. */
+  u64 beacon_ns = sync->epoch_ns + sched->superframe_ns
+    - (sched->coordinator ? 0 : sched->guard_ns);
+  u64 slot = div64_u64(now_ns - sync->epoch_ns, sched->slot_ns);
+
+  /* The end of the superframe not taken up by whole slots. */
+  if (slot >= sched->slots) {
+    step.action = SX1280_TDMA_STANDBY;
+    step.next_ns = beacon_ns;
+    return step;
+  }
+
+  u32 bit = BIT(slot);
+
+  step.slot_ns = sync->epoch_ns + slot * sched->slot_ns;
+  step.next_ns = step.slot_ns + sched->slot_ns;
+  if (step.next_ns > beacon_ns) {
+    step.next_ns = beacon_ns;
+  }
+
+  /* Owned slots are listened in too, for ACKs. */
+  if ((sched->tx_slots & bit) && sync->tx_slot_ns != step.slot_ns) {
+    sync->tx_slot_ns = step.slot_ns;
+    step.action = SX1280_TDMA_TX;
+  } else if ((sched->tx_slots | sched->rx_slots) & bit) {
+    step.action = SX1280_TDMA_LISTEN;
+  } else {
+    step.action = SX1280_TDMA_STANDBY;
+  }
+
+  return step;
+}
+
+#endif
@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+/* Userspace stand-in for the kernel's <linux/bits.h>, for tests only. */
+
+#ifndef SX1280_TEST_LINUX_BITS_H
+#define SX1280_TEST_LINUX_BITS_H
+
+#define BIT(nr) (1UL << (nr))
+
+#endif
@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+/* Userspace stand-in for the kernel's <linux/math64.h>, for tests only. */
+
+#ifndef SX1280_TEST_LINUX_MATH64_H
+#define SX1280_TEST_LINUX_MATH64_H
+
+#include <linux/types.h>
+
+static inline u64 div64_u64(u64 dividend, u64 divisor) {
+  return dividend / divisor;
+}
+
+#endif
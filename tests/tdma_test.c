@@ -0,0 +1,396 @@
+// SPDX-License-Identifier: GPL-2.0-only
+
+/*
+ * tdma_test.c - Runs the TDMA superframe arithmetic against a simulated
+ * channel: a coordinator and two nodes, beacons lost on the way to either, and
+ * timers that fire late by a deterministic amount. Build and run with
+ * `make test`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../sx1280_tdma.h"
+
+#define MS 1000000ULL
+#define US 1000ULL
+
+#define SUPERFRAME_NS (100 * MS)
+#define SLOT_NS (10 * MS)
+#define GUARD_NS (1 * MS)
+
+/* Longer than the guard, as LoRa beacons are. */
+#define BEACON_NS (3 * MS)
+#define FRAME_NS (4 * MS)
+#define LATENCY_MAX_NS (200 * US)
+
+#define SUPERFRAMES 40
+#define TXS_MAX 1024
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    failures++; \
+  } \
+} while (0)
+
+enum sim_radio {
+  SIM_STANDBY,
+  SIM_RX,
+  SIM_TX,
+};
+
+struct sim_node {
+  const char *name;
+  struct sx1280_tdma_sched sched;
+  struct sx1280_tdma_sync sync;
+
+  /* When the timer fires, or 0 if it isn't armed. */
+  u64 timer_ns;
+
+  enum sim_radio radio;
+  u64 radio_ns;
+  u64 tx_end_ns;
+  bool tx_beacon;
+
+  /* Beacons dropped on the way to this node, as a mask of their numbers. */
+  u64 dropped;
+
+  u64 radio_total_ns[3];
+  unsigned int beacons;
+  unsigned int missed;
+  unsigned int lost;
+};
+
+struct sim_tx {
+  unsigned int node;
+  u64 start_ns;
+  u64 end_ns;
+  bool beacon;
+};
+
+static unsigned int failures;
+static u32 seed = 1;
+
+static struct sim_node nodes[3];
+static struct sim_tx txs[TXS_MAX];
+static unsigned int n_txs;
+
+/* The end of each beacon: where the coordinator's superframes really start. */
+static u64 epochs[SUPERFRAMES + 2];
+static unsigned int n_epochs;
+
+/**
+ * Gets how late a timer fires, from a fixed pseudo-random sequence.
+ */
+static u64 sim_latency(void) {
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) % LATENCY_MAX_NS;
+}
+
+static void sim_radio(struct sim_node *node, enum sim_radio radio, u64 now) {
+  node->radio_total_ns[node->radio] += now - node->radio_ns;
+  node->radio = radio;
+  node->radio_ns = now;
+}
+
+static void sim_tx_start(struct sim_node *node, u64 now, u64 len_ns, bool beacon) {
+  sim_radio(node, SIM_TX, now);
+  node->tx_end_ns = now + len_ns;
+  node->tx_beacon = beacon;
+
+  if (n_txs < TXS_MAX) {
+    txs[n_txs++] = (struct sim_tx) {
+      .node = node - nodes,
+      .start_ns = now,
+      .end_ns = now + len_ns,
+      .beacon = beacon,
+    };
+  }
+}
+
+/**
+ * Does what sx1280_tdma_event() does in the driver, on the simulated radio.
+ */
+static void sim_event(struct sim_node *node, u64 now) {
+  struct sx1280_tdma_step step = sx1280_tdma_step(&node->sync, &node->sched, now);
+
+  node->missed += step.missed;
+  node->lost += step.lost;
+  node->timer_ns = 0;
+
+  switch (step.action) {
+  case SX1280_TDMA_BEACON:
+    CHECK(node->radio != SIM_TX);
+    sim_tx_start(node, now, BEACON_NS, true);
+    return;
+  case SX1280_TDMA_WAIT:
+    break;
+  case SX1280_TDMA_LISTEN:
+    if (node->radio == SIM_STANDBY) {
+      sim_radio(node, SIM_RX, now);
+    }
+    break;
+  case SX1280_TDMA_STANDBY:
+    if (node->radio == SIM_RX) {
+      sim_radio(node, SIM_STANDBY, now);
+    }
+    break;
+  case SX1280_TDMA_TX:
+    if (node->radio != SIM_TX) {
+      sim_tx_start(node, now, FRAME_NS, false);
+    }
+    break;
+  }
+
+  if (step.next_ns) {
+    node->timer_ns = step.next_ns + sim_latency();
+  }
+}
+
+/**
+ * Finishes a transmission. The chip goes back to listening, and a beacon is
+ * heard by every node that was listening throughout, unless it's dropped.
+ */
+static void sim_tx_done(struct sim_node *node, u64 now) {
+  node->tx_end_ns = 0;
+  sim_radio(node, SIM_RX, now);
+
+  if (!node->tx_beacon) {
+    return;
+  }
+
+  unsigned int number = n_epochs;
+  u64 start = now - BEACON_NS;
+
+  epochs[n_epochs++] = now;
+  sx1280_tdma_sync_beacon(&node->sync, &node->sched, now);
+  node->beacons++;
+
+  for (unsigned int i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++) {
+    struct sim_node *peer = &nodes[i];
+
+    if (
+      peer == node
+      || (peer->dropped & (1ULL << number))
+      || peer->radio != SIM_RX
+      || peer->radio_ns > start
+    ) {
+      continue;
+    }
+
+    sx1280_tdma_sync_beacon(&peer->sync, &peer->sched, now);
+    peer->beacons++;
+    sim_event(peer, now);
+  }
+
+  sim_event(node, now);
+}
+
+static void sim_init(
+  struct sim_node *node,
+  const char *name,
+  bool coordinator,
+  u32 tx_slots,
+  u32 rx_slots
+) {
+  node->name = name;
+  sx1280_tdma_sched_init(
+    &node->sched,
+    coordinator,
+    SUPERFRAME_NS,
+    SLOT_NS,
+    GUARD_NS,
+    BEACON_NS,
+    tx_slots,
+    rx_slots
+  );
+  sx1280_tdma_sync_reset(&node->sync, &node->sched);
+}
+
+/**
+ * Runs the simulation until the coordinator has sent all its beacons, always
+ * finishing transmissions before firing timers due at the same time.
+ */
+static void sim_run(void) {
+  u64 now = 0;
+
+  for (unsigned int i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++) {
+    sim_event(&nodes[i], nodes[i].sched.coordinator ? MS : 0);
+  }
+
+  while (n_epochs < SUPERFRAMES) {
+    struct sim_node *next = NULL;
+    bool tx = false;
+    u64 when = 0;
+
+    for (unsigned int i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++) {
+      struct sim_node *node = &nodes[i];
+
+      if (node->tx_end_ns && (!next || node->tx_end_ns <= when)) {
+        next = node;
+        when = node->tx_end_ns;
+        tx = true;
+      }
+    }
+
+    for (unsigned int i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++) {
+      struct sim_node *node = &nodes[i];
+
+      if (node->timer_ns && (!next || node->timer_ns < when)) {
+        next = node;
+        when = node->timer_ns;
+        tx = false;
+      }
+    }
+
+    if (!next) {
+      fprintf(stderr, "simulation stalled\n");
+      failures++;
+      return;
+    }
+
+    CHECK(when >= now);
+    now = when;
+
+    if (tx) {
+      sim_tx_done(next, now);
+    } else {
+      sim_event(next, now);
+    }
+  }
+
+  for (unsigned int i = 0; i < sizeof(nodes) / sizeof(nodes[0]); i++) {
+    sim_radio(&nodes[i], nodes[i].radio, now);
+  }
+}
+
+/**
+ * Gets the superframe a time falls in, by the coordinator's beacons.
+ */
+static int sim_superframe(u64 ns) {
+  int k = -1;
+
+  for (unsigned int i = 0; i < n_epochs && epochs[i] <= ns; i++) {
+    k = i;
+  }
+
+  return k;
+}
+
+/**
+ * Finds whether a node sent a frame in a superframe.
+ */
+static bool sim_sent_in(unsigned int node, int k) {
+  for (unsigned int i = 0; i < n_txs; i++) {
+    if (txs[i].node == node && !txs[i].beacon && sim_superframe(txs[i].start_ns) == k) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void test_sched(void) {
+  struct sx1280_tdma_sched sched;
+
+  /* Slots are capped by the mask, and the guard at half a superframe. */
+  sx1280_tdma_sched_init(&sched, false, MS, 10 * US, 2 * MS, 0, 0, 0);
+  CHECK(sched.slots == SX1280_TDMA_SLOTS_MAX);
+  CHECK(sched.guard_ns == MS / 2);
+
+  /* Slots that don't fit whole are left out. */
+  sx1280_tdma_sched_init(&sched, false, 25 * MS, 10 * MS, 0, 0, 0, 0);
+  CHECK(sched.slots == 2);
+}
+
+static void test_channel(void) {
+  /* The coordinator owns slot 0, and listens to everyone else. */
+  sim_init(&nodes[0], "coordinator", true, BIT(0), 0x3fe);
+  sim_init(&nodes[1], "a", false, BIT(1), 0);
+  sim_init(&nodes[2], "b", false, BIT(2) | BIT(5), BIT(0));
+
+  /* A misses two beacons and coasts, B misses five and loses the sync. */
+  nodes[1].dropped = (1ULL << 10) | (1ULL << 11);
+  nodes[2].dropped = 0x1fULL << 20;
+
+  sim_run();
+
+  CHECK(n_epochs == SUPERFRAMES);
+
+  /* Nothing is ever on the air at the same time. */
+  for (unsigned int i = 1; i < n_txs; i++) {
+    CHECK(txs[i].start_ns >= txs[i - 1].end_ns);
+  }
+
+  /*
+   * Frames start within the guard of the start of an owned slot, by the
+   * coordinator's superframes, end within it, and there's one per slot.
+   */
+  int last_k[3] = { -1, -1, -1 };
+  u64 last_slot[3] = { 0 };
+
+  for (unsigned int i = 0; i < n_txs; i++) {
+    const struct sim_tx *t = &txs[i];
+
+    if (t->beacon) {
+      continue;
+    }
+
+    int k = sim_superframe(t->start_ns);
+    CHECK(k >= 0);
+    if (k < 0) {
+      continue;
+    }
+
+    u64 offset = t->start_ns - epochs[k];
+    u64 slot = (offset + SLOT_NS / 2) / SLOT_NS;
+    u64 start = slot * SLOT_NS;
+    u64 skew = offset > start ? offset - start : start - offset;
+
+    CHECK(nodes[t->node].sched.tx_slots & BIT(slot));
+    CHECK(skew <= GUARD_NS);
+    CHECK(offset + FRAME_NS <= start + SLOT_NS);
+    CHECK(k != last_k[t->node] || slot != last_slot[t->node]);
+
+    last_k[t->node] = k;
+    last_slot[t->node] = slot;
+  }
+
+  /* Everyone sends in every superframe they're in step with. */
+  for (int k = 0; k < SUPERFRAMES - 1; k++) {
+    CHECK(sim_sent_in(0, k));
+    CHECK(sim_sent_in(1, k));
+    CHECK(sim_sent_in(2, k) == (k < 23 || k > 24));
+  }
+
+  /* A coasts over its missed beacons, and hears every other one. */
+  CHECK(nodes[1].beacons == SUPERFRAMES - 2);
+  CHECK(nodes[1].missed == 2);
+  CHECK(nodes[1].lost == 0);
+
+  /* B gives up on the fourth, and picks the superframe up again after. */
+  CHECK(nodes[2].beacons == SUPERFRAMES - 5);
+  CHECK(nodes[2].missed == SX1280_TDMA_BEACON_LOSS_MAX + 1);
+  CHECK(nodes[2].lost == 1);
+  CHECK(nodes[2].sync.synced);
+
+  /* A only needs the chip for its own slot and the beacon. */
+  u64 a_total = nodes[1].radio_total_ns[SIM_STANDBY]
+    + nodes[1].radio_total_ns[SIM_RX]
+    + nodes[1].radio_total_ns[SIM_TX];
+  CHECK(nodes[1].radio_total_ns[SIM_STANDBY] * 10 >= a_total * 8);
+}
+
+int main(void) {
+  test_sched();
+  test_channel();
+
+  if (failures) {
+    fprintf(stderr, "%u check(s) failed\n", failures);
+    return EXIT_FAILURE;
+  }
+
+  printf("tdma: all checks passed\n");
+  return EXIT_SUCCESS;
+}